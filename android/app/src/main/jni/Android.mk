@@ -3,7 +3,8 @@ LOCAL_PATH := $(call my-dir)
 include $(CLEAR_VARS)
 
 LOCAL_MODULE    := gstplayer
-LOCAL_SRC_FILES := player.c
+LOCAL_SRC_FILES := player.c ../../../../../common/gst-player-state-snapshot.c
+LOCAL_C_INCLUDES := $(LOCAL_PATH)/../../../../../common
 
 LOCAL_SHARED_LIBRARIES := gstreamer_android
 LOCAL_LDLIBS := -llog -landroid
@@ -27,6 +27,8 @@
 
 #include <gst/player/player.h>
 
+#include "gst-player-state-snapshot.h"
+
 GST_DEBUG_CATEGORY_STATIC (debug_category);
 #define GST_CAT_DEFAULT debug_category
 
@@ -37,6 +39,7 @@ typedef struct _Player
 {
   jobject java_player;
   GstPlayer *player;
+  GstPlayerStateSnapshot *snapshot;
   GstPlayerVideoRenderer *renderer;
   ANativeWindow *native_window;
 } Player;
@@ -200,6 +203,7 @@ native_new (JNIEnv * env, jobject thiz)
 
   player->renderer = gst_player_video_overlay_video_renderer_new (NULL);
   player->player = gst_player_new (player->renderer, NULL);
+  player->snapshot = gst_player_state_snapshot_new (player->player);
   SET_CUSTOM_DATA (env, thiz, native_player_field_id, player);
   player->java_player = (*env)->NewGlobalRef (env, thiz);
 
@@ -227,6 +231,8 @@ native_free (JNIEnv * env, jobject thiz)
     return;
 
   g_object_unref (player->player);
+  /* only after the player, its signals are emitted from its own thread */
+  gst_player_state_snapshot_free (player->snapshot);
   (*env)->DeleteGlobalRef (env, player->java_player);
   g_free (player);
   SET_CUSTOM_DATA (env, thiz, native_player_field_id, NULL);
@@ -312,42 +318,42 @@ static jlong
 native_get_position (JNIEnv * env, jobject thiz)
 {
   Player *player = GET_CUSTOM_DATA (env, thiz, native_player_field_id);
-  jdouble position;
+  GstPlayerStateSnapshotData snapshot;
 
   if (!player)
     return -1;
 
-  g_object_get (player->player, "position", &position, NULL);
+  gst_player_state_snapshot_read (player->snapshot, &snapshot);
 
-  return position;
+  return snapshot.position;
 }
 
 static jlong
 native_get_duration (JNIEnv * env, jobject thiz)
 {
   Player *player = GET_CUSTOM_DATA (env, thiz, native_player_field_id);
-  jlong duration;
+  GstPlayerStateSnapshotData snapshot;
 
   if (!player)
     return -1;
 
-  g_object_get (player->player, "duration", &duration, NULL);
+  gst_player_state_snapshot_read (player->snapshot, &snapshot);
 
-  return duration;
+  return snapshot.duration;
 }
 
 static jdouble
 native_get_volume (JNIEnv * env, jobject thiz)
 {
   Player *player = GET_CUSTOM_DATA (env, thiz, native_player_field_id);
-  jdouble volume;
+  GstPlayerStateSnapshotData snapshot;
 
   if (!player)
     return 1.0;
 
-  g_object_get (player->player, "volume", &volume, NULL);
+  gst_player_state_snapshot_read (player->snapshot, &snapshot);
 
-  return volume;
+  return snapshot.volume;
 }
 
 static void
@@ -365,14 +371,14 @@ static jboolean
 native_get_mute (JNIEnv * env, jobject thiz)
 {
   Player *player = GET_CUSTOM_DATA (env, thiz, native_player_field_id);
-  jboolean mute;
+  GstPlayerStateSnapshotData snapshot;
 
   if (!player)
     return FALSE;
 
-  g_object_get (player->player, "mute", &mute, NULL);
+  gst_player_state_snapshot_read (player->snapshot, &snapshot);
 
-  return mute;
+  return snapshot.mute;
 }
 
 static void
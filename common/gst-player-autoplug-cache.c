@@ -0,0 +1,492 @@
+/* GStreamer
+ *
+ * Copyright (C) 2016 GStreamer developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Remembers which element decodebin ended up with for each kind of
+ * stream, so that later items with the same container and codecs don't
+ * try the candidates that failed before again, like hardware decoders
+ * that can't handle the profile.
+ *
+ * Once an item prerolled, every element inside a decodebin is stored
+ * for the caps on its sink pad, minus the fields that differ between
+ * files of the same profile (volatile_fields). Resolution and framerate
+ * are kept as coarse classes instead, decoders that are limited to some
+ * size or rate then don't get picked for larger streams. That is the
+ * demuxer, the
+ * parsers and the decoders of the chain. On later items the stored
+ * element is moved to the front of the candidates in "autoplug-sort".
+ * The others stay in the list, so a stored element that fails is only
+ * tried once more, and the decisions of an item that fails are dropped.
+ *
+ * The decisions are kept in the user's cache directory. With @warm, one
+ * instance of each stored element is created and dropped again in the
+ * background right away, so that their plugins are loaded and their
+ * classes are set up before the first item needs them.
+ *
+ * How long items take from creating the source until they prerolled is
+ * measured separately for those where all decisions were cached. Only
+ * playbin's decodebin is covered, not decodebin3. */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#include "gst-player-autoplug-cache.h"
+
+static const gchar *volatile_fields[] = {
+  "codec_data", "streamheader", "width", "height", "framerate",
+  "pixel-aspect-ratio", "colorimetry", "chroma-site", "rate", "channels",
+  "channel-mask", "bitrate"
+};
+
+/* the usual limits of hardware decoders */
+#define MAX_HD_PIXELS (1920 * 1088)
+#define MAX_UHD_PIXELS (4096 * 2304)
+#define MAX_NORMAL_FPS 30
+#define MAX_HIGH_FPS 60
+
+struct _GstPlayerAutoplugCache
+{
+  GstElement *pipeline;
+  GstBus *bus;
+  gchar *path;
+
+  gulong element_added_id;
+  gulong source_setup_id;
+  gulong state_changed_id;
+  gulong error_id;
+
+  GThread *warm_thread;
+  gchar **warm_factories;
+
+  GMutex lock;
+  /* caps without the volatile fields to factory name */
+  GHashTable *chains;
+  gboolean dirty;
+  /* decisions taken from the cache for the current item */
+  GHashTable *used;
+  gint64 item_start;
+  guint item_hits;
+  guint item_misses;
+
+  GstPlayerAutoplugStats stats;
+  guint64 cached_total;
+  guint64 uncached_total;
+};
+
+static gchar *
+caps_key (const GstCaps * caps)
+{
+  GstCaps *copy = gst_caps_copy (caps);
+  gchar *key;
+  guint i, j;
+
+  for (i = 0; i < gst_caps_get_size (copy); i++) {
+    GstStructure *s = gst_caps_get_structure (copy, i);
+    gint width, height, fps_n, fps_d;
+
+    if (gst_structure_get_int (s, "width", &width)
+        && gst_structure_get_int (s, "height", &height)) {
+      gint64 pixels = (gint64) width * height;
+
+      gst_structure_set (s, "size-class", G_TYPE_STRING,
+          pixels <= MAX_HD_PIXELS ? "hd" : pixels <= MAX_UHD_PIXELS ?
+          "uhd" : "larger", NULL);
+    }
+    if (gst_structure_get_fraction (s, "framerate", &fps_n, &fps_d)
+        && fps_d > 0) {
+      gst_structure_set (s, "rate-class", G_TYPE_STRING,
+          fps_n <= MAX_NORMAL_FPS * fps_d ? "normal" :
+          fps_n <= MAX_HIGH_FPS * fps_d ? "high" : "higher", NULL);
+    }
+
+    for (j = 0; j < G_N_ELEMENTS (volatile_fields); j++)
+      gst_structure_remove_field (s, volatile_fields[j]);
+  }
+  key = gst_caps_to_string (copy);
+  gst_caps_unref (copy);
+
+  return key;
+}
+
+/* one "FACTORY CAPS" per line */
+static void
+load_chains (GstPlayerAutoplugCache * self)
+{
+  gchar *contents, **lines, **line;
+
+  if (!g_file_get_contents (self->path, &contents, NULL, NULL))
+    return;
+
+  lines = g_strsplit (contents, "\n", -1);
+  for (line = lines; *line; line++) {
+    gchar *space = strchr (*line, ' ');
+
+    if (!space || space == *line || space[1] == '\0')
+      continue;
+
+    *space = '\0';
+    g_hash_table_insert (self->chains, g_strdup (space + 1),
+        g_strdup (*line));
+  }
+  g_strfreev (lines);
+  g_free (contents);
+
+  GST_DEBUG ("Loaded %u autoplug decisions from %s",
+      g_hash_table_size (self->chains), self->path);
+}
+
+static void
+save_chains (GstPlayerAutoplugCache * self)
+{
+  GHashTableIter iter;
+  gpointer key, value;
+  GString *contents;
+  gchar *dirname;
+
+  if (!self->dirty)
+    return;
+
+  contents = g_string_new (NULL);
+  g_hash_table_iter_init (&iter, self->chains);
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    g_string_append_printf (contents, "%s %s\n", (const gchar *) value,
+        (const gchar *) key);
+
+  dirname = g_path_get_dirname (self->path);
+  if (g_mkdir_with_parents (dirname, 0700) != 0
+      || !g_file_set_contents (self->path, contents->str, contents->len,
+          NULL))
+    GST_WARNING ("Could not write the autoplug decisions to %s", self->path);
+  g_free (dirname);
+  g_string_free (contents, TRUE);
+}
+
+static gpointer
+warm_thread (GstPlayerAutoplugCache * self)
+{
+  gchar **name;
+
+  for (name = self->warm_factories; *name; name++) {
+    GstElementFactory *factory = gst_element_factory_find (*name);
+    GstElement *element;
+
+    if (!factory)
+      continue;
+
+    /* the plugin and the class stay around afterwards */
+    element = gst_element_factory_create (factory, NULL);
+    if (element)
+      gst_object_unref (gst_object_ref_sink (element));
+    gst_object_unref (factory);
+  }
+
+  return NULL;
+}
+
+G_GNUC_BEGIN_IGNORE_DEPRECATIONS
+
+static GValueArray *
+autoplug_sort_cb (GstElement * decodebin, GstPad * pad, GstCaps * caps,
+    GValueArray * factories, GstPlayerAutoplugCache * self)
+{
+  GValueArray *sorted = NULL;
+  const gchar *name;
+  gchar *key;
+  guint i, cached = G_MAXUINT;
+
+  key = caps_key (caps);
+
+  g_mutex_lock (&self->lock);
+  name = g_hash_table_lookup (self->chains, key);
+  for (i = 0; name && i < factories->n_values; i++) {
+    GstPluginFeature *factory =
+        g_value_get_object (g_value_array_get_nth (factories, i));
+
+    if (g_strcmp0 (GST_OBJECT_NAME (factory), name) == 0) {
+      cached = i;
+      break;
+    }
+  }
+
+  if (cached != G_MAXUINT) {
+    self->item_hits++;
+    g_hash_table_add (self->used, key);
+    key = NULL;
+  } else {
+    self->item_misses++;
+  }
+  g_mutex_unlock (&self->lock);
+  g_free (key);
+
+  /* NULL keeps the order */
+  if (cached == G_MAXUINT || cached == 0)
+    return NULL;
+
+  sorted = g_value_array_new (factories->n_values);
+  g_value_array_append (sorted, g_value_array_get_nth (factories, cached));
+  for (i = 0; i < factories->n_values; i++)
+    if (i != cached)
+      g_value_array_append (sorted, g_value_array_get_nth (factories, i));
+
+  return sorted;
+}
+
+G_GNUC_END_IGNORE_DEPRECATIONS
+
+static void
+deep_element_added_cb (GstBin * bin, GstBin * sub_bin, GstElement * element,
+    GstPlayerAutoplugCache * self)
+{
+  GstElementFactory *factory = gst_element_get_factory (element);
+
+  if (factory && g_strcmp0 (GST_OBJECT_NAME (factory), "decodebin") == 0)
+    g_signal_connect (element, "autoplug-sort",
+        G_CALLBACK (autoplug_sort_cb), self);
+}
+
+/* the source is created first for every item */
+static void
+source_setup_cb (GstElement * playbin, GstElement * source,
+    GstPlayerAutoplugCache * self)
+{
+  g_mutex_lock (&self->lock);
+  g_hash_table_remove_all (self->used);
+  self->item_start = g_get_monotonic_time ();
+  self->item_hits = self->item_misses = 0;
+  g_mutex_unlock (&self->lock);
+}
+
+static void
+record_element (const GValue * value, GstPlayerAutoplugCache * self)
+{
+  GstElement *element = g_value_get_object (value);
+  GstElementFactory *factory = gst_element_get_factory (element);
+  GstObject *parent = gst_object_get_parent (GST_OBJECT (element));
+  GstElementFactory *parent_factory = NULL;
+  GstCaps *caps = NULL;
+  GstPad *pad;
+
+  if (parent && GST_IS_ELEMENT (parent))
+    parent_factory = gst_element_get_factory (GST_ELEMENT (parent));
+  if (parent)
+    gst_object_unref (parent);
+
+  /* only what decodebin plugged */
+  if (!factory || !parent_factory
+      || g_strcmp0 (GST_OBJECT_NAME (parent_factory), "decodebin") != 0)
+    return;
+
+  pad = gst_element_get_static_pad (element, "sink");
+  if (pad) {
+    caps = gst_pad_get_current_caps (pad);
+    gst_object_unref (pad);
+  }
+  if (!caps)
+    return;
+
+  g_mutex_lock (&self->lock);
+  g_hash_table_insert (self->chains, caps_key (caps),
+      g_strdup (GST_OBJECT_NAME (factory)));
+  self->dirty = TRUE;
+  g_mutex_unlock (&self->lock);
+  gst_caps_unref (caps);
+}
+
+static void
+item_prerolled (GstPlayerAutoplugCache * self)
+{
+  GstIterator *it;
+  GstClockTime startup;
+
+  it = gst_bin_iterate_recurse (GST_BIN (self->pipeline));
+  gst_iterator_foreach (it, (GstIteratorForeachFunction) record_element,
+      self);
+  gst_iterator_free (it);
+
+  g_mutex_lock (&self->lock);
+  if (self->item_start == 0) {
+    g_mutex_unlock (&self->lock);
+    return;
+  }
+
+  startup = (g_get_monotonic_time () - self->item_start) * GST_USECOND;
+  self->stats.items++;
+  self->stats.last_startup = startup;
+  self->stats.hits += self->item_hits;
+  self->stats.misses += self->item_misses;
+  if (self->item_hits > 0 && self->item_misses == 0) {
+    self->stats.cached_items++;
+    self->cached_total += startup;
+  } else {
+    self->uncached_total += startup;
+  }
+  self->item_start = 0;
+  g_mutex_unlock (&self->lock);
+
+  GST_DEBUG ("Item prerolled after %" GST_TIME_FORMAT ", %u of %u autoplug "
+      "decisions cached", GST_TIME_ARGS (startup), self->item_hits,
+      self->item_hits + self->item_misses);
+}
+
+static void
+state_changed_cb (GstBus * bus, GstMessage * msg,
+    GstPlayerAutoplugCache * self)
+{
+  GstState old_state, new_state;
+
+  if (GST_MESSAGE_SRC (msg) != GST_OBJECT (self->pipeline))
+    return;
+
+  gst_message_parse_state_changed (msg, &old_state, &new_state, NULL);
+  if (old_state == GST_STATE_READY && new_state == GST_STATE_PAUSED)
+    item_prerolled (self);
+}
+
+/* the cached elements might be why */
+static void
+error_cb (GstBus * bus, GstMessage * msg, GstPlayerAutoplugCache * self)
+{
+  GHashTableIter iter;
+  gpointer key;
+
+  g_mutex_lock (&self->lock);
+  g_hash_table_iter_init (&iter, self->used);
+  while (g_hash_table_iter_next (&iter, &key, NULL)) {
+    g_hash_table_remove (self->chains, key);
+    self->dirty = TRUE;
+  }
+  g_hash_table_remove_all (self->used);
+  g_mutex_unlock (&self->lock);
+}
+
+/**
+ * gst_player_autoplug_cache_new:
+ * @player: the player to cache the decisions of
+ * @warm: load the elements of cached decisions in the background
+ *
+ * Has to be created before @player gets an URI, and freed only after
+ * @player was disposed.
+ */
+GstPlayerAutoplugCache *
+gst_player_autoplug_cache_new (GstPlayer * player, gboolean warm)
+{
+  GstPlayerAutoplugCache *self;
+
+  g_return_val_if_fail (GST_IS_PLAYER (player), NULL);
+
+  self = g_new0 (GstPlayerAutoplugCache, 1);
+  g_mutex_init (&self->lock);
+  self->chains = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+      g_free);
+  self->used = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  self->path = g_build_filename (g_get_user_cache_dir (), "gst-player",
+      "autoplug-cache", NULL);
+  load_chains (self);
+
+  self->pipeline = gst_player_get_pipeline (player);
+  self->bus = gst_element_get_bus (self->pipeline);
+
+  self->element_added_id = g_signal_connect (self->pipeline,
+      "deep-element-added", G_CALLBACK (deep_element_added_cb), self);
+  self->source_setup_id = g_signal_connect (self->pipeline, "source-setup",
+      G_CALLBACK (source_setup_cb), self);
+  /* GstPlayer already has a signal watch on its bus */
+  self->state_changed_id = g_signal_connect (self->bus,
+      "message::state-changed", G_CALLBACK (state_changed_cb), self);
+  self->error_id = g_signal_connect (self->bus, "message::error",
+      G_CALLBACK (error_cb), self);
+
+  if (warm && g_hash_table_size (self->chains) > 0) {
+    GHashTable *seen = g_hash_table_new (g_str_hash, g_str_equal);
+    GPtrArray *names = g_ptr_array_new ();
+    GHashTableIter iter;
+    gpointer value;
+
+    /* each factory once, most are in several chains */
+    g_hash_table_iter_init (&iter, self->chains);
+    while (g_hash_table_iter_next (&iter, NULL, &value)) {
+      if (!g_hash_table_contains (seen, value)) {
+        g_hash_table_add (seen, value);
+        g_ptr_array_add (names, g_strdup (value));
+      }
+    }
+    g_ptr_array_add (names, NULL);
+    self->warm_factories = (gchar **) g_ptr_array_free (names, FALSE);
+    g_hash_table_unref (seen);
+
+    self->warm_thread = g_thread_new ("autoplug-warm",
+        (GThreadFunc) warm_thread, self);
+  }
+
+  return self;
+}
+
+void
+gst_player_autoplug_cache_free (GstPlayerAutoplugCache * self)
+{
+  g_return_if_fail (self != NULL);
+
+  if (self->warm_thread)
+    g_thread_join (self->warm_thread);
+  g_strfreev (self->warm_factories);
+
+  g_signal_handler_disconnect (self->bus, self->state_changed_id);
+  g_signal_handler_disconnect (self->bus, self->error_id);
+  gst_object_unref (self->bus);
+  g_signal_handler_disconnect (self->pipeline, self->element_added_id);
+  g_signal_handler_disconnect (self->pipeline, self->source_setup_id);
+  gst_object_unref (self->pipeline);
+
+  save_chains (self);
+
+  g_hash_table_unref (self->used);
+  g_hash_table_unref (self->chains);
+  g_free (self->path);
+  g_mutex_clear (&self->lock);
+  g_free (self);
+}
+
+/**
+ * gst_player_autoplug_cache_get_stats:
+ *
+ * Returns: %FALSE if no item prerolled yet
+ */
+gboolean
+gst_player_autoplug_cache_get_stats (GstPlayerAutoplugCache * self,
+    GstPlayerAutoplugStats * stats)
+{
+  guint uncached_items;
+
+  g_return_val_if_fail (self != NULL, FALSE);
+  g_return_val_if_fail (stats != NULL, FALSE);
+
+  g_mutex_lock (&self->lock);
+  *stats = self->stats;
+  uncached_items = stats->items - stats->cached_items;
+  stats->cached_startup = stats->cached_items > 0 ?
+      self->cached_total / stats->cached_items : GST_CLOCK_TIME_NONE;
+  stats->uncached_startup = uncached_items > 0 ?
+      self->uncached_total / uncached_items : GST_CLOCK_TIME_NONE;
+  g_mutex_unlock (&self->lock);
+
+  return stats->items > 0;
+}
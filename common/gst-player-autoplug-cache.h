@@ -0,0 +1,52 @@
+/* GStreamer
+ *
+ * Copyright (C) 2016 GStreamer developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __GST_PLAYER_AUTOPLUG_CACHE_H__
+#define __GST_PLAYER_AUTOPLUG_CACHE_H__
+
+#include <gst/player/player.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GstPlayerAutoplugCache GstPlayerAutoplugCache;
+
+/* Time from creating the source of an item until it prerolled, split by
+ * whether all its autoplugging decisions came from the cache */
+typedef struct
+{
+  guint items;
+  guint cached_items;
+  GstClockTime cached_startup;
+  GstClockTime uncached_startup;
+  GstClockTime last_startup;
+  guint hits;
+  guint misses;
+} GstPlayerAutoplugStats;
+
+GstPlayerAutoplugCache * gst_player_autoplug_cache_new (GstPlayer * player,
+    gboolean warm);
+void gst_player_autoplug_cache_free (GstPlayerAutoplugCache * self);
+
+gboolean gst_player_autoplug_cache_get_stats (GstPlayerAutoplugCache * self,
+    GstPlayerAutoplugStats * stats);
+
+G_END_DECLS
+
+#endif /* __GST_PLAYER_AUTOPLUG_CACHE_H__ */
@@ -0,0 +1,455 @@
+/* GStreamer
+ *
+ * Copyright (C) 2016 GStreamer developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Writes a range of a URI to a new file by remuxing its compressed
+ * streams, in a pipeline of its own next to the player:
+ *
+ *   source ! parsebin ! muxer ! filesink
+ *
+ * parsebin demuxes and parses, but never decodes. Once it exposed all
+ * streams, they are linked to the muxer and the range is seeked to,
+ * upstream from one of its pads as muxers don't handle seeks. Until
+ * that seek's flush went through, everything is dropped before the
+ * muxer, so it never sees data from outside the range.
+ *
+ * By default the start snaps back to the keyframe before it, so the clip
+ * can start there without decoding anything. In accurate mode the video
+ * streams are decoded and encoded again with an encoder for the same
+ * format, which is the only way to start on an arbitrary frame with the
+ * muxers available: they can not switch from encoded edge frames to the
+ * original stream within one track. Audio is always passed through, the
+ * muxer clips it to the range. */
+
+#include <glib/gstdio.h>
+
+#include "gst-player-clip-export.h"
+
+struct _GstPlayerClipExport
+{
+  GstElement *pipeline;
+  GstElement *muxer;
+  gchar *location;
+  gboolean accurate;
+
+  /* of the seek to the range, constant once the pipeline runs */
+  guint32 seek_seqnum;
+  GstEvent *seek;
+  gint seek_sent;
+
+  guint bus_watch_id;
+  gboolean succeeded;
+  GstPlayerClipExportDoneFunc done;
+  gpointer user_data;
+};
+
+static const struct
+{
+  const gchar *extension;
+  const gchar *factory;
+} muxers[] = {
+  {".mkv", "matroskamux"},
+  {".mka", "matroskamux"},
+  {".webm", "webmmux"},
+  {".mp4", "mp4mux"},
+  {".m4v", "mp4mux"},
+  {".m4a", "mp4mux"},
+  {".mov", "qtmux"},
+  {".ts", "mpegtsmux"},
+  {".ogg", "oggmux"},
+  {".ogv", "oggmux"},
+  {".flv", "flvmux"},
+};
+
+/* Matroska takes almost any format, so it is used for unknown extensions */
+static GstElement *
+make_muxer (const gchar * location)
+{
+  gchar *lower = g_ascii_strdown (location, -1);
+  const gchar *factory = "matroskamux";
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS (muxers); i++) {
+    if (g_str_has_suffix (lower, muxers[i].extension)) {
+      factory = muxers[i].factory;
+      break;
+    }
+  }
+  g_free (lower);
+
+  return gst_element_factory_make (factory, NULL);
+}
+
+static GstPadProbeReturn
+drop_until_seek_probe (GstPad * pad, GstPadProbeInfo * info,
+    GstPlayerClipExport * clip)
+{
+  if (GST_PAD_PROBE_INFO_TYPE (info) & (GST_PAD_PROBE_TYPE_BUFFER |
+          GST_PAD_PROBE_TYPE_BUFFER_LIST))
+    return GST_PAD_PROBE_DROP;
+
+  switch (GST_EVENT_TYPE (GST_PAD_PROBE_INFO_EVENT (info))) {
+    case GST_EVENT_FLUSH_STOP:
+      if (gst_event_get_seqnum (GST_PAD_PROBE_INFO_EVENT (info)) ==
+          clip->seek_seqnum)
+        return GST_PAD_PROBE_REMOVE;
+      break;
+    case GST_EVENT_EOS:
+      /* short files might be read completely before the seek */
+      return GST_PAD_PROBE_DROP;
+    default:
+      break;
+  }
+
+  return GST_PAD_PROBE_OK;
+}
+
+static void
+seek_func (GstElement * parsebin, GstEvent * seek)
+{
+  GstPad *pad = NULL;
+  gboolean ret = FALSE;
+
+  GST_OBJECT_LOCK (parsebin);
+  if (parsebin->srcpads)
+    pad = gst_object_ref (parsebin->srcpads->data);
+  GST_OBJECT_UNLOCK (parsebin);
+
+  /* reaches the demuxer, which seeks all streams */
+  if (pad) {
+    ret = gst_pad_send_event (pad, gst_event_ref (seek));
+    gst_object_unref (pad);
+  }
+
+  if (!ret) {
+    GError *err = g_error_new_literal (GST_STREAM_ERROR,
+        GST_STREAM_ERROR_FAILED, "Could not seek to the start of the clip");
+
+    gst_element_post_message (parsebin,
+        gst_message_new_error (GST_OBJECT (parsebin), err, NULL));
+    g_error_free (err);
+  }
+}
+
+/* from the streaming thread, once parsebin exposed all streams */
+static void
+no_more_pads_cb (GstElement * parsebin, GstPlayerClipExport * clip)
+{
+  if (!g_atomic_int_compare_and_exchange (&clip->seek_sent, 0, 1))
+    return;
+
+  gst_element_call_async (parsebin, (GstElementCallAsyncFunc) seek_func,
+      gst_event_ref (clip->seek), (GDestroyNotify) gst_event_unref);
+}
+
+static GstElement *
+add_element (GstPlayerClipExport * clip, GstElement * element)
+{
+  gst_bin_add (GST_BIN (clip->pipeline), element);
+  gst_element_sync_state_with_parent (element);
+
+  return element;
+}
+
+static void
+discard_pad (GstPlayerClipExport * clip, GstPad * pad)
+{
+  GstElement *sink = gst_element_factory_make ("fakesink", NULL);
+  GstPad *sinkpad;
+
+  g_object_set (sink, "sync", FALSE, "async", FALSE, NULL);
+  add_element (clip, sink);
+
+  sinkpad = gst_element_get_static_pad (sink, "sink");
+  gst_pad_link (pad, sinkpad);
+  gst_object_unref (sinkpad);
+}
+
+/* the highest ranked encoder producing the format of @caps */
+static GstElement *
+make_encoder (GstCaps * caps)
+{
+  GList *encoders, *matching;
+  GstElement *encoder = NULL;
+  GstCaps *format;
+
+  format = gst_caps_new_empty_simple (gst_structure_get_name
+      (gst_caps_get_structure (caps, 0)));
+  encoders =
+      gst_element_factory_list_get_elements (GST_ELEMENT_FACTORY_TYPE_ENCODER |
+      GST_ELEMENT_FACTORY_TYPE_MEDIA_VIDEO, GST_RANK_MARGINAL);
+  matching = gst_element_factory_list_filter (encoders, format, GST_PAD_SRC,
+      FALSE);
+  matching = g_list_sort (matching, gst_plugin_feature_rank_compare_func);
+
+  if (matching)
+    encoder = gst_element_factory_create (matching->data, NULL);
+
+  gst_plugin_feature_list_free (matching);
+  gst_plugin_feature_list_free (encoders);
+  gst_caps_unref (format);
+
+  return encoder;
+}
+
+static void
+decoded_pad_added_cb (GstElement * decodebin, GstPad * pad,
+    GstElement * convert)
+{
+  GstPad *sinkpad = gst_element_get_static_pad (convert, "sink");
+
+  if (!gst_pad_is_linked (sinkpad))
+    gst_pad_link (pad, sinkpad);
+  gst_object_unref (sinkpad);
+}
+
+/* decodebin ! videoconvert ! encoder, returns the pad to feed it or NULL */
+static GstPad *
+add_reencoder (GstPlayerClipExport * clip, GstCaps * caps)
+{
+  GstElement *decodebin, *convert, *encoder;
+  GstPad *srcpad, *muxpad;
+
+  encoder = make_encoder (caps);
+  if (!encoder)
+    return NULL;
+
+  srcpad = gst_element_get_static_pad (encoder, "src");
+  muxpad = gst_element_get_compatible_pad (clip->muxer, srcpad, NULL);
+  if (!muxpad) {
+    gst_object_unref (srcpad);
+    gst_object_unref (encoder);
+    return NULL;
+  }
+
+  decodebin = gst_element_factory_make ("decodebin", NULL);
+  convert = gst_element_factory_make ("videoconvert", NULL);
+  g_signal_connect (decodebin, "pad-added",
+      G_CALLBACK (decoded_pad_added_cb), convert);
+
+  /* downstream first, so nothing flows into unlinked pads */
+  gst_bin_add_many (GST_BIN (clip->pipeline), decodebin, convert, encoder,
+      NULL);
+  gst_pad_link (srcpad, muxpad);
+  gst_element_link (convert, encoder);
+  gst_element_sync_state_with_parent (encoder);
+  gst_element_sync_state_with_parent (convert);
+  gst_element_sync_state_with_parent (decodebin);
+
+  gst_object_unref (muxpad);
+  gst_object_unref (srcpad);
+
+  return gst_element_get_static_pad (decodebin, "sink");
+}
+
+static void
+pad_added_cb (GstElement * parsebin, GstPad * pad, GstPlayerClipExport * clip)
+{
+  GstCaps *caps;
+  GstPad *sinkpad = NULL;
+
+  caps = gst_pad_get_current_caps (pad);
+  if (!caps)
+    caps = gst_pad_query_caps (pad, NULL);
+
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER |
+      GST_PAD_PROBE_TYPE_BUFFER_LIST | GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM |
+      GST_PAD_PROBE_TYPE_EVENT_FLUSH,
+      (GstPadProbeCallback) drop_until_seek_probe, clip, NULL);
+
+  if (clip->accurate && gst_caps_get_size (caps) > 0
+      && g_str_has_prefix (gst_structure_get_name (gst_caps_get_structure
+              (caps, 0)), "video/")) {
+    sinkpad = add_reencoder (clip, caps);
+    if (!sinkpad)
+      g_warning ("No encoder for %" GST_PTR_FORMAT
+          ", starting on a keyframe instead", caps);
+  }
+
+  /* the parsers can still convert to what the muxer wants */
+  if (!sinkpad)
+    sinkpad = gst_element_get_compatible_pad (clip->muxer, pad, NULL);
+
+  if (sinkpad) {
+    gst_pad_link (pad, sinkpad);
+    gst_object_unref (sinkpad);
+  } else {
+    g_warning ("Can't put %" GST_PTR_FORMAT " into the clip, leaving it out",
+        caps);
+    discard_pad (clip, pad);
+  }
+
+  gst_caps_unref (caps);
+}
+
+static gboolean
+bus_cb (GstBus * bus, GstMessage * msg, GstPlayerClipExport * clip)
+{
+  GError *err = NULL;
+
+  switch (GST_MESSAGE_TYPE (msg)) {
+    case GST_MESSAGE_EOS:
+      clip->succeeded = TRUE;
+      break;
+    case GST_MESSAGE_ERROR:
+      gst_message_parse_error (msg, &err, NULL);
+      break;
+    default:
+      return G_SOURCE_CONTINUE;
+  }
+
+  /* the callback is allowed to free the export */
+  clip->bus_watch_id = 0;
+  if (clip->done)
+    clip->done (clip, err, clip->user_data);
+  g_clear_error (&err);
+
+  return G_SOURCE_REMOVE;
+}
+
+/**
+ * gst_player_clip_export_new:
+ * @uri: the media to cut the clip from
+ * @start: start of the clip
+ * @stop: end of the clip, or %GST_CLOCK_TIME_NONE for the end of @uri
+ * @location: file to write, the muxer is picked by its extension
+ * @accurate: re-encode the video to start exactly at @start instead of at
+ *     the keyframe before
+ * @done: (allow-none): called once the clip is written or failed
+ * @user_data: data passed to @done
+ * @error: location for a #GError
+ *
+ * Starts writing the clip in the background. A partially written file is
+ * removed again if the export fails or is freed before it finished.
+ *
+ * Returns: the running export, or %NULL on error
+ */
+GstPlayerClipExport *
+gst_player_clip_export_new (const gchar * uri, GstClockTime start,
+    GstClockTime stop, const gchar * location, gboolean accurate,
+    GstPlayerClipExportDoneFunc done, gpointer user_data, GError ** error)
+{
+  GstPlayerClipExport *clip;
+  GstElement *source, *parsebin, *sink;
+  GstSeekFlags flags;
+  GstBus *bus;
+
+  g_return_val_if_fail (uri != NULL, NULL);
+  g_return_val_if_fail (location != NULL, NULL);
+  g_return_val_if_fail (GST_CLOCK_TIME_IS_VALID (start), NULL);
+
+  source = gst_element_make_from_uri (GST_URI_SRC, uri, NULL, error);
+  if (!source)
+    return NULL;
+
+  parsebin = gst_element_factory_make ("parsebin", NULL);
+  sink = gst_element_factory_make ("filesink", NULL);
+
+  clip = g_new0 (GstPlayerClipExport, 1);
+  clip->location = g_strdup (location);
+  clip->accurate = accurate;
+  clip->done = done;
+  clip->user_data = user_data;
+  clip->muxer = make_muxer (location);
+
+  if (!parsebin || !sink || !clip->muxer) {
+    g_set_error (error, GST_CORE_ERROR, GST_CORE_ERROR_MISSING_PLUGIN,
+        "Elements for remuxing '%s' are missing", location);
+    gst_object_unref (source);
+    if (parsebin)
+      gst_object_unref (parsebin);
+    if (sink)
+      gst_object_unref (sink);
+    if (clip->muxer)
+      gst_object_unref (clip->muxer);
+    g_free (clip->location);
+    g_free (clip);
+    return NULL;
+  }
+
+  flags = GST_SEEK_FLAG_FLUSH | (accurate ? GST_SEEK_FLAG_ACCURATE :
+      GST_SEEK_FLAG_KEY_UNIT | GST_SEEK_FLAG_SNAP_BEFORE);
+  clip->seek = gst_event_new_seek (1.0, GST_FORMAT_TIME, flags,
+      GST_SEEK_TYPE_SET, start,
+      GST_CLOCK_TIME_IS_VALID (stop) ? GST_SEEK_TYPE_SET : GST_SEEK_TYPE_NONE,
+      GST_CLOCK_TIME_IS_VALID (stop) ? stop : GST_CLOCK_TIME_NONE);
+  clip->seek_seqnum = gst_event_get_seqnum (clip->seek);
+
+  /* no need to keep pace with anything, write as fast as possible */
+  g_object_set (sink, "location", location, "sync", FALSE, NULL);
+
+  clip->pipeline = gst_pipeline_new ("clip-export");
+  gst_bin_add_many (GST_BIN (clip->pipeline), source, parsebin, clip->muxer,
+      sink, NULL);
+  gst_element_link (source, parsebin);
+  gst_element_link (clip->muxer, sink);
+
+  g_signal_connect (parsebin, "pad-added", G_CALLBACK (pad_added_cb), clip);
+  g_signal_connect (parsebin, "no-more-pads", G_CALLBACK (no_more_pads_cb),
+      clip);
+
+  /* below the player's and the UI's sources, it is not in a hurry */
+  bus = gst_element_get_bus (clip->pipeline);
+  clip->bus_watch_id = gst_bus_add_watch_full (bus, G_PRIORITY_LOW,
+      (GstBusFunc) bus_cb, clip, NULL);
+  gst_object_unref (bus);
+
+  if (gst_element_set_state (clip->pipeline,
+          GST_STATE_PLAYING) == GST_STATE_CHANGE_FAILURE) {
+    g_set_error (error, GST_RESOURCE_ERROR, GST_RESOURCE_ERROR_FAILED,
+        "Could not start writing '%s'", location);
+    gst_player_clip_export_free (clip);
+    return NULL;
+  }
+
+  return clip;
+}
+
+/**
+ * gst_player_clip_export_free:
+ *
+ * Stops the export if it is still running and removes the incomplete file
+ * then.
+ */
+void
+gst_player_clip_export_free (GstPlayerClipExport * clip)
+{
+  g_return_if_fail (clip != NULL);
+
+  if (clip->bus_watch_id)
+    g_source_remove (clip->bus_watch_id);
+
+  gst_element_set_state (clip->pipeline, GST_STATE_NULL);
+  gst_object_unref (clip->pipeline);
+  gst_event_unref (clip->seek);
+
+  if (!clip->succeeded)
+    g_unlink (clip->location);
+
+  g_free (clip->location);
+  g_free (clip);
+}
+
+const gchar *
+gst_player_clip_export_get_location (GstPlayerClipExport * clip)
+{
+  g_return_val_if_fail (clip != NULL, NULL);
+
+  return clip->location;
+}
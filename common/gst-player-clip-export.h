@@ -0,0 +1,45 @@
+/* GStreamer
+ *
+ * Copyright (C) 2016 GStreamer developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __GST_PLAYER_CLIP_EXPORT_H__
+#define __GST_PLAYER_CLIP_EXPORT_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GstPlayerClipExport GstPlayerClipExport;
+
+/* Called from the default main context once the export finished, with
+ * @error set if it failed */
+typedef void (*GstPlayerClipExportDoneFunc) (GstPlayerClipExport * clip,
+    const GError * error, gpointer user_data);
+
+GstPlayerClipExport * gst_player_clip_export_new (const gchar * uri,
+    GstClockTime start, GstClockTime stop, const gchar * location,
+    gboolean accurate, GstPlayerClipExportDoneFunc done, gpointer user_data,
+    GError ** error);
+void gst_player_clip_export_free (GstPlayerClipExport * clip);
+
+const gchar * gst_player_clip_export_get_location (GstPlayerClipExport * clip);
+
+G_END_DECLS
+
+#endif /* __GST_PLAYER_CLIP_EXPORT_H__ */
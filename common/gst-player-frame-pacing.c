@@ -0,0 +1,311 @@
+/* GStreamer
+ *
+ * Copyright (C) 2016 GStreamer developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Frame pacing statistics and adaptive frame dropping for the video
+ * renderers.
+ *
+ * The renderer forwards the buffers and events of two pads: the sink's
+ * own pad, where the time at which each frame is supposed to be shown is
+ * queued, and a pad upstream of any conversion, where late frames can be
+ * dropped before they are converted. Whenever a frame is actually shown,
+ * the newest queued frame that is due by then is the one on the screen and
+ * anything older never made it there. */
+
+#include <math.h>
+#include <string.h>
+#include <gst/base/gstbasesink.h>
+
+#include "gst-player-frame-pacing.h"
+
+/* frames queued in the sink but not shown yet, more than this means the
+ * renderer is not drawing at all */
+#define MAX_PENDING 16
+
+#define PROBE_TYPE_EVENT \
+    (GST_PAD_PROBE_TYPE_EVENT_BOTH | GST_PAD_PROBE_TYPE_EVENT_FLUSH)
+
+/* how late a frame without duration can be before it is dropped */
+#define DEFAULT_ALLOWED_LATENESS (20 * GST_MSECOND)
+
+static const gint histogram_bounds[GST_PLAYER_FRAME_PACING_N_BOUNDS] =
+    { -16, -8, -4, -2, 2, 4, 8, 16, 33, 66 };
+
+struct _GstPlayerFramePacing
+{
+  GMutex lock;
+  GstElement *sink;
+  gboolean adaptive;
+
+  GstSegment sink_segment;
+  GstSegment entry_segment;
+  GQueue pending_frames;
+  gboolean last_dropped;
+
+  guint64 presented, skipped, dropped_early;
+  guint64 histogram[GST_PLAYER_FRAME_PACING_N_BOUNDS + 1];
+  GstClockTimeDiff max_delay;
+  gdouble sum_delay, sum_delay_sq;
+};
+
+/* the clock time at which the sink is going to show the buffer */
+static GstClockTime
+intended_time (GstPlayerFramePacing * self, GstSegment * segment,
+    GstBuffer * buffer)
+{
+  GstClockTime running_time;
+
+  if (!self->sink || segment->format != GST_FORMAT_TIME
+      || !GST_BUFFER_PTS_IS_VALID (buffer))
+    return GST_CLOCK_TIME_NONE;
+
+  running_time = gst_segment_to_running_time (segment, GST_FORMAT_TIME,
+      GST_BUFFER_PTS (buffer));
+  if (!GST_CLOCK_TIME_IS_VALID (running_time))
+    return GST_CLOCK_TIME_NONE;
+
+  return gst_element_get_base_time (self->sink) + running_time +
+      gst_base_sink_get_latency (GST_BASE_SINK (self->sink)) +
+      gst_base_sink_get_render_delay (GST_BASE_SINK (self->sink));
+}
+
+static GstClockTime
+get_clock_time (GstPlayerFramePacing * self)
+{
+  GstClock *clock;
+  GstClockTime now;
+
+  if (!self->sink)
+    return GST_CLOCK_TIME_NONE;
+
+  clock = gst_element_get_clock (self->sink);
+  if (!clock)
+    return GST_CLOCK_TIME_NONE;
+
+  now = gst_clock_get_time (clock);
+  gst_object_unref (clock);
+
+  return now;
+}
+
+static void
+clear_pending (GstPlayerFramePacing * self)
+{
+  while (!g_queue_is_empty (&self->pending_frames))
+    g_free (g_queue_pop_head (&self->pending_frames));
+}
+
+GstPlayerFramePacing *
+gst_player_frame_pacing_new (void)
+{
+  GstPlayerFramePacing *self = g_new0 (GstPlayerFramePacing, 1);
+
+  g_mutex_init (&self->lock);
+  g_queue_init (&self->pending_frames);
+  gst_segment_init (&self->sink_segment, GST_FORMAT_UNDEFINED);
+  gst_segment_init (&self->entry_segment, GST_FORMAT_UNDEFINED);
+
+  return self;
+}
+
+void
+gst_player_frame_pacing_free (GstPlayerFramePacing * self)
+{
+  clear_pending (self);
+  if (self->sink)
+    gst_object_unref (self->sink);
+  g_mutex_clear (&self->lock);
+  g_free (self);
+}
+
+/* @sink is the sink whose clock, base time and latency the frames are
+ * scheduled against, the one that got the pad of the sink probe */
+void
+gst_player_frame_pacing_set_sink (GstPlayerFramePacing * self,
+    GstElement * sink)
+{
+  g_mutex_lock (&self->lock);
+  gst_object_replace ((GstObject **) & self->sink, GST_OBJECT (sink));
+  g_mutex_unlock (&self->lock);
+}
+
+void
+gst_player_frame_pacing_set_adaptive (GstPlayerFramePacing * self,
+    gboolean adaptive)
+{
+  g_mutex_lock (&self->lock);
+  self->adaptive = adaptive;
+  g_mutex_unlock (&self->lock);
+}
+
+gboolean
+gst_player_frame_pacing_get_adaptive (GstPlayerFramePacing * self)
+{
+  gboolean adaptive;
+
+  g_mutex_lock (&self->lock);
+  adaptive = self->adaptive;
+  g_mutex_unlock (&self->lock);
+
+  return adaptive;
+}
+
+/* For a buffer, event and flush probe on the sink's own pad */
+void
+gst_player_frame_pacing_sink_probe (GstPlayerFramePacing * self,
+    GstPadProbeInfo * info)
+{
+  g_mutex_lock (&self->lock);
+  if (GST_PAD_PROBE_INFO_TYPE (info) & GST_PAD_PROBE_TYPE_BUFFER) {
+    GstClockTime intended;
+
+    intended = intended_time (self, &self->sink_segment,
+        GST_PAD_PROBE_INFO_BUFFER (info));
+    if (GST_CLOCK_TIME_IS_VALID (intended)) {
+      if (g_queue_get_length (&self->pending_frames) >= MAX_PENDING) {
+        g_free (g_queue_pop_head (&self->pending_frames));
+        self->skipped++;
+      }
+      g_queue_push_tail (&self->pending_frames, g_memdup (&intended,
+              sizeof (intended)));
+    }
+  } else if (GST_PAD_PROBE_INFO_TYPE (info) & PROBE_TYPE_EVENT) {
+    GstEvent *event = GST_PAD_PROBE_INFO_EVENT (info);
+
+    if (GST_EVENT_TYPE (event) == GST_EVENT_SEGMENT)
+      gst_event_copy_segment (event, &self->sink_segment);
+    else if (GST_EVENT_TYPE (event) == GST_EVENT_FLUSH_STOP)
+      clear_pending (self);
+  }
+  g_mutex_unlock (&self->lock);
+}
+
+/* For a buffer, event and flush probe upstream of any conversion, returns
+ * TRUE if the buffer is to be dropped.
+ *
+ * Late frames would be dropped by the sink anyway, but only after paying
+ * for their conversion. Never drop two in a row so that something is
+ * still shown when the machine is just too slow */
+gboolean
+gst_player_frame_pacing_entry_probe (GstPlayerFramePacing * self,
+    GstPadProbeInfo * info)
+{
+  gboolean drop = FALSE;
+
+  g_mutex_lock (&self->lock);
+  if (GST_PAD_PROBE_INFO_TYPE (info) & GST_PAD_PROBE_TYPE_BUFFER) {
+    GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER (info);
+    GstClockTime intended, now, allowed;
+
+    if (self->adaptive && !self->last_dropped) {
+      intended = intended_time (self, &self->entry_segment, buffer);
+      now = get_clock_time (self);
+      allowed = GST_BUFFER_DURATION_IS_VALID (buffer) ?
+          GST_BUFFER_DURATION (buffer) : DEFAULT_ALLOWED_LATENESS;
+
+      drop = GST_CLOCK_TIME_IS_VALID (intended)
+          && GST_CLOCK_TIME_IS_VALID (now) && now > intended + allowed;
+    }
+    self->last_dropped = drop;
+    if (drop)
+      self->dropped_early++;
+  } else if (GST_PAD_PROBE_INFO_TYPE (info) & PROBE_TYPE_EVENT) {
+    GstEvent *event = GST_PAD_PROBE_INFO_EVENT (info);
+
+    if (GST_EVENT_TYPE (event) == GST_EVENT_SEGMENT) {
+      gst_event_copy_segment (event, &self->entry_segment);
+    } else if (GST_EVENT_TYPE (event) == GST_EVENT_FLUSH_STOP) {
+      /* a new segment follows, do not judge the first frames after a
+       * seek by the old one */
+      gst_segment_init (&self->entry_segment, GST_FORMAT_UNDEFINED);
+      self->last_dropped = FALSE;
+    }
+  }
+  g_mutex_unlock (&self->lock);
+
+  return drop;
+}
+
+/* Called whenever the renderer put a frame on the screen */
+void
+gst_player_frame_pacing_frame_shown (GstPlayerFramePacing * self)
+{
+  GstClockTime now, *intended = NULL;
+  GstClockTimeDiff delay;
+  guint i;
+
+  g_mutex_lock (&self->lock);
+  now = get_clock_time (self);
+  if (!GST_CLOCK_TIME_IS_VALID (now)) {
+    g_mutex_unlock (&self->lock);
+    return;
+  }
+
+  while (!g_queue_is_empty (&self->pending_frames)
+      && *(GstClockTime *) g_queue_peek_head (&self->pending_frames) <= now) {
+    if (intended) {
+      g_free (intended);
+      self->skipped++;
+    }
+    intended = g_queue_pop_head (&self->pending_frames);
+  }
+
+  if (intended) {
+    delay = GST_CLOCK_DIFF (*intended, now);
+    g_free (intended);
+
+    for (i = 0; i < G_N_ELEMENTS (histogram_bounds); i++)
+      if (delay < histogram_bounds[i] * GST_MSECOND)
+        break;
+    self->histogram[i]++;
+
+    self->presented++;
+    self->sum_delay += delay;
+    self->sum_delay_sq += (gdouble) delay * delay;
+    if (delay > self->max_delay)
+      self->max_delay = delay;
+  }
+  g_mutex_unlock (&self->lock);
+}
+
+void
+gst_player_frame_pacing_get_stats (GstPlayerFramePacing * self,
+    GstPlayerFramePacingStats * stats)
+{
+  gdouble mean = 0.0, jitter = 0.0;
+
+  g_mutex_lock (&self->lock);
+  if (self->presented > 0) {
+    mean = self->sum_delay / self->presented;
+    jitter = sqrt (MAX (0.0, self->sum_delay_sq / self->presented -
+            mean * mean));
+  }
+
+  stats->presented = self->presented;
+  stats->skipped = self->skipped;
+  stats->dropped_early = self->dropped_early;
+  stats->mean_delay = (GstClockTimeDiff) mean;
+  stats->jitter = (GstClockTimeDiff) jitter;
+  stats->max_delay = self->max_delay;
+  memcpy (stats->histogram, self->histogram, sizeof (stats->histogram));
+  g_mutex_unlock (&self->lock);
+
+  memcpy (stats->histogram_bounds, histogram_bounds,
+      sizeof (stats->histogram_bounds));
+}
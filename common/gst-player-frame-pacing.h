@@ -0,0 +1,68 @@
+/* GStreamer
+ *
+ * Copyright (C) 2016 GStreamer developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __GST_PLAYER_FRAME_PACING_H__
+#define __GST_PLAYER_FRAME_PACING_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GstPlayerFramePacing GstPlayerFramePacing;
+
+#define GST_PLAYER_FRAME_PACING_N_BOUNDS 10
+
+/* Delays between the intended and the actual presentation time of the
+ * frames, positive values are late */
+typedef struct
+{
+  guint64 presented;
+  guint64 skipped;
+  guint64 dropped_early;
+  GstClockTimeDiff mean_delay;
+  GstClockTimeDiff jitter;
+  GstClockTimeDiff max_delay;
+  /* upper bounds of the histogram buckets in ms, the last bucket
+   * collects everything above */
+  gint histogram_bounds[GST_PLAYER_FRAME_PACING_N_BOUNDS];
+  guint64 histogram[GST_PLAYER_FRAME_PACING_N_BOUNDS + 1];
+} GstPlayerFramePacingStats;
+
+GstPlayerFramePacing * gst_player_frame_pacing_new (void);
+void gst_player_frame_pacing_free (GstPlayerFramePacing * self);
+
+void gst_player_frame_pacing_set_sink (GstPlayerFramePacing * self,
+    GstElement * sink);
+void gst_player_frame_pacing_set_adaptive (GstPlayerFramePacing * self,
+    gboolean adaptive);
+gboolean gst_player_frame_pacing_get_adaptive (GstPlayerFramePacing * self);
+
+void gst_player_frame_pacing_sink_probe (GstPlayerFramePacing * self,
+    GstPadProbeInfo * info);
+gboolean gst_player_frame_pacing_entry_probe (GstPlayerFramePacing * self,
+    GstPadProbeInfo * info);
+void gst_player_frame_pacing_frame_shown (GstPlayerFramePacing * self);
+
+void gst_player_frame_pacing_get_stats (GstPlayerFramePacing * self,
+    GstPlayerFramePacingStats * stats);
+
+G_END_DECLS
+
+#endif /* __GST_PLAYER_FRAME_PACING_H__ */
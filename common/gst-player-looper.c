@@ -0,0 +1,681 @@
+/* GStreamer
+ *
+ * Copyright (C) 2016 GStreamer developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Confines playback to a range of the current media and optionally
+ * repeats it without going through EOS and restarting the pipeline.
+ *
+ * The end of the range is the stop position of the seek segment, there is
+ * no polling of the position. When repeating, playback runs in a segment
+ * seek, once its SEGMENT_DONE is posted the next, non-flushing, segment
+ * seek back to the start of the range is queued behind the data that is
+ * still on its way to the sinks, so there is no gap at the boundary.
+ *
+ * For a new URI the first seek is done while the pipeline prerolls: the
+ * sinks drop everything until the flush of that seek reached them, so the
+ * first frame shown is the one at the start of the range.
+ *
+ * Seeks done by the player itself, e.g. for the user or for rate changes,
+ * are plain flushing seeks. They are rewritten on their way upstream from
+ * the sinks to stay inside the range and to be segment seeks while
+ * repeating, so no second seek is needed after them.
+ *
+ * The bus callbacks run in the player's own thread, the probes in the
+ * streaming threads. The looper has to stay around until the player was
+ * stopped and disposed. */
+
+#include <gst/base/gstbasesink.h>
+
+#include "gst-player-looper.h"
+
+typedef struct
+{
+  GstPlayerLooper *looper;
+  GstPad *pad;
+  gulong id;
+
+  /* only touched by the streaming thread */
+  guint seen_loops;
+  gboolean flushed;
+  gboolean boundary;
+  guint32 flush_seqnum;
+} LooperProbe;
+
+struct _GstPlayerLooper
+{
+  GstElement *pipeline;
+  GstBus *bus;
+
+  gulong element_added_id;
+  gulong element_removed_id;
+  gulong source_setup_id;
+  gulong segment_done_id;
+  gulong async_done_id;
+
+  /* incremented right before the seek of each new loop */
+  volatile gint loops;
+  /* set until the first seek for a new URI is done, the sinks drop
+   * everything before it */
+  volatile gint start_pending;
+
+  GMutex lock;
+  gboolean enabled;
+  GstClockTime start;
+  GstClockTime stop;
+  /* the next ASYNC_DONE is from our own seek */
+  gboolean own_seek;
+  /* a new URI is prerolling */
+  gboolean new_uri;
+  gboolean start_seek_sent;
+  guint32 start_seqnum;
+  /* of the last seek done by the looper, it is not rewritten */
+  guint32 own_seqnum;
+  GList *probes;
+  GstPlayerLooperStats stats;
+  /* loops counted before the stats were reset */
+  guint loops_base;
+  guint measured_loop;
+};
+
+/* with the lock */
+static gboolean
+has_range (GstPlayerLooper * self)
+{
+  return self->start > 0 || GST_CLOCK_TIME_IS_VALID (self->stop);
+}
+
+static gdouble
+get_rate (GstPlayerLooper * self)
+{
+  GstQuery *query;
+  gdouble rate = 1.0;
+
+  /* the player's seeks set the rate, the sinks know the current one */
+  query = gst_query_new_segment (GST_FORMAT_TIME);
+  if (gst_element_query (self->pipeline, query))
+    gst_query_parse_segment (query, &rate, NULL, NULL, NULL);
+  gst_query_unref (query);
+
+  return rate != 0.0 ? rate : 1.0;
+}
+
+/* Without @flush this starts the next loop, from the beginning of the
+ * range, after the current one. With @flush playback continues in a loop
+ * from the current position, or from the beginning of the range if it is
+ * outside */
+static void
+looper_seek (GstPlayerLooper * self, gboolean flush)
+{
+  GstSeekFlags flags = GST_SEEK_FLAG_ACCURATE;
+  GstClockTime start, stop, position = GST_CLOCK_TIME_NONE;
+  gdouble rate = get_rate (self);
+  GstEvent *event;
+  gint64 value;
+
+  if (flush
+      && gst_element_query_position (self->pipeline, GST_FORMAT_TIME, &value))
+    position = value;
+
+  g_mutex_lock (&self->lock);
+  start = self->start;
+  stop = self->stop;
+  if (self->enabled)
+    flags |= GST_SEEK_FLAG_SEGMENT;
+  if (flush)
+    self->own_seek = TRUE;
+  g_mutex_unlock (&self->lock);
+
+  /* backwards playback needs a stop position to start from */
+  if (rate < 0 && !GST_CLOCK_TIME_IS_VALID (stop)
+      && gst_element_query_duration (self->pipeline, GST_FORMAT_TIME, &value))
+    stop = value;
+
+  if (GST_CLOCK_TIME_IS_VALID (position) && (position < start ||
+          (GST_CLOCK_TIME_IS_VALID (stop) && position >= stop)))
+    position = GST_CLOCK_TIME_NONE;
+
+  if (flush) {
+    flags |= GST_SEEK_FLAG_FLUSH;
+    if (rate > 0 && GST_CLOCK_TIME_IS_VALID (position))
+      start = position;
+    else if (rate < 0 && GST_CLOCK_TIME_IS_VALID (position))
+      stop = position;
+  }
+
+  event = gst_event_new_seek (rate, GST_FORMAT_TIME, flags,
+      GST_SEEK_TYPE_SET, start,
+      GST_CLOCK_TIME_IS_VALID (stop) ? GST_SEEK_TYPE_SET :
+      GST_SEEK_TYPE_NONE, GST_CLOCK_TIME_IS_VALID (stop) ? stop : -1);
+  g_mutex_lock (&self->lock);
+  self->own_seqnum = gst_event_get_seqnum (event);
+  g_mutex_unlock (&self->lock);
+
+  if (!gst_element_send_event (self->pipeline, event)) {
+    g_mutex_lock (&self->lock);
+    if (flush)
+      self->own_seek = FALSE;
+    g_mutex_unlock (&self->lock);
+  }
+}
+
+static void
+segment_done_cb (GstBus * bus, GstMessage * msg, GstPlayerLooper * self)
+{
+  gboolean enabled;
+
+  g_mutex_lock (&self->lock);
+  enabled = self->enabled;
+  g_mutex_unlock (&self->lock);
+
+  if (!enabled)
+    return;
+
+  g_atomic_int_inc (&self->loops);
+  looper_seek (self, FALSE);
+}
+
+static void
+async_done_cb (GstBus * bus, GstMessage * msg, GstPlayerLooper * self)
+{
+  gboolean rearm;
+
+  g_mutex_lock (&self->lock);
+  rearm = self->new_uri && !self->own_seek;
+  self->new_uri = FALSE;
+  self->own_seek = FALSE;
+  g_mutex_unlock (&self->lock);
+
+  /* whatever happened, the sinks must not drop anything anymore */
+  g_atomic_int_set (&self->start_pending, FALSE);
+
+  /* a new URI prerolled without the start seek, e.g. it failed. The seeks
+   * of the player are already rewritten into the range */
+  if (rearm)
+    looper_seek (self, TRUE);
+}
+
+/* from a thread of the pipeline's pool, not the streaming thread that
+ * noticed the first buffer */
+static void
+start_seek_func (GstElement * pipeline, GstPlayerLooper * self)
+{
+  GstSeekFlags flags = GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_ACCURATE;
+  GstEvent *event;
+
+  g_mutex_lock (&self->lock);
+  if (self->enabled)
+    flags |= GST_SEEK_FLAG_SEGMENT;
+  /* the rate of the player is only applied after prerolling */
+  event = gst_event_new_seek (1.0, GST_FORMAT_TIME, flags,
+      GST_SEEK_TYPE_SET, self->start,
+      GST_CLOCK_TIME_IS_VALID (self->stop) ? GST_SEEK_TYPE_SET :
+      GST_SEEK_TYPE_NONE, GST_CLOCK_TIME_IS_VALID (self->stop) ?
+      self->stop : -1);
+  self->start_seqnum = self->own_seqnum = gst_event_get_seqnum (event);
+  self->own_seek = TRUE;
+  g_mutex_unlock (&self->lock);
+
+  if (!gst_element_send_event (pipeline, event)) {
+    /* e.g. live, play from where it is */
+    g_mutex_lock (&self->lock);
+    self->own_seek = FALSE;
+    g_mutex_unlock (&self->lock);
+    g_atomic_int_set (&self->start_pending, FALSE);
+  }
+}
+
+/* with the URI the range applies to again */
+static void
+source_setup_cb (GstElement * pipeline, GstElement * source,
+    GstPlayerLooper * self)
+{
+  g_mutex_lock (&self->lock);
+  /* not for sources added later on, e.g. for subtitles */
+  if ((self->enabled || has_range (self))
+      && GST_STATE (pipeline) <= GST_STATE_READY) {
+    self->start_seek_sent = FALSE;
+    self->new_uri = TRUE;
+    g_atomic_int_set (&self->start_pending, TRUE);
+  }
+  g_mutex_unlock (&self->lock);
+}
+
+/* before the first seek for a new URI nothing gets to the sinks */
+static gboolean
+drop_before_start (GstPlayerLooper * self, LooperProbe * probe)
+{
+  gboolean drop;
+
+  if (!g_atomic_int_get (&self->start_pending))
+    return FALSE;
+
+  g_mutex_lock (&self->lock);
+  drop = !self->start_seek_sent || probe->flush_seqnum != self->start_seqnum;
+  if (!self->start_seek_sent) {
+    self->start_seek_sent = TRUE;
+    gst_element_call_async (self->pipeline,
+        (GstElementCallAsyncFunc) start_seek_func, self, NULL);
+  }
+  g_mutex_unlock (&self->lock);
+
+  return drop;
+}
+
+static void
+measure_boundary (GstPlayerLooper * self, GstPad * pad, GstBuffer * buffer,
+    guint loop)
+{
+  GstElement *sink;
+  GstEvent *event;
+  const GstSegment *segment;
+  GstClock *clock;
+  GstClockTime running_time, deadline;
+  GstClockTimeDiff jitter;
+
+  if (!GST_BUFFER_PTS_IS_VALID (buffer))
+    return;
+
+  event = gst_pad_get_sticky_event (pad, GST_EVENT_SEGMENT, 0);
+  if (!event)
+    return;
+  gst_event_parse_segment (event, &segment);
+  running_time = gst_segment_to_running_time (segment, GST_FORMAT_TIME,
+      GST_BUFFER_PTS (buffer));
+  gst_event_unref (event);
+
+  sink = gst_pad_get_parent_element (pad);
+  if (!sink)
+    return;
+
+  clock = gst_element_get_clock (sink);
+  if (!clock || !GST_CLOCK_TIME_IS_VALID (running_time)
+      || !gst_base_sink_get_sync (GST_BASE_SINK (sink))) {
+    if (clock)
+      gst_object_unref (clock);
+    gst_object_unref (sink);
+    return;
+  }
+
+  deadline = gst_element_get_base_time (sink) + running_time +
+      gst_base_sink_get_latency (GST_BASE_SINK (sink)) +
+      gst_base_sink_get_render_delay (GST_BASE_SINK (sink));
+  jitter = GST_CLOCK_DIFF (deadline, gst_clock_get_time (clock));
+  gst_object_unref (clock);
+  gst_object_unref (sink);
+
+  /* the worst of all sinks for each boundary */
+  g_mutex_lock (&self->lock);
+  if (self->measured_loop != loop
+      || self->stats.last_jitter == GST_CLOCK_STIME_NONE
+      || jitter > self->stats.last_jitter)
+    self->stats.last_jitter = jitter;
+  self->measured_loop = loop;
+  if (self->stats.min_jitter == GST_CLOCK_STIME_NONE
+      || jitter < self->stats.min_jitter)
+    self->stats.min_jitter = jitter;
+  if (self->stats.max_jitter == GST_CLOCK_STIME_NONE
+      || jitter > self->stats.max_jitter)
+    self->stats.max_jitter = jitter;
+  g_mutex_unlock (&self->lock);
+}
+
+/* Returns a replacement for a flushing seek of the player that keeps it in
+ * the range, or %NULL to let @event through as it is. Every sink forwards
+ * its own copy, they are all rewritten the same way */
+static GstEvent *
+rewrite_seek (GstPlayerLooper * self, GstEvent * event)
+{
+  GstSeekFlags flags;
+  GstSeekType start_type, stop_type;
+  GstFormat format;
+  gdouble rate;
+  gint64 start, stop;
+  GstClockTime range_start, range_stop;
+  gboolean enabled, own;
+  GstEvent *seek;
+
+  gst_event_parse_seek (event, &rate, &format, &flags, &start_type, &start,
+      &stop_type, &stop);
+  if (format != GST_FORMAT_TIME || !(flags & GST_SEEK_FLAG_FLUSH))
+    return NULL;
+
+  g_mutex_lock (&self->lock);
+  own = gst_event_get_seqnum (event) == self->own_seqnum;
+  enabled = self->enabled;
+  range_start = self->start;
+  range_stop = self->stop;
+  if (own || !(enabled || has_range (self))) {
+    g_mutex_unlock (&self->lock);
+    return NULL;
+  }
+  g_mutex_unlock (&self->lock);
+
+  if (enabled)
+    flags |= GST_SEEK_FLAG_SEGMENT;
+
+  /* the player seeks to absolute positions, backwards from the stop */
+  if (rate >= 0) {
+    if (start_type != GST_SEEK_TYPE_SET || start < (gint64) range_start
+        || (GST_CLOCK_TIME_IS_VALID (range_stop)
+            && start >= (gint64) range_stop))
+      start = range_start;
+    stop = GST_CLOCK_TIME_IS_VALID (range_stop) ? range_stop : -1;
+  } else {
+    if (stop_type != GST_SEEK_TYPE_SET || stop == -1
+        || stop <= (gint64) range_start
+        || (GST_CLOCK_TIME_IS_VALID (range_stop)
+            && stop > (gint64) range_stop))
+      stop = GST_CLOCK_TIME_IS_VALID (range_stop) ? range_stop : -1;
+    start = range_start;
+  }
+  start_type = GST_SEEK_TYPE_SET;
+  stop_type = stop != -1 ? GST_SEEK_TYPE_SET : GST_SEEK_TYPE_NONE;
+
+  GST_DEBUG ("Rewriting seek to %" GST_TIME_FORMAT " - %" GST_TIME_FORMAT,
+      GST_TIME_ARGS (start), GST_TIME_ARGS (stop));
+
+  seek = gst_event_new_seek (rate, format, flags, start_type, start,
+      stop_type, stop);
+  gst_event_set_seqnum (seek, gst_event_get_seqnum (event));
+
+  return seek;
+}
+
+static GstPadProbeReturn
+sink_probe_cb (GstPad * pad, GstPadProbeInfo * info, LooperProbe * probe)
+{
+  guint loops = g_atomic_int_get (&probe->looper->loops);
+
+  if (GST_PAD_PROBE_INFO_TYPE (info) & GST_PAD_PROBE_TYPE_EVENT_UPSTREAM) {
+    GstEvent *seek;
+
+    if (GST_EVENT_TYPE (GST_PAD_PROBE_INFO_EVENT (info)) != GST_EVENT_SEEK)
+      return GST_PAD_PROBE_OK;
+
+    seek = rewrite_seek (probe->looper, GST_PAD_PROBE_INFO_EVENT (info));
+    if (seek) {
+      gst_event_unref (GST_PAD_PROBE_INFO_EVENT (info));
+      GST_PAD_PROBE_INFO_DATA (info) = seek;
+    }
+    return GST_PAD_PROBE_OK;
+  }
+
+  if (GST_PAD_PROBE_INFO_TYPE (info) & GST_PAD_PROBE_TYPE_BUFFER) {
+    if (drop_before_start (probe->looper, probe))
+      return GST_PAD_PROBE_DROP;
+    if (probe->boundary) {
+      probe->boundary = FALSE;
+      measure_boundary (probe->looper, pad, GST_PAD_PROBE_INFO_BUFFER (info),
+          loops);
+    }
+    return GST_PAD_PROBE_OK;
+  }
+
+  switch (GST_EVENT_TYPE (GST_PAD_PROBE_INFO_EVENT (info))) {
+    case GST_EVENT_FLUSH_STOP:
+      probe->flushed = TRUE;
+      probe->boundary = FALSE;
+      probe->flush_seqnum =
+          gst_event_get_seqnum (GST_PAD_PROBE_INFO_EVENT (info));
+      break;
+    case GST_EVENT_SEGMENT:
+      /* only a segment without a flush before it starts a new loop */
+      if (!probe->flushed && loops != probe->seen_loops)
+        probe->boundary = TRUE;
+      probe->flushed = FALSE;
+      probe->seen_loops = loops;
+      break;
+    default:
+      break;
+  }
+
+  return GST_PAD_PROBE_OK;
+}
+
+static void
+looper_probe_free (LooperProbe * probe)
+{
+  gst_pad_remove_probe (probe->pad, probe->id);
+  gst_object_unref (probe->pad);
+  g_free (probe);
+}
+
+static void
+deep_element_added_cb (GstBin * bin, GstBin * sub_bin, GstElement * element,
+    GstPlayerLooper * self)
+{
+  LooperProbe *probe;
+  GstPad *pad;
+
+  if (!GST_IS_BASE_SINK (element))
+    return;
+
+  pad = gst_element_get_static_pad (element, "sink");
+  if (!pad)
+    return;
+
+  probe = g_new0 (LooperProbe, 1);
+  probe->looper = self;
+  probe->pad = pad;
+  probe->seen_loops = g_atomic_int_get (&self->loops);
+
+  g_mutex_lock (&self->lock);
+  self->probes = g_list_prepend (self->probes, probe);
+  probe->id = gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER |
+      GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM | GST_PAD_PROBE_TYPE_EVENT_FLUSH |
+      GST_PAD_PROBE_TYPE_EVENT_UPSTREAM,
+      (GstPadProbeCallback) sink_probe_cb, probe, NULL);
+  g_mutex_unlock (&self->lock);
+}
+
+static void
+deep_element_removed_cb (GstBin * bin, GstBin * sub_bin,
+    GstElement * element, GstPlayerLooper * self)
+{
+  GList *l, *next;
+
+  g_mutex_lock (&self->lock);
+  for (l = self->probes; l; l = next) {
+    LooperProbe *probe = l->data;
+
+    next = l->next;
+    if (GST_OBJECT_PARENT (probe->pad) == GST_OBJECT_CAST (element)) {
+      looper_probe_free (probe);
+      self->probes = g_list_delete_link (self->probes, l);
+    }
+  }
+  g_mutex_unlock (&self->lock);
+}
+
+static void
+reset_stats (GstPlayerLooper * self)
+{
+  /* the probes compare against the counter, so it never goes back */
+  self->loops_base = g_atomic_int_get (&self->loops);
+  self->measured_loop = self->loops_base;
+  self->stats.loops = 0;
+  self->stats.last_jitter = GST_CLOCK_STIME_NONE;
+  self->stats.min_jitter = GST_CLOCK_STIME_NONE;
+  self->stats.max_jitter = GST_CLOCK_STIME_NONE;
+}
+
+static gboolean
+pipeline_is_prerolled (GstPlayerLooper * self)
+{
+  GstState state = GST_STATE_NULL;
+
+  gst_element_get_state (self->pipeline, &state, NULL, 0);
+
+  return state >= GST_STATE_PAUSED;
+}
+
+/**
+ * gst_player_looper_new:
+ * @player: the player to loop playback of
+ *
+ * Has to be created before @player gets an URI, and freed only after
+ * @player was disposed.
+ *
+ * Returns: a new, disabled looper for the whole media
+ */
+GstPlayerLooper *
+gst_player_looper_new (GstPlayer * player)
+{
+  GstPlayerLooper *self;
+
+  g_return_val_if_fail (GST_IS_PLAYER (player), NULL);
+
+  self = g_new0 (GstPlayerLooper, 1);
+  g_mutex_init (&self->lock);
+  self->start = 0;
+  self->stop = GST_CLOCK_TIME_NONE;
+  reset_stats (self);
+
+  self->pipeline = gst_player_get_pipeline (player);
+  self->element_added_id = g_signal_connect (self->pipeline,
+      "deep-element-added", G_CALLBACK (deep_element_added_cb), self);
+  self->element_removed_id = g_signal_connect (self->pipeline,
+      "deep-element-removed", G_CALLBACK (deep_element_removed_cb), self);
+  self->source_setup_id = g_signal_connect (self->pipeline, "source-setup",
+      G_CALLBACK (source_setup_cb), self);
+
+  /* GstPlayer already has a signal watch on its bus */
+  self->bus = gst_element_get_bus (self->pipeline);
+  self->segment_done_id = g_signal_connect (self->bus,
+      "message::segment-done", G_CALLBACK (segment_done_cb), self);
+  self->async_done_id = g_signal_connect (self->bus,
+      "message::async-done", G_CALLBACK (async_done_cb), self);
+
+  return self;
+}
+
+void
+gst_player_looper_free (GstPlayerLooper * looper)
+{
+  g_return_if_fail (looper != NULL);
+
+  g_signal_handler_disconnect (looper->bus, looper->segment_done_id);
+  g_signal_handler_disconnect (looper->bus, looper->async_done_id);
+  gst_object_unref (looper->bus);
+
+  g_signal_handler_disconnect (looper->pipeline, looper->element_added_id);
+  g_signal_handler_disconnect (looper->pipeline, looper->element_removed_id);
+  g_signal_handler_disconnect (looper->pipeline, looper->source_setup_id);
+  gst_object_unref (looper->pipeline);
+
+  g_list_free_full (looper->probes, (GDestroyNotify) looper_probe_free);
+  g_mutex_clear (&looper->lock);
+  g_free (looper);
+}
+
+/**
+ * gst_player_looper_set_enabled:
+ * @looper: the looper
+ * @enabled: whether to repeat the range
+ *
+ * While enabled the player never reaches the end of the stream.
+ */
+void
+gst_player_looper_set_enabled (GstPlayerLooper * looper, gboolean enabled)
+{
+  gboolean changed;
+
+  g_return_if_fail (looper != NULL);
+
+  g_mutex_lock (&looper->lock);
+  changed = looper->enabled != enabled;
+  looper->enabled = enabled;
+  if (changed)
+    reset_stats (looper);
+  g_mutex_unlock (&looper->lock);
+
+  if (!changed || !pipeline_is_prerolled (looper))
+    return;
+
+  /* when disabling this leaves the segment seek, or playback would stop
+   * at its end */
+  looper_seek (looper, TRUE);
+}
+
+gboolean
+gst_player_looper_get_enabled (GstPlayerLooper * looper)
+{
+  gboolean enabled;
+
+  g_return_val_if_fail (looper != NULL, FALSE);
+
+  g_mutex_lock (&looper->lock);
+  enabled = looper->enabled;
+  g_mutex_unlock (&looper->lock);
+
+  return enabled;
+}
+
+/**
+ * gst_player_looper_set_range:
+ * @looper: the looper
+ * @start: where each loop starts
+ * @stop: where each loop ends, or %GST_CLOCK_TIME_NONE for the end of
+ *   the media
+ *
+ * Playback is confined to the range also while not repeating it, and for
+ * all following URIs too. Once prerolled playback continues in the new
+ * range right away.
+ */
+void
+gst_player_looper_set_range (GstPlayerLooper * looper, GstClockTime start,
+    GstClockTime stop)
+{
+  gboolean reseek;
+
+  g_return_if_fail (looper != NULL);
+  g_return_if_fail (GST_CLOCK_TIME_IS_VALID (start));
+  g_return_if_fail (!GST_CLOCK_TIME_IS_VALID (stop) || stop > start);
+
+  g_mutex_lock (&looper->lock);
+  reseek = looper->enabled || has_range (looper);
+  looper->start = start;
+  looper->stop = stop;
+  reseek |= has_range (looper);
+  reset_stats (looper);
+  g_mutex_unlock (&looper->lock);
+
+  if (reseek && pipeline_is_prerolled (looper))
+    looper_seek (looper, TRUE);
+}
+
+/**
+ * gst_player_looper_get_stats:
+ * @looper: the looper
+ * @stats: (out): filled with the loop statistics since the looper was
+ *   enabled or its range was changed. The jitter fields are
+ *   %GST_CLOCK_STIME_NONE until a boundary was measured.
+ */
+void
+gst_player_looper_get_stats (GstPlayerLooper * looper,
+    GstPlayerLooperStats * stats)
+{
+  g_return_if_fail (looper != NULL);
+  g_return_if_fail (stats != NULL);
+
+  g_mutex_lock (&looper->lock);
+  *stats = looper->stats;
+  stats->loops = g_atomic_int_get (&looper->loops) - looper->loops_base;
+  g_mutex_unlock (&looper->lock);
+}
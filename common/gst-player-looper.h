@@ -0,0 +1,55 @@
+/* GStreamer
+ *
+ * Copyright (C) 2016 GStreamer developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __GST_PLAYER_LOOPER_H__
+#define __GST_PLAYER_LOOPER_H__
+
+#include <gst/player/player.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GstPlayerLooper GstPlayerLooper;
+
+/* Lateness of the first buffer after a loop boundary at the sinks, i.e.
+ * how long after its presentation time it arrived there. Negative values
+ * are the margin it had, positive ones are a visible or audible gap. */
+typedef struct
+{
+  guint loops;
+  GstClockTimeDiff last_jitter;
+  GstClockTimeDiff min_jitter;
+  GstClockTimeDiff max_jitter;
+} GstPlayerLooperStats;
+
+GstPlayerLooper * gst_player_looper_new (GstPlayer * player);
+void gst_player_looper_free (GstPlayerLooper * looper);
+
+void gst_player_looper_set_enabled (GstPlayerLooper * looper, gboolean enabled);
+gboolean gst_player_looper_get_enabled (GstPlayerLooper * looper);
+
+void gst_player_looper_set_range (GstPlayerLooper * looper, GstClockTime start,
+    GstClockTime stop);
+
+void gst_player_looper_get_stats (GstPlayerLooper * looper,
+    GstPlayerLooperStats * stats);
+
+G_END_DECLS
+
+#endif /* __GST_PLAYER_LOOPER_H__ */
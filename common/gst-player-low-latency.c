@@ -0,0 +1,383 @@
+/* GStreamer
+ *
+ * Copyright (C) 2016 GStreamer developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* A profile for live camera feeds, trading robustness against jitter for
+ * delay, and a way to measure what that delay is.
+ *
+ * The profile configures elements as they are added to the pipeline: a
+ * short jitterbuffer that drops what is too late instead of waiting for
+ * it, playsink's queues in front of the audio and video sinks only holding
+ * a few hundred milliseconds and dropping old data when full, sinks
+ * that drop late frames and small audio ringbuffers.
+ *
+ * For measuring, the test source marks the wall clock time into each
+ * frame as a pattern of black and white blocks (simplevideomark). The
+ * player reads it back right before the video sink (simplevideomarkdetect)
+ * and compares it to the wall clock time the frame is going to be shown
+ * at. The time is in microseconds, so all 64 bits of the pattern are
+ * used. Sender and player have to be on the same host or have synchronised
+ * clocks. */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "gst-player-low-latency.h"
+
+#define JITTERBUFFER_LATENCY_MS 50
+#define MAX_QUEUE_TIME (200 * GST_MSECOND)
+#define MAX_VIDEO_LATENESS (20 * GST_MSECOND)
+/* in microseconds, like the properties */
+#define AUDIO_BUFFER_TIME 40000
+#define AUDIO_LATENCY_TIME 10000
+
+/* 64 data blocks and the 4 of the marker fit into 640 pixels */
+#define PATTERN_DATA_COUNT 64
+#define PATTERN_WIDTH 8
+#define PATTERN_HEIGHT 16
+
+/* percentiles are over this many of the most recent frames */
+#define MAX_SAMPLES 1024
+
+struct _GstPlayerLowLatency
+{
+  GstElement *pipeline;
+  GstBus *bus;
+
+  gulong element_added_id;
+  gulong source_setup_id;
+  gulong element_message_id;
+  gulong latency_message_id;
+  gulong async_done_id;
+
+  GMutex lock;
+  /* of the pipeline, GST_CLOCK_TIME_NONE until queried again */
+  GstClockTime latency;
+  GstClockTimeDiff samples[MAX_SAMPLES];
+  guint n_samples;
+  guint next_sample;
+};
+
+static void
+set_if_exists (GstElement * element, const gchar * property, ...)
+{
+  va_list args;
+
+  if (!g_object_class_find_property (G_OBJECT_GET_CLASS (element), property))
+    return;
+
+  va_start (args, property);
+  g_object_set_valist (G_OBJECT (element), property, args);
+  va_end (args);
+}
+
+static void
+source_setup_cb (GstElement * playbin, GstElement * source,
+    GstPlayerLowLatency * self)
+{
+  /* rtspsrc, its jitterbuffers are configured from these */
+  set_if_exists (source, "latency", JITTERBUFFER_LATENCY_MS, NULL);
+  set_if_exists (source, "drop-on-latency", TRUE, NULL);
+}
+
+static void
+deep_element_added_cb (GstBin * bin, GstBin * sub_bin, GstElement * element,
+    GstPlayerLowLatency * self)
+{
+  GstElementFactory *factory = gst_element_get_factory (element);
+  const gchar *name = factory ? GST_OBJECT_NAME (factory) : NULL;
+
+  if (g_strcmp0 (name, "rtpjitterbuffer") == 0) {
+    g_object_set (element, "latency", JITTERBUFFER_LATENCY_MS,
+        "drop-on-latency", TRUE, NULL);
+  } else if (g_strcmp0 (name, "queue") == 0
+      && (g_str_has_prefix (GST_OBJECT_NAME (element), "vqueue")
+          || g_str_has_prefix (GST_OBJECT_NAME (element), "aqueue"))) {
+    /* playsink's queues in front of the sinks; a sink that can't keep up
+     * should lose old frames, not add delay */
+    g_object_set (element, "max-size-buffers", 0, "max-size-bytes", 0,
+        "max-size-time", (guint64) MAX_QUEUE_TIME, "leaky",
+        2 /* downstream */ , NULL);
+  } else if (g_strcmp0 (name, "queue2") == 0) {
+    g_object_set (element, "max-size-time", (guint64) MAX_QUEUE_TIME,
+        "use-buffering", FALSE, NULL);
+  } else if (!GST_IS_BIN (element)
+      && GST_OBJECT_FLAG_IS_SET (element, GST_ELEMENT_FLAG_SINK)) {
+    if (g_object_class_find_property (G_OBJECT_GET_CLASS (element),
+            "buffer-time")) {
+      g_object_set (element, "buffer-time", (gint64) AUDIO_BUFFER_TIME,
+          "latency-time", (gint64) AUDIO_LATENCY_TIME, NULL);
+    } else {
+      /* with QoS the decoders already skip frames that would be late */
+      set_if_exists (element, "qos", TRUE, NULL);
+      set_if_exists (element, "max-lateness", (gint64) MAX_VIDEO_LATENESS,
+          NULL);
+    }
+  }
+}
+
+/* only changes when the pipeline reports it */
+static void
+latency_changed_cb (GstBus * bus, GstMessage * msg, GstPlayerLowLatency * self)
+{
+  self->latency = GST_CLOCK_TIME_NONE;
+}
+
+/* the wall clock time at which the frame at @running_time is shown */
+static gint64
+render_wall_time (GstPlayerLowLatency * self, GstClockTime running_time)
+{
+  GstClock *clock;
+  GstClockTime base_time, now;
+  gint64 wall_now;
+
+  clock = gst_element_get_clock (self->pipeline);
+  if (!clock)
+    return -1;
+
+  if (!GST_CLOCK_TIME_IS_VALID (self->latency)) {
+    GstQuery *query = gst_query_new_latency ();
+
+    self->latency = 0;
+    if (gst_element_query (self->pipeline, query))
+      gst_query_parse_latency (query, NULL, &self->latency, NULL);
+    gst_query_unref (query);
+  }
+
+  base_time = gst_element_get_base_time (self->pipeline);
+  now = gst_clock_get_time (clock);
+  wall_now = g_get_real_time () * GST_USECOND;
+  gst_object_unref (clock);
+
+  return wall_now + GST_CLOCK_DIFF (now,
+      base_time + running_time + self->latency);
+}
+
+static void
+element_message_cb (GstBus * bus, GstMessage * msg, GstPlayerLowLatency * self)
+{
+  const GstStructure *s = gst_message_get_structure (msg);
+  gboolean have_pattern = FALSE;
+  guint64 data, running_time;
+  gint64 shown;
+
+  if (!gst_structure_has_name (s, "GstSimpleVideoMarkDetect")
+      || !gst_structure_get_boolean (s, "have-pattern", &have_pattern)
+      || !have_pattern
+      || !gst_structure_get_uint64 (s, "data", &data)
+      || !gst_structure_get_uint64 (s, "running-time", &running_time)
+      || !GST_CLOCK_TIME_IS_VALID (running_time))
+    return;
+
+  shown = render_wall_time (self, running_time);
+  if (shown < 0)
+    return;
+
+  g_mutex_lock (&self->lock);
+  /* the marked data is the wall clock time in microseconds */
+  self->samples[self->next_sample] = shown - (gint64) data * GST_USECOND;
+  self->next_sample = (self->next_sample + 1) % MAX_SAMPLES;
+  self->n_samples = MIN (self->n_samples + 1, MAX_SAMPLES);
+  g_mutex_unlock (&self->lock);
+}
+
+/**
+ * gst_player_low_latency_new:
+ * @player: the player to configure
+ * @profile: apply the low latency profile
+ * @measure: measure the latency of streams from the test source
+ *
+ * Has to be created before @player gets an URI, and freed only after
+ * @player was disposed.
+ */
+GstPlayerLowLatency *
+gst_player_low_latency_new (GstPlayer * player, gboolean profile,
+    gboolean measure)
+{
+  GstPlayerLowLatency *self;
+
+  g_return_val_if_fail (GST_IS_PLAYER (player), NULL);
+
+  self = g_new0 (GstPlayerLowLatency, 1);
+  g_mutex_init (&self->lock);
+  self->latency = GST_CLOCK_TIME_NONE;
+  self->pipeline = gst_player_get_pipeline (player);
+  self->bus = gst_element_get_bus (self->pipeline);
+
+  if (profile) {
+    /* only used for buffering network streams, which is what adds the
+     * most delay by default */
+    g_object_set (self->pipeline, "buffer-duration",
+        (gint64) MAX_QUEUE_TIME, NULL);
+
+    self->element_added_id = g_signal_connect (self->pipeline,
+        "deep-element-added", G_CALLBACK (deep_element_added_cb), self);
+    self->source_setup_id = g_signal_connect (self->pipeline,
+        "source-setup", G_CALLBACK (source_setup_cb), self);
+  }
+
+  if (measure) {
+    GstElement *detect =
+        gst_element_factory_make ("simplevideomarkdetect", NULL);
+
+    if (detect) {
+      g_object_set (detect, "pattern-width", PATTERN_WIDTH, "pattern-height",
+          PATTERN_HEIGHT, "pattern-data-count", PATTERN_DATA_COUNT, NULL);
+      g_object_set (self->pipeline, "video-filter", detect, NULL);
+      /* GstPlayer already has a signal watch on its bus */
+      self->element_message_id = g_signal_connect (self->bus,
+          "message::element", G_CALLBACK (element_message_cb), self);
+      self->latency_message_id = g_signal_connect (self->bus,
+          "message::latency", G_CALLBACK (latency_changed_cb), self);
+      self->async_done_id = g_signal_connect (self->bus,
+          "message::async-done", G_CALLBACK (latency_changed_cb), self);
+    } else {
+      g_warning ("simplevideomarkdetect is missing, can't measure latency");
+    }
+  }
+
+  return self;
+}
+
+void
+gst_player_low_latency_free (GstPlayerLowLatency * self)
+{
+  g_return_if_fail (self != NULL);
+
+  if (self->element_message_id)
+    g_signal_handler_disconnect (self->bus, self->element_message_id);
+  if (self->latency_message_id)
+    g_signal_handler_disconnect (self->bus, self->latency_message_id);
+  if (self->async_done_id)
+    g_signal_handler_disconnect (self->bus, self->async_done_id);
+  gst_object_unref (self->bus);
+
+  if (self->element_added_id)
+    g_signal_handler_disconnect (self->pipeline, self->element_added_id);
+  if (self->source_setup_id)
+    g_signal_handler_disconnect (self->pipeline, self->source_setup_id);
+  gst_object_unref (self->pipeline);
+
+  g_mutex_clear (&self->lock);
+  g_free (self);
+}
+
+static gint
+compare_diff (gconstpointer a, gconstpointer b)
+{
+  GstClockTimeDiff x = *(const GstClockTimeDiff *) a;
+  GstClockTimeDiff y = *(const GstClockTimeDiff *) b;
+
+  return x < y ? -1 : x > y;
+}
+
+/**
+ * gst_player_low_latency_get_stats:
+ *
+ * Returns: %FALSE if nothing was measured yet
+ */
+gboolean
+gst_player_low_latency_get_stats (GstPlayerLowLatency * self,
+    GstPlayerLatencyStats * stats)
+{
+  GstClockTimeDiff sorted[MAX_SAMPLES];
+  guint n;
+
+  g_return_val_if_fail (self != NULL, FALSE);
+  g_return_val_if_fail (stats != NULL, FALSE);
+
+  g_mutex_lock (&self->lock);
+  n = self->n_samples;
+  memcpy (sorted, self->samples, n * sizeof (GstClockTimeDiff));
+  g_mutex_unlock (&self->lock);
+
+  if (n == 0)
+    return FALSE;
+
+  qsort (sorted, n, sizeof (GstClockTimeDiff), compare_diff);
+  stats->samples = n;
+  stats->p50 = sorted[(n - 1) * 50 / 100];
+  stats->p95 = sorted[(n - 1) * 95 / 100];
+  stats->p99 = sorted[(n - 1) * 99 / 100];
+  stats->max = sorted[n - 1];
+
+  return TRUE;
+}
+
+static GstPadProbeReturn
+mark_time_probe (GstPad * pad, GstPadProbeInfo * info, GstElement * mark)
+{
+  /* read by the element for the buffer that is just arriving */
+  g_object_set (mark, "pattern-data", (guint64) g_get_real_time (), NULL);
+
+  return GST_PAD_PROBE_OK;
+}
+
+/**
+ * gst_player_latency_test_source_new:
+ * @host: where to send to
+ * @port: the UDP port
+ * @error: location for a #GError
+ *
+ * Starts sending a live test video with the wall clock time marked into
+ * every frame, as H.264 in MPEG-TS over UDP. Play it as udp://host:port
+ * with measuring enabled.
+ *
+ * Returns: the running sender pipeline, set it to %GST_STATE_NULL and
+ * unref it once done
+ */
+GstElement *
+gst_player_latency_test_source_new (const gchar * host, gint port,
+    GError ** error)
+{
+  GstElement *pipeline, *mark, *sink;
+  GstPad *pad;
+
+  pipeline = gst_parse_launch ("videotestsrc is-live=true pattern=ball ! "
+      "video/x-raw,width=640,height=360,framerate=30/1 ! "
+      "simplevideomark name=mark ! videoconvert ! "
+      "x264enc tune=zerolatency speed-preset=ultrafast key-int-max=30 ! "
+      "h264parse ! mpegtsmux alignment=7 ! udpsink name=sink", error);
+  if (!pipeline)
+    return NULL;
+
+  mark = gst_bin_get_by_name (GST_BIN (pipeline), "mark");
+  sink = gst_bin_get_by_name (GST_BIN (pipeline), "sink");
+  g_object_set (mark, "pattern-width", PATTERN_WIDTH, "pattern-height",
+      PATTERN_HEIGHT, "pattern-data-count", PATTERN_DATA_COUNT, NULL);
+  g_object_set (sink, "host", host, "port", port, NULL);
+
+  pad = gst_element_get_static_pad (mark, "sink");
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER,
+      (GstPadProbeCallback) mark_time_probe, mark, NULL);
+  gst_object_unref (pad);
+  gst_object_unref (mark);
+  gst_object_unref (sink);
+
+  if (gst_element_set_state (pipeline,
+          GST_STATE_PLAYING) == GST_STATE_CHANGE_FAILURE) {
+    g_set_error (error, GST_CORE_ERROR, GST_CORE_ERROR_STATE_CHANGE,
+        "Could not start the latency test source");
+    gst_element_set_state (pipeline, GST_STATE_NULL);
+    gst_object_unref (pipeline);
+    return NULL;
+  }
+
+  return pipeline;
+}
@@ -0,0 +1,53 @@
+/* GStreamer
+ *
+ * Copyright (C) 2016 GStreamer developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __GST_PLAYER_LOW_LATENCY_H__
+#define __GST_PLAYER_LOW_LATENCY_H__
+
+#include <gst/player/player.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GstPlayerLowLatency GstPlayerLowLatency;
+
+/* Time from the timestamp marked into a frame by the test source until
+ * that frame is rendered, over the most recent frames */
+typedef struct
+{
+  guint samples;
+  GstClockTimeDiff p50;
+  GstClockTimeDiff p95;
+  GstClockTimeDiff p99;
+  GstClockTimeDiff max;
+} GstPlayerLatencyStats;
+
+GstPlayerLowLatency * gst_player_low_latency_new (GstPlayer * player,
+    gboolean profile, gboolean measure);
+void gst_player_low_latency_free (GstPlayerLowLatency * self);
+
+gboolean gst_player_low_latency_get_stats (GstPlayerLowLatency * self,
+    GstPlayerLatencyStats * stats);
+
+GstElement * gst_player_latency_test_source_new (const gchar * host,
+    gint port, GError ** error);
+
+G_END_DECLS
+
+#endif /* __GST_PLAYER_LOW_LATENCY_H__ */
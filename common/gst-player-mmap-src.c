@@ -0,0 +1,494 @@
+/* GStreamer
+ *
+ * Copyright (C) 2016 GStreamer developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* A source for local files that maps the whole file instead of reading
+ * it into new buffers. Every buffer is a part of one read-only memory
+ * wrapping the mapping, so the data is never copied and the mapping
+ * stays around until the last buffer is gone.
+ *
+ * The kernel is told that the file is read sequentially and the next
+ * READAHEAD_SEQUENTIAL bytes are requested ahead of time. After a seek
+ * the file is marked for random access with a small window instead, as
+ * demuxers jumping around in the index would otherwise make the kernel
+ * read lots of data that is never used, until reads are contiguous for
+ * a while again.
+ *
+ * Accessing a mapping past the end of a file that was truncated raises
+ * SIGBUS, so the size is checked again for every buffer. Once the file
+ * shrank, and for anything appended after starting, the data is read
+ * into new buffers like filesrc does. Buffers handed out before a
+ * truncation can still fault, so this is only used when asked for.
+ *
+ * It is then registered for "file" URIs above filesrc, but only takes
+ * regular, non-empty files that can be mapped. Everything else is left
+ * to filesrc. */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <glib/gstdio.h>
+#include <gst/base/gstbasesrc.h>
+
+#ifdef G_OS_UNIX
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+#ifdef G_OS_WIN32
+#include <io.h>
+#endif
+
+#ifndef O_BINARY
+#define O_BINARY 0
+#endif
+
+#include "gst-player-mmap-src.h"
+
+#define DEFAULT_BLOCKSIZE (256 * 1024)
+
+/* how much is requested ahead of the reads */
+#define READAHEAD_SEQUENTIAL (8 * 1024 * 1024)
+#define READAHEAD_RANDOM (512 * 1024)
+/* contiguous reads after a seek until going back to sequential access */
+#define SEQUENTIAL_THRESHOLD (4 * 1024 * 1024)
+
+#define GST_TYPE_PLAYER_MMAP_SRC (gst_player_mmap_src_get_type ())
+#define GST_PLAYER_MMAP_SRC(obj) (G_TYPE_CHECK_INSTANCE_CAST ((obj), \
+        GST_TYPE_PLAYER_MMAP_SRC, GstPlayerMmapSrc))
+
+typedef struct
+{
+  GstBaseSrc parent;
+
+  gchar *uri;
+  gchar *location;
+
+  /* set up when starting */
+  gint fd;
+  GMappedFile *mapped;
+  guint8 *data;
+  guint64 size;
+  /* covers all of the mapping, buffers share parts of it */
+  GstMemory *memory;
+
+  /* only used by the streaming thread */
+  guint64 next_offset;
+  guint64 readahead_end;
+  guint64 sequential_bytes;
+  gboolean random;
+  /* the file shrank, nothing is served from the mapping anymore */
+  gboolean truncated;
+} GstPlayerMmapSrc;
+
+typedef struct
+{
+  GstBaseSrcClass parent_class;
+} GstPlayerMmapSrcClass;
+
+static GType gst_player_mmap_src_get_type (void);
+static void gst_player_mmap_src_uri_handler_init (gpointer g_iface,
+    gpointer iface_data);
+
+G_DEFINE_TYPE_WITH_CODE (GstPlayerMmapSrc, gst_player_mmap_src,
+    GST_TYPE_BASE_SRC, G_IMPLEMENT_INTERFACE (GST_TYPE_URI_HANDLER,
+        gst_player_mmap_src_uri_handler_init));
+
+static GstStaticPadTemplate src_template = GST_STATIC_PAD_TEMPLATE ("src",
+    GST_PAD_SRC,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS_ANY);
+
+static const gchar *const *
+uri_handler_get_protocols (GType type)
+{
+  static const gchar *protocols[] = { "file", NULL };
+
+  return protocols;
+}
+
+static GstURIType
+uri_handler_get_type (GType type)
+{
+  return GST_URI_SRC;
+}
+
+static gchar *
+uri_handler_get_uri (GstURIHandler * handler)
+{
+  GstPlayerMmapSrc *self = GST_PLAYER_MMAP_SRC (handler);
+  gchar *uri;
+
+  GST_OBJECT_LOCK (self);
+  uri = g_strdup (self->uri);
+  GST_OBJECT_UNLOCK (self);
+
+  return uri;
+}
+
+/* failing here makes playbin try filesrc instead */
+static gboolean
+uri_handler_set_uri (GstURIHandler * handler, const gchar * uri,
+    GError ** error)
+{
+  GstPlayerMmapSrc *self = GST_PLAYER_MMAP_SRC (handler);
+  GStatBuf st;
+  gchar *location;
+
+  if (GST_STATE (self) != GST_STATE_NULL) {
+    g_set_error (error, GST_URI_ERROR, GST_URI_ERROR_BAD_STATE,
+        "Can't change the URI while running");
+    return FALSE;
+  }
+
+  location = g_filename_from_uri (uri, NULL, NULL);
+  if (!location) {
+    g_set_error (error, GST_URI_ERROR, GST_URI_ERROR_BAD_URI,
+        "Not a local file: %s", uri);
+    return FALSE;
+  }
+
+  if (g_stat (location, &st) != 0 || !S_ISREG (st.st_mode)
+      || st.st_size == 0 || (guint64) st.st_size > G_MAXSIZE) {
+    g_set_error (error, GST_URI_ERROR, GST_URI_ERROR_BAD_REFERENCE,
+        "Not a regular file that can be mapped: %s", location);
+    g_free (location);
+    return FALSE;
+  }
+
+  GST_OBJECT_LOCK (self);
+  g_free (self->uri);
+  self->uri = g_strdup (uri);
+  g_free (self->location);
+  self->location = location;
+  GST_OBJECT_UNLOCK (self);
+
+  return TRUE;
+}
+
+static void
+gst_player_mmap_src_uri_handler_init (gpointer g_iface, gpointer iface_data)
+{
+  GstURIHandlerInterface *iface = (GstURIHandlerInterface *) g_iface;
+
+  iface->get_type = uri_handler_get_type;
+  iface->get_protocols = uri_handler_get_protocols;
+  iface->get_uri = uri_handler_get_uri;
+  iface->set_uri = uri_handler_set_uri;
+}
+
+#ifdef HAVE_MADVISE
+/* page aligned, as the kernel wants it */
+static void
+advise (GstPlayerMmapSrc * self, guint64 offset, guint64 length, gint advice)
+{
+  static gsize page_size = 0;
+  guint64 start, end;
+
+  if (page_size == 0)
+    page_size = sysconf (_SC_PAGESIZE);
+
+  start = offset - offset % page_size;
+  end = MIN (offset + length, self->size);
+  if (end <= start)
+    return;
+
+  if (madvise (self->data + start, end - start, advice) != 0)
+    GST_DEBUG_OBJECT (self, "madvise failed: %s", g_strerror (errno));
+}
+#endif
+
+static void
+set_access_pattern (GstPlayerMmapSrc * self, gboolean random)
+{
+  GST_DEBUG_OBJECT (self, "Switching to %s access",
+      random ? "random" : "sequential");
+
+  self->random = random;
+  self->sequential_bytes = 0;
+  self->readahead_end = 0;
+
+#ifdef HAVE_MADVISE
+  advise (self, 0, self->size, random ? MADV_RANDOM : MADV_SEQUENTIAL);
+#endif
+#ifdef HAVE_POSIX_FADVISE
+  posix_fadvise (self->fd, 0, 0,
+      random ? POSIX_FADV_RANDOM : POSIX_FADV_SEQUENTIAL);
+#endif
+}
+
+static void
+update_readahead (GstPlayerMmapSrc * self, guint64 offset, guint size)
+{
+  guint64 window;
+
+  if (offset != self->next_offset) {
+    if (!self->random)
+      set_access_pattern (self, TRUE);
+    self->sequential_bytes = 0;
+    self->readahead_end = 0;
+  } else if (self->random) {
+    self->sequential_bytes += size;
+    if (self->sequential_bytes >= SEQUENTIAL_THRESHOLD)
+      set_access_pattern (self, FALSE);
+  }
+  self->next_offset = offset + size;
+
+  window = self->random ? READAHEAD_RANDOM : READAHEAD_SEQUENTIAL;
+
+  /* only once half of the window is used up, not for every buffer */
+  if (self->readahead_end > offset + window / 2)
+    return;
+
+  if (self->readahead_end < offset)
+    self->readahead_end = offset;
+#ifdef HAVE_MADVISE
+  advise (self, self->readahead_end, offset + window - self->readahead_end,
+      MADV_WILLNEED);
+#endif
+#ifdef HAVE_POSIX_FADVISE
+  posix_fadvise (self->fd, self->readahead_end,
+      offset + window - self->readahead_end, POSIX_FADV_WILLNEED);
+#endif
+  self->readahead_end = offset + window;
+}
+
+/* the file might have been written to since it was mapped */
+static guint64
+get_file_size (GstPlayerMmapSrc * self)
+{
+  struct stat st;
+
+  if (fstat (self->fd, &st) != 0)
+    return self->size;
+
+  return st.st_size;
+}
+
+static GstFlowReturn
+read_buffer (GstPlayerMmapSrc * self, guint64 offset, guint size,
+    GstBuffer ** buffer)
+{
+  GstBuffer *buf;
+  GstMapInfo info;
+  gssize ret;
+
+  buf = gst_buffer_new_allocate (NULL, size, NULL);
+  gst_buffer_map (buf, &info, GST_MAP_WRITE);
+  if (lseek (self->fd, offset, SEEK_SET) == (off_t) - 1)
+    ret = -1;
+  else
+    ret = read (self->fd, info.data, size);
+  gst_buffer_unmap (buf, &info);
+
+  if (ret <= 0) {
+    gst_buffer_unref (buf);
+    if (ret == 0)
+      return GST_FLOW_EOS;
+    GST_ELEMENT_ERROR (self, RESOURCE, READ, (NULL), GST_ERROR_SYSTEM);
+    return GST_FLOW_ERROR;
+  }
+
+  gst_buffer_resize (buf, 0, ret);
+  GST_BUFFER_OFFSET (buf) = offset;
+  GST_BUFFER_OFFSET_END (buf) = offset + ret;
+  *buffer = buf;
+
+  return GST_FLOW_OK;
+}
+
+static GstFlowReturn
+gst_player_mmap_src_create (GstBaseSrc * basesrc, guint64 offset,
+    guint size, GstBuffer ** buffer)
+{
+  GstPlayerMmapSrc *self = GST_PLAYER_MMAP_SRC (basesrc);
+  guint64 file_size = get_file_size (self);
+  GstBuffer *buf;
+
+  if (file_size < self->size && !self->truncated) {
+    GST_WARNING_OBJECT (self, "File was truncated, not mapping it anymore");
+    self->truncated = TRUE;
+  }
+
+  if (offset >= file_size)
+    return GST_FLOW_EOS;
+
+  size = MIN (size, file_size - offset);
+  update_readahead (self, offset, size);
+
+  if (self->truncated || offset + size > self->size)
+    return read_buffer (self, offset, size, buffer);
+
+  buf = gst_buffer_new ();
+  gst_buffer_append_memory (buf, gst_memory_share (self->memory, offset,
+          size));
+  GST_BUFFER_OFFSET (buf) = offset;
+  GST_BUFFER_OFFSET_END (buf) = offset + size;
+  *buffer = buf;
+
+  return GST_FLOW_OK;
+}
+
+static gboolean
+gst_player_mmap_src_get_size (GstBaseSrc * basesrc, guint64 * size)
+{
+  GstPlayerMmapSrc *self = GST_PLAYER_MMAP_SRC (basesrc);
+
+  if (!self->memory)
+    return FALSE;
+
+  *size = get_file_size (self);
+
+  return TRUE;
+}
+
+static gboolean
+gst_player_mmap_src_is_seekable (GstBaseSrc * basesrc)
+{
+  return TRUE;
+}
+
+static gboolean
+gst_player_mmap_src_start (GstBaseSrc * basesrc)
+{
+  GstPlayerMmapSrc *self = GST_PLAYER_MMAP_SRC (basesrc);
+  GError *err = NULL;
+  gchar *location;
+
+  GST_OBJECT_LOCK (self);
+  location = g_strdup (self->location);
+  GST_OBJECT_UNLOCK (self);
+
+  if (!location) {
+    GST_ELEMENT_ERROR (self, RESOURCE, NOT_FOUND, ("No file given"), (NULL));
+    return FALSE;
+  }
+
+  self->fd = g_open (location, O_RDONLY | O_BINARY, 0);
+  if (self->fd < 0) {
+    GST_ELEMENT_ERROR (self, RESOURCE, OPEN_READ,
+        ("Could not open %s", location), GST_ERROR_SYSTEM);
+    g_free (location);
+    return FALSE;
+  }
+
+  self->mapped = g_mapped_file_new_from_fd (self->fd, FALSE, &err);
+  if (!self->mapped || g_mapped_file_get_length (self->mapped) == 0) {
+    GST_ELEMENT_ERROR (self, RESOURCE, OPEN_READ,
+        ("Could not map %s", location),
+        ("%s", err ? err->message : "empty file"));
+    g_clear_error (&err);
+    g_free (location);
+    return FALSE;
+  }
+  g_free (location);
+
+  self->data = (guint8 *) g_mapped_file_get_contents (self->mapped);
+  self->size = g_mapped_file_get_length (self->mapped);
+  self->memory = gst_memory_new_wrapped (GST_MEMORY_FLAG_READONLY,
+      self->data, self->size, 0, self->size,
+      g_mapped_file_ref (self->mapped),
+      (GDestroyNotify) g_mapped_file_unref);
+
+  self->next_offset = 0;
+  self->truncated = FALSE;
+  set_access_pattern (self, FALSE);
+
+  return TRUE;
+}
+
+static gboolean
+gst_player_mmap_src_stop (GstBaseSrc * basesrc)
+{
+  GstPlayerMmapSrc *self = GST_PLAYER_MMAP_SRC (basesrc);
+
+  /* buffers still downstream keep the mapping alive */
+  if (self->memory)
+    gst_memory_unref (self->memory);
+  self->memory = NULL;
+  if (self->mapped)
+    g_mapped_file_unref (self->mapped);
+  self->mapped = NULL;
+  self->data = NULL;
+  self->size = 0;
+  if (self->fd >= 0)
+    close (self->fd);
+  self->fd = -1;
+
+  return TRUE;
+}
+
+static void
+gst_player_mmap_src_finalize (GObject * object)
+{
+  GstPlayerMmapSrc *self = GST_PLAYER_MMAP_SRC (object);
+
+  g_free (self->uri);
+  g_free (self->location);
+
+  G_OBJECT_CLASS (gst_player_mmap_src_parent_class)->finalize (object);
+}
+
+static void
+gst_player_mmap_src_init (GstPlayerMmapSrc * self)
+{
+  self->fd = -1;
+  gst_base_src_set_blocksize (GST_BASE_SRC (self), DEFAULT_BLOCKSIZE);
+}
+
+static void
+gst_player_mmap_src_class_init (GstPlayerMmapSrcClass * klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  GstElementClass *element_class = GST_ELEMENT_CLASS (klass);
+  GstBaseSrcClass *basesrc_class = GST_BASE_SRC_CLASS (klass);
+
+  gobject_class->finalize = gst_player_mmap_src_finalize;
+
+  basesrc_class->start = gst_player_mmap_src_start;
+  basesrc_class->stop = gst_player_mmap_src_stop;
+  basesrc_class->get_size = gst_player_mmap_src_get_size;
+  basesrc_class->is_seekable = gst_player_mmap_src_is_seekable;
+  basesrc_class->create = gst_player_mmap_src_create;
+
+  gst_element_class_add_static_pad_template (element_class, &src_template);
+  gst_element_class_set_static_metadata (element_class,
+      "Memory mapped file source", "Source/File",
+      "Reads local files without copying by mapping them",
+      "GStreamer developers");
+}
+
+/**
+ * gst_player_mmap_src_register:
+ *
+ * Makes playbin read regular local files through a memory mapping instead
+ * of with filesrc. Needs to be called after gst_init(), and only when
+ * asked for: files truncated while they are played can crash it.
+ */
+gboolean
+gst_player_mmap_src_register (void)
+{
+  return gst_element_register (NULL, "playermmapsrc", GST_RANK_PRIMARY + 1,
+      GST_TYPE_PLAYER_MMAP_SRC);
+}
@@ -0,0 +1,660 @@
+/* GStreamer
+ *
+ * Copyright (C) 2016 GStreamer developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Frame synchronised playback of the same content in several players.
+ *
+ * The master provides its system clock on the network and picks a base
+ * time. Slaves use a network client clock slaved to it and get the base
+ * time from the master. Every player then presents stream position p at
+ * clock time base + p: after prerolling, a player that starts late seeks
+ * to where the others are and moves its own base time by the same
+ * amount. The pipeline start time is disabled so that state changes
+ * don't touch the base time again, and the latency is fixed so that
+ * different sinks still line up. Any other flushing seek restarts the
+ * running time, so the player is aligned again after it: seeks only
+ * change the position until the next tick.
+ *
+ * The base time is handed out over a small UDP protocol on the port
+ * after the clock's. Players also exchange how far ahead of the shared
+ * timeline they are over it, which is what the skew is computed from:
+ *
+ *   slave -> master: "BASE?"          master -> slave: "BASE <base>"
+ *   slave -> master: "POS <offset>"   master -> slave: "POS <offset> <base>"
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <gio/gio.h>
+#include <gst/net/net.h>
+
+#include "gst-player-net-sync.h"
+
+/* time given to the master's own preroll */
+#define START_DELAY (1 * GST_SECOND)
+/* a player joining late seeks this far ahead of the others, so it is
+ * prerolled again by the time they get there */
+#define JOIN_MARGIN (500 * GST_MSECOND)
+/* the same for all players, whatever their sinks need */
+#define PIPELINE_LATENCY (200 * GST_MSECOND)
+#define TICK_INTERVAL_MS 250
+#define REPORT_INTERVAL G_USEC_PER_SEC
+#define PEER_TIMEOUT (5 * G_USEC_PER_SEC)
+/* sinks wait for this until the real base time is known */
+#define UNKNOWN_BASE_TIME (G_MAXUINT64 / 2)
+
+typedef struct
+{
+  GstClockTimeDiff offset;
+  gint64 last_seen;
+} Peer;
+
+struct _GstPlayerNetSync
+{
+  GstElement *pipeline;
+  GstBus *bus;
+  GstClock *clock;
+  gboolean master;
+
+  GstNetTimeProvider *provider;
+  GSocket *socket;
+  GSource *socket_source;
+  GSocketAddress *master_address;
+  guint tick_id;
+  gint64 last_report;
+
+  gulong async_done_id;
+  gulong state_changed_id;
+
+  GMutex lock;
+  /* protected by lock */
+  GstClockTime base_time;
+  gboolean prerolled;
+  gboolean aligned;
+  /* the alignment seek did not complete yet */
+  gboolean aligning;
+  GstClockTimeDiff offset;
+  gboolean have_offset;
+  GHashTable *peers;
+};
+
+static gboolean
+set_base_time_foreach (const GValue * item, GstClockTime * base_time)
+{
+  GstElement *element = g_value_get_object (item);
+
+  gst_element_set_base_time (element, *base_time);
+
+  return TRUE;
+}
+
+/* the pipeline only hands its base time to its children when going to
+ * PLAYING or when they are added */
+static void
+set_base_time (GstElement * pipeline, GstClockTime base_time)
+{
+  GstIterator *it;
+
+  gst_element_set_base_time (pipeline, base_time);
+
+  it = gst_bin_iterate_recurse (GST_BIN (pipeline));
+  while (gst_iterator_foreach (it,
+          (GstIteratorForeachFunction) set_base_time_foreach,
+          &base_time) == GST_ITERATOR_RESYNC)
+    gst_iterator_resync (it);
+  gst_iterator_free (it);
+}
+
+static void
+send_message (GstPlayerNetSync * self, GSocketAddress * to,
+    const gchar * message)
+{
+  GError *err = NULL;
+
+  if (g_socket_send_to (self->socket, to, message, strlen (message), NULL,
+          &err) < 0) {
+    GST_DEBUG ("Could not send '%s': %s", message, err->message);
+    g_clear_error (&err);
+  }
+}
+
+static gchar *
+address_to_string (GSocketAddress * address)
+{
+  GInetSocketAddress *inet = G_INET_SOCKET_ADDRESS (address);
+  gchar *host, *str;
+
+  host = g_inet_address_to_string (g_inet_socket_address_get_address (inet));
+  str = g_strdup_printf ("%s:%u", host, g_inet_socket_address_get_port (inet));
+  g_free (host);
+
+  return str;
+}
+
+static void
+update_peer (GstPlayerNetSync * self, const gchar * name,
+    GstClockTimeDiff offset)
+{
+  Peer *peer;
+
+  peer = g_hash_table_lookup (self->peers, name);
+  if (!peer) {
+    peer = g_new0 (Peer, 1);
+    g_hash_table_insert (self->peers, g_strdup (name), peer);
+  }
+  peer->offset = offset;
+  peer->last_seen = g_get_monotonic_time ();
+}
+
+static void
+set_shared_base_time (GstPlayerNetSync * self, GstClockTime base_time)
+{
+  if (self->base_time == base_time)
+    return;
+
+  /* the master restarted or is only known now */
+  self->base_time = base_time;
+  self->aligned = FALSE;
+}
+
+static void
+handle_message (GstPlayerNetSync * self, GSocketAddress * from,
+    const gchar * message)
+{
+  gchar *end;
+
+  g_mutex_lock (&self->lock);
+  if (self->master) {
+    gchar *reply = NULL;
+
+    if (strcmp (message, "BASE?") == 0) {
+      reply = g_strdup_printf ("BASE %" G_GUINT64_FORMAT, self->base_time);
+    } else if (g_str_has_prefix (message, "POS ")) {
+      GstClockTimeDiff offset = g_ascii_strtoll (message + 4, &end, 10);
+
+      if (*end == '\0') {
+        gchar *name = address_to_string (from);
+
+        update_peer (self, name, offset);
+        g_free (name);
+      }
+      if (self->have_offset)
+        reply = g_strdup_printf ("POS %" G_GINT64_FORMAT " %"
+            G_GUINT64_FORMAT, self->offset, self->base_time);
+    }
+    g_mutex_unlock (&self->lock);
+
+    if (reply)
+      send_message (self, from, reply);
+    g_free (reply);
+    return;
+  }
+
+  if (g_str_has_prefix (message, "BASE ")) {
+    GstClockTime base_time = g_ascii_strtoull (message + 5, &end, 10);
+
+    if (*end == '\0')
+      set_shared_base_time (self, base_time);
+  } else if (g_str_has_prefix (message, "POS ")) {
+    GstClockTimeDiff offset = g_ascii_strtoll (message + 4, &end, 10);
+
+    if (*end == ' ') {
+      GstClockTime base_time = g_ascii_strtoull (end + 1, &end, 10);
+
+      if (*end == '\0') {
+        set_shared_base_time (self, base_time);
+        update_peer (self, "master", offset);
+      }
+    }
+  }
+  g_mutex_unlock (&self->lock);
+}
+
+static gboolean
+socket_readable_cb (GSocket * socket, GIOCondition condition,
+    GstPlayerNetSync * self)
+{
+  GSocketAddress *from = NULL;
+  gchar buf[128];
+  gssize len;
+
+  while ((len = g_socket_receive_from (socket, &from, buf, sizeof (buf) - 1,
+              NULL, NULL)) >= 0) {
+    buf[len] = '\0';
+    handle_message (self, from, buf);
+    g_clear_object (&from);
+  }
+
+  return G_SOURCE_CONTINUE;
+}
+
+/* seeks to where the other players are, and lets position p be presented
+ * at base + p from there on */
+static void
+align (GstPlayerNetSync * self, GstClockTime base_time)
+{
+  GstClockTime now, position = 0;
+
+  now = gst_clock_get_time (self->clock);
+  if (now + JOIN_MARGIN > base_time)
+    position = now + JOIN_MARGIN - base_time;
+
+  GST_DEBUG ("Aligning to base time %" GST_TIME_FORMAT " at position %"
+      GST_TIME_FORMAT, GST_TIME_ARGS (base_time), GST_TIME_ARGS (position));
+
+  set_base_time (self->pipeline, base_time + position);
+  /* also makes the sinks give up waiting for the previous base time */
+  gst_element_seek (self->pipeline, 1.0, GST_FORMAT_TIME,
+      GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_ACCURATE, GST_SEEK_TYPE_SET,
+      position, GST_SEEK_TYPE_NONE, GST_CLOCK_TIME_NONE);
+}
+
+static void
+sample_offset (GstPlayerNetSync * self, GstClockTime base_time)
+{
+  gint64 position;
+  GstClockTime now;
+
+  if (GST_STATE (self->pipeline) != GST_STATE_PLAYING
+      || !gst_element_query_position (self->pipeline, GST_FORMAT_TIME,
+          &position))
+    return;
+  now = gst_clock_get_time (self->clock);
+
+  g_mutex_lock (&self->lock);
+  if (self->aligned && self->base_time == base_time) {
+    self->offset = position - GST_CLOCK_DIFF (base_time, now);
+    self->have_offset = TRUE;
+  }
+  g_mutex_unlock (&self->lock);
+}
+
+static gboolean
+tick_cb (GstPlayerNetSync * self)
+{
+  GstClockTime base_time;
+  gint64 now;
+  gboolean need_align;
+  gchar *message = NULL;
+
+  g_mutex_lock (&self->lock);
+  base_time = self->base_time;
+  need_align = self->prerolled && !self->aligned
+      && base_time != GST_CLOCK_TIME_NONE;
+  if (need_align)
+    self->aligned = self->aligning = TRUE;
+  g_mutex_unlock (&self->lock);
+
+  /* a slave's clock jumps until it is synced, nothing can be aligned to
+   * it before */
+  if (need_align && !gst_clock_is_synced (self->clock)) {
+    g_mutex_lock (&self->lock);
+    self->aligned = self->aligning = FALSE;
+    g_mutex_unlock (&self->lock);
+    need_align = FALSE;
+  }
+  if (need_align)
+    align (self, base_time);
+
+  now = g_get_monotonic_time ();
+  if (now < self->last_report + REPORT_INTERVAL)
+    return G_SOURCE_CONTINUE;
+  self->last_report = now;
+
+  if (base_time != GST_CLOCK_TIME_NONE)
+    sample_offset (self, base_time);
+
+  if (self->master)
+    return G_SOURCE_CONTINUE;
+
+  g_mutex_lock (&self->lock);
+  if (self->base_time == GST_CLOCK_TIME_NONE)
+    message = g_strdup ("BASE?");
+  else if (self->have_offset)
+    message = g_strdup_printf ("POS %" G_GINT64_FORMAT, self->offset);
+  g_mutex_unlock (&self->lock);
+
+  if (message)
+    send_message (self, self->master_address, message);
+  g_free (message);
+
+  return G_SOURCE_CONTINUE;
+}
+
+static void
+async_done_cb (GstBus * bus, GstMessage * msg, GstPlayerNetSync * self)
+{
+  if (GST_MESSAGE_SRC (msg) != GST_OBJECT_CAST (self->pipeline))
+    return;
+
+  g_mutex_lock (&self->lock);
+  self->prerolled = TRUE;
+  /* someone else seeked, the running time starts from 0 again */
+  if (self->aligned && !self->aligning) {
+    GST_DEBUG ("Flushed after aligning, aligning again");
+    self->aligned = FALSE;
+    self->have_offset = FALSE;
+  }
+  self->aligning = FALSE;
+  g_mutex_unlock (&self->lock);
+}
+
+static void
+state_changed_cb (GstBus * bus, GstMessage * msg, GstPlayerNetSync * self)
+{
+  GstState new_state;
+
+  if (GST_MESSAGE_SRC (msg) != GST_OBJECT_CAST (self->pipeline))
+    return;
+
+  gst_message_parse_state_changed (msg, NULL, &new_state, NULL);
+  if (new_state > GST_STATE_READY)
+    return;
+
+  /* a new item has to preroll and be aligned again */
+  g_mutex_lock (&self->lock);
+  self->prerolled = FALSE;
+  self->aligned = FALSE;
+  self->aligning = FALSE;
+  self->have_offset = FALSE;
+  g_mutex_unlock (&self->lock);
+
+  set_base_time (self->pipeline, UNKNOWN_BASE_TIME);
+}
+
+static GstPlayerNetSync *
+net_sync_new (GstPlayer * player, GstClock * clock, gboolean master)
+{
+  GstPlayerNetSync *self;
+
+  self = g_new0 (GstPlayerNetSync, 1);
+  g_mutex_init (&self->lock);
+  self->master = master;
+  self->clock = clock;
+  self->base_time = GST_CLOCK_TIME_NONE;
+  self->peers = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+      g_free);
+
+  self->pipeline = gst_player_get_pipeline (player);
+  gst_pipeline_use_clock (GST_PIPELINE (self->pipeline), clock);
+  gst_pipeline_set_latency (GST_PIPELINE (self->pipeline), PIPELINE_LATENCY);
+  gst_element_set_start_time (self->pipeline, GST_CLOCK_TIME_NONE);
+  set_base_time (self->pipeline, UNKNOWN_BASE_TIME);
+
+  /* GstPlayer already has a signal watch on its bus */
+  self->bus = gst_element_get_bus (self->pipeline);
+  self->async_done_id = g_signal_connect (self->bus, "message::async-done",
+      G_CALLBACK (async_done_cb), self);
+  self->state_changed_id = g_signal_connect (self->bus,
+      "message::state-changed", G_CALLBACK (state_changed_cb), self);
+
+  return self;
+}
+
+static gboolean
+net_sync_start (GstPlayerNetSync * self, GInetAddress * bind_address,
+    gint port, GError ** error)
+{
+  GSocketAddress *address;
+  gboolean ret;
+
+  self->socket = g_socket_new (g_inet_address_get_family (bind_address),
+      G_SOCKET_TYPE_DATAGRAM, G_SOCKET_PROTOCOL_UDP, error);
+  if (!self->socket)
+    return FALSE;
+
+  address = g_inet_socket_address_new (bind_address, port);
+  ret = g_socket_bind (self->socket, address, TRUE, error);
+  g_object_unref (address);
+  if (!ret)
+    return FALSE;
+
+  g_socket_set_blocking (self->socket, FALSE);
+  self->socket_source = g_socket_create_source (self->socket, G_IO_IN, NULL);
+  g_source_set_callback (self->socket_source, (GSourceFunc) socket_readable_cb,
+      self, NULL);
+  g_source_attach (self->socket_source, NULL);
+
+  self->tick_id = g_timeout_add (TICK_INTERVAL_MS, (GSourceFunc) tick_cb,
+      self);
+
+  return TRUE;
+}
+
+/**
+ * gst_player_net_sync_new_master:
+ * @player: the player to synchronise
+ * @port: the UDP port to provide the clock on, the next one is used for
+ *     handing out the base time
+ * @error: location for a #GError
+ *
+ * Has to be created before @player gets an URI, and freed only after
+ * @player was disposed.
+ */
+GstPlayerNetSync *
+gst_player_net_sync_new_master (GstPlayer * player, gint port,
+    GError ** error)
+{
+  GstPlayerNetSync *self;
+  GInetAddress *any;
+  gboolean ret;
+
+  g_return_val_if_fail (GST_IS_PLAYER (player), NULL);
+  g_return_val_if_fail (port > 0 && port < 65535, NULL);
+
+  self = net_sync_new (player, gst_system_clock_obtain (), TRUE);
+  self->base_time = gst_clock_get_time (self->clock) + START_DELAY;
+
+  self->provider = gst_net_time_provider_new (self->clock, NULL, port);
+  if (!self->provider) {
+    g_set_error (error, GST_RESOURCE_ERROR, GST_RESOURCE_ERROR_OPEN_READ,
+        "Could not provide the clock on port %d", port);
+    gst_player_net_sync_free (self);
+    return NULL;
+  }
+
+  any = g_inet_address_new_any (G_SOCKET_FAMILY_IPV4);
+  ret = net_sync_start (self, any, port + 1, error);
+  g_object_unref (any);
+  if (!ret) {
+    gst_player_net_sync_free (self);
+    return NULL;
+  }
+
+  return self;
+}
+
+static GInetAddress *
+resolve (const gchar * host, GError ** error)
+{
+  GInetAddress *address;
+  GResolver *resolver;
+  GList *addresses;
+
+  address = g_inet_address_new_from_string (host);
+  if (address)
+    return address;
+
+  resolver = g_resolver_get_default ();
+  addresses = g_resolver_lookup_by_name (resolver, host, NULL, error);
+  g_object_unref (resolver);
+  if (!addresses)
+    return NULL;
+
+  address = g_object_ref (addresses->data);
+  g_resolver_free_addresses (addresses);
+
+  return address;
+}
+
+/**
+ * gst_player_net_sync_new_slave:
+ * @player: the player to synchronise
+ * @host: where the master runs
+ * @port: the port the master provides its clock on
+ * @error: location for a #GError
+ *
+ * Has to be created before @player gets an URI, and freed only after
+ * @player was disposed. Nothing is shown before the master was reached.
+ */
+GstPlayerNetSync *
+gst_player_net_sync_new_slave (GstPlayer * player, const gchar * host,
+    gint port, GError ** error)
+{
+  GstPlayerNetSync *self;
+  GInetAddress *address, *any;
+  GstClock *clock;
+  gchar *address_str;
+  gboolean ret;
+
+  g_return_val_if_fail (GST_IS_PLAYER (player), NULL);
+  g_return_val_if_fail (host != NULL, NULL);
+  g_return_val_if_fail (port > 0 && port < 65535, NULL);
+
+  address = resolve (host, error);
+  if (!address)
+    return NULL;
+
+  address_str = g_inet_address_to_string (address);
+  clock = gst_net_client_clock_new ("player-net-sync", address_str, port, 0);
+  g_free (address_str);
+
+  self = net_sync_new (player, clock, FALSE);
+  self->master_address = g_inet_socket_address_new (address, port + 1);
+
+  any = g_inet_address_new_any (g_inet_address_get_family (address));
+  ret = net_sync_start (self, any, 0, error);
+  g_object_unref (any);
+  g_object_unref (address);
+  if (!ret) {
+    gst_player_net_sync_free (self);
+    return NULL;
+  }
+
+  return self;
+}
+
+/* splits HOST:PORT, as given on the command line */
+gboolean
+gst_player_net_sync_parse_address (const gchar * address, gchar ** host,
+    gint * port)
+{
+  const gchar *colon;
+  gchar *end;
+  gint64 p;
+
+  g_return_val_if_fail (address != NULL, FALSE);
+
+  colon = strrchr (address, ':');
+  if (!colon || colon == address)
+    return FALSE;
+
+  p = g_ascii_strtoll (colon + 1, &end, 10);
+  if (*end != '\0' || end == colon + 1 || p <= 0 || p >= 65535)
+    return FALSE;
+
+  *host = g_strndup (address, colon - address);
+  *port = p;
+
+  return TRUE;
+}
+
+void
+gst_player_net_sync_free (GstPlayerNetSync * self)
+{
+  g_return_if_fail (self != NULL);
+
+  if (self->tick_id)
+    g_source_remove (self->tick_id);
+  if (self->socket_source) {
+    g_source_destroy (self->socket_source);
+    g_source_unref (self->socket_source);
+  }
+  g_clear_object (&self->socket);
+  g_clear_object (&self->master_address);
+  if (self->provider)
+    gst_object_unref (self->provider);
+
+  g_signal_handler_disconnect (self->bus, self->async_done_id);
+  g_signal_handler_disconnect (self->bus, self->state_changed_id);
+  gst_object_unref (self->bus);
+  gst_object_unref (self->pipeline);
+  gst_object_unref (self->clock);
+
+  g_hash_table_unref (self->peers);
+  g_mutex_clear (&self->lock);
+  g_free (self);
+}
+
+/**
+ * gst_player_net_sync_get_skew:
+ * @max_skew: (out): how far the peer furthest away is ahead of this player,
+ *     negative if behind
+ * @n_peers: (out): the number of peers that reported recently, for a slave
+ *     only the master
+ *
+ * Returns: %FALSE if there is nothing to compare yet
+ */
+gboolean
+gst_player_net_sync_get_skew (GstPlayerNetSync * self,
+    GstClockTimeDiff * max_skew, guint * n_peers)
+{
+  GHashTableIter iter;
+  Peer *peer;
+  gint64 duration = -1, now = g_get_monotonic_time ();
+  gboolean ret = FALSE;
+
+  g_return_val_if_fail (self != NULL, FALSE);
+  g_return_val_if_fail (max_skew != NULL, FALSE);
+  g_return_val_if_fail (n_peers != NULL, FALSE);
+
+  /* positions wrap around when looping, skews are at most half of it */
+  gst_element_query_duration (self->pipeline, GST_FORMAT_TIME, &duration);
+
+  *max_skew = 0;
+  *n_peers = 0;
+
+  g_mutex_lock (&self->lock);
+  g_hash_table_iter_init (&iter, self->peers);
+  while (self->have_offset
+      && g_hash_table_iter_next (&iter, NULL, (gpointer *) & peer)) {
+    GstClockTimeDiff skew;
+
+    if (now - peer->last_seen > PEER_TIMEOUT)
+      continue;
+
+    skew = peer->offset - self->offset;
+    if (duration > 0) {
+      skew %= duration;
+      if (skew > duration / 2)
+        skew -= duration;
+      else if (skew < -duration / 2)
+        skew += duration;
+    }
+
+    if (ABS (skew) >= ABS (*max_skew))
+      *max_skew = skew;
+    (*n_peers)++;
+    ret = TRUE;
+  }
+  g_mutex_unlock (&self->lock);
+
+  return ret;
+}
@@ -0,0 +1,44 @@
+/* GStreamer
+ *
+ * Copyright (C) 2016 GStreamer developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __GST_PLAYER_NET_SYNC_H__
+#define __GST_PLAYER_NET_SYNC_H__
+
+#include <gst/player/player.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GstPlayerNetSync GstPlayerNetSync;
+
+GstPlayerNetSync * gst_player_net_sync_new_master (GstPlayer * player,
+    gint port, GError ** error);
+GstPlayerNetSync * gst_player_net_sync_new_slave (GstPlayer * player,
+    const gchar * host, gint port, GError ** error);
+void gst_player_net_sync_free (GstPlayerNetSync * self);
+
+gboolean gst_player_net_sync_parse_address (const gchar * address,
+    gchar ** host, gint * port);
+
+gboolean gst_player_net_sync_get_skew (GstPlayerNetSync * self,
+    GstClockTimeDiff * max_skew, guint * n_peers);
+
+G_END_DECLS
+
+#endif /* __GST_PLAYER_NET_SYNC_H__ */
@@ -0,0 +1,319 @@
+/* GStreamer
+ *
+ * Copyright (C) 2016 GStreamer developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Gets the next playlist items into the page cache while the current
+ * one plays, so that they don't start with cold reads from NFS or
+ * spinning disks. For each upcoming local file the first bytes up to the
+ * configured size and the last TAIL_SIZE bytes are fetched, the latter
+ * for indexes written at the end like the moov of MP4 recordings.
+ *
+ * A thread of its own goes through the files in CHUNK_SIZE steps and
+ * asks the kernel to read each chunk with POSIX_FADV_WILLNEED, or reads
+ * it itself where that is not available. It never issues more than the
+ * configured rate per second, runs at idle I/O priority where possible
+ * and stops while the player is buffering, so the item that is playing
+ * always comes first. */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <glib/gstdio.h>
+
+#ifdef G_OS_UNIX
+#include <unistd.h>
+#endif
+
+#ifdef G_OS_WIN32
+#include <io.h>
+#endif
+
+#if defined (__linux__)
+#include <sys/syscall.h>
+#endif
+
+#ifndef O_BINARY
+#define O_BINARY 0
+#endif
+
+#include "gst-player-prefetch.h"
+
+#define CHUNK_SIZE (1024 * 1024)
+#define TAIL_SIZE (1024 * 1024)
+/* files that were fetched already, e.g. when skipping back and forth */
+#define MAX_DONE 8
+
+struct _GstPlayerPrefetch
+{
+  GstPlayer *player;
+  guint64 size;
+  guint64 rate;
+
+  GThread *thread;
+  GMutex lock;
+  GCond cond;
+  /* protected by lock */
+  GQueue pending;
+  GQueue done;
+  /* bumped for every new list, the current file is dropped then */
+  guint generation;
+  gboolean buffering;
+  gboolean quit;
+};
+
+static gboolean
+is_queued (GQueue * queue, const gchar * path)
+{
+  return g_queue_find_custom (queue, path, (GCompareFunc) g_strcmp0) != NULL;
+}
+
+/* with the lock, FALSE if the file is not wanted anymore */
+static gboolean
+wait_until (GstPlayerPrefetch * self, gint64 end_time, guint generation)
+{
+  while (!self->quit && self->generation == generation
+      && (self->buffering || g_get_monotonic_time () < end_time)) {
+    if (self->buffering)
+      g_cond_wait (&self->cond, &self->lock);
+    else
+      g_cond_wait_until (&self->cond, &self->lock, end_time);
+  }
+
+  return !self->quit && self->generation == generation;
+}
+
+static void
+fetch_range (gint fd, guint64 offset, guint64 length, guint8 * scratch)
+{
+#ifdef HAVE_POSIX_FADVISE
+  posix_fadvise (fd, offset, length, POSIX_FADV_WILLNEED);
+#else
+  if (lseek (fd, offset, SEEK_SET) == (off_t) offset)
+    while (length > 0 && read (fd, scratch, MIN (length, CHUNK_SIZE)) > 0)
+      length -= MIN (length, CHUNK_SIZE);
+#endif
+}
+
+/* returns FALSE if it was interrupted */
+static gboolean
+fetch_file (GstPlayerPrefetch * self, const gchar * path, guint generation,
+    guint8 * scratch)
+{
+  GStatBuf st;
+  guint64 starts[2], ends[2], offset, fetched = 0;
+  gint64 start_time = g_get_monotonic_time ();
+  gboolean ret = TRUE;
+  guint i;
+  gint fd;
+
+  fd = g_open (path, O_RDONLY | O_BINARY, 0);
+  if (fd < 0)
+    return TRUE;
+
+  if (fstat (fd, &st) != 0 || !S_ISREG (st.st_mode)) {
+    close (fd);
+    return TRUE;
+  }
+
+  /* the tail first, demuxers need the index before anything else */
+  ends[1] = MIN (self->size, (guint64) st.st_size);
+  starts[1] = 0;
+  ends[0] = st.st_size;
+  starts[0] = MAX (ends[1], ends[0] - MIN (TAIL_SIZE, ends[0]));
+
+  GST_DEBUG ("Prefetching %" G_GUINT64_FORMAT " bytes of %s",
+      ends[0] - starts[0] + ends[1], path);
+
+  for (i = 0; i < 2 && ret; i++) {
+    for (offset = starts[i]; offset < ends[i] && ret; offset += CHUNK_SIZE) {
+      guint64 length = MIN (CHUNK_SIZE, ends[i] - offset);
+      gint64 end_time;
+
+      fetch_range (fd, offset, length, scratch);
+      fetched += length;
+
+      /* stays within the rate on average */
+      end_time = start_time + fetched * G_USEC_PER_SEC / self->rate;
+      g_mutex_lock (&self->lock);
+      ret = wait_until (self, end_time, generation);
+      g_mutex_unlock (&self->lock);
+    }
+  }
+
+  close (fd);
+
+  return ret;
+}
+
+static gpointer
+prefetch_thread (GstPlayerPrefetch * self)
+{
+  guint8 *scratch = NULL;
+
+#if defined (__linux__) && defined (SYS_ioprio_set)
+  /* IOPRIO_WHO_PROCESS with 0 is this thread, IOPRIO_CLASS_IDLE */
+  syscall (SYS_ioprio_set, 1, 0, 3 << 13);
+#endif
+#ifndef HAVE_POSIX_FADVISE
+  scratch = g_malloc (CHUNK_SIZE);
+#endif
+
+  g_mutex_lock (&self->lock);
+  while (!self->quit) {
+    gchar *path;
+    guint generation;
+
+    path = g_queue_pop_head (&self->pending);
+    if (!path) {
+      g_cond_wait (&self->cond, &self->lock);
+      continue;
+    }
+    generation = self->generation;
+    g_mutex_unlock (&self->lock);
+
+    if (fetch_file (self, path, generation, scratch)) {
+      g_mutex_lock (&self->lock);
+      g_queue_push_tail (&self->done, path);
+      if (g_queue_get_length (&self->done) > MAX_DONE)
+        g_free (g_queue_pop_head (&self->done));
+    } else {
+      g_free (path);
+      g_mutex_lock (&self->lock);
+    }
+  }
+  g_mutex_unlock (&self->lock);
+
+  g_free (scratch);
+
+  return NULL;
+}
+
+static void
+buffering_cb (GstPlayer * player, gint percent, GstPlayerPrefetch * self)
+{
+  g_mutex_lock (&self->lock);
+  self->buffering = percent < 100;
+  g_cond_broadcast (&self->cond);
+  g_mutex_unlock (&self->lock);
+}
+
+/**
+ * gst_player_prefetch_new:
+ * @player: the player to give way to while it is buffering
+ * @size: how many bytes from the start of each file to fetch
+ * @rate: how many bytes per second to fetch at most
+ *
+ * Returns: (transfer full): a new prefetcher, without any files yet
+ */
+GstPlayerPrefetch *
+gst_player_prefetch_new (GstPlayer * player, guint64 size, guint64 rate)
+{
+  GstPlayerPrefetch *self;
+
+  g_return_val_if_fail (GST_IS_PLAYER (player), NULL);
+  g_return_val_if_fail (rate > 0, NULL);
+
+  self = g_new0 (GstPlayerPrefetch, 1);
+  self->player = player;
+  self->size = size;
+  self->rate = rate;
+  g_mutex_init (&self->lock);
+  g_cond_init (&self->cond);
+  g_queue_init (&self->pending);
+  g_queue_init (&self->done);
+
+  g_object_add_weak_pointer (G_OBJECT (player), (gpointer *) & self->player);
+  g_signal_connect (player, "buffering", G_CALLBACK (buffering_cb), self);
+
+  self->thread = g_thread_new ("prefetch", (GThreadFunc) prefetch_thread,
+      self);
+
+  return self;
+}
+
+/**
+ * gst_player_prefetch_free:
+ * @self: the prefetcher
+ *
+ * Stops fetching, can be called before or after the player is gone.
+ */
+void
+gst_player_prefetch_free (GstPlayerPrefetch * self)
+{
+  g_return_if_fail (self != NULL);
+
+  if (self->player) {
+    g_signal_handlers_disconnect_by_data (self->player, self);
+    g_object_remove_weak_pointer (G_OBJECT (self->player),
+        (gpointer *) & self->player);
+  }
+
+  g_mutex_lock (&self->lock);
+  self->quit = TRUE;
+  g_cond_broadcast (&self->cond);
+  g_mutex_unlock (&self->lock);
+  g_thread_join (self->thread);
+
+  g_queue_foreach (&self->pending, (GFunc) g_free, NULL);
+  g_queue_clear (&self->pending);
+  g_queue_foreach (&self->done, (GFunc) g_free, NULL);
+  g_queue_clear (&self->done);
+  g_cond_clear (&self->cond);
+  g_mutex_clear (&self->lock);
+  g_free (self);
+}
+
+/**
+ * gst_player_prefetch_set_upcoming:
+ * @self: the prefetcher
+ * @uris: the items that play next, in order
+ * @n_uris: the number of @uris
+ *
+ * Replaces the files to fetch. Anything but local files is skipped, and
+ * so are files fetched recently.
+ */
+void
+gst_player_prefetch_set_upcoming (GstPlayerPrefetch * self,
+    const gchar * const *uris, guint n_uris)
+{
+  guint i;
+
+  g_return_if_fail (self != NULL);
+
+  g_mutex_lock (&self->lock);
+  g_queue_foreach (&self->pending, (GFunc) g_free, NULL);
+  g_queue_clear (&self->pending);
+  self->generation++;
+
+  for (i = 0; i < n_uris; i++) {
+    gchar *path = g_filename_from_uri (uris[i], NULL, NULL);
+
+    if (path && !is_queued (&self->done, path)
+        && !is_queued (&self->pending, path))
+      g_queue_push_tail (&self->pending, path);
+    else
+      g_free (path);
+  }
+
+  g_cond_broadcast (&self->cond);
+  g_mutex_unlock (&self->lock);
+}
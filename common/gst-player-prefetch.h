@@ -0,0 +1,39 @@
+/* GStreamer
+ *
+ * Copyright (C) 2016 GStreamer developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __GST_PLAYER_PREFETCH_H__
+#define __GST_PLAYER_PREFETCH_H__
+
+#include <gst/player/player.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GstPlayerPrefetch GstPlayerPrefetch;
+
+GstPlayerPrefetch * gst_player_prefetch_new (GstPlayer * player,
+    guint64 size, guint64 rate);
+void gst_player_prefetch_free (GstPlayerPrefetch * self);
+
+void gst_player_prefetch_set_upcoming (GstPlayerPrefetch * self,
+    const gchar * const * uris, guint n_uris);
+
+G_END_DECLS
+
+#endif /* __GST_PLAYER_PREFETCH_H__ */
@@ -0,0 +1,1327 @@
+/* GStreamer
+ *
+ * Copyright (C) 2016 GStreamer developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* A seek index for local files whose demuxers have to bisect or scan for
+ * seeking, like raw MPEG-TS or VBR MP3 without a TOC. It is a source
+ * element for "seekindex+file" URIs
+ * that playbin picks up like any other source:
+ *
+ *   source ! parsebin
+ *
+ * with one source pad per stream of the parsebin, so parsed but not
+ * decoded data. The demuxer always runs in push mode, so everything it
+ * reads goes through the source pad in order.
+ *
+ * Containers that come with an index (indexed_formats) are only passed
+ * through, the demuxer stays in charge of reading and seeking.
+ *
+ * While playing, the time of every keyframe of the index stream, the
+ * first video stream or else the first stream, is put into the index
+ * together with the offset the source was reading at OFFSET_HISTORY
+ * frames earlier. Starting to read there gives some frames before the
+ * keyframe, which are dropped, but never skips it. Entries are at least
+ * INDEX_INTERVAL apart. Nothing is recorded after seeks left to the
+ * demuxer until the next seek with the index, their times can be
+ * estimates. A scan of the whole file in a pipeline of its
+ * own runs next to playback at SCAN_RATE until the index is complete.
+ * If the item changes before, what it found so far is kept.
+ *
+ * The index is kept in the user's cache directory, keyed by the path,
+ * size and modification time of the file. Entries are stored as deltas
+ * in variable length integers, which makes them a few bytes each.
+ *
+ * A flushing seek in time close enough after an entry, or anywhere if
+ * the index is complete, is turned into a seek in bytes on the source.
+ * Data is dropped until the first keyframe of the index stream, whose
+ * time is then taken from the entry. The same offset is applied to all
+ * streams until the next seek, and all get a new segment from the entry
+ * or the seek position. Other seeks, including those with a stop position
+ * and segment seeks, are left to the demuxer. For
+ * audio-only files every frame is a keyframe, so the time after a seek
+ * can be a few frames off. */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+#include <sys/stat.h>
+#include <glib/gstdio.h>
+#include <gst/base/gsttypefindhelper.h>
+
+#include "gst-player-seek-index.h"
+
+#define SEEK_INDEX_PREFIX "seekindex+"
+
+#define INDEX_INTERVAL GST_SECOND
+/* without a complete index, seeks further after an entry than this are
+ * left to the demuxer */
+#define MAX_ENTRY_DISTANCE (10 * GST_SECOND)
+#define OFFSET_HISTORY 3
+/* small reads in the scan so offsets are exact enough, playback uses the
+ * source's default */
+#define SCAN_BLOCKSIZE 4096
+/* enough for typefinding the container */
+#define SNIFF_SIZE 4096
+#define SCAN_RATE (16 * 1024 * 1024)
+
+#define INDEX_MAGIC "GPSI"
+#define INDEX_VERSION 1
+#define INDEX_FLAG_COMPLETE 1
+
+typedef struct
+{
+  GstClockTime time;
+  guint64 offset;
+} IndexEntry;
+
+typedef struct
+{
+  GMutex lock;
+  /* sorted by time */
+  GArray *entries;
+  gboolean complete;
+  GstClockTime duration;
+  gboolean dirty;
+} SeekIndex;
+
+/* everything happens in the streaming thread of the source, parsebin has
+ * no queues */
+typedef struct
+{
+  SeekIndex *index;
+  GstPad *index_pad;
+  gboolean index_pad_is_video;
+  /* times after a seek done by the demuxer can be estimates */
+  gboolean anchored;
+
+  guint64 read_offset;
+  /* start of the last buffer of the source */
+  guint64 read_start;
+  /* the same when the last index stream buffers came out */
+  guint64 history[OFFSET_HISTORY];
+  GstClockTime max_position;
+
+  /* 0 for no limit */
+  guint64 rate;
+  gint64 rate_start;
+  guint64 rate_bytes;
+} Recorder;
+
+#define GST_TYPE_PLAYER_SEEK_INDEX_SRC (gst_player_seek_index_src_get_type ())
+#define GST_PLAYER_SEEK_INDEX_SRC(obj) (G_TYPE_CHECK_INSTANCE_CAST ((obj), \
+        GST_TYPE_PLAYER_SEEK_INDEX_SRC, GstPlayerSeekIndexSrc))
+
+typedef struct _GstPlayerSeekIndexSrc GstPlayerSeekIndexSrc;
+
+typedef struct
+{
+  GstPlayerSeekIndexSrc *src;
+  GstPad *ghost;
+  /* of the demuxer */
+  GstSegment segment;
+} Stream;
+
+struct _GstPlayerSeekIndexSrc
+{
+  GstBin parent;
+
+  gchar *uri;
+  gchar *location;
+
+  /* set up when going to READY */
+  gchar *index_path;
+  SeekIndex *index;
+  GstElement *source;
+  Recorder recorder;
+  /* the container has an index, nothing is done */
+  gboolean passthrough;
+
+  GMutex lock;
+  /* protected by lock */
+  GPtrArray *streams;
+  guint n_pads;
+  /* between a seek done with the index and the next seek */
+  gboolean remapping;
+  gboolean shift_known;
+  GstClockTimeDiff shift;
+  GstClockTime entry_time;
+  GstClockTime segment_start;
+  guint32 seek_seqnum;
+
+  GstElement *scan;
+  SeekIndex *scan_index;
+  Recorder scan_recorder;
+};
+
+typedef struct
+{
+  GstBinClass parent_class;
+} GstPlayerSeekIndexSrcClass;
+
+static GType gst_player_seek_index_src_get_type (void);
+static void gst_player_seek_index_src_uri_handler_init (gpointer g_iface,
+    gpointer iface_data);
+
+G_DEFINE_TYPE_WITH_CODE (GstPlayerSeekIndexSrc, gst_player_seek_index_src,
+    GST_TYPE_BIN, G_IMPLEMENT_INTERFACE (GST_TYPE_URI_HANDLER,
+        gst_player_seek_index_src_uri_handler_init));
+
+static const gchar *indexed_formats[] = {
+  "video/quicktime", "video/x-matroska", "video/webm", "video/x-msvideo"
+};
+
+static GstStaticPadTemplate src_template = GST_STATIC_PAD_TEMPLATE ("src_%u",
+    GST_PAD_SRC,
+    GST_PAD_SOMETIMES,
+    GST_STATIC_CAPS_ANY);
+
+static const gchar *const *
+uri_handler_get_protocols (GType type)
+{
+  static const gchar *protocols[] = { SEEK_INDEX_PREFIX "file", NULL };
+
+  return protocols;
+}
+
+static GstURIType
+uri_handler_get_type (GType type)
+{
+  return GST_URI_SRC;
+}
+
+static gchar *
+uri_handler_get_uri (GstURIHandler * handler)
+{
+  GstPlayerSeekIndexSrc *self = GST_PLAYER_SEEK_INDEX_SRC (handler);
+  gchar *uri;
+
+  GST_OBJECT_LOCK (self);
+  uri = g_strdup (self->uri);
+  GST_OBJECT_UNLOCK (self);
+
+  return uri;
+}
+
+static gboolean
+uri_handler_set_uri (GstURIHandler * handler, const gchar * uri,
+    GError ** error)
+{
+  GstPlayerSeekIndexSrc *self = GST_PLAYER_SEEK_INDEX_SRC (handler);
+  gchar *location;
+
+  if (!g_str_has_prefix (uri, SEEK_INDEX_PREFIX)
+      || !(location = g_filename_from_uri (uri + strlen (SEEK_INDEX_PREFIX),
+              NULL, NULL))) {
+    g_set_error (error, GST_URI_ERROR, GST_URI_ERROR_BAD_URI,
+        "Not a seek index URI: %s", uri);
+    return FALSE;
+  }
+
+  if (GST_STATE (self) != GST_STATE_NULL) {
+    g_set_error (error, GST_URI_ERROR, GST_URI_ERROR_BAD_STATE,
+        "Can't change the URI while running");
+    g_free (location);
+    return FALSE;
+  }
+
+  GST_OBJECT_LOCK (self);
+  g_free (self->uri);
+  self->uri = g_strdup (uri);
+  g_free (self->location);
+  self->location = location;
+  GST_OBJECT_UNLOCK (self);
+
+  return TRUE;
+}
+
+static void
+gst_player_seek_index_src_uri_handler_init (gpointer g_iface,
+    gpointer iface_data)
+{
+  GstURIHandlerInterface *iface = (GstURIHandlerInterface *) g_iface;
+
+  iface->get_type = uri_handler_get_type;
+  iface->get_protocols = uri_handler_get_protocols;
+  iface->get_uri = uri_handler_get_uri;
+  iface->set_uri = uri_handler_set_uri;
+}
+
+static SeekIndex *
+seek_index_new (void)
+{
+  SeekIndex *index = g_new0 (SeekIndex, 1);
+
+  g_mutex_init (&index->lock);
+  index->entries = g_array_new (FALSE, FALSE, sizeof (IndexEntry));
+  index->duration = GST_CLOCK_TIME_NONE;
+
+  return index;
+}
+
+static void
+seek_index_free (SeekIndex * index)
+{
+  g_array_unref (index->entries);
+  g_mutex_clear (&index->lock);
+  g_free (index);
+}
+
+static void
+seek_index_add (SeekIndex * index, GstClockTime time, guint64 offset)
+{
+  IndexEntry *entries, entry = { time, offset };
+  guint low = 0, high, mid;
+
+  g_mutex_lock (&index->lock);
+  entries = (IndexEntry *) index->entries->data;
+  high = index->entries->len;
+  while (low < high) {
+    mid = (low + high) / 2;
+    if (entries[mid].time < time)
+      low = mid + 1;
+    else
+      high = mid;
+  }
+
+  if ((low == 0 || time - entries[low - 1].time >= INDEX_INTERVAL)
+      && (low == index->entries->len
+          || entries[low].time - time >= INDEX_INTERVAL)) {
+    g_array_insert_val (index->entries, low, entry);
+    index->dirty = TRUE;
+  }
+  g_mutex_unlock (&index->lock);
+}
+
+/* the last entry at or before @time, if it is close enough */
+static gboolean
+seek_index_lookup (SeekIndex * index, GstClockTime time, IndexEntry * entry)
+{
+  IndexEntry *entries;
+  guint low = 0, high, mid;
+  gboolean found = FALSE;
+
+  g_mutex_lock (&index->lock);
+  entries = (IndexEntry *) index->entries->data;
+  high = index->entries->len;
+  while (low < high) {
+    mid = (low + high) / 2;
+    if (entries[mid].time <= time)
+      low = mid + 1;
+    else
+      high = mid;
+  }
+
+  if (low > 0 && (index->complete
+          || time - entries[low - 1].time <= MAX_ENTRY_DISTANCE)) {
+    *entry = entries[low - 1];
+    found = TRUE;
+  }
+  g_mutex_unlock (&index->lock);
+
+  return found;
+}
+
+/* entries of a scan that did not finish, they are just as exact */
+static void
+seek_index_merge (SeekIndex * index, SeekIndex * from)
+{
+  GArray *entries;
+  guint i;
+
+  g_mutex_lock (&from->lock);
+  entries = g_array_ref (from->entries);
+  g_mutex_unlock (&from->lock);
+
+  for (i = 0; i < entries->len; i++) {
+    IndexEntry *entry = &g_array_index (entries, IndexEntry, i);
+
+    seek_index_add (index, entry->time, entry->offset);
+  }
+  g_array_unref (entries);
+}
+
+static void
+put_varint (GByteArray * data, guint64 value)
+{
+  guint8 byte;
+
+  do {
+    byte = value & 0x7f;
+    value >>= 7;
+    if (value)
+      byte |= 0x80;
+    g_byte_array_append (data, &byte, 1);
+  } while (value);
+}
+
+static gboolean
+get_varint (const guint8 ** p, const guint8 * end, guint64 * value)
+{
+  guint shift = 0;
+
+  *value = 0;
+  while (*p < end && shift < 64) {
+    guint8 byte = *(*p)++;
+
+    *value |= (guint64) (byte & 0x7f) << shift;
+    if (!(byte & 0x80))
+      return TRUE;
+    shift += 7;
+  }
+
+  return FALSE;
+}
+
+/* the same for every copy of a file, but not after it changed */
+static gchar *
+seek_index_get_path (const gchar * location)
+{
+  GStatBuf st;
+  gchar *key, *checksum, *path;
+
+  if (g_stat (location, &st) != 0)
+    return NULL;
+
+  key = g_strdup_printf ("%s\n%" G_GUINT64_FORMAT "\n%" G_GINT64_FORMAT,
+      location, (guint64) st.st_size, (gint64) st.st_mtime);
+  checksum = g_compute_checksum_for_string (G_CHECKSUM_SHA1, key, -1);
+  path = g_build_filename (g_get_user_cache_dir (), "gst-player",
+      "seek-index", checksum, NULL);
+  g_free (checksum);
+  g_free (key);
+
+  return path;
+}
+
+static SeekIndex *
+seek_index_load (const gchar * path)
+{
+  SeekIndex *index = seek_index_new ();
+  const guint8 *p, *end;
+  gchar *contents;
+  gsize length;
+  guint64 n, i, duration, time = 0, offset = 0;
+
+  if (!path || !g_file_get_contents (path, &contents, &length, NULL))
+    return index;
+
+  p = (const guint8 *) contents;
+  end = p + length;
+  if (length < 6 || memcmp (p, INDEX_MAGIC, 4) != 0 || p[4] != INDEX_VERSION)
+    goto out;
+
+  index->complete = (p[5] & INDEX_FLAG_COMPLETE) != 0;
+  p += 6;
+  if (!get_varint (&p, end, &duration) || !get_varint (&p, end, &n))
+    goto out;
+  index->duration = duration > 0 ? duration - 1 : GST_CLOCK_TIME_NONE;
+
+  for (i = 0; i < n; i++) {
+    guint64 time_delta, offset_delta;
+    IndexEntry entry;
+
+    if (!get_varint (&p, end, &time_delta)
+        || !get_varint (&p, end, &offset_delta))
+      break;
+
+    /* offsets can go backwards, they are zigzag coded */
+    time += time_delta;
+    offset += (offset_delta >> 1) ^ -(gint64) (offset_delta & 1);
+    entry.time = time;
+    entry.offset = offset;
+    g_array_append_val (index->entries, entry);
+  }
+
+  /* a broken file is only as good as what was read */
+  if (i < n)
+    index->complete = FALSE;
+
+out:
+  g_free (contents);
+
+  GST_DEBUG ("Loaded %u seek index entries from %s", index->entries->len,
+      path);
+
+  return index;
+}
+
+static void
+seek_index_save (SeekIndex * index, const gchar * path)
+{
+  GByteArray *data;
+  gchar *dirname;
+  guint8 header[6];
+  guint64 time = 0, offset = 0;
+  guint i;
+
+  /* passthrough */
+  if (!path)
+    return;
+
+  g_mutex_lock (&index->lock);
+  if (!index->dirty || !path) {
+    g_mutex_unlock (&index->lock);
+    return;
+  }
+
+  data = g_byte_array_new ();
+  memcpy (header, INDEX_MAGIC, 4);
+  header[4] = INDEX_VERSION;
+  header[5] = index->complete ? INDEX_FLAG_COMPLETE : 0;
+  g_byte_array_append (data, header, sizeof (header));
+  put_varint (data, GST_CLOCK_TIME_IS_VALID (index->duration) ?
+      index->duration + 1 : 0);
+  put_varint (data, index->entries->len);
+
+  for (i = 0; i < index->entries->len; i++) {
+    IndexEntry *entry = &g_array_index (index->entries, IndexEntry, i);
+    gint64 offset_delta = entry->offset - offset;
+
+    put_varint (data, entry->time - time);
+    put_varint (data, (offset_delta << 1) ^ (offset_delta >> 63));
+    time = entry->time;
+    offset = entry->offset;
+  }
+  index->dirty = FALSE;
+  g_mutex_unlock (&index->lock);
+
+  dirname = g_path_get_dirname (path);
+  if (g_mkdir_with_parents (dirname, 0700) != 0
+      || !g_file_set_contents (path, (const gchar *) data->data, data->len,
+          NULL))
+    GST_WARNING ("Could not write the seek index to %s", path);
+  g_free (dirname);
+  g_byte_array_unref (data);
+}
+
+static void
+recorder_init (Recorder * recorder, SeekIndex * index, guint64 rate)
+{
+  memset (recorder, 0, sizeof (Recorder));
+  recorder->index = index;
+  recorder->anchored = TRUE;
+  recorder->max_position = GST_CLOCK_TIME_NONE;
+  recorder->rate = rate;
+}
+
+static void
+recorder_reset (Recorder * recorder, guint64 offset)
+{
+  guint i;
+
+  recorder->read_offset = recorder->read_start = offset;
+  for (i = 0; i < OFFSET_HISTORY; i++)
+    recorder->history[i] = offset;
+  recorder->rate_start = 0;
+}
+
+/* a buffer of the index stream at @position in the file */
+static void
+recorder_add (Recorder * recorder, GstBuffer * buffer, GstClockTime position)
+{
+  guint i;
+
+  if (GST_CLOCK_TIME_IS_VALID (position)) {
+    if (recorder->anchored
+        && !GST_BUFFER_FLAG_IS_SET (buffer, GST_BUFFER_FLAG_DELTA_UNIT))
+      seek_index_add (recorder->index, position, recorder->history[0]);
+
+    if (GST_BUFFER_DURATION_IS_VALID (buffer))
+      position += GST_BUFFER_DURATION (buffer);
+    if (!GST_CLOCK_TIME_IS_VALID (recorder->max_position)
+        || position > recorder->max_position)
+      recorder->max_position = position;
+  }
+
+  for (i = 0; i + 1 < OFFSET_HISTORY; i++)
+    recorder->history[i] = recorder->history[i + 1];
+  recorder->history[OFFSET_HISTORY - 1] = recorder->read_start;
+}
+
+static GstPadProbeReturn
+source_probe (GstPad * pad, GstPadProbeInfo * info, Recorder * recorder)
+{
+  if (GST_PAD_PROBE_INFO_TYPE (info) & GST_PAD_PROBE_TYPE_BUFFER) {
+    GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER (info);
+    gsize size = gst_buffer_get_size (buffer);
+    gint64 delay;
+
+    if (GST_BUFFER_OFFSET_IS_VALID (buffer))
+      recorder->read_start = GST_BUFFER_OFFSET (buffer);
+    else
+      recorder->read_start = recorder->read_offset;
+    recorder->read_offset = recorder->read_start + size;
+
+    if (recorder->rate == 0)
+      return GST_PAD_PROBE_OK;
+
+    /* the scan only runs at the given rate */
+    if (recorder->rate_start == 0) {
+      recorder->rate_start = g_get_monotonic_time ();
+      recorder->rate_bytes = 0;
+    }
+    recorder->rate_bytes += size;
+    delay = recorder->rate_start +
+        recorder->rate_bytes * G_USEC_PER_SEC / recorder->rate -
+        g_get_monotonic_time ();
+    if (delay > 0)
+      g_usleep (delay);
+  } else if (GST_PAD_PROBE_INFO_TYPE (info) &
+      GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM) {
+    GstEvent *event = GST_PAD_PROBE_INFO_EVENT (info);
+    const GstSegment *segment;
+
+    if (GST_EVENT_TYPE (event) == GST_EVENT_SEGMENT) {
+      gst_event_parse_segment (event, &segment);
+      if (segment->format == GST_FORMAT_BYTES)
+        recorder_reset (recorder, segment->start);
+    }
+  } else if (GST_PAD_PROBE_INFO_TYPE (info) & GST_PAD_PROBE_TYPE_PUSH) {
+    /* queries come here before and after they are answered */
+    GstQuery *query = GST_PAD_PROBE_INFO_QUERY (info);
+
+    /* keeps the demuxer in push mode, everything it reads passes here */
+    if (GST_QUERY_TYPE (query) == GST_QUERY_SCHEDULING) {
+      gst_query_set_scheduling (query, GST_SCHEDULING_FLAG_SEEKABLE, 1, -1,
+          0);
+      gst_query_add_scheduling_mode (query, GST_PAD_MODE_PUSH);
+      return GST_PAD_PROBE_HANDLED;
+    }
+  }
+
+  return GST_PAD_PROBE_OK;
+}
+
+static gboolean
+has_own_index (const gchar * location)
+{
+  guint8 data[SNIFF_SIZE];
+  const gchar *name;
+  gboolean ret = FALSE;
+  GstCaps *caps;
+  gsize size;
+  FILE *file;
+  guint i;
+
+  file = g_fopen (location, "rb");
+  if (!file)
+    return FALSE;
+  size = fread (data, 1, sizeof (data), file);
+  fclose (file);
+
+  caps = gst_type_find_helper_for_data (NULL, data, size, NULL);
+  if (!caps)
+    return FALSE;
+
+  name = gst_structure_get_name (gst_caps_get_structure (caps, 0));
+  for (i = 0; i < G_N_ELEMENTS (indexed_formats); i++)
+    if (g_strcmp0 (name, indexed_formats[i]) == 0)
+      ret = TRUE;
+  gst_caps_unref (caps);
+
+  return ret;
+}
+
+/* without @recorder the demuxer can pick the scheduling mode */
+static GstElement *
+make_source (const gchar * location, Recorder * recorder, guint blocksize)
+{
+  GstElement *source;
+  gchar *uri;
+  GstPad *pad;
+
+  uri = gst_filename_to_uri (location, NULL);
+  source = uri ? gst_element_make_from_uri (GST_URI_SRC, uri, NULL,
+      NULL) : NULL;
+  g_free (uri);
+  if (!source)
+    return NULL;
+
+  if (blocksize > 0 && g_object_class_find_property (G_OBJECT_GET_CLASS
+          (source), "blocksize"))
+    g_object_set (source, "blocksize", blocksize, NULL);
+
+  if (!recorder)
+    return source;
+
+  pad = gst_element_get_static_pad (source, "src");
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER |
+      GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM | GST_PAD_PROBE_TYPE_QUERY_UPSTREAM,
+      (GstPadProbeCallback) source_probe, recorder, NULL);
+  gst_object_unref (pad);
+
+  return source;
+}
+
+/* with the lock taken if needed, video streams are preferred */
+static void
+recorder_pad_added (Recorder * recorder, GstPad * pad)
+{
+  GstCaps *caps = gst_pad_get_current_caps (pad);
+  gboolean video = FALSE;
+
+  if (!caps)
+    caps = gst_pad_query_caps (pad, NULL);
+  if (caps && !gst_caps_is_empty (caps))
+    video = g_str_has_prefix (gst_structure_get_name
+        (gst_caps_get_structure (caps, 0)), "video/");
+  if (caps)
+    gst_caps_unref (caps);
+
+  if (!recorder->index_pad || (video && !recorder->index_pad_is_video)) {
+    recorder->index_pad = pad;
+    recorder->index_pad_is_video = video;
+  }
+}
+
+static GstClockTime
+stream_position (Stream * stream, GstBuffer * buffer)
+{
+  GstClockTime ts = GST_BUFFER_PTS (buffer);
+
+  if (!GST_CLOCK_TIME_IS_VALID (ts))
+    ts = GST_BUFFER_DTS (buffer);
+  if (!GST_CLOCK_TIME_IS_VALID (ts) || stream->segment.format !=
+      GST_FORMAT_TIME)
+    return GST_CLOCK_TIME_NONE;
+
+  return gst_segment_to_stream_time (&stream->segment, GST_FORMAT_TIME, ts);
+}
+
+static GstClockTime
+shift_time (Stream * stream, GstClockTime ts, GstClockTimeDiff shift)
+{
+  GstClockTime position;
+
+  if (!GST_CLOCK_TIME_IS_VALID (ts))
+    return GST_CLOCK_TIME_NONE;
+
+  position = gst_segment_to_stream_time (&stream->segment, GST_FORMAT_TIME,
+      ts);
+  if (!GST_CLOCK_TIME_IS_VALID (position))
+    return GST_CLOCK_TIME_NONE;
+
+  if (shift < 0 && position < (GstClockTime) - shift)
+    return 0;
+
+  return position + shift;
+}
+
+static GstPadProbeReturn
+stream_probe (GstPad * pad, GstPadProbeInfo * info, Stream * stream)
+{
+  GstPlayerSeekIndexSrc *self = stream->src;
+  GstClockTimeDiff shift;
+  GstClockTime position;
+  GstBuffer *buffer;
+  gboolean remapping;
+
+  if (GST_PAD_PROBE_INFO_TYPE (info) & GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM) {
+    GstEvent *event = GST_PAD_PROBE_INFO_EVENT (info);
+    GstSegment segment;
+
+    if (GST_EVENT_TYPE (event) != GST_EVENT_SEGMENT)
+      return GST_PAD_PROBE_OK;
+
+    g_mutex_lock (&self->lock);
+    gst_event_copy_segment (event, &stream->segment);
+    if (self->remapping) {
+      /* all streams continue from the entry or the seek position */
+      gst_segment_init (&segment, GST_FORMAT_TIME);
+      segment.start = segment.time = segment.position = self->segment_start;
+      gst_event_unref (event);
+      event = gst_event_new_segment (&segment);
+      gst_event_set_seqnum (event, self->seek_seqnum);
+      GST_PAD_PROBE_INFO_DATA (info) = event;
+    }
+    g_mutex_unlock (&self->lock);
+
+    return GST_PAD_PROBE_OK;
+  }
+
+  buffer = GST_PAD_PROBE_INFO_BUFFER (info);
+
+  g_mutex_lock (&self->lock);
+  position = stream_position (stream, buffer);
+  if (self->remapping && !self->shift_known) {
+    /* the keyframe the entry is for */
+    if (pad != self->recorder.index_pad || !GST_CLOCK_TIME_IS_VALID (position)
+        || GST_BUFFER_FLAG_IS_SET (buffer, GST_BUFFER_FLAG_DELTA_UNIT)) {
+      g_mutex_unlock (&self->lock);
+      return GST_PAD_PROBE_DROP;
+    }
+
+    self->shift = GST_CLOCK_DIFF (position, self->entry_time);
+    self->shift_known = TRUE;
+    self->recorder.anchored = TRUE;
+    GST_DEBUG_OBJECT (self, "Keyframe at %" GST_TIME_FORMAT " is %"
+        GST_TIME_FORMAT, GST_TIME_ARGS (position),
+        GST_TIME_ARGS (self->entry_time));
+  }
+  remapping = self->remapping;
+  shift = remapping ? self->shift : 0;
+  g_mutex_unlock (&self->lock);
+
+  if (pad == self->recorder.index_pad)
+    recorder_add (&self->recorder, buffer, shift_time (stream,
+            GST_BUFFER_PTS_IS_VALID (buffer) ? GST_BUFFER_PTS (buffer) :
+            GST_BUFFER_DTS (buffer), shift));
+
+  if (remapping) {
+    buffer = gst_buffer_make_writable (buffer);
+    GST_BUFFER_PTS (buffer) = shift_time (stream, GST_BUFFER_PTS (buffer),
+        shift);
+    GST_BUFFER_DTS (buffer) = shift_time (stream, GST_BUFFER_DTS (buffer),
+        shift);
+    GST_PAD_PROBE_INFO_DATA (info) = buffer;
+  }
+
+  return GST_PAD_PROBE_OK;
+}
+
+/* returns FALSE if the seek is left to the demuxer */
+static gboolean
+handle_seek (GstPlayerSeekIndexSrc * self, GstEvent * event)
+{
+  GstSeekFlags flags;
+  GstSeekType start_type, stop_type;
+  GstFormat format;
+  gdouble rate;
+  gint64 start, stop;
+  guint32 seqnum = GST_EVENT_SEQNUM (event);
+  IndexEntry entry;
+  GstElement *source;
+  gboolean ret;
+
+  if (self->passthrough)
+    return FALSE;
+
+  gst_event_parse_seek (event, &rate, &format, &flags, &start_type, &start,
+      &stop_type, &stop);
+
+  g_mutex_lock (&self->lock);
+  /* arrives once for every stream */
+  if (self->remapping && seqnum == self->seek_seqnum) {
+    g_mutex_unlock (&self->lock);
+    return TRUE;
+  }
+
+  /* the segment sent after the seek has no stop and is no segment seek */
+  if (format != GST_FORMAT_TIME || rate != 1.0
+      || start_type != GST_SEEK_TYPE_SET || !(flags & GST_SEEK_FLAG_FLUSH)
+      || (flags & GST_SEEK_FLAG_SEGMENT)
+      || (stop_type != GST_SEEK_TYPE_NONE && stop != -1)
+      || start < 0 || !self->source
+      || !seek_index_lookup (self->index, start, &entry)) {
+    self->remapping = FALSE;
+    if (format == GST_FORMAT_TIME)
+      self->recorder.anchored = FALSE;
+    g_mutex_unlock (&self->lock);
+    return FALSE;
+  }
+
+  GST_DEBUG_OBJECT (self, "Seeking to %" GST_TIME_FORMAT " from offset %"
+      G_GUINT64_FORMAT " at %" GST_TIME_FORMAT, GST_TIME_ARGS (start),
+      entry.offset, GST_TIME_ARGS (entry.time));
+
+  self->remapping = TRUE;
+  self->shift_known = FALSE;
+  self->entry_time = entry.time;
+  self->segment_start = (flags & GST_SEEK_FLAG_KEY_UNIT) ? entry.time : start;
+  self->seek_seqnum = seqnum;
+  source = gst_object_ref (self->source);
+  g_mutex_unlock (&self->lock);
+
+  event = gst_event_new_seek (1.0, GST_FORMAT_BYTES, GST_SEEK_FLAG_FLUSH,
+      GST_SEEK_TYPE_SET, entry.offset, GST_SEEK_TYPE_NONE, -1);
+  gst_event_set_seqnum (event, seqnum);
+  ret = gst_element_send_event (source, event);
+  gst_object_unref (source);
+
+  if (!ret) {
+    g_mutex_lock (&self->lock);
+    self->remapping = FALSE;
+    g_mutex_unlock (&self->lock);
+  }
+
+  return ret;
+}
+
+static gboolean
+ghost_event (GstPad * pad, GstObject * parent, GstEvent * event)
+{
+  GstPlayerSeekIndexSrc *self = GST_PLAYER_SEEK_INDEX_SRC (parent);
+
+  if (GST_EVENT_TYPE (event) == GST_EVENT_SEEK && handle_seek (self, event)) {
+    gst_event_unref (event);
+    return TRUE;
+  }
+
+  return gst_proxy_pad_event_default (pad, parent, event);
+}
+
+/* demuxers of these formats often only estimate */
+static gboolean
+ghost_query (GstPad * pad, GstObject * parent, GstQuery * query)
+{
+  GstPlayerSeekIndexSrc *self = GST_PLAYER_SEEK_INDEX_SRC (parent);
+  GstClockTime duration = GST_CLOCK_TIME_NONE;
+  GstFormat format;
+
+  if (GST_QUERY_TYPE (query) == GST_QUERY_DURATION) {
+    gst_query_parse_duration (query, &format, NULL);
+    g_mutex_lock (&self->index->lock);
+    if (self->index->complete)
+      duration = self->index->duration;
+    g_mutex_unlock (&self->index->lock);
+
+    if (format == GST_FORMAT_TIME && GST_CLOCK_TIME_IS_VALID (duration)) {
+      gst_query_set_duration (query, GST_FORMAT_TIME, duration);
+      return TRUE;
+    }
+  }
+
+  return gst_proxy_pad_query_default (pad, parent, query);
+}
+
+static void
+pad_added_cb (GstElement * parsebin, GstPad * pad, GstPlayerSeekIndexSrc * self)
+{
+  Stream *stream = g_new0 (Stream, 1);
+  gchar *name;
+
+  stream->src = self;
+  gst_segment_init (&stream->segment, GST_FORMAT_UNDEFINED);
+
+  g_mutex_lock (&self->lock);
+  name = g_strdup_printf ("src_%u", self->n_pads++);
+  g_ptr_array_add (self->streams, stream);
+  if (!self->passthrough)
+    recorder_pad_added (&self->recorder, pad);
+  g_mutex_unlock (&self->lock);
+
+  if (!self->passthrough)
+    gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER |
+        GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM,
+        (GstPadProbeCallback) stream_probe, stream, NULL);
+
+  stream->ghost = gst_ghost_pad_new_from_template (name, pad,
+      gst_element_class_get_pad_template (GST_ELEMENT_GET_CLASS (self),
+          "src_%u"));
+  g_free (name);
+  gst_pad_set_event_function (stream->ghost, ghost_event);
+  gst_pad_set_query_function (stream->ghost, ghost_query);
+  gst_pad_set_active (stream->ghost, TRUE);
+  gst_element_add_pad (GST_ELEMENT (self), stream->ghost);
+}
+
+static void
+no_more_pads_cb (GstElement * parsebin, GstPlayerSeekIndexSrc * self)
+{
+  gst_element_no_more_pads (GST_ELEMENT (self));
+}
+
+static void
+scan_pad_added_cb (GstElement * parsebin, GstPad * pad,
+    GstPlayerSeekIndexSrc * self)
+{
+  GstElement *sink = gst_element_factory_make ("fakesink", NULL);
+  GstPad *sinkpad;
+
+  g_object_set (sink, "sync", FALSE, "async", FALSE, NULL);
+  gst_bin_add (GST_BIN (GST_ELEMENT_PARENT (parsebin)), sink);
+  sinkpad = gst_element_get_static_pad (sink, "sink");
+  gst_pad_link (pad, sinkpad);
+  gst_object_unref (sinkpad);
+  gst_element_sync_state_with_parent (sink);
+
+  recorder_pad_added (&self->scan_recorder, pad);
+}
+
+static GstPadProbeReturn
+scan_stream_probe (GstPad * pad, GstPadProbeInfo * info,
+    GstPlayerSeekIndexSrc * self)
+{
+  GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER (info);
+  GstEvent *sticky;
+  Stream stream;
+
+  if (pad != self->scan_recorder.index_pad)
+    return GST_PAD_PROBE_OK;
+
+  sticky = gst_pad_get_sticky_event (pad, GST_EVENT_SEGMENT, 0);
+  if (!sticky)
+    return GST_PAD_PROBE_OK;
+  gst_event_copy_segment (sticky, &stream.segment);
+  gst_event_unref (sticky);
+
+  recorder_add (&self->scan_recorder, buffer, stream_position (&stream,
+          buffer));
+
+  return GST_PAD_PROBE_OK;
+}
+
+static void
+scan_pad_added_probe_cb (GstElement * parsebin, GstPad * pad,
+    GstPlayerSeekIndexSrc * self)
+{
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER,
+      (GstPadProbeCallback) scan_stream_probe, self, NULL);
+}
+
+/* the index and its path only go away with the lock, after the scan was
+ * stopped */
+static void
+stop_scan (GstPlayerSeekIndexSrc * self)
+{
+  GstElement *scan;
+  SeekIndex *scan_index;
+
+  g_mutex_lock (&self->lock);
+  scan = self->scan;
+  scan_index = self->scan_index;
+  self->scan = NULL;
+  self->scan_index = NULL;
+  g_mutex_unlock (&self->lock);
+
+  if (!scan)
+    return;
+
+  gst_element_set_state (scan, GST_STATE_NULL);
+  gst_object_unref (scan);
+
+  /* what was scanned so far is not lost when switching items */
+  g_mutex_lock (&self->lock);
+  if (self->index)
+    seek_index_merge (self->index, scan_index);
+  g_mutex_unlock (&self->lock);
+  seek_index_free (scan_index);
+}
+
+static void
+scan_done (GstElement * element, gpointer user_data)
+{
+  GstPlayerSeekIndexSrc *self = GST_PLAYER_SEEK_INDEX_SRC (element);
+  gboolean eos = GPOINTER_TO_INT (user_data);
+  GstElement *scan;
+  SeekIndex *scan_index;
+  GArray *entries;
+
+  g_mutex_lock (&self->lock);
+  if (!self->scan || !self->index || !eos) {
+    g_mutex_unlock (&self->lock);
+    stop_scan (self);
+    return;
+  }
+
+  scan = self->scan;
+  scan_index = self->scan_index;
+  self->scan = NULL;
+  self->scan_index = NULL;
+
+  /* everything is in it now */
+  g_mutex_lock (&scan_index->lock);
+  entries = scan_index->entries;
+  scan_index->entries = g_array_new (FALSE, FALSE, sizeof (IndexEntry));
+  g_mutex_unlock (&scan_index->lock);
+
+  g_mutex_lock (&self->index->lock);
+  g_array_unref (self->index->entries);
+  self->index->entries = entries;
+  self->index->complete = TRUE;
+  self->index->duration = self->scan_recorder.max_position;
+  self->index->dirty = TRUE;
+  g_mutex_unlock (&self->index->lock);
+
+  GST_DEBUG_OBJECT (self, "Scan done, %u entries", entries->len);
+
+  seek_index_save (self->index, self->index_path);
+  g_mutex_unlock (&self->lock);
+
+  gst_element_set_state (scan, GST_STATE_NULL);
+  gst_object_unref (scan);
+  seek_index_free (scan_index);
+}
+
+static GstBusSyncReply
+scan_bus_cb (GstBus * bus, GstMessage * msg, GstPlayerSeekIndexSrc * self)
+{
+  if (GST_MESSAGE_TYPE (msg) == GST_MESSAGE_EOS
+      || GST_MESSAGE_TYPE (msg) == GST_MESSAGE_ERROR)
+    gst_element_call_async (GST_ELEMENT (self), scan_done,
+        GINT_TO_POINTER (GST_MESSAGE_TYPE (msg) == GST_MESSAGE_EOS), NULL);
+
+  gst_message_unref (msg);
+
+  return GST_BUS_DROP;
+}
+
+/* reads the whole file next to playback, for the parts not played */
+static void
+start_scan (GstPlayerSeekIndexSrc * self)
+{
+  GstElement *scan, *source, *parsebin;
+  GstBus *bus;
+
+  if (self->passthrough || self->index->complete)
+    return;
+
+  self->scan_index = seek_index_new ();
+  recorder_init (&self->scan_recorder, self->scan_index, SCAN_RATE);
+
+  source = make_source (self->location, &self->scan_recorder,
+      SCAN_BLOCKSIZE);
+  parsebin = gst_element_factory_make ("parsebin", NULL);
+  if (!source || !parsebin) {
+    if (source)
+      gst_object_unref (source);
+    if (parsebin)
+      gst_object_unref (parsebin);
+    seek_index_free (self->scan_index);
+    self->scan_index = NULL;
+    return;
+  }
+
+  scan = gst_pipeline_new ("seek-index-scan");
+  gst_bin_add_many (GST_BIN (scan), source, parsebin, NULL);
+  gst_element_link (source, parsebin);
+  g_signal_connect (parsebin, "pad-added",
+      G_CALLBACK (scan_pad_added_probe_cb), self);
+  g_signal_connect (parsebin, "pad-added", G_CALLBACK (scan_pad_added_cb),
+      self);
+
+  bus = gst_element_get_bus (scan);
+  gst_bus_set_sync_handler (bus, (GstBusSyncHandler) scan_bus_cb, self,
+      NULL);
+  gst_object_unref (bus);
+
+  g_mutex_lock (&self->lock);
+  self->scan = scan;
+  g_mutex_unlock (&self->lock);
+
+  gst_element_set_state (scan, GST_STATE_PLAYING);
+}
+
+static gboolean
+setup (GstPlayerSeekIndexSrc * self)
+{
+  GstElement *parsebin;
+  gchar *location;
+
+  GST_OBJECT_LOCK (self);
+  location = g_strdup (self->location);
+  GST_OBJECT_UNLOCK (self);
+
+  if (!location) {
+    GST_ELEMENT_ERROR (self, RESOURCE, NOT_FOUND, ("No file given"), (NULL));
+    return FALSE;
+  }
+
+  self->passthrough = has_own_index (location);
+  if (self->passthrough) {
+    GST_DEBUG_OBJECT (self, "%s has an index, passing it through", location);
+    self->index = seek_index_new ();
+  } else {
+    self->index_path = seek_index_get_path (location);
+    self->index = seek_index_load (self->index_path);
+  }
+  recorder_init (&self->recorder, self->index, 0);
+
+  self->source = make_source (location,
+      self->passthrough ? NULL : &self->recorder, 0);
+  parsebin = gst_element_factory_make ("parsebin", NULL);
+  g_free (location);
+  if (!self->source || !parsebin) {
+    GST_ELEMENT_ERROR (self, CORE, MISSING_PLUGIN,
+        ("Missing a source for local files or parsebin"), (NULL));
+    if (parsebin)
+      gst_object_unref (parsebin);
+    return FALSE;
+  }
+
+  g_signal_connect (parsebin, "pad-added", G_CALLBACK (pad_added_cb), self);
+  g_signal_connect (parsebin, "no-more-pads", G_CALLBACK (no_more_pads_cb),
+      self);
+  gst_bin_add_many (GST_BIN (self), gst_object_ref (self->source), parsebin,
+      NULL);
+  gst_element_link (self->source, parsebin);
+
+  return TRUE;
+}
+
+static void
+teardown (GstPlayerSeekIndexSrc * self)
+{
+  GList *children;
+
+  GST_OBJECT_LOCK (self);
+  children = g_list_copy_deep (GST_BIN_CHILDREN (self),
+      (GCopyFunc) gst_object_ref, NULL);
+  GST_OBJECT_UNLOCK (self);
+  while (children) {
+    gst_bin_remove (GST_BIN (self), children->data);
+    gst_object_unref (children->data);
+    children = g_list_delete_link (children, children);
+  }
+
+  if (self->source)
+    gst_object_unref (self->source);
+  self->source = NULL;
+
+  /* a finished scan might still be saving */
+  g_mutex_lock (&self->lock);
+  if (self->index)
+    seek_index_free (self->index);
+  self->index = NULL;
+  g_free (self->index_path);
+  self->index_path = NULL;
+  g_mutex_unlock (&self->lock);
+}
+
+static void
+remove_pads (GstPlayerSeekIndexSrc * self)
+{
+  guint i;
+
+  g_mutex_lock (&self->lock);
+  for (i = 0; i < self->streams->len; i++) {
+    Stream *stream = g_ptr_array_index (self->streams, i);
+
+    gst_element_remove_pad (GST_ELEMENT (self), stream->ghost);
+  }
+  g_ptr_array_set_size (self->streams, 0);
+  self->n_pads = 0;
+  self->remapping = FALSE;
+  recorder_init (&self->recorder, self->index, 0);
+  g_mutex_unlock (&self->lock);
+}
+
+static GstStateChangeReturn
+gst_player_seek_index_src_change_state (GstElement * element,
+    GstStateChange transition)
+{
+  GstPlayerSeekIndexSrc *self = GST_PLAYER_SEEK_INDEX_SRC (element);
+  GstStateChangeReturn ret;
+
+  switch (transition) {
+    case GST_STATE_CHANGE_NULL_TO_READY:
+      if (!setup (self)) {
+        teardown (self);
+        return GST_STATE_CHANGE_FAILURE;
+      }
+      break;
+    case GST_STATE_CHANGE_READY_TO_PAUSED:
+      start_scan (self);
+      break;
+    case GST_STATE_CHANGE_PAUSED_TO_READY:
+      stop_scan (self);
+      break;
+    default:
+      break;
+  }
+
+  ret =
+      GST_ELEMENT_CLASS (gst_player_seek_index_src_parent_class)->change_state
+      (element, transition);
+
+  switch (transition) {
+    case GST_STATE_CHANGE_PAUSED_TO_READY:
+      remove_pads (self);
+      /* what was played is kept for next time */
+      seek_index_save (self->index, self->index_path);
+      break;
+    case GST_STATE_CHANGE_READY_TO_NULL:
+      teardown (self);
+      break;
+    default:
+      break;
+  }
+
+  return ret;
+}
+
+static void
+gst_player_seek_index_src_finalize (GObject * object)
+{
+  GstPlayerSeekIndexSrc *self = GST_PLAYER_SEEK_INDEX_SRC (object);
+
+  g_ptr_array_unref (self->streams);
+  g_mutex_clear (&self->lock);
+  g_free (self->uri);
+  g_free (self->location);
+
+  G_OBJECT_CLASS (gst_player_seek_index_src_parent_class)->finalize (object);
+}
+
+static void
+gst_player_seek_index_src_init (GstPlayerSeekIndexSrc * self)
+{
+  g_mutex_init (&self->lock);
+  self->streams = g_ptr_array_new_with_free_func (g_free);
+
+  GST_OBJECT_FLAG_SET (self, GST_ELEMENT_FLAG_SOURCE);
+}
+
+static void
+gst_player_seek_index_src_class_init (GstPlayerSeekIndexSrcClass * klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  GstElementClass *element_class = GST_ELEMENT_CLASS (klass);
+
+  gobject_class->finalize = gst_player_seek_index_src_finalize;
+  element_class->change_state = gst_player_seek_index_src_change_state;
+
+  gst_element_class_add_static_pad_template (element_class, &src_template);
+  gst_element_class_set_static_metadata (element_class, "Seek index source",
+      "Source/File", "Seeks in local files with a persistent keyframe index",
+      "GStreamer developers");
+}
+
+/**
+ * gst_player_seek_index_register:
+ *
+ * Makes playbin handle "seekindex+" URIs, see
+ * gst_player_seek_index_wrap_uri(). Needs to be called after gst_init().
+ */
+gboolean
+gst_player_seek_index_register (void)
+{
+  return gst_element_register (NULL, "playerseekindexsrc", GST_RANK_PRIMARY,
+      GST_TYPE_PLAYER_SEEK_INDEX_SRC);
+}
+
+/**
+ * gst_player_seek_index_wrap_uri:
+ * @uri: the URI to play
+ *
+ * Returns: (transfer full): a "seekindex+" URI for @uri if it is for a
+ * local file, otherwise a copy of @uri
+ */
+gchar *
+gst_player_seek_index_wrap_uri (const gchar * uri)
+{
+  g_return_val_if_fail (uri != NULL, NULL);
+
+  if (gst_uri_has_protocol (uri, "file"))
+    return g_strconcat (SEEK_INDEX_PREFIX, uri, NULL);
+
+  return g_strdup (uri);
+}
@@ -0,0 +1,1236 @@
+/* GStreamer
+ *
+ * Copyright (C) 2016 GStreamer developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* A sequence of recordings as one timeline, as a source element for
+ * "segments" URIs that playbin picks up like any other source. The
+ * location is a directory, a pattern with one %d or %0Nd for the number
+ * or a pattern with wildcards:
+ *
+ *   segments:///srv/rec/cam_%2504d.mp4
+ *
+ * All files are sorted by name. Their durations, which give the offset of
+ * each in the timeline, are looked up in order by a thread of its own so
+ * that the first part plays right away. Later parts and seeks past what
+ * is known wait for it, and the total duration is only answered and
+ * announced once all of them are known. Only two
+ * parts are ever open, each being filesrc ! parsebin in a bin of its own:
+ * the one being played and the one after it. The latter is prerolled
+ * right away and its data is held back until the current part reached
+ * EOS on all of its streams, so there is no gap at the boundary.
+ *
+ * The element has one source pad per stream of the first part, with
+ * parsed but not decoded data. Timestamps are moved into the timeline
+ * and all parts share one segment, which only changes with seeks. A seek
+ * shuts down the open parts and opens the one containing the target,
+ * seeking in it before any of its data gets through. */
+
+#include <string.h>
+#include <gst/pbutils/pbutils.h>
+
+#include "gst-player-segments.h"
+
+#define SEGMENTS_PROTOCOL "segments"
+#define DISCOVER_TIMEOUT (10 * GST_SECOND)
+
+#define GST_TYPE_PLAYER_SEGMENT_SRC (gst_player_segment_src_get_type ())
+#define GST_PLAYER_SEGMENT_SRC(obj) (G_TYPE_CHECK_INSTANCE_CAST ((obj), \
+        GST_TYPE_PLAYER_SEGMENT_SRC, GstPlayerSegmentSrc))
+
+typedef struct _GstPlayerSegmentSrc GstPlayerSegmentSrc;
+
+typedef struct
+{
+  GstPad *pad;
+  gboolean need_segment;
+  gboolean eos;
+} OutputStream;
+
+typedef struct _Part Part;
+
+typedef struct
+{
+  Part *part;
+  /* without parent, linked to a source pad of the parsebin */
+  GstPad *sinkpad;
+  /* NULL if the first part had no such stream */
+  OutputStream *output;
+  GstSegment segment;
+  gboolean eos;
+} PartStream;
+
+struct _Part
+{
+  GstPlayerSegmentSrc *src;
+  guint index;
+  GstElement *bin;
+  GPtrArray *streams;
+  guint n_video, n_audio, n_other;
+
+  /* data is dropped until the seek in this part is done */
+  gboolean seeking;
+  GstEvent *seek;
+  guint32 seek_seqnum;
+
+  /* no longer current or next, wakes up waiting streaming threads */
+  gboolean shutdown;
+};
+
+struct _GstPlayerSegmentSrc
+{
+  GstBin parent;
+
+  gchar *uri;
+
+  /* set up when going to READY */
+  GPtrArray *files;
+  /* n_files + 1 entries, the last one is the total duration. Only the
+   * first n_offsets are known, each is written once before that grows */
+  GstClockTime *offsets;
+  GThread *discover_thread;
+
+  GMutex lock;
+  GCond cond;
+  /* protected by lock */
+  guint n_offsets;
+  gboolean discover_failed;
+  gboolean discover_stop;
+  Part *current;
+  Part *next;
+  GList *finished;
+  /* of OutputStream, named after the streams of the first part */
+  GHashTable *outputs;
+  gboolean exposed;
+  guint32 last_seek_seqnum;
+  guint32 segment_seqnum;
+};
+
+typedef struct
+{
+  GstBinClass parent_class;
+} GstPlayerSegmentSrcClass;
+
+static GType gst_player_segment_src_get_type (void);
+static void gst_player_segment_src_uri_handler_init (gpointer g_iface,
+    gpointer iface_data);
+
+G_DEFINE_TYPE_WITH_CODE (GstPlayerSegmentSrc, gst_player_segment_src,
+    GST_TYPE_BIN, G_IMPLEMENT_INTERFACE (GST_TYPE_URI_HANDLER,
+        gst_player_segment_src_uri_handler_init));
+
+static GstStaticPadTemplate src_template = GST_STATIC_PAD_TEMPLATE ("src_%s",
+    GST_PAD_SRC,
+    GST_PAD_SOMETIMES,
+    GST_STATIC_CAPS_ANY);
+
+static void part_start (Part * part);
+static void part_destroy (Part * part);
+
+static const gchar *const *
+uri_handler_get_protocols (GType type)
+{
+  static const gchar *protocols[] = { SEGMENTS_PROTOCOL, NULL };
+
+  return protocols;
+}
+
+static GstURIType
+uri_handler_get_type (GType type)
+{
+  return GST_URI_SRC;
+}
+
+static gchar *
+uri_handler_get_uri (GstURIHandler * handler)
+{
+  GstPlayerSegmentSrc *self = GST_PLAYER_SEGMENT_SRC (handler);
+  gchar *uri;
+
+  GST_OBJECT_LOCK (self);
+  uri = g_strdup (self->uri);
+  GST_OBJECT_UNLOCK (self);
+
+  return uri;
+}
+
+static gboolean
+uri_handler_set_uri (GstURIHandler * handler, const gchar * uri,
+    GError ** error)
+{
+  GstPlayerSegmentSrc *self = GST_PLAYER_SEGMENT_SRC (handler);
+
+  if (!gst_uri_has_protocol (uri, SEGMENTS_PROTOCOL)) {
+    g_set_error (error, GST_URI_ERROR, GST_URI_ERROR_UNSUPPORTED_PROTOCOL,
+        "Not a segments URI: %s", uri);
+    return FALSE;
+  }
+
+  if (GST_STATE (self) != GST_STATE_NULL) {
+    g_set_error (error, GST_URI_ERROR, GST_URI_ERROR_BAD_STATE,
+        "Can't change the URI while running");
+    return FALSE;
+  }
+
+  GST_OBJECT_LOCK (self);
+  g_free (self->uri);
+  self->uri = g_strdup (uri);
+  GST_OBJECT_UNLOCK (self);
+
+  return TRUE;
+}
+
+static void
+gst_player_segment_src_uri_handler_init (gpointer g_iface,
+    gpointer iface_data)
+{
+  GstURIHandlerInterface *iface = (GstURIHandlerInterface *) g_iface;
+
+  iface->get_type = uri_handler_get_type;
+  iface->get_protocols = uri_handler_get_protocols;
+  iface->get_uri = uri_handler_get_uri;
+  iface->set_uri = uri_handler_set_uri;
+}
+
+static gint
+compare_paths (gconstpointer a, gconstpointer b)
+{
+  return g_strcmp0 (*(const gchar **) a, *(const gchar **) b);
+}
+
+/* the files of a directory, or those matching a wildcard pattern */
+static void
+add_matching_files (GPtrArray * files, const gchar * dirname,
+    const gchar * pattern)
+{
+  GPatternSpec *spec = pattern ? g_pattern_spec_new (pattern) : NULL;
+  const gchar *name;
+  GDir *dir;
+
+  dir = g_dir_open (dirname, 0, NULL);
+  while (dir && (name = g_dir_read_name (dir))) {
+    gchar *path;
+
+    if (name[0] == '.' || (spec && !g_pattern_match_string (spec, name)))
+      continue;
+
+    path = g_build_filename (dirname, name, NULL);
+    if (g_file_test (path, G_FILE_TEST_IS_REGULAR))
+      g_ptr_array_add (files, path);
+    else
+      g_free (path);
+  }
+
+  if (dir)
+    g_dir_close (dir);
+  if (spec)
+    g_pattern_spec_free (spec);
+
+  g_ptr_array_sort (files, compare_paths);
+}
+
+/* %d or %0Nd, counting from 0 or 1 up to the first missing number */
+static gboolean
+add_numbered_files (GPtrArray * files, const gchar * location)
+{
+  const gchar *percent = strchr (location, '%'), *p;
+  gchar *prefix, *suffix;
+  gint width = 0, i;
+
+  if (!percent || strchr (percent + 1, '%'))
+    return FALSE;
+
+  p = percent + 1;
+  if (*p == '0')
+    p++;
+  while (g_ascii_isdigit (*p))
+    width = width * 10 + (*p++ - '0');
+  if (*p != 'd' || width > 16)
+    return FALSE;
+
+  prefix = g_strndup (location, percent - location);
+  suffix = g_strdup (p + 1);
+
+  for (i = 0;; i++) {
+    gchar *path;
+
+    if (percent[1] == '0')
+      path = g_strdup_printf ("%s%0*d%s", prefix, width, i, suffix);
+    else
+      path = g_strdup_printf ("%s%d%s", prefix, i, suffix);
+
+    if (g_file_test (path, G_FILE_TEST_IS_REGULAR)) {
+      g_ptr_array_add (files, path);
+    } else {
+      g_free (path);
+      if (i > 0)
+        break;
+    }
+  }
+
+  g_free (prefix);
+  g_free (suffix);
+
+  return TRUE;
+}
+
+static GPtrArray *
+find_files (const gchar * location)
+{
+  GPtrArray *files = g_ptr_array_new_with_free_func (g_free);
+
+  if (g_file_test (location, G_FILE_TEST_IS_DIR)) {
+    add_matching_files (files, location, NULL);
+  } else if (!add_numbered_files (files, location)) {
+    gchar *dirname = g_path_get_dirname (location);
+    gchar *basename = g_path_get_basename (location);
+
+    add_matching_files (files, dirname, basename);
+    g_free (dirname);
+    g_free (basename);
+  }
+
+  return files;
+}
+
+/* only the headers are read, which is enough for the durations */
+static gpointer
+discover_thread_func (GstPlayerSegmentSrc * self)
+{
+  GstDiscoverer *discoverer;
+  GError *err = NULL;
+  gboolean stop = FALSE;
+  guint i;
+
+  discoverer = gst_discoverer_new (DISCOVER_TIMEOUT, &err);
+  if (!discoverer) {
+    GST_ELEMENT_ERROR (self, CORE, MISSING_PLUGIN, ("%s", err->message),
+        (NULL));
+    g_clear_error (&err);
+    g_mutex_lock (&self->lock);
+    self->discover_failed = TRUE;
+    g_cond_broadcast (&self->cond);
+    g_mutex_unlock (&self->lock);
+    return NULL;
+  }
+
+  for (i = 0; !stop && i < self->files->len; i++) {
+    gchar *uri = gst_filename_to_uri (g_ptr_array_index (self->files, i),
+        NULL);
+    GstDiscovererInfo *info = NULL;
+    GstClockTime duration = GST_CLOCK_TIME_NONE;
+
+    if (uri)
+      info = gst_discoverer_discover_uri (discoverer, uri, &err);
+    if (info)
+      duration = gst_discoverer_info_get_duration (info);
+    g_free (uri);
+
+    if (!GST_CLOCK_TIME_IS_VALID (duration)) {
+      GST_ELEMENT_ERROR (self, RESOURCE, READ,
+          ("Could not get the duration of %s",
+              (gchar *) g_ptr_array_index (self->files, i)),
+          ("%s", err ? err->message : "unknown"));
+      g_clear_error (&err);
+      if (info)
+        gst_discoverer_info_unref (info);
+      g_mutex_lock (&self->lock);
+      self->discover_failed = TRUE;
+      g_cond_broadcast (&self->cond);
+      g_mutex_unlock (&self->lock);
+      break;
+    }
+    gst_discoverer_info_unref (info);
+    g_clear_error (&err);
+
+    g_mutex_lock (&self->lock);
+    self->offsets[i + 1] = self->offsets[i] + duration;
+    self->n_offsets = i + 2;
+    stop = self->discover_stop;
+    g_cond_broadcast (&self->cond);
+    g_mutex_unlock (&self->lock);
+  }
+  g_object_unref (discoverer);
+
+  if (i == self->files->len && !stop) {
+    GST_DEBUG_OBJECT (self, "%u files, %" GST_TIME_FORMAT " in total",
+        self->files->len, GST_TIME_ARGS (self->offsets[self->files->len]));
+    gst_element_post_message (GST_ELEMENT (self),
+        gst_message_new_duration_changed (GST_OBJECT (self)));
+  }
+
+  return NULL;
+}
+
+/* with the lock taken, blocks until the first @n offsets are known */
+static gboolean
+wait_offsets (GstPlayerSegmentSrc * self, guint n)
+{
+  while (self->n_offsets < n && !self->discover_failed
+      && !self->discover_stop)
+    g_cond_wait (&self->cond, &self->lock);
+
+  return self->n_offsets >= n;
+}
+
+/* with the lock taken */
+static gboolean
+have_duration (GstPlayerSegmentSrc * self)
+{
+  return self->files && self->n_offsets == self->files->len + 1;
+}
+
+static gboolean
+open_files (GstPlayerSegmentSrc * self)
+{
+  gchar *location;
+
+  GST_OBJECT_LOCK (self);
+  location = self->uri ? gst_uri_get_location (self->uri) : NULL;
+  GST_OBJECT_UNLOCK (self);
+
+  if (!location) {
+    GST_ELEMENT_ERROR (self, RESOURCE, NOT_FOUND, ("No location given"),
+        (NULL));
+    return FALSE;
+  }
+
+  self->files = find_files (location);
+  if (self->files->len == 0) {
+    GST_ELEMENT_ERROR (self, RESOURCE, NOT_FOUND,
+        ("No files found for %s", location), (NULL));
+    g_free (location);
+    return FALSE;
+  }
+  g_free (location);
+
+  self->offsets = g_new0 (GstClockTime, self->files->len + 1);
+  self->n_offsets = 1;
+  self->discover_failed = FALSE;
+  self->discover_stop = FALSE;
+  self->discover_thread = g_thread_new ("segments-discover",
+      (GThreadFunc) discover_thread_func, self);
+
+  return TRUE;
+}
+
+/* the part containing @position, with the lock taken. Waits until the
+ * durations up to there are known */
+static gboolean
+find_part (GstPlayerSegmentSrc * self, GstClockTime position, guint * part)
+{
+  guint i;
+
+  for (i = 0; i + 1 < self->files->len; i++) {
+    if (!wait_offsets (self, i + 2))
+      return FALSE;
+    if (position < self->offsets[i + 1])
+      break;
+  }
+  *part = i;
+
+  return TRUE;
+}
+
+static GstClockTime
+to_timeline (PartStream * stream, GstClockTime time)
+{
+  GstClockTime offset = stream->part->src->offsets[stream->part->index];
+  guint64 stream_time;
+  gint sign;
+
+  if (!GST_CLOCK_TIME_IS_VALID (time))
+    return GST_CLOCK_TIME_NONE;
+
+  /* DTS can be before the segment start */
+  sign = gst_segment_to_stream_time_full (&stream->segment, GST_FORMAT_TIME,
+      time, &stream_time);
+  if (sign > 0)
+    return offset + stream_time;
+  if (sign < 0 && offset >= stream_time)
+    return offset - stream_time;
+
+  return GST_CLOCK_TIME_NONE;
+}
+
+/* blocks until @part is the current one and its offset is known, with
+ * the lock taken */
+static gboolean
+wait_current (Part * part)
+{
+  GstPlayerSegmentSrc *self = part->src;
+
+  while (!part->shutdown && self->current != part)
+    g_cond_wait (&self->cond, &self->lock);
+
+  return !part->shutdown && wait_offsets (self, part->index + 1);
+}
+
+static GstFlowReturn
+part_stream_chain (GstPad * pad, GstObject * parent, GstBuffer * buffer)
+{
+  PartStream *stream = gst_pad_get_element_private (pad);
+  Part *part = stream->part;
+  GstPlayerSegmentSrc *self = part->src;
+  OutputStream *output;
+  GstFlowReturn ret;
+
+  g_mutex_lock (&self->lock);
+  if (!wait_current (part)) {
+    g_mutex_unlock (&self->lock);
+    gst_buffer_unref (buffer);
+    return GST_FLOW_FLUSHING;
+  }
+  output = part->seeking ? NULL : stream->output;
+  g_mutex_unlock (&self->lock);
+
+  if (!output) {
+    gst_buffer_unref (buffer);
+    return GST_FLOW_OK;
+  }
+
+  buffer = gst_buffer_make_writable (buffer);
+  GST_BUFFER_PTS (buffer) = to_timeline (stream, GST_BUFFER_PTS (buffer));
+  GST_BUFFER_DTS (buffer) = to_timeline (stream, GST_BUFFER_DTS (buffer));
+
+  ret = gst_pad_push (output->pad, buffer);
+
+  /* the other streams go on */
+  return ret == GST_FLOW_NOT_LINKED ? GST_FLOW_OK : ret;
+}
+
+static void
+push_eos (GstPlayerSegmentSrc * self, OutputStream * output)
+{
+  gboolean eos;
+
+  g_mutex_lock (&self->lock);
+  eos = output->eos;
+  output->eos = TRUE;
+  g_mutex_unlock (&self->lock);
+
+  if (!eos)
+    gst_pad_push_event (output->pad, gst_event_new_eos ());
+}
+
+static void
+advance_parts (GstElement * element, gpointer user_data)
+{
+  GstPlayerSegmentSrc *self = GST_PLAYER_SEGMENT_SRC (element);
+  GList *finished;
+  Part *next = NULL;
+
+  g_mutex_lock (&self->lock);
+  finished = self->finished;
+  self->finished = NULL;
+  if (self->current && !self->next
+      && self->current->index + 1 < self->files->len) {
+    next = self->next = g_new0 (Part, 1);
+    next->src = self;
+    next->index = self->current->index + 1;
+  }
+  g_mutex_unlock (&self->lock);
+
+  g_list_free_full (finished, (GDestroyNotify) part_destroy);
+  if (next)
+    part_start (next);
+}
+
+/* with the lock taken, once all streams of @part are done */
+static void
+part_finished (Part * part)
+{
+  GstPlayerSegmentSrc *self = part->src;
+
+  if (self->current != part)
+    return;
+
+  GST_DEBUG_OBJECT (self, "Part %u finished", part->index);
+
+  part->shutdown = TRUE;
+  self->finished = g_list_prepend (self->finished, part);
+  self->current = self->next;
+  self->next = NULL;
+  g_cond_broadcast (&self->cond);
+
+  /* can't shut down a part from its own streaming thread */
+  gst_element_call_async (GST_ELEMENT (self), advance_parts, NULL, NULL);
+}
+
+static gboolean
+part_stream_event (GstPad * pad, GstObject * parent, GstEvent * event)
+{
+  PartStream *stream = gst_pad_get_element_private (pad);
+  Part *part = stream->part;
+  GstPlayerSegmentSrc *self = part->src;
+  OutputStream *output;
+  GstEvent *segment_event = NULL;
+  gboolean last_part, all_eos = TRUE, ret = TRUE;
+  guint i;
+
+  switch (GST_EVENT_TYPE (event)) {
+    case GST_EVENT_FLUSH_START:
+    case GST_EVENT_STREAM_START:
+      gst_event_unref (event);
+      return TRUE;
+    case GST_EVENT_FLUSH_STOP:
+      g_mutex_lock (&self->lock);
+      if (part->seeking && GST_EVENT_SEQNUM (event) == part->seek_seqnum)
+        part->seeking = FALSE;
+      g_mutex_unlock (&self->lock);
+      gst_event_unref (event);
+      return TRUE;
+    default:
+      break;
+  }
+
+  g_mutex_lock (&self->lock);
+  if (!wait_current (part)) {
+    g_mutex_unlock (&self->lock);
+    gst_event_unref (event);
+    return FALSE;
+  }
+  output = stream->output;
+
+  switch (GST_EVENT_TYPE (event)) {
+    case GST_EVENT_SEGMENT:
+      gst_event_copy_segment (event, &stream->segment);
+      if (output && output->need_segment && !part->seeking) {
+        GstSegment segment;
+
+        /* where the part starts after a seek, in the timeline */
+        gst_segment_init (&segment, GST_FORMAT_TIME);
+        segment.start = segment.time = segment.position =
+            to_timeline (stream, stream->segment.start);
+        segment_event = gst_event_new_segment (&segment);
+        gst_event_set_seqnum (segment_event, self->segment_seqnum);
+        output->need_segment = FALSE;
+      }
+      g_mutex_unlock (&self->lock);
+
+      gst_event_unref (event);
+      if (segment_event)
+        ret = gst_pad_push_event (output->pad, segment_event);
+      return ret;
+    case GST_EVENT_EOS:
+      stream->eos = TRUE;
+      for (i = 0; i < part->streams->len; i++)
+        all_eos &= ((PartStream *) g_ptr_array_index (part->streams, i))->eos;
+      last_part = part->index + 1 >= self->files->len;
+      if (all_eos && !last_part)
+        part_finished (part);
+      g_mutex_unlock (&self->lock);
+
+      gst_event_unref (event);
+      if (last_part && output)
+        push_eos (self, output);
+
+      /* also for the streams the last part does not have */
+      if (last_part && all_eos) {
+        GList *outputs, *l;
+
+        g_mutex_lock (&self->lock);
+        outputs = g_hash_table_get_values (self->outputs);
+        g_mutex_unlock (&self->lock);
+
+        for (l = outputs; l; l = l->next)
+          push_eos (self, l->data);
+        g_list_free (outputs);
+      }
+      return TRUE;
+    case GST_EVENT_GAP:
+      g_mutex_unlock (&self->lock);
+      gst_event_unref (event);
+      return TRUE;
+    default:
+      g_mutex_unlock (&self->lock);
+      break;
+  }
+
+  if (!output || part->seeking) {
+    gst_event_unref (event);
+    return TRUE;
+  }
+
+  return gst_pad_push_event (output->pad, event);
+}
+
+static gboolean
+part_stream_query (GstPad * pad, GstObject * parent, GstQuery * query)
+{
+  PartStream *stream = gst_pad_get_element_private (pad);
+
+  /* caps and allocation are whatever is downstream of the output */
+  if (stream->output && !GST_QUERY_IS_SERIALIZED (query)
+      && gst_pad_peer_query (stream->output->pad, query))
+    return TRUE;
+
+  return gst_pad_query_default (pad, parent, query);
+}
+
+static void
+part_stream_free (PartStream * stream)
+{
+  gst_object_unref (stream->sinkpad);
+  g_free (stream);
+}
+
+static void
+part_destroy (Part * part)
+{
+  GstPlayerSegmentSrc *self = part->src;
+
+  gst_element_set_state (part->bin, GST_STATE_NULL);
+  gst_bin_remove (GST_BIN (self), part->bin);
+
+  if (part->seek)
+    gst_event_unref (part->seek);
+  g_ptr_array_unref (part->streams);
+  g_free (part);
+}
+
+static gboolean
+output_event (GstPad * pad, GstObject * parent, GstEvent * event);
+static gboolean
+output_query (GstPad * pad, GstObject * parent, GstQuery * query);
+
+/* with the lock taken, only the first part has new streams */
+static OutputStream *
+get_output (GstPlayerSegmentSrc * self, const gchar * name, gboolean * added)
+{
+  OutputStream *output = g_hash_table_lookup (self->outputs, name);
+  gchar *pad_name;
+
+  *added = FALSE;
+  if (output || self->exposed)
+    return output;
+
+  output = g_new0 (OutputStream, 1);
+  pad_name = g_strdup_printf ("src_%s", name);
+  output->pad = gst_pad_new_from_static_template (&src_template, pad_name);
+  g_free (pad_name);
+  gst_pad_set_event_function (output->pad, output_event);
+  gst_pad_set_query_function (output->pad, output_query);
+  gst_pad_use_fixed_caps (output->pad);
+  output->need_segment = TRUE;
+  g_hash_table_insert (self->outputs, g_strdup (name), output);
+  *added = TRUE;
+
+  return output;
+}
+
+static void
+part_pad_added_cb (GstElement * parsebin, GstPad * pad, Part * part)
+{
+  GstPlayerSegmentSrc *self = part->src;
+  PartStream *stream;
+  GstCaps *caps;
+  const gchar *media;
+  gchar *name, *stream_id;
+  gboolean added;
+
+  caps = gst_pad_get_current_caps (pad);
+  if (!caps)
+    caps = gst_pad_query_caps (pad, NULL);
+  media = gst_structure_get_name (gst_caps_get_structure (caps, 0));
+
+  stream = g_new0 (PartStream, 1);
+  stream->part = part;
+  gst_segment_init (&stream->segment, GST_FORMAT_TIME);
+
+  g_mutex_lock (&self->lock);
+  if (g_str_has_prefix (media, "video/"))
+    name = g_strdup_printf ("video_%u", part->n_video++);
+  else if (g_str_has_prefix (media, "audio/"))
+    name = g_strdup_printf ("audio_%u", part->n_audio++);
+  else
+    name = g_strdup_printf ("other_%u", part->n_other++);
+  gst_caps_unref (caps);
+
+  stream->output = get_output (self, name, &added);
+  g_ptr_array_add (part->streams, stream);
+  g_mutex_unlock (&self->lock);
+
+  stream->sinkpad = gst_pad_new (name, GST_PAD_SINK);
+  gst_pad_set_element_private (stream->sinkpad, stream);
+  gst_pad_set_chain_function (stream->sinkpad, part_stream_chain);
+  gst_pad_set_event_function (stream->sinkpad, part_stream_event);
+  gst_pad_set_query_function (stream->sinkpad, part_stream_query);
+  gst_pad_set_active (stream->sinkpad, TRUE);
+
+  if (added) {
+    gst_pad_set_active (stream->output->pad, TRUE);
+    stream_id = gst_pad_create_stream_id (stream->output->pad,
+        GST_ELEMENT (self), name);
+    gst_pad_push_event (stream->output->pad,
+        gst_event_new_stream_start (stream_id));
+    g_free (stream_id);
+    gst_element_add_pad (GST_ELEMENT (self), stream->output->pad);
+  }
+  g_free (name);
+
+  gst_pad_link (pad, stream->sinkpad);
+}
+
+static void
+part_seek (GstElement * element, gpointer user_data)
+{
+  GstPlayerSegmentSrc *self = GST_PLAYER_SEGMENT_SRC (element);
+  Part *part = user_data;
+  GstEvent *seek = NULL;
+  GstPad *pad = NULL;
+
+  g_mutex_lock (&self->lock);
+  /* the part might be gone already */
+  if (part == self->current && part->seek && part->streams->len > 0) {
+    seek = part->seek;
+    part->seek = NULL;
+    pad = gst_object_ref (((PartStream *)
+            g_ptr_array_index (part->streams, 0))->sinkpad);
+  }
+  g_mutex_unlock (&self->lock);
+
+  if (!seek)
+    return;
+
+  if (!gst_pad_push_event (pad, seek)) {
+    GST_WARNING_OBJECT (self, "Seek in part %u failed, playing it from the "
+        "start", part->index);
+    g_mutex_lock (&self->lock);
+    if (part == self->current)
+      part->seeking = FALSE;
+    g_mutex_unlock (&self->lock);
+  }
+  gst_object_unref (pad);
+}
+
+static void
+part_no_more_pads_cb (GstElement * parsebin, Part * part)
+{
+  GstPlayerSegmentSrc *self = part->src;
+  gboolean expose, seek;
+
+  g_mutex_lock (&self->lock);
+  expose = !self->exposed;
+  self->exposed = TRUE;
+  seek = part->seek != NULL;
+  g_mutex_unlock (&self->lock);
+
+  if (expose)
+    gst_element_no_more_pads (GST_ELEMENT (self));
+
+  /* from outside the streaming thread */
+  if (seek)
+    gst_element_call_async (GST_ELEMENT (self), part_seek, part, NULL);
+}
+
+static void
+part_start (Part * part)
+{
+  GstPlayerSegmentSrc *self = part->src;
+  GstElement *filesrc, *parsebin;
+
+  GST_DEBUG_OBJECT (self, "Opening part %u: %s", part->index,
+      (gchar *) g_ptr_array_index (self->files, part->index));
+
+  part->streams =
+      g_ptr_array_new_with_free_func ((GDestroyNotify) part_stream_free);
+  part->bin = gst_bin_new (NULL);
+  filesrc = gst_element_factory_make ("filesrc", NULL);
+  parsebin = gst_element_factory_make ("parsebin", NULL);
+  g_object_set (filesrc, "location", g_ptr_array_index (self->files,
+          part->index), NULL);
+  g_signal_connect (parsebin, "pad-added", G_CALLBACK (part_pad_added_cb),
+      part);
+  g_signal_connect (parsebin, "no-more-pads",
+      G_CALLBACK (part_no_more_pads_cb), part);
+  gst_bin_add_many (GST_BIN (part->bin), filesrc, parsebin, NULL);
+  gst_element_link (filesrc, parsebin);
+
+  gst_bin_add (GST_BIN (self), part->bin);
+  gst_element_sync_state_with_parent (part->bin);
+}
+
+static void
+push_to_outputs (GstPlayerSegmentSrc * self, GstEvent * event)
+{
+  GList *outputs, *l;
+
+  g_mutex_lock (&self->lock);
+  outputs = g_hash_table_get_values (self->outputs);
+  g_mutex_unlock (&self->lock);
+
+  for (l = outputs; l; l = l->next)
+    gst_pad_push_event (((OutputStream *) l->data)->pad,
+        gst_event_ref (event));
+  g_list_free (outputs);
+  gst_event_unref (event);
+}
+
+/* with the lock taken, the parts have to be destroyed after unlocking */
+static GList *
+take_parts (GstPlayerSegmentSrc * self)
+{
+  GList *parts = self->finished, *l;
+
+  if (self->current)
+    parts = g_list_prepend (parts, self->current);
+  if (self->next)
+    parts = g_list_prepend (parts, self->next);
+  for (l = parts; l; l = l->next)
+    ((Part *) l->data)->shutdown = TRUE;
+  g_cond_broadcast (&self->cond);
+
+  self->current = self->next = NULL;
+  self->finished = NULL;
+
+  return parts;
+}
+
+static gboolean
+handle_seek (GstPlayerSegmentSrc * self, GstEvent * event)
+{
+  GstSeekFlags flags;
+  GstSeekType start_type, stop_type;
+  GstFormat format;
+  gdouble rate;
+  gint64 start, stop;
+  guint32 seqnum = GST_EVENT_SEQNUM (event);
+  GstClockTime position;
+  GHashTableIter iter;
+  OutputStream *output;
+  Part *current, *next = NULL;
+  GList *parts;
+
+  gst_event_parse_seek (event, &rate, &format, &flags, &start_type, &start,
+      &stop_type, &stop);
+
+  /* only what is needed for seeking in the timeline */
+  if (format != GST_FORMAT_TIME || rate != 1.0
+      || start_type != GST_SEEK_TYPE_SET || !(flags & GST_SEEK_FLAG_FLUSH))
+    return FALSE;
+
+  g_mutex_lock (&self->lock);
+  /* arrives once for every output */
+  if (seqnum == self->last_seek_seqnum) {
+    g_mutex_unlock (&self->lock);
+    return TRUE;
+  }
+  self->last_seek_seqnum = seqnum;
+  g_mutex_unlock (&self->lock);
+
+  current = g_new0 (Part, 1);
+  current->src = self;
+  position = MAX (start, 0);
+
+  g_mutex_lock (&self->lock);
+  if (!find_part (self, position, &current->index)) {
+    g_mutex_unlock (&self->lock);
+    g_free (current);
+    return FALSE;
+  }
+  if (have_duration (self))
+    position = MIN (position, self->offsets[self->files->len]);
+  g_mutex_unlock (&self->lock);
+
+  event = gst_event_new_flush_start ();
+  gst_event_set_seqnum (event, seqnum);
+  push_to_outputs (self, event);
+
+  g_mutex_lock (&self->lock);
+  parts = take_parts (self);
+  g_mutex_unlock (&self->lock);
+  g_list_free_full (parts, (GDestroyNotify) part_destroy);
+
+  event = gst_event_new_flush_stop (TRUE);
+  gst_event_set_seqnum (event, seqnum);
+  push_to_outputs (self, event);
+
+  current->seek_seqnum = gst_util_seqnum_next ();
+  current->seek = gst_event_new_seek (1.0, GST_FORMAT_TIME,
+      flags & ~GST_SEEK_FLAG_SEGMENT, GST_SEEK_TYPE_SET,
+      position - self->offsets[current->index], GST_SEEK_TYPE_NONE,
+      GST_CLOCK_TIME_NONE);
+  gst_event_set_seqnum (current->seek, current->seek_seqnum);
+  current->seeking = TRUE;
+
+  if (current->index + 1 < self->files->len) {
+    next = g_new0 (Part, 1);
+    next->src = self;
+    next->index = current->index + 1;
+  }
+
+  GST_DEBUG_OBJECT (self, "Seeking to %" GST_TIME_FORMAT " in part %u",
+      GST_TIME_ARGS (position), current->index);
+
+  g_mutex_lock (&self->lock);
+  g_hash_table_iter_init (&iter, self->outputs);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *) & output)) {
+    output->need_segment = TRUE;
+    output->eos = FALSE;
+  }
+  self->segment_seqnum = seqnum;
+  self->current = current;
+  self->next = next;
+  g_mutex_unlock (&self->lock);
+
+  part_start (current);
+  if (next)
+    part_start (next);
+
+  return TRUE;
+}
+
+static gboolean
+output_event (GstPad * pad, GstObject * parent, GstEvent * event)
+{
+  GstPlayerSegmentSrc *self = GST_PLAYER_SEGMENT_SRC (parent);
+  gboolean ret = FALSE;
+
+  if (GST_EVENT_TYPE (event) == GST_EVENT_SEEK)
+    ret = handle_seek (self, event);
+  gst_event_unref (event);
+
+  return ret;
+}
+
+static gboolean
+output_query (GstPad * pad, GstObject * parent, GstQuery * query)
+{
+  GstPlayerSegmentSrc *self = GST_PLAYER_SEGMENT_SRC (parent);
+  GstClockTime duration = GST_CLOCK_TIME_NONE;
+  GstFormat format;
+
+  switch (GST_QUERY_TYPE (query)) {
+    case GST_QUERY_DURATION:
+      gst_query_parse_duration (query, &format, NULL);
+      if (format != GST_FORMAT_TIME)
+        return FALSE;
+      g_mutex_lock (&self->lock);
+      if (have_duration (self))
+        duration = self->offsets[self->files->len];
+      g_mutex_unlock (&self->lock);
+      /* announced once known */
+      if (!GST_CLOCK_TIME_IS_VALID (duration))
+        return FALSE;
+      gst_query_set_duration (query, GST_FORMAT_TIME, duration);
+      return TRUE;
+    case GST_QUERY_SEEKING:
+      gst_query_parse_seeking (query, &format, NULL, NULL, NULL);
+      if (format != GST_FORMAT_TIME || !self->offsets)
+        return FALSE;
+      g_mutex_lock (&self->lock);
+      if (have_duration (self))
+        duration = self->offsets[self->files->len];
+      g_mutex_unlock (&self->lock);
+      gst_query_set_seeking (query, GST_FORMAT_TIME, TRUE, 0,
+          GST_CLOCK_TIME_IS_VALID (duration) ? (gint64) duration : -1);
+      return TRUE;
+    default:
+      return gst_pad_query_default (pad, parent, query);
+  }
+}
+
+static void
+start_parts (GstPlayerSegmentSrc * self)
+{
+  Part *current, *next = NULL;
+
+  current = g_new0 (Part, 1);
+  current->src = self;
+  if (self->files->len > 1) {
+    next = g_new0 (Part, 1);
+    next->src = self;
+    next->index = 1;
+  }
+
+  g_mutex_lock (&self->lock);
+  self->current = current;
+  self->next = next;
+  g_mutex_unlock (&self->lock);
+
+  part_start (current);
+  if (next)
+    part_start (next);
+}
+
+static void
+stop_parts (GstPlayerSegmentSrc * self)
+{
+  GHashTableIter iter;
+  OutputStream *output;
+  GList *parts;
+
+  g_mutex_lock (&self->lock);
+  parts = take_parts (self);
+  g_mutex_unlock (&self->lock);
+  g_list_free_full (parts, (GDestroyNotify) part_destroy);
+
+  g_hash_table_iter_init (&iter, self->outputs);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *) & output)) {
+    gst_pad_set_active (output->pad, FALSE);
+    gst_element_remove_pad (GST_ELEMENT (self), output->pad);
+  }
+  g_hash_table_remove_all (self->outputs);
+  self->exposed = FALSE;
+}
+
+static void
+close_files (GstPlayerSegmentSrc * self)
+{
+  /* finishes the file it is looking at first */
+  if (self->discover_thread) {
+    g_mutex_lock (&self->lock);
+    self->discover_stop = TRUE;
+    g_cond_broadcast (&self->cond);
+    g_mutex_unlock (&self->lock);
+    g_thread_join (self->discover_thread);
+  }
+  self->discover_thread = NULL;
+
+  if (self->files)
+    g_ptr_array_unref (self->files);
+  self->files = NULL;
+  g_free (self->offsets);
+  self->offsets = NULL;
+}
+
+static GstStateChangeReturn
+gst_player_segment_src_change_state (GstElement * element,
+    GstStateChange transition)
+{
+  GstPlayerSegmentSrc *self = GST_PLAYER_SEGMENT_SRC (element);
+  GstStateChangeReturn ret;
+
+  switch (transition) {
+    case GST_STATE_CHANGE_NULL_TO_READY:
+      if (!open_files (self)) {
+        close_files (self);
+        return GST_STATE_CHANGE_FAILURE;
+      }
+      break;
+    case GST_STATE_CHANGE_READY_TO_PAUSED:
+      start_parts (self);
+      break;
+    case GST_STATE_CHANGE_PAUSED_TO_READY:
+      /* nothing may be waiting to become current while shutting down */
+      stop_parts (self);
+      break;
+    default:
+      break;
+  }
+
+  ret =
+      GST_ELEMENT_CLASS (gst_player_segment_src_parent_class)->change_state
+      (element, transition);
+
+  if (transition == GST_STATE_CHANGE_READY_TO_NULL)
+    close_files (self);
+
+  return ret;
+}
+
+static void
+output_stream_free (OutputStream * output)
+{
+  g_free (output);
+}
+
+static void
+gst_player_segment_src_finalize (GObject * object)
+{
+  GstPlayerSegmentSrc *self = GST_PLAYER_SEGMENT_SRC (object);
+
+  close_files (self);
+  g_hash_table_unref (self->outputs);
+  g_cond_clear (&self->cond);
+  g_mutex_clear (&self->lock);
+  g_free (self->uri);
+
+  G_OBJECT_CLASS (gst_player_segment_src_parent_class)->finalize (object);
+}
+
+static void
+gst_player_segment_src_init (GstPlayerSegmentSrc * self)
+{
+  g_mutex_init (&self->lock);
+  g_cond_init (&self->cond);
+  self->outputs = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+      (GDestroyNotify) output_stream_free);
+
+  GST_OBJECT_FLAG_SET (self, GST_ELEMENT_FLAG_SOURCE);
+}
+
+static void
+gst_player_segment_src_class_init (GstPlayerSegmentSrcClass * klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  GstElementClass *element_class = GST_ELEMENT_CLASS (klass);
+
+  gobject_class->finalize = gst_player_segment_src_finalize;
+  element_class->change_state = gst_player_segment_src_change_state;
+
+  gst_element_class_add_static_pad_template (element_class, &src_template);
+  gst_element_class_set_static_metadata (element_class, "Segments source",
+      "Source/File", "Plays a sequence of recordings as one timeline",
+      "GStreamer developers");
+}
+
+/**
+ * gst_player_segments_register:
+ *
+ * Makes playbin handle "segments" URIs, see
+ * gst_player_segments_make_uri(). Needs to be called after gst_init().
+ */
+gboolean
+gst_player_segments_register (void)
+{
+  return gst_element_register (NULL, "playersegmentsrc", GST_RANK_PRIMARY,
+      GST_TYPE_PLAYER_SEGMENT_SRC);
+}
+
+/**
+ * gst_player_segments_make_uri:
+ * @location: a directory, or a file name pattern with a %d, %0Nd or
+ *     wildcards
+ *
+ * Returns: (transfer full): a "segments" URI for @location
+ */
+gchar *
+gst_player_segments_make_uri (const gchar * location)
+{
+  gchar *path, *escaped, *uri;
+
+  g_return_val_if_fail (location != NULL, NULL);
+
+  if (g_path_is_absolute (location)) {
+    path = g_strdup (location);
+  } else {
+    gchar *cwd = g_get_current_dir ();
+
+    path = g_build_filename (cwd, location, NULL);
+    g_free (cwd);
+  }
+
+  escaped = g_uri_escape_string (path, "/", FALSE);
+  uri = g_strconcat (SEGMENTS_PROTOCOL "://", escaped, NULL);
+  g_free (escaped);
+  g_free (path);
+
+  return uri;
+}
@@ -0,0 +1,236 @@
+/* GStreamer
+ *
+ * Copyright (C) 2016 GStreamer developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Keeps a copy of the interesting player state, updated from the player's
+ * own signals, so that frontends can read it from any thread without
+ * querying the pipeline or taking the player lock.
+ *
+ * The copy is protected by a sequence counter: writers (the signal
+ * handlers, serialized by a mutex among themselves) make it odd while
+ * updating and even again afterwards. Readers retry until they copied
+ * the data between two identical, even counter values. */
+
+#include "gst-player-state-snapshot.h"
+
+struct _GstPlayerStateSnapshot
+{
+  GWeakRef player;
+
+  GMutex write_lock;
+  volatile gint seq;
+  GstPlayerStateSnapshotData data;
+};
+
+static inline void
+snapshot_write_begin (GstPlayerStateSnapshot * self)
+{
+  g_mutex_lock (&self->write_lock);
+  /* full barrier, the counter is odd before any field changes */
+  g_atomic_int_inc (&self->seq);
+}
+
+static inline void
+snapshot_write_end (GstPlayerStateSnapshot * self)
+{
+  g_atomic_int_inc (&self->seq);
+  g_mutex_unlock (&self->write_lock);
+}
+
+static gint
+get_track_index (GstPlayer * player, GType type)
+{
+  GstPlayerStreamInfo *info = NULL;
+  gint index = -1;
+
+  if (type == GST_TYPE_PLAYER_VIDEO_INFO)
+    info = (GstPlayerStreamInfo *) gst_player_get_current_video_track (player);
+  else if (type == GST_TYPE_PLAYER_AUDIO_INFO)
+    info = (GstPlayerStreamInfo *) gst_player_get_current_audio_track (player);
+  else if (type == GST_TYPE_PLAYER_SUBTITLE_INFO)
+    info = (GstPlayerStreamInfo *)
+        gst_player_get_current_subtitle_track (player);
+
+  if (info) {
+    index = gst_player_stream_info_get_index (info);
+    g_object_unref (info);
+  }
+
+  return index;
+}
+
+static void
+position_updated_cb (GstPlayer * player, GstClockTime position,
+    GstPlayerStateSnapshot * self)
+{
+  gdouble rate = gst_player_get_rate (player);
+
+  snapshot_write_begin (self);
+  self->data.position = position;
+  self->data.rate = rate;
+  snapshot_write_end (self);
+}
+
+static void
+duration_changed_cb (GstPlayer * player, GstClockTime duration,
+    GstPlayerStateSnapshot * self)
+{
+  snapshot_write_begin (self);
+  self->data.duration = duration;
+  snapshot_write_end (self);
+}
+
+static void
+state_changed_cb (GstPlayer * player, GstPlayerState state,
+    GstPlayerStateSnapshot * self)
+{
+  gdouble rate = gst_player_get_rate (player);
+
+  snapshot_write_begin (self);
+  self->data.state = state;
+  self->data.rate = rate;
+  if (state == GST_PLAYER_STATE_STOPPED)
+    self->data.position = 0;
+  snapshot_write_end (self);
+}
+
+static void
+buffering_cb (GstPlayer * player, gint percent, GstPlayerStateSnapshot * self)
+{
+  snapshot_write_begin (self);
+  self->data.buffering_percent = percent;
+  snapshot_write_end (self);
+}
+
+static void
+volume_changed_cb (GstPlayer * player, GstPlayerStateSnapshot * self)
+{
+  gdouble volume = gst_player_get_volume (player);
+
+  snapshot_write_begin (self);
+  self->data.volume = volume;
+  snapshot_write_end (self);
+}
+
+static void
+mute_changed_cb (GstPlayer * player, GstPlayerStateSnapshot * self)
+{
+  gboolean mute = gst_player_get_mute (player);
+
+  snapshot_write_begin (self);
+  self->data.mute = mute;
+  snapshot_write_end (self);
+}
+
+static void
+media_info_updated_cb (GstPlayer * player, GstPlayerMediaInfo * info,
+    GstPlayerStateSnapshot * self)
+{
+  gint video, audio, subtitle;
+
+  video = get_track_index (player, GST_TYPE_PLAYER_VIDEO_INFO);
+  audio = get_track_index (player, GST_TYPE_PLAYER_AUDIO_INFO);
+  subtitle = get_track_index (player, GST_TYPE_PLAYER_SUBTITLE_INFO);
+
+  snapshot_write_begin (self);
+  self->data.video_track = video;
+  self->data.audio_track = audio;
+  self->data.subtitle_track = subtitle;
+  snapshot_write_end (self);
+}
+
+/* Must be called before any other handlers are connected to @player, so
+ * that they already see the updated snapshot. */
+GstPlayerStateSnapshot *
+gst_player_state_snapshot_new (GstPlayer * player)
+{
+  GstPlayerStateSnapshot *self;
+
+  g_return_val_if_fail (GST_IS_PLAYER (player), NULL);
+
+  self = g_new0 (GstPlayerStateSnapshot, 1);
+  g_weak_ref_init (&self->player, player);
+  g_mutex_init (&self->write_lock);
+
+  self->data.position = gst_player_get_position (player);
+  self->data.duration = gst_player_get_duration (player);
+  self->data.rate = gst_player_get_rate (player);
+  self->data.state = GST_PLAYER_STATE_STOPPED;
+  self->data.buffering_percent = 100;
+  self->data.volume = gst_player_get_volume (player);
+  self->data.mute = gst_player_get_mute (player);
+  self->data.video_track = -1;
+  self->data.audio_track = -1;
+  self->data.subtitle_track = -1;
+
+  g_signal_connect (player, "position-updated",
+      G_CALLBACK (position_updated_cb), self);
+  g_signal_connect (player, "seek-done", G_CALLBACK (position_updated_cb),
+      self);
+  g_signal_connect (player, "duration-changed",
+      G_CALLBACK (duration_changed_cb), self);
+  g_signal_connect (player, "state-changed", G_CALLBACK (state_changed_cb),
+      self);
+  g_signal_connect (player, "buffering", G_CALLBACK (buffering_cb), self);
+  g_signal_connect (player, "volume-changed", G_CALLBACK (volume_changed_cb),
+      self);
+  g_signal_connect (player, "mute-changed", G_CALLBACK (mute_changed_cb),
+      self);
+  g_signal_connect (player, "media-info-updated",
+      G_CALLBACK (media_info_updated_cb), self);
+
+  return self;
+}
+
+/* Without a signal dispatcher the handlers run on the player's thread, in
+ * that case free the snapshot only after the player is gone. */
+void
+gst_player_state_snapshot_free (GstPlayerStateSnapshot * self)
+{
+  GstPlayer *player;
+
+  g_return_if_fail (self != NULL);
+
+  player = g_weak_ref_get (&self->player);
+  if (player) {
+    g_signal_handlers_disconnect_by_data (player, self);
+    g_object_unref (player);
+  }
+  g_weak_ref_clear (&self->player);
+  g_mutex_clear (&self->write_lock);
+  g_free (self);
+}
+
+void
+gst_player_state_snapshot_read (GstPlayerStateSnapshot * self,
+    GstPlayerStateSnapshotData * data)
+{
+  gint seq;
+
+  g_return_if_fail (self != NULL);
+  g_return_if_fail (data != NULL);
+
+  do {
+    /* a writer is in the middle of an update, it will be quick */
+    while ((seq = g_atomic_int_get (&self->seq)) & 1)
+      g_thread_yield ();
+
+    *data = self->data;
+  } while (g_atomic_int_get (&self->seq) != seq);
+}
@@ -0,0 +1,54 @@
+/* GStreamer
+ *
+ * Copyright (C) 2016 GStreamer developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __GST_PLAYER_STATE_SNAPSHOT_H__
+#define __GST_PLAYER_STATE_SNAPSHOT_H__
+
+#include <gst/player/player.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GstPlayerStateSnapshot GstPlayerStateSnapshot;
+
+/* Copy of the player state as last reported by its signals. The track
+ * fields are stream indices, -1 if there is no such track selected. */
+typedef struct
+{
+  GstClockTime position;
+  GstClockTime duration;
+  gdouble rate;
+  GstPlayerState state;
+  gint buffering_percent;
+  gdouble volume;
+  gboolean mute;
+  gint video_track;
+  gint audio_track;
+  gint subtitle_track;
+} GstPlayerStateSnapshotData;
+
+GstPlayerStateSnapshot * gst_player_state_snapshot_new (GstPlayer * player);
+void gst_player_state_snapshot_free (GstPlayerStateSnapshot * snapshot);
+
+void gst_player_state_snapshot_read (GstPlayerStateSnapshot * snapshot,
+    GstPlayerStateSnapshotData * data);
+
+G_END_DECLS
+
+#endif /* __GST_PLAYER_STATE_SNAPSHOT_H__ */
@@ -0,0 +1,831 @@
+/* GStreamer
+ *
+ * Copyright (C) 2016 GStreamer developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Timeshift for live sources, as a source element for "timeshift+" URIs
+ * that playbin picks up like any other source.
+ *
+ * The live URI is received by a capture pipeline of its own, which keeps
+ * running while the player is paused:
+ *
+ *   urisourcebin ! parsebin ! mpegtsmux ! appsink
+ *
+ * The compressed MPEG-TS it produces goes into a ring of chunks, so the
+ * memory needed depends on the bitrate only. Chunks start at keyframes
+ * where possible and form the seek index. Once the chunks in memory get
+ * too big, the oldest are spilled into a temporary file, which is itself
+ * a ring. What falls out of that is gone for good.
+ *
+ * The player reads from the ring through an appsrc in time format. A seek
+ * snaps back to the start of the keyframe chunk before the target,
+ * seeking to the end catches up with the live stream again. */
+
+#include <string.h>
+#include <gio/gio.h>
+#include <gst/app/gstappsrc.h>
+#include <gst/app/gstappsink.h>
+
+#include "gst-player-timeshift.h"
+
+#define TIMESHIFT_PREFIX "timeshift+"
+
+/* the ring in memory, before chunks are spilled to disk */
+#define MAX_MEMORY_SIZE (32 * 1024 * 1024)
+/* the ring on disk, everything older is dropped */
+#define MAX_FILE_SIZE (G_GUINT64_CONSTANT (1024) * 1024 * 1024)
+/* a keyframe only starts a new chunk once the current one is this big,
+ * otherwise audio-only streams would get a chunk per frame */
+#define MIN_KEY_CHUNK_SIZE (16 * 1024)
+#define MAX_CHUNK_SIZE (256 * 1024)
+#define MAX_READ_SIZE (64 * 1024)
+#define DURATION_UPDATE_INTERVAL GST_SECOND
+
+typedef struct
+{
+  /* in the ring, counted since the start of the capture */
+  guint64 offset;
+  gsize size;
+  /* NULL once spilled to the file */
+  GByteArray *data;
+  GstClockTime time;
+  gboolean keyframe;
+} Chunk;
+
+#define GST_TYPE_PLAYER_TIMESHIFT_SRC (gst_player_timeshift_src_get_type ())
+#define GST_PLAYER_TIMESHIFT_SRC(obj) (G_TYPE_CHECK_INSTANCE_CAST ((obj), \
+        GST_TYPE_PLAYER_TIMESHIFT_SRC, GstPlayerTimeshiftSrc))
+
+typedef struct
+{
+  GstBin parent;
+
+  GstElement *appsrc;
+  gchar *uri;
+
+  GstElement *capture;
+  GstElement *muxer;
+
+  GMutex lock;
+  /* of Chunk, oldest first, the last one is still being filled */
+  GPtrArray *chunks;
+  /* chunks before this one are in the file */
+  guint n_spilled;
+  gsize memory_size;
+  guint64 end_offset;
+  GFile *file;
+  GFileIOStream *file_stream;
+  gboolean file_failed;
+
+  GstClockTime first_running_time;
+  GstClockTime last_time;
+  GstClockTime duration_posted;
+  gboolean capture_eos;
+
+  /* where the player reads */
+  guint64 read_offset;
+  gboolean need_data;
+  gboolean discont;
+} GstPlayerTimeshiftSrc;
+
+typedef struct
+{
+  GstBinClass parent_class;
+} GstPlayerTimeshiftSrcClass;
+
+static GType gst_player_timeshift_src_get_type (void);
+static void gst_player_timeshift_src_uri_handler_init (gpointer g_iface,
+    gpointer iface_data);
+
+G_DEFINE_TYPE_WITH_CODE (GstPlayerTimeshiftSrc, gst_player_timeshift_src,
+    GST_TYPE_BIN, G_IMPLEMENT_INTERFACE (GST_TYPE_URI_HANDLER,
+        gst_player_timeshift_src_uri_handler_init));
+
+static GstStaticPadTemplate src_template = GST_STATIC_PAD_TEMPLATE ("src",
+    GST_PAD_SRC,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS ("video/mpegts, systemstream = (boolean) true, "
+        "packetsize = (int) 188"));
+
+/* what is live and does not come with seeking of its own */
+static const gchar *const live_protocols[] = {
+  "http", "https", "rtsp", "rtspt", "rtspu", "rtsps", "udp", "rtp", "rtmp",
+  "mms", "mmsh", NULL
+};
+
+static const gchar *const *
+uri_handler_get_protocols (GType type)
+{
+  static gchar **protocols = NULL;
+
+  if (g_once_init_enter (&protocols)) {
+    guint i, n = g_strv_length ((gchar **) live_protocols);
+    gchar **p = g_new0 (gchar *, n + 1);
+
+    for (i = 0; i < n; i++)
+      p[i] = g_strconcat (TIMESHIFT_PREFIX, live_protocols[i], NULL);
+    g_once_init_leave (&protocols, p);
+  }
+
+  return (const gchar * const *) protocols;
+}
+
+static GstURIType
+uri_handler_get_type (GType type)
+{
+  return GST_URI_SRC;
+}
+
+static gchar *
+uri_handler_get_uri (GstURIHandler * handler)
+{
+  GstPlayerTimeshiftSrc *self = GST_PLAYER_TIMESHIFT_SRC (handler);
+  gchar *uri;
+
+  GST_OBJECT_LOCK (self);
+  uri = g_strdup (self->uri);
+  GST_OBJECT_UNLOCK (self);
+
+  return uri;
+}
+
+static gboolean
+uri_handler_set_uri (GstURIHandler * handler, const gchar * uri,
+    GError ** error)
+{
+  GstPlayerTimeshiftSrc *self = GST_PLAYER_TIMESHIFT_SRC (handler);
+
+  if (!g_str_has_prefix (uri, TIMESHIFT_PREFIX)) {
+    g_set_error (error, GST_URI_ERROR, GST_URI_ERROR_UNSUPPORTED_PROTOCOL,
+        "Not a timeshift URI: %s", uri);
+    return FALSE;
+  }
+
+  if (GST_STATE (self) != GST_STATE_NULL) {
+    g_set_error (error, GST_URI_ERROR, GST_URI_ERROR_BAD_STATE,
+        "Can't change the URI while running");
+    return FALSE;
+  }
+
+  GST_OBJECT_LOCK (self);
+  g_free (self->uri);
+  self->uri = g_strdup (uri);
+  GST_OBJECT_UNLOCK (self);
+
+  return TRUE;
+}
+
+static void
+gst_player_timeshift_src_uri_handler_init (gpointer g_iface,
+    gpointer iface_data)
+{
+  GstURIHandlerInterface *iface = (GstURIHandlerInterface *) g_iface;
+
+  iface->get_type = uri_handler_get_type;
+  iface->get_protocols = uri_handler_get_protocols;
+  iface->get_uri = uri_handler_get_uri;
+  iface->set_uri = uri_handler_set_uri;
+}
+
+static void
+chunk_free (Chunk * chunk)
+{
+  if (chunk->data)
+    g_byte_array_unref (chunk->data);
+  g_free (chunk);
+}
+
+/* the chunk containing @offset, or -1 */
+static gint
+find_chunk (GstPlayerTimeshiftSrc * self, guint64 offset)
+{
+  gint low = 0, high = (gint) self->chunks->len - 1;
+
+  while (low <= high) {
+    gint mid = (low + high) / 2;
+    Chunk *chunk = g_ptr_array_index (self->chunks, mid);
+
+    if (offset < chunk->offset)
+      high = mid - 1;
+    else if (offset >= chunk->offset + chunk->size)
+      low = mid + 1;
+    else
+      return mid;
+  }
+
+  return -1;
+}
+
+/* the keyframe chunk at or before @time, or the first one after it if
+ * @time is older than the ring */
+static Chunk *
+find_keyframe_chunk (GstPlayerTimeshiftSrc * self, GstClockTime time)
+{
+  gint low = 0, high = (gint) self->chunks->len - 1, i;
+
+  while (low <= high) {
+    gint mid = (low + high) / 2;
+    Chunk *chunk = g_ptr_array_index (self->chunks, mid);
+
+    if (chunk->time <= time)
+      low = mid + 1;
+    else
+      high = mid - 1;
+  }
+
+  for (i = high; i >= 0; i--) {
+    Chunk *chunk = g_ptr_array_index (self->chunks, i);
+    if (chunk->keyframe)
+      return chunk;
+  }
+
+  for (i = MAX (high, 0); i < (gint) self->chunks->len; i++) {
+    Chunk *chunk = g_ptr_array_index (self->chunks, i);
+    if (chunk->keyframe)
+      return chunk;
+  }
+
+  return NULL;
+}
+
+static gboolean
+file_access (GstPlayerTimeshiftSrc * self, guint64 offset, guint8 * data,
+    gsize size, gboolean write)
+{
+  while (size > 0) {
+    guint64 position = offset % MAX_FILE_SIZE;
+    gsize len = MIN (size, MAX_FILE_SIZE - position);
+    gboolean ok;
+
+    if (!g_seekable_seek (G_SEEKABLE (self->file_stream), position,
+            G_SEEK_SET, NULL, NULL))
+      return FALSE;
+
+    if (write)
+      ok = g_output_stream_write_all (g_io_stream_get_output_stream
+          (G_IO_STREAM (self->file_stream)), data, len, NULL, NULL, NULL);
+    else
+      ok = g_input_stream_read_all (g_io_stream_get_input_stream
+          (G_IO_STREAM (self->file_stream)), data, len, NULL, NULL, NULL);
+    if (!ok)
+      return FALSE;
+
+    offset += len;
+    data += len;
+    size -= len;
+  }
+
+  return TRUE;
+}
+
+/* with the lock */
+static void
+drop_oldest_chunk (GstPlayerTimeshiftSrc * self)
+{
+  Chunk *chunk = g_ptr_array_index (self->chunks, 0);
+
+  if (chunk->data)
+    self->memory_size -= chunk->size;
+  else
+    self->n_spilled--;
+  g_ptr_array_remove_index (self->chunks, 0);
+
+  /* the player was too far behind, continue at the oldest keyframe left */
+  if (self->chunks->len > 0) {
+    Chunk *first = g_ptr_array_index (self->chunks, 0);
+
+    if (self->read_offset < first->offset) {
+      Chunk *keyframe = find_keyframe_chunk (self, first->time);
+
+      self->read_offset = keyframe ? keyframe->offset : first->offset;
+      self->discont = TRUE;
+    }
+  }
+}
+
+/* with the lock, moves the oldest chunks from memory into the file */
+static void
+spill_chunks (GstPlayerTimeshiftSrc * self)
+{
+  while (self->memory_size > MAX_MEMORY_SIZE
+      && self->n_spilled + 1 < self->chunks->len) {
+    Chunk *chunk = g_ptr_array_index (self->chunks, self->n_spilled);
+
+    if (!self->file && !self->file_failed) {
+      GError *err = NULL;
+
+      self->file = g_file_new_tmp ("gst-player-timeshift-XXXXXX",
+          &self->file_stream, &err);
+      if (!self->file) {
+        GST_ELEMENT_WARNING (self, RESOURCE, OPEN_WRITE,
+            ("Can't spill the timeshift buffer to disk, keeping only %u MiB",
+                MAX_MEMORY_SIZE / (1024 * 1024)), ("%s", err->message));
+        g_clear_error (&err);
+        self->file_failed = TRUE;
+      }
+    }
+
+    if (self->file_failed) {
+      drop_oldest_chunk (self);
+      continue;
+    }
+
+    /* make room in the file ring */
+    while (self->n_spilled > 0 && chunk->offset + chunk->size -
+        ((Chunk *) g_ptr_array_index (self->chunks, 0))->offset >
+        MAX_FILE_SIZE)
+      drop_oldest_chunk (self);
+
+    if (!file_access (self, chunk->offset, chunk->data->data, chunk->size,
+            TRUE)) {
+      GST_ELEMENT_WARNING (self, RESOURCE, WRITE,
+          ("Can't spill the timeshift buffer to disk"), (NULL));
+      self->file_failed = TRUE;
+      continue;
+    }
+
+    g_byte_array_unref (chunk->data);
+    chunk->data = NULL;
+    self->memory_size -= chunk->size;
+    self->n_spilled++;
+  }
+}
+
+/* with the lock */
+static void
+ring_append (GstPlayerTimeshiftSrc * self, GstBuffer * buffer,
+    GstClockTime time, gboolean keyframe)
+{
+  Chunk *chunk = NULL;
+  GstMapInfo map;
+
+  if (self->chunks->len > 0)
+    chunk = g_ptr_array_index (self->chunks, self->chunks->len - 1);
+
+  if (!chunk || chunk->size >= MAX_CHUNK_SIZE || (keyframe
+          && chunk->size >= MIN_KEY_CHUNK_SIZE)) {
+    chunk = g_new0 (Chunk, 1);
+    chunk->offset = self->end_offset;
+    chunk->data = g_byte_array_new ();
+    chunk->time = time;
+    chunk->keyframe = keyframe;
+    g_ptr_array_add (self->chunks, chunk);
+  }
+
+  gst_buffer_map (buffer, &map, GST_MAP_READ);
+  g_byte_array_append (chunk->data, map.data, map.size);
+  gst_buffer_unmap (buffer, &map);
+
+  chunk->size += map.size;
+  self->end_offset += map.size;
+  self->memory_size += map.size;
+
+  spill_chunks (self);
+}
+
+/* with the lock, the next piece for the player or NULL if it caught up */
+static GstBuffer *
+ring_read (GstPlayerTimeshiftSrc * self)
+{
+  GstBuffer *buffer;
+  GstMapInfo map;
+  Chunk *chunk;
+  gsize position, len;
+  gint idx;
+
+  idx = find_chunk (self, self->read_offset);
+  if (idx < 0)
+    return NULL;
+
+  chunk = g_ptr_array_index (self->chunks, idx);
+  position = self->read_offset - chunk->offset;
+  len = MIN (chunk->size - position, MAX_READ_SIZE);
+
+  buffer = gst_buffer_new_allocate (NULL, len, NULL);
+  gst_buffer_map (buffer, &map, GST_MAP_WRITE);
+  if (chunk->data) {
+    memcpy (map.data, chunk->data->data + position, len);
+  } else if (!file_access (self, self->read_offset, map.data, len, FALSE)) {
+    gst_buffer_unmap (buffer, &map);
+    gst_buffer_unref (buffer);
+    /* lost, go on with what is still there */
+    self->read_offset += len;
+    self->discont = TRUE;
+    return NULL;
+  }
+  gst_buffer_unmap (buffer, &map);
+
+  if (position == 0)
+    GST_BUFFER_PTS (buffer) = chunk->time;
+  if (self->discont)
+    GST_BUFFER_FLAG_SET (buffer, GST_BUFFER_FLAG_DISCONT);
+  self->discont = FALSE;
+  self->read_offset += len;
+
+  return buffer;
+}
+
+static void
+push_next (GstPlayerTimeshiftSrc * self)
+{
+  GstBuffer *buffer;
+  gboolean eos;
+
+  g_mutex_lock (&self->lock);
+  buffer = ring_read (self);
+  self->need_data = buffer == NULL;
+  eos = !buffer && self->capture_eos && self->read_offset >= self->end_offset;
+  g_mutex_unlock (&self->lock);
+
+  if (buffer)
+    gst_app_src_push_buffer (GST_APP_SRC (self->appsrc), buffer);
+  else if (eos)
+    gst_app_src_end_of_stream (GST_APP_SRC (self->appsrc));
+}
+
+static void
+need_data_cb (GstAppSrc * appsrc, guint length, GstPlayerTimeshiftSrc * self)
+{
+  push_next (self);
+}
+
+static void
+enough_data_cb (GstAppSrc * appsrc, GstPlayerTimeshiftSrc * self)
+{
+  g_mutex_lock (&self->lock);
+  self->need_data = FALSE;
+  g_mutex_unlock (&self->lock);
+}
+
+/* @offset is a time, the appsrc is in time format */
+static gboolean
+seek_data_cb (GstAppSrc * appsrc, guint64 offset, GstPlayerTimeshiftSrc * self)
+{
+  Chunk *chunk;
+  GstClockTime time;
+
+  g_mutex_lock (&self->lock);
+  chunk = find_keyframe_chunk (self, offset);
+  self->read_offset = chunk ? chunk->offset : self->end_offset;
+  time = chunk ? chunk->time : self->last_time;
+  self->need_data = FALSE;
+  self->discont = FALSE;
+  g_mutex_unlock (&self->lock);
+
+  GST_DEBUG_OBJECT (self, "Seek to %" GST_TIME_FORMAT " resolved to %"
+      GST_TIME_FORMAT, GST_TIME_ARGS (offset), GST_TIME_ARGS (time));
+
+  return TRUE;
+}
+
+static GstFlowReturn
+capture_new_sample_cb (GstAppSink * appsink, GstPlayerTimeshiftSrc * self)
+{
+  GstSample *sample = gst_app_sink_pull_sample (appsink);
+  GstBuffer *buffer = gst_sample_get_buffer (sample);
+  GstSegment *segment = gst_sample_get_segment (sample);
+  GstClockTime running_time, time, duration = GST_CLOCK_TIME_NONE;
+  gboolean push;
+
+  running_time = gst_segment_to_running_time (segment, GST_FORMAT_TIME,
+      GST_BUFFER_PTS (buffer));
+
+  g_mutex_lock (&self->lock);
+  if (GST_CLOCK_TIME_IS_VALID (running_time)) {
+    if (!GST_CLOCK_TIME_IS_VALID (self->first_running_time))
+      self->first_running_time = running_time;
+    if (running_time >= self->first_running_time)
+      self->last_time = MAX (self->last_time,
+          running_time - self->first_running_time);
+  }
+  time = self->last_time;
+
+  ring_append (self, buffer, time,
+      !GST_BUFFER_FLAG_IS_SET (buffer, GST_BUFFER_FLAG_DELTA_UNIT));
+
+  if (time >= self->duration_posted + DURATION_UPDATE_INTERVAL) {
+    self->duration_posted = time;
+    duration = time;
+  }
+  push = self->need_data;
+  g_mutex_unlock (&self->lock);
+
+  gst_sample_unref (sample);
+
+  /* the seekable range grows with the capture */
+  if (GST_CLOCK_TIME_IS_VALID (duration)) {
+    gst_app_src_set_duration (GST_APP_SRC (self->appsrc), duration);
+    gst_element_post_message (GST_ELEMENT (self),
+        gst_message_new_duration_changed (GST_OBJECT (self)));
+  }
+
+  if (push)
+    push_next (self);
+
+  return GST_FLOW_OK;
+}
+
+static void
+capture_eos_cb (GstAppSink * appsink, GstPlayerTimeshiftSrc * self)
+{
+  gboolean push;
+
+  g_mutex_lock (&self->lock);
+  self->capture_eos = TRUE;
+  push = self->need_data;
+  g_mutex_unlock (&self->lock);
+
+  if (push)
+    push_next (self);
+}
+
+/* only errors and warnings are of interest to the player */
+static GstBusSyncReply
+capture_bus_sync_handler (GstBus * bus, GstMessage * msg,
+    GstPlayerTimeshiftSrc * self)
+{
+  if (GST_MESSAGE_TYPE (msg) == GST_MESSAGE_ERROR
+      || GST_MESSAGE_TYPE (msg) == GST_MESSAGE_WARNING)
+    gst_element_post_message (GST_ELEMENT (self), gst_message_ref (msg));
+
+  return GST_BUS_DROP;
+}
+
+/* so decoding can start at any keyframe in the ring */
+static void
+capture_element_added_cb (GstBin * bin, GstBin * sub_bin, GstElement * element,
+    GstPlayerTimeshiftSrc * self)
+{
+  if (g_object_class_find_property (G_OBJECT_GET_CLASS (element),
+          "config-interval"))
+    g_object_set (element, "config-interval", 1, NULL);
+}
+
+static void
+parsed_pad_added_cb (GstElement * parsebin, GstPad * pad,
+    GstPlayerTimeshiftSrc * self)
+{
+  GstPad *sinkpad = gst_element_get_compatible_pad (self->muxer, pad, NULL);
+
+  if (!sinkpad) {
+    GstElement *sink = gst_element_factory_make ("fakesink", NULL);
+
+    GST_WARNING_OBJECT (self, "Can't timeshift stream %" GST_PTR_FORMAT, pad);
+    g_object_set (sink, "sync", FALSE, "async", FALSE, NULL);
+    gst_bin_add (GST_BIN (self->capture), sink);
+    gst_element_sync_state_with_parent (sink);
+    sinkpad = gst_element_get_static_pad (sink, "sink");
+  }
+
+  gst_pad_link (pad, sinkpad);
+  gst_object_unref (sinkpad);
+}
+
+static void
+source_pad_added_cb (GstElement * source, GstPad * pad,
+    GstPlayerTimeshiftSrc * self)
+{
+  GstElement *parsebin = gst_element_factory_make ("parsebin", NULL);
+  GstPad *sinkpad;
+
+  g_signal_connect (parsebin, "pad-added", G_CALLBACK (parsed_pad_added_cb),
+      self);
+  gst_bin_add (GST_BIN (self->capture), parsebin);
+  gst_element_sync_state_with_parent (parsebin);
+
+  sinkpad = gst_element_get_static_pad (parsebin, "sink");
+  gst_pad_link (pad, sinkpad);
+  gst_object_unref (sinkpad);
+}
+
+static gboolean
+start_capture (GstPlayerTimeshiftSrc * self)
+{
+  GstAppSinkCallbacks callbacks = { NULL, };
+  GstElement *source, *sink;
+  GstBus *bus;
+
+  source = gst_element_factory_make ("urisourcebin", NULL);
+  self->muxer = gst_element_factory_make ("mpegtsmux", NULL);
+  sink = gst_element_factory_make ("appsink", NULL);
+  if (!source || !self->muxer || !sink || !self->appsrc) {
+    GST_ELEMENT_ERROR (self, CORE, MISSING_PLUGIN,
+        ("Elements needed for timeshifting are missing"), (NULL));
+    if (source)
+      gst_object_unref (source);
+    if (self->muxer)
+      gst_object_unref (self->muxer);
+    if (sink)
+      gst_object_unref (sink);
+    self->muxer = NULL;
+    return FALSE;
+  }
+
+  GST_OBJECT_LOCK (self);
+  g_object_set (source, "uri", self->uri + strlen (TIMESHIFT_PREFIX), NULL);
+  GST_OBJECT_UNLOCK (self);
+  g_signal_connect (source, "pad-added", G_CALLBACK (source_pad_added_cb),
+      self);
+
+  g_object_set (sink, "sync", FALSE, NULL);
+  callbacks.eos = (void (*)(GstAppSink *, gpointer)) capture_eos_cb;
+  callbacks.new_sample =
+      (GstFlowReturn (*)(GstAppSink *, gpointer)) capture_new_sample_cb;
+  gst_app_sink_set_callbacks (GST_APP_SINK (sink), &callbacks, self, NULL);
+
+  self->capture = gst_pipeline_new ("timeshift-capture");
+  g_signal_connect (self->capture, "deep-element-added",
+      G_CALLBACK (capture_element_added_cb), self);
+  gst_bin_add_many (GST_BIN (self->capture), source, self->muxer, sink, NULL);
+  gst_element_link (self->muxer, sink);
+
+  bus = gst_element_get_bus (self->capture);
+  gst_bus_set_sync_handler (bus, (GstBusSyncHandler) capture_bus_sync_handler,
+      self, NULL);
+  gst_object_unref (bus);
+
+  self->first_running_time = GST_CLOCK_TIME_NONE;
+  self->last_time = 0;
+  self->duration_posted = 0;
+
+  /* keeps running whatever state the player is in */
+  if (gst_element_set_state (self->capture,
+          GST_STATE_PLAYING) == GST_STATE_CHANGE_FAILURE) {
+    gst_element_set_state (self->capture, GST_STATE_NULL);
+    gst_object_unref (self->capture);
+    self->capture = NULL;
+    self->muxer = NULL;
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+static void
+stop_capture (GstPlayerTimeshiftSrc * self)
+{
+  if (self->capture) {
+    gst_element_set_state (self->capture, GST_STATE_NULL);
+    gst_object_unref (self->capture);
+    self->capture = NULL;
+    self->muxer = NULL;
+  }
+
+  g_mutex_lock (&self->lock);
+  g_ptr_array_set_size (self->chunks, 0);
+  self->n_spilled = 0;
+  self->memory_size = 0;
+  self->end_offset = 0;
+  self->read_offset = 0;
+  self->need_data = FALSE;
+  self->discont = FALSE;
+  self->capture_eos = FALSE;
+  self->file_failed = FALSE;
+  if (self->file) {
+    g_object_unref (self->file_stream);
+    self->file_stream = NULL;
+    g_file_delete (self->file, NULL, NULL);
+    g_object_unref (self->file);
+    self->file = NULL;
+  }
+  g_mutex_unlock (&self->lock);
+}
+
+static GstStateChangeReturn
+gst_player_timeshift_src_change_state (GstElement * element,
+    GstStateChange transition)
+{
+  GstPlayerTimeshiftSrc *self = GST_PLAYER_TIMESHIFT_SRC (element);
+  GstStateChangeReturn ret;
+
+  if (transition == GST_STATE_CHANGE_NULL_TO_READY && !start_capture (self))
+    return GST_STATE_CHANGE_FAILURE;
+
+  ret =
+      GST_ELEMENT_CLASS (gst_player_timeshift_src_parent_class)->change_state
+      (element, transition);
+
+  if (transition == GST_STATE_CHANGE_READY_TO_NULL
+      || (transition == GST_STATE_CHANGE_NULL_TO_READY
+          && ret == GST_STATE_CHANGE_FAILURE))
+    stop_capture (self);
+
+  return ret;
+}
+
+static void
+gst_player_timeshift_src_finalize (GObject * object)
+{
+  GstPlayerTimeshiftSrc *self = GST_PLAYER_TIMESHIFT_SRC (object);
+
+  stop_capture (self);
+  g_ptr_array_unref (self->chunks);
+  g_mutex_clear (&self->lock);
+  g_free (self->uri);
+
+  G_OBJECT_CLASS (gst_player_timeshift_src_parent_class)->finalize (object);
+}
+
+static void
+gst_player_timeshift_src_init (GstPlayerTimeshiftSrc * self)
+{
+  GstAppSrcCallbacks callbacks = { NULL, };
+  GstCaps *caps;
+  GstPad *pad;
+
+  g_mutex_init (&self->lock);
+  self->chunks = g_ptr_array_new_with_free_func ((GDestroyNotify) chunk_free);
+
+  self->appsrc = gst_element_factory_make ("appsrc", NULL);
+  if (!self->appsrc)
+    return;
+
+  caps = gst_static_pad_template_get_caps (&src_template);
+  g_object_set (self->appsrc, "format", GST_FORMAT_TIME, "caps", caps,
+      "stream-type", GST_APP_STREAM_TYPE_SEEKABLE, "max-bytes",
+      (guint64) (4 * MAX_READ_SIZE), NULL);
+  gst_caps_unref (caps);
+
+  callbacks.need_data = (void (*)(GstAppSrc *, guint, gpointer)) need_data_cb;
+  callbacks.enough_data = (void (*)(GstAppSrc *, gpointer)) enough_data_cb;
+  callbacks.seek_data =
+      (gboolean (*)(GstAppSrc *, guint64, gpointer)) seek_data_cb;
+  gst_app_src_set_callbacks (GST_APP_SRC (self->appsrc), &callbacks, self,
+      NULL);
+
+  gst_bin_add (GST_BIN (self), self->appsrc);
+
+  pad = gst_element_get_static_pad (self->appsrc, "src");
+  gst_element_add_pad (GST_ELEMENT (self),
+      gst_ghost_pad_new_from_template ("src", pad,
+          gst_element_class_get_pad_template (GST_ELEMENT_GET_CLASS (self),
+              "src")));
+  gst_object_unref (pad);
+}
+
+static void
+gst_player_timeshift_src_class_init (GstPlayerTimeshiftSrcClass * klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  GstElementClass *element_class = GST_ELEMENT_CLASS (klass);
+
+  gobject_class->finalize = gst_player_timeshift_src_finalize;
+  element_class->change_state = gst_player_timeshift_src_change_state;
+
+  gst_element_class_add_static_pad_template (element_class, &src_template);
+  gst_element_class_set_static_metadata (element_class, "Timeshift source",
+      "Source/Network", "Makes live sources pausable and seekable",
+      "GStreamer developers");
+}
+
+/**
+ * gst_player_timeshift_register:
+ *
+ * Makes playbin handle "timeshift+" URIs, see
+ * gst_player_timeshift_wrap_uri(). Needs to be called after gst_init().
+ */
+gboolean
+gst_player_timeshift_register (void)
+{
+  return gst_element_register (NULL, "playertimeshiftsrc", GST_RANK_PRIMARY,
+      GST_TYPE_PLAYER_TIMESHIFT_SRC);
+}
+
+/**
+ * gst_player_timeshift_wrap_uri:
+ * @uri: the URI to play
+ *
+ * Returns: (transfer full): a "timeshift+" URI for @uri if it is for a
+ * live protocol, otherwise a copy of @uri
+ */
+gchar *
+gst_player_timeshift_wrap_uri (const gchar * uri)
+{
+  gchar *protocol;
+  gboolean live = FALSE;
+  guint i;
+
+  g_return_val_if_fail (uri != NULL, NULL);
+
+  protocol = gst_uri_get_protocol (uri);
+  for (i = 0; protocol && live_protocols[i]; i++)
+    live |= g_ascii_strcasecmp (protocol, live_protocols[i]) == 0;
+  g_free (protocol);
+
+  return live ? g_strconcat (TIMESHIFT_PREFIX, uri, NULL) : g_strdup (uri);
+}
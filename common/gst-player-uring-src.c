@@ -0,0 +1,726 @@
+/* GStreamer
+ *
+ * Copyright (C) 2016 GStreamer developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* A source for local files that keeps several reads in flight with
+ * io_uring, for files that need more bandwidth than one blocking read()
+ * after the other can give, like high bitrate intra-only files on NVMe
+ * or NFS. Only built if liburing is available.
+ *
+ * There is a fixed set of SLOT_SIZE slots which are registered with the
+ * kernel once. Reads of the next blocks are queued into free slots ahead
+ * of the requests from downstream, and the buffers pushed wrap the slot
+ * memory. A slot is only reused once its buffer is freed, if all slots
+ * are still downstream a block is read into newly allocated memory
+ * instead of waiting for them.
+ *
+ * The number of reads in flight starts at INITIAL_DEPTH and is adapted
+ * every ADAPT_BYTES while downstream had to wait for reads: doubled or
+ * halved, continuing in the same direction as long as the throughput
+ * went up. When downstream is faster than the reads there is nothing to
+ * gain, and the depth is left alone.
+ *
+ * Reads that don't continue where the last one ended, or have another
+ * size than the slots, throw away the queued reads and are done on
+ * their own. */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "gst-player-uring-src.h"
+
+#ifdef HAVE_LIBURING
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <liburing.h>
+#include <glib/gstdio.h>
+#include <gst/base/gstbasesrc.h>
+
+#define SLOT_SIZE (1024 * 1024)
+#define N_SLOTS 32
+
+#define MIN_DEPTH 2
+#define INITIAL_DEPTH 4
+#define MAX_DEPTH N_SLOTS
+#define ADAPT_BYTES (64 * 1024 * 1024)
+
+#define GST_TYPE_PLAYER_URING_SRC (gst_player_uring_src_get_type ())
+#define GST_PLAYER_URING_SRC(obj) (G_TYPE_CHECK_INSTANCE_CAST ((obj), \
+        GST_TYPE_PLAYER_URING_SRC, GstPlayerUringSrc))
+
+typedef enum
+{
+  SLOT_FREE,
+  SLOT_READING,
+  SLOT_DONE,
+  /* wrapped by a buffer */
+  SLOT_DOWNSTREAM
+} SlotState;
+
+typedef struct _SlotSet SlotSet;
+
+typedef struct
+{
+  SlotSet *set;
+  guint index;
+  guint8 *data;
+  SlotState state;
+  guint64 offset;
+  guint length;
+  gint res;
+} Slot;
+
+/* outlives the element as long as buffers are around */
+struct _SlotSet
+{
+  gint refcount;
+  /* for DOWNSTREAM -> FREE, everything else is done by the streaming
+   * thread */
+  GMutex lock;
+  Slot slots[N_SLOTS];
+};
+
+typedef struct
+{
+  GstBaseSrc parent;
+
+  gchar *uri;
+  gchar *location;
+
+  /* set up when starting */
+  gint fd;
+  guint64 size;
+  struct io_uring ring;
+  gboolean ring_ready;
+  gboolean fixed;
+  SlotSet *slots;
+
+  /* only used by the streaming thread */
+  GQueue pending;
+  guint64 next_offset;
+  guint depth;
+  gint direction;
+  guint64 period_bytes;
+  gint64 period_start;
+  gboolean period_waited;
+  gdouble last_rate;
+} GstPlayerUringSrc;
+
+typedef struct
+{
+  GstBaseSrcClass parent_class;
+} GstPlayerUringSrcClass;
+
+static GType gst_player_uring_src_get_type (void);
+static void gst_player_uring_src_uri_handler_init (gpointer g_iface,
+    gpointer iface_data);
+
+G_DEFINE_TYPE_WITH_CODE (GstPlayerUringSrc, gst_player_uring_src,
+    GST_TYPE_BASE_SRC, G_IMPLEMENT_INTERFACE (GST_TYPE_URI_HANDLER,
+        gst_player_uring_src_uri_handler_init));
+
+static GstStaticPadTemplate src_template = GST_STATIC_PAD_TEMPLATE ("src",
+    GST_PAD_SRC,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS_ANY);
+
+static const gchar *const *
+uri_handler_get_protocols (GType type)
+{
+  static const gchar *protocols[] = { "file", NULL };
+
+  return protocols;
+}
+
+static GstURIType
+uri_handler_get_type (GType type)
+{
+  return GST_URI_SRC;
+}
+
+static gchar *
+uri_handler_get_uri (GstURIHandler * handler)
+{
+  GstPlayerUringSrc *self = GST_PLAYER_URING_SRC (handler);
+  gchar *uri;
+
+  GST_OBJECT_LOCK (self);
+  uri = g_strdup (self->uri);
+  GST_OBJECT_UNLOCK (self);
+
+  return uri;
+}
+
+/* failing here makes playbin try the next source for file URIs */
+static gboolean
+uri_handler_set_uri (GstURIHandler * handler, const gchar * uri,
+    GError ** error)
+{
+  GstPlayerUringSrc *self = GST_PLAYER_URING_SRC (handler);
+  GStatBuf st;
+  gchar *location;
+
+  if (GST_STATE (self) != GST_STATE_NULL) {
+    g_set_error (error, GST_URI_ERROR, GST_URI_ERROR_BAD_STATE,
+        "Can't change the URI while running");
+    return FALSE;
+  }
+
+  location = g_filename_from_uri (uri, NULL, NULL);
+  if (!location) {
+    g_set_error (error, GST_URI_ERROR, GST_URI_ERROR_BAD_URI,
+        "Not a local file: %s", uri);
+    return FALSE;
+  }
+
+  if (g_stat (location, &st) != 0 || !S_ISREG (st.st_mode)) {
+    g_set_error (error, GST_URI_ERROR, GST_URI_ERROR_BAD_REFERENCE,
+        "Not a regular file: %s", location);
+    g_free (location);
+    return FALSE;
+  }
+
+  GST_OBJECT_LOCK (self);
+  g_free (self->uri);
+  self->uri = g_strdup (uri);
+  g_free (self->location);
+  self->location = location;
+  GST_OBJECT_UNLOCK (self);
+
+  return TRUE;
+}
+
+static void
+gst_player_uring_src_uri_handler_init (gpointer g_iface, gpointer iface_data)
+{
+  GstURIHandlerInterface *iface = (GstURIHandlerInterface *) g_iface;
+
+  iface->get_type = uri_handler_get_type;
+  iface->get_protocols = uri_handler_get_protocols;
+  iface->get_uri = uri_handler_get_uri;
+  iface->set_uri = uri_handler_set_uri;
+}
+
+static SlotSet *
+slot_set_new (void)
+{
+  SlotSet *set = g_new0 (SlotSet, 1);
+  guint i;
+
+  set->refcount = 1;
+  g_mutex_init (&set->lock);
+  for (i = 0; i < N_SLOTS; i++) {
+    set->slots[i].set = set;
+    set->slots[i].index = i;
+    set->slots[i].data = g_malloc (SLOT_SIZE);
+  }
+
+  return set;
+}
+
+static SlotSet *
+slot_set_ref (SlotSet * set)
+{
+  g_atomic_int_inc (&set->refcount);
+
+  return set;
+}
+
+static void
+slot_set_unref (SlotSet * set)
+{
+  guint i;
+
+  if (!g_atomic_int_dec_and_test (&set->refcount))
+    return;
+
+  for (i = 0; i < N_SLOTS; i++)
+    g_free (set->slots[i].data);
+  g_mutex_clear (&set->lock);
+  g_free (set);
+}
+
+static Slot *
+take_free_slot (SlotSet * set)
+{
+  Slot *slot = NULL;
+  guint i;
+
+  g_mutex_lock (&set->lock);
+  for (i = 0; i < N_SLOTS && !slot; i++) {
+    if (set->slots[i].state == SLOT_FREE) {
+      slot = &set->slots[i];
+      slot->state = SLOT_READING;
+    }
+  }
+  g_mutex_unlock (&set->lock);
+
+  return slot;
+}
+
+static void
+release_slot (Slot * slot)
+{
+  g_mutex_lock (&slot->set->lock);
+  slot->state = SLOT_FREE;
+  g_mutex_unlock (&slot->set->lock);
+}
+
+/* from whichever thread frees the buffer */
+static void
+slot_buffer_freed (Slot * slot)
+{
+  SlotSet *set = slot->set;
+
+  release_slot (slot);
+  slot_set_unref (set);
+}
+
+/* waits for the next completion, all of them are for slots */
+static gboolean
+reap_one (GstPlayerUringSrc * self)
+{
+  struct io_uring_cqe *cqe;
+  Slot *slot;
+  gint ret;
+
+  do {
+    ret = io_uring_wait_cqe (&self->ring, &cqe);
+  } while (ret == -EINTR);
+
+  if (ret < 0) {
+    GST_ELEMENT_ERROR (self, RESOURCE, READ, (NULL),
+        ("Waiting for reads failed: %s", g_strerror (-ret)));
+    return FALSE;
+  }
+
+  slot = io_uring_cqe_get_data (cqe);
+  slot->res = cqe->res;
+  slot->state = SLOT_DONE;
+  io_uring_cqe_seen (&self->ring, cqe);
+
+  return TRUE;
+}
+
+static gboolean
+wait_slot (GstPlayerUringSrc * self, Slot * slot)
+{
+  while (slot->state == SLOT_READING) {
+    if (!reap_one (self))
+      return FALSE;
+  }
+
+  return TRUE;
+}
+
+/* throws away all queued reads */
+static gboolean
+drain (GstPlayerUringSrc * self)
+{
+  Slot *slot;
+  gboolean ret = TRUE;
+
+  while ((slot = g_queue_pop_head (&self->pending))) {
+    if (ret)
+      ret = wait_slot (self, slot);
+    release_slot (slot);
+  }
+
+  return ret;
+}
+
+static void
+queue_read (GstPlayerUringSrc * self, Slot * slot, guint64 offset,
+    guint length)
+{
+  struct io_uring_sqe *sqe = io_uring_get_sqe (&self->ring);
+
+  if (slot->set && self->fixed)
+    io_uring_prep_read_fixed (sqe, self->fd, slot->data, length, offset,
+        slot->index);
+  else
+    io_uring_prep_read (sqe, self->fd, slot->data, length, offset);
+  io_uring_sqe_set_data (sqe, slot);
+
+  slot->offset = offset;
+  slot->length = length;
+  slot->state = SLOT_READING;
+}
+
+/* fills up the queue to the current depth, as far as slots are free */
+static void
+queue_reads (GstPlayerUringSrc * self)
+{
+  guint queued = 0;
+
+  while (self->pending.length < self->depth
+      && self->next_offset < self->size) {
+    Slot *slot = take_free_slot (self->slots);
+    guint length;
+
+    if (!slot)
+      break;
+
+    length = MIN (SLOT_SIZE, self->size - self->next_offset);
+    queue_read (self, slot, self->next_offset, length);
+    g_queue_push_tail (&self->pending, slot);
+    self->next_offset += length;
+    queued++;
+  }
+
+  if (queued > 0)
+    io_uring_submit (&self->ring);
+}
+
+static GstFlowReturn
+read_unqueued (GstPlayerUringSrc * self, guint64 offset, guint size,
+    GstBuffer ** buffer)
+{
+  Slot slot = { NULL, };
+
+  slot.data = g_malloc (size);
+  queue_read (self, &slot, offset, size);
+  io_uring_submit (&self->ring);
+
+  if (!wait_slot (self, &slot)) {
+    g_free (slot.data);
+    return GST_FLOW_ERROR;
+  }
+
+  if (slot.res < 0) {
+    GST_ELEMENT_ERROR (self, RESOURCE, READ, (NULL),
+        ("Reading failed: %s", g_strerror (-slot.res)));
+    g_free (slot.data);
+    return GST_FLOW_ERROR;
+  } else if (slot.res == 0) {
+    g_free (slot.data);
+    return GST_FLOW_EOS;
+  }
+
+  *buffer = gst_buffer_new_wrapped (slot.data, slot.res);
+
+  return GST_FLOW_OK;
+}
+
+static void
+adapt_depth (GstPlayerUringSrc * self, guint bytes, gboolean waited)
+{
+  gint64 now = g_get_monotonic_time ();
+  gdouble rate;
+
+  self->period_bytes += bytes;
+  self->period_waited |= waited;
+  if (self->period_bytes < ADAPT_BYTES)
+    return;
+
+  rate = self->period_bytes / (gdouble) MAX (now - self->period_start, 1);
+  if (self->period_waited) {
+    if (rate < self->last_rate)
+      self->direction = -self->direction;
+    if (self->direction > 0)
+      self->depth = MIN (self->depth * 2, MAX_DEPTH);
+    else
+      self->depth = MAX (self->depth / 2, MIN_DEPTH);
+
+    GST_DEBUG_OBJECT (self, "%.0f MB/s, %u reads in flight now", rate,
+        self->depth);
+  }
+
+  self->last_rate = rate;
+  self->period_bytes = 0;
+  self->period_start = now;
+  self->period_waited = FALSE;
+}
+
+static GstFlowReturn
+gst_player_uring_src_create (GstBaseSrc * basesrc, guint64 offset,
+    guint size, GstBuffer ** buffer)
+{
+  GstPlayerUringSrc *self = GST_PLAYER_URING_SRC (basesrc);
+  Slot *slot;
+  GstBuffer *buf;
+  gboolean waited;
+
+  if (offset >= self->size)
+    return GST_FLOW_EOS;
+
+  slot = g_queue_peek_head (&self->pending);
+  if (size != SLOT_SIZE || (slot ? slot->offset : self->next_offset) !=
+      offset) {
+    if (!drain (self))
+      return GST_FLOW_ERROR;
+
+    if (size != SLOT_SIZE) {
+      size = MIN (size, self->size - offset);
+      self->next_offset = offset + size;
+      return read_unqueued (self, offset, size, buffer);
+    }
+    self->next_offset = offset;
+  }
+
+  queue_reads (self);
+
+  /* all slots are downstream */
+  slot = g_queue_pop_head (&self->pending);
+  if (!slot) {
+    size = MIN (size, self->size - offset);
+    self->next_offset = offset + size;
+    return read_unqueued (self, offset, size, buffer);
+  }
+
+  waited = slot->state == SLOT_READING;
+  if (!wait_slot (self, slot)) {
+    release_slot (slot);
+    return GST_FLOW_ERROR;
+  }
+
+  if (slot->res <= 0) {
+    gint res = slot->res;
+
+    release_slot (slot);
+    if (res == 0)
+      return GST_FLOW_EOS;
+
+    GST_ELEMENT_ERROR (self, RESOURCE, READ, (NULL),
+        ("Reading failed: %s", g_strerror (-res)));
+    return GST_FLOW_ERROR;
+  }
+
+  /* the queued reads after this one are at the wrong offsets now */
+  if ((guint) slot->res < slot->length) {
+    drain (self);
+    self->next_offset = offset + slot->res;
+  }
+
+  slot->state = SLOT_DOWNSTREAM;
+  buf = gst_buffer_new ();
+  gst_buffer_append_memory (buf,
+      gst_memory_new_wrapped (GST_MEMORY_FLAG_READONLY, slot->data,
+          SLOT_SIZE, 0, slot->res, slot, (GDestroyNotify) slot_buffer_freed));
+  slot_set_ref (self->slots);
+
+  adapt_depth (self, slot->res, waited);
+
+  /* keep the disk busy while downstream is working */
+  queue_reads (self);
+
+  *buffer = buf;
+
+  return GST_FLOW_OK;
+}
+
+static gboolean
+gst_player_uring_src_get_size (GstBaseSrc * basesrc, guint64 * size)
+{
+  GstPlayerUringSrc *self = GST_PLAYER_URING_SRC (basesrc);
+
+  if (self->fd < 0)
+    return FALSE;
+
+  *size = self->size;
+
+  return TRUE;
+}
+
+static gboolean
+gst_player_uring_src_is_seekable (GstBaseSrc * basesrc)
+{
+  return TRUE;
+}
+
+static gboolean
+gst_player_uring_src_start (GstBaseSrc * basesrc)
+{
+  GstPlayerUringSrc *self = GST_PLAYER_URING_SRC (basesrc);
+  struct iovec iovecs[N_SLOTS];
+  struct stat st;
+  gchar *location;
+  guint i;
+  gint ret;
+
+  GST_OBJECT_LOCK (self);
+  location = g_strdup (self->location);
+  GST_OBJECT_UNLOCK (self);
+
+  if (!location) {
+    GST_ELEMENT_ERROR (self, RESOURCE, NOT_FOUND, ("No file given"), (NULL));
+    return FALSE;
+  }
+
+  /* stop() is not called when this fails */
+  self->fd = g_open (location, O_RDONLY, 0);
+  if (self->fd < 0 || fstat (self->fd, &st) != 0) {
+    GST_ELEMENT_ERROR (self, RESOURCE, OPEN_READ,
+        ("Could not open %s", location), GST_ERROR_SYSTEM);
+    g_free (location);
+    if (self->fd >= 0)
+      close (self->fd);
+    self->fd = -1;
+    return FALSE;
+  }
+  g_free (location);
+  self->size = st.st_size;
+
+  ret = io_uring_queue_init (N_SLOTS + 1, &self->ring, 0);
+  if (ret < 0) {
+    GST_ELEMENT_ERROR (self, RESOURCE, OPEN_READ, (NULL),
+        ("io_uring is not available: %s", g_strerror (-ret)));
+    close (self->fd);
+    self->fd = -1;
+    return FALSE;
+  }
+  self->ring_ready = TRUE;
+
+  /* limited by RLIMIT_MEMLOCK on older kernels */
+  self->slots = slot_set_new ();
+  for (i = 0; i < N_SLOTS; i++) {
+    iovecs[i].iov_base = self->slots->slots[i].data;
+    iovecs[i].iov_len = SLOT_SIZE;
+  }
+  ret = io_uring_register_buffers (&self->ring, iovecs, N_SLOTS);
+  self->fixed = ret == 0;
+  if (!self->fixed)
+    GST_INFO_OBJECT (self, "Could not register the buffers: %s",
+        g_strerror (-ret));
+
+  g_queue_init (&self->pending);
+  self->next_offset = 0;
+  self->depth = INITIAL_DEPTH;
+  self->direction = 1;
+  self->period_bytes = 0;
+  self->period_start = g_get_monotonic_time ();
+  self->period_waited = FALSE;
+  self->last_rate = 0;
+
+  return TRUE;
+}
+
+static gboolean
+gst_player_uring_src_stop (GstBaseSrc * basesrc)
+{
+  GstPlayerUringSrc *self = GST_PLAYER_URING_SRC (basesrc);
+
+  if (self->ring_ready) {
+    drain (self);
+    if (self->fixed)
+      io_uring_unregister_buffers (&self->ring);
+    io_uring_queue_exit (&self->ring);
+  }
+  self->ring_ready = FALSE;
+  self->fixed = FALSE;
+
+  /* buffers still downstream keep their slots alive */
+  if (self->slots)
+    slot_set_unref (self->slots);
+  self->slots = NULL;
+
+  if (self->fd >= 0)
+    close (self->fd);
+  self->fd = -1;
+
+  return TRUE;
+}
+
+static void
+gst_player_uring_src_finalize (GObject * object)
+{
+  GstPlayerUringSrc *self = GST_PLAYER_URING_SRC (object);
+
+  g_free (self->uri);
+  g_free (self->location);
+
+  G_OBJECT_CLASS (gst_player_uring_src_parent_class)->finalize (object);
+}
+
+static void
+gst_player_uring_src_init (GstPlayerUringSrc * self)
+{
+  self->fd = -1;
+  gst_base_src_set_blocksize (GST_BASE_SRC (self), SLOT_SIZE);
+}
+
+static void
+gst_player_uring_src_class_init (GstPlayerUringSrcClass * klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  GstElementClass *element_class = GST_ELEMENT_CLASS (klass);
+  GstBaseSrcClass *basesrc_class = GST_BASE_SRC_CLASS (klass);
+
+  gobject_class->finalize = gst_player_uring_src_finalize;
+
+  basesrc_class->start = gst_player_uring_src_start;
+  basesrc_class->stop = gst_player_uring_src_stop;
+  basesrc_class->get_size = gst_player_uring_src_get_size;
+  basesrc_class->is_seekable = gst_player_uring_src_is_seekable;
+  basesrc_class->create = gst_player_uring_src_create;
+
+  gst_element_class_add_static_pad_template (element_class, &src_template);
+  gst_element_class_set_static_metadata (element_class,
+      "io_uring file source", "Source/File",
+      "Reads local files with several reads in flight",
+      "GStreamer developers");
+}
+
+/* the kernel might be too old, or io_uring disabled by a sysctl or a
+ * seccomp filter */
+static gboolean
+uring_available (void)
+{
+  struct io_uring ring;
+  gint ret;
+
+  ret = io_uring_queue_init (1, &ring, 0);
+  if (ret < 0) {
+    GST_INFO ("io_uring is not available: %s", g_strerror (-ret));
+    return FALSE;
+  }
+  io_uring_queue_exit (&ring);
+
+  return TRUE;
+}
+
+#endif /* HAVE_LIBURING */
+
+/**
+ * gst_player_uring_src_register:
+ *
+ * Makes playbin read regular local files with io_uring, above all other
+ * sources for file URIs. Needs to be called after gst_init().
+ *
+ * Returns: %FALSE if built without liburing or if the kernel does not
+ *     provide io_uring
+ */
+gboolean
+gst_player_uring_src_register (void)
+{
+#ifdef HAVE_LIBURING
+  if (!uring_available ())
+    return FALSE;
+
+  return gst_element_register (NULL, "playeruringsrc", GST_RANK_PRIMARY + 2,
+      GST_TYPE_PLAYER_URING_SRC);
+#else
+  return FALSE;
+#endif
+}
@@ -0,0 +1,195 @@
+/* GStreamer command line playback testing utility - source benchmark
+ *
+ * Copyright (C) 2016 GStreamer developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Reads a file as fast as possible with each of the sources for local
+ * files, "SOURCE ! fakesink sync=false", and prints the throughput. The
+ * file's pages are dropped from the page cache before every run where
+ * posix_fadvise() is available, so each run reads from the disk. Without
+ * it only the first run can, the sources then take turns so none of them
+ * profits from the cache more than the others. All of them read blocks
+ * of the same size. */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "gst-play-benchmark.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <glib/gstdio.h>
+
+#ifdef G_OS_UNIX
+#include <unistd.h>
+#endif
+
+#define BENCHMARK_BLOCKSIZE (1024 * 1024)
+
+static const gchar *sources[] = {
+  "filesrc", "playermmapsrc", "playeruringsrc"
+};
+
+static GstElement *
+make_source (const gchar * name, const gchar * uri)
+{
+  GstElement *src = gst_element_factory_make (name, NULL);
+
+  if (!src)
+    return NULL;
+
+  if (!gst_uri_handler_set_uri (GST_URI_HANDLER (src), uri, NULL)) {
+    gst_object_unref (src);
+    return NULL;
+  }
+  g_object_set (src, "blocksize", BENCHMARK_BLOCKSIZE, NULL);
+
+  return src;
+}
+
+/* only clean pages are dropped, which is all of them for a file that is
+ * just read */
+static gboolean
+drop_cache (const gchar * filename)
+{
+#ifdef HAVE_POSIX_FADVISE
+  gboolean ret;
+  gint fd;
+
+  fd = g_open (filename, O_RDONLY, 0);
+  if (fd < 0)
+    return FALSE;
+  ret = posix_fadvise (fd, 0, 0, POSIX_FADV_DONTNEED) == 0;
+  close (fd);
+
+  return ret;
+#else
+  return FALSE;
+#endif
+}
+
+/* returns the time it took, or GST_CLOCK_TIME_NONE on errors */
+static GstClockTime
+run_once (GstElement * src)
+{
+  GstElement *pipeline, *sink;
+  GstMessage *msg;
+  GstBus *bus;
+  gint64 start;
+  GstClockTime elapsed = GST_CLOCK_TIME_NONE;
+
+  pipeline = gst_pipeline_new (NULL);
+  sink = gst_element_factory_make ("fakesink", NULL);
+  g_object_set (sink, "sync", FALSE, NULL);
+  gst_bin_add_many (GST_BIN (pipeline), gst_object_ref (src), sink, NULL);
+  gst_element_link (src, sink);
+
+  bus = gst_element_get_bus (pipeline);
+  start = g_get_monotonic_time ();
+  gst_element_set_state (pipeline, GST_STATE_PLAYING);
+  msg = gst_bus_timed_pop_filtered (bus, GST_CLOCK_TIME_NONE,
+      GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+
+  if (GST_MESSAGE_TYPE (msg) == GST_MESSAGE_EOS) {
+    elapsed = (g_get_monotonic_time () - start) * GST_USECOND;
+  } else {
+    GError *err = NULL;
+
+    gst_message_parse_error (msg, &err, NULL);
+    g_printerr ("  %s failed: %s\n", GST_OBJECT_NAME (src), err->message);
+    g_clear_error (&err);
+  }
+  gst_message_unref (msg);
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (bus);
+  gst_object_unref (pipeline);
+
+  return elapsed;
+}
+
+/**
+ * gst_play_benchmark_sources:
+ * @filename: a local file
+ * @runs: how often to read it with each source
+ *
+ * Returns: %FALSE if @filename can't be read by any source
+ */
+gboolean
+gst_play_benchmark_sources (const gchar * filename, guint runs)
+{
+  GstClockTime best[G_N_ELEMENTS (sources)];
+  GStatBuf st;
+  guint64 size;
+  gboolean ret = FALSE;
+  gchar *uri;
+  guint i, run;
+
+  uri = gst_filename_to_uri (filename, NULL);
+  if (!uri || g_stat (filename, &st) != 0 || st.st_size == 0) {
+    g_printerr ("Not a local file: %s\n", filename);
+    g_free (uri);
+    return FALSE;
+  }
+  size = st.st_size;
+
+  g_print ("%s:\n", filename);
+  if (drop_cache (filename))
+    g_print ("  dropping the page cache before each run\n");
+  else
+    g_print ("  can't drop the page cache, later runs read from memory\n");
+
+  for (i = 0; i < G_N_ELEMENTS (sources); i++)
+    best[i] = GST_CLOCK_TIME_NONE;
+
+  for (run = 0; run < runs; run++) {
+    for (i = 0; i < G_N_ELEMENTS (sources); i++) {
+      GstElement *src = make_source (sources[i], uri);
+      GstClockTime elapsed;
+
+      if (!src)
+        continue;
+
+      drop_cache (filename);
+      elapsed = run_once (src);
+      gst_object_unref (src);
+
+      if (!GST_CLOCK_TIME_IS_VALID (elapsed) || elapsed == 0)
+        continue;
+
+      g_print ("  run %u, %-16s %8.1f MB/s\n", run + 1, sources[i],
+          size / 1e6 / (elapsed / (gdouble) GST_SECOND));
+      if (!GST_CLOCK_TIME_IS_VALID (best[i]) || elapsed < best[i])
+        best[i] = elapsed;
+      ret = TRUE;
+    }
+  }
+
+  for (i = 0; i < G_N_ELEMENTS (sources); i++) {
+    if (!GST_CLOCK_TIME_IS_VALID (best[i]))
+      g_print ("  %-23s not available\n", sources[i]);
+    else
+      g_print ("  best of %-15s %8.1f MB/s\n", sources[i],
+          size / 1e6 / (best[i] / (gdouble) GST_SECOND));
+  }
+
+  g_free (uri);
+
+  return ret;
+}
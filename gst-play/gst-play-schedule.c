@@ -0,0 +1,495 @@
+/* GStreamer command line playback testing utility - scheduled playback
+ *
+ * Copyright (C) 2016 GStreamer developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Plays items at given wall clock times. The schedule file has one item
+ * per line, the time followed by a file or URI:
+ *
+ *   14:00:00.000 /srv/signage/news.mp4
+ *   2016-12-24T18:00:00 http://example.com/greeting.webm
+ *
+ * Times without a date are for today, empty lines and lines starting
+ * with '#' are skipped.
+ *
+ * Each item gets its own player, which is prerolled to PAUSED some time
+ * before the item is due while the previous item is still playing. All
+ * players run on the realtime system clock, so wall clock times are
+ * clock times. The base time is set to the scheduled time minus the
+ * pipeline latency and the pipeline start time is disabled, so the first
+ * frame is presented at exactly the scheduled time however early PLAYING
+ * was reached. */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "gst-play-schedule.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <gst/player/player.h>
+
+/* how long before its time an item is set to PLAYING, it then waits for
+ * the clock in the sinks */
+#define START_LEAD (100 * GST_MSECOND)
+
+typedef struct
+{
+  GstClockTime start;
+  gchar *uri;
+  guint index;
+} ScheduleEntry;
+
+typedef struct
+{
+  GstPlaySchedule *schedule;
+  ScheduleEntry *entry;
+  GstPlayer *player;
+  GstElement *pipeline;
+  GstPad *sink_pad;
+} ScheduledItem;
+
+struct _GstPlaySchedule
+{
+  GPtrArray *entries;
+  guint next;
+  GstClock *clock;
+  GstClockTime preroll;
+
+  ScheduledItem *current;
+  ScheduledItem *spare;
+  /* keeps playing until the current item is due */
+  ScheduledItem *previous;
+  guint timeout_id;
+
+  GstPlayScheduleDoneFunc done;
+  gpointer user_data;
+};
+
+static void schedule_arm (GstPlaySchedule * self);
+
+static void
+schedule_entry_free (ScheduleEntry * entry)
+{
+  g_free (entry->uri);
+  g_free (entry);
+}
+
+static gint
+compare_entries (gconstpointer a, gconstpointer b)
+{
+  const ScheduleEntry *x = *(const ScheduleEntry **) a;
+  const ScheduleEntry *y = *(const ScheduleEntry **) b;
+
+  return x->start < y->start ? -1 : x->start > y->start;
+}
+
+/* HH:MM:SS[.fff] for today or YYYY-MM-DDTHH:MM:SS[.fff], in local time */
+static gboolean
+parse_time (const gchar * str, GstClockTime * time)
+{
+  GDateTime *date_time;
+  gint year, month, day, hour, minute, n = 0;
+  gdouble seconds;
+  gchar *end;
+
+  if (sscanf (str, "%d-%d-%dT%d:%d:%n", &year, &month, &day, &hour, &minute,
+          &n) != 5 || n == 0) {
+    GDateTime *now = g_date_time_new_now_local ();
+
+    g_date_time_get_ymd (now, &year, &month, &day);
+    g_date_time_unref (now);
+
+    n = 0;
+    if (sscanf (str, "%d:%d:%n", &hour, &minute, &n) != 2 || n == 0)
+      return FALSE;
+  }
+
+  seconds = g_ascii_strtod (str + n, &end);
+  if (end == str + n || *end != '\0' || seconds < 0 || seconds >= 61)
+    return FALSE;
+
+  date_time = g_date_time_new_local (year, month, day, hour, minute, seconds);
+  if (!date_time)
+    return FALSE;
+
+  *time = g_date_time_to_unix (date_time) * GST_SECOND +
+      g_date_time_get_microsecond (date_time) * GST_USECOND;
+  g_date_time_unref (date_time);
+
+  return TRUE;
+}
+
+static GstPadProbeReturn
+item_sink_probe (GstPad * pad, GstPadProbeInfo * info, ScheduledItem * item)
+{
+  GstClockTime now;
+
+  /* the probe is added after prerolling, the sink only takes the next
+   * buffer once the prerolled one was presented */
+  now = gst_clock_get_time (item->schedule->clock);
+  g_print ("Item %u started %+.3f ms from its time: %s\n",
+      item->entry->index + 1,
+      (gdouble) GST_CLOCK_DIFF (item->entry->start, now) / GST_MSECOND,
+      item->entry->uri);
+
+  return GST_PAD_PROBE_REMOVE;
+}
+
+/* the sink that presents the first frame, the video sink if there is one */
+static GstPad *
+find_sink_pad (GstElement * pipeline)
+{
+  GstIterator *it;
+  GValue item = G_VALUE_INIT;
+  GstElement *sink = NULL;
+  GstPad *pad = NULL;
+  gboolean done = FALSE;
+
+  it = gst_bin_iterate_recurse (GST_BIN (pipeline));
+  while (!done) {
+    switch (gst_iterator_next (it, &item)) {
+      case GST_ITERATOR_OK:{
+        GstElement *element = g_value_get_object (&item);
+        const gchar *klass;
+
+        if (GST_IS_BIN (element)
+            || !GST_OBJECT_FLAG_IS_SET (element, GST_ELEMENT_FLAG_SINK)) {
+          g_value_reset (&item);
+          break;
+        }
+
+        klass = gst_element_class_get_metadata (GST_ELEMENT_GET_CLASS
+            (element), GST_ELEMENT_METADATA_KLASS);
+        if (!sink || strstr (klass, "Video")) {
+          gst_object_replace ((GstObject **) & sink, GST_OBJECT (element));
+          done = strstr (klass, "Video") != NULL;
+        }
+        g_value_reset (&item);
+        break;
+      }
+      case GST_ITERATOR_RESYNC:
+        gst_object_replace ((GstObject **) & sink, NULL);
+        gst_iterator_resync (it);
+        break;
+      default:
+        done = TRUE;
+        break;
+    }
+  }
+  g_value_unset (&item);
+  gst_iterator_free (it);
+
+  if (sink) {
+    pad = gst_element_get_static_pad (sink, "sink");
+    gst_object_unref (sink);
+  }
+
+  return pad;
+}
+
+static void
+item_finished (ScheduledItem * item)
+{
+  GstPlaySchedule *self = item->schedule;
+
+  if (item != self->current)
+    return;
+
+  if (!self->spare && self->next >= self->entries->len) {
+    g_print ("Reached end of schedule.\n");
+    if (self->done)
+      self->done (self->user_data);
+  }
+}
+
+static void
+item_eos_cb (GstPlayer * player, ScheduledItem * item)
+{
+  g_print ("Item %u finished\n", item->entry->index + 1);
+  item_finished (item);
+}
+
+static void
+item_error_cb (GstPlayer * player, GError * err, ScheduledItem * item)
+{
+  g_printerr ("ERROR %s for %s\n", err->message, item->entry->uri);
+  item_finished (item);
+}
+
+static ScheduledItem *
+item_new (GstPlaySchedule * self, ScheduleEntry * entry)
+{
+  ScheduledItem *item = g_new0 (ScheduledItem, 1);
+
+  item->schedule = self;
+  item->entry = entry;
+  item->player =
+      gst_player_new (NULL, gst_player_g_main_context_signal_dispatcher_new
+      (NULL));
+  item->pipeline = gst_player_get_pipeline (item->player);
+
+  gst_pipeline_use_clock (GST_PIPELINE (item->pipeline), self->clock);
+  gst_element_set_start_time (item->pipeline, GST_CLOCK_TIME_NONE);
+
+  g_signal_connect (item->player, "end-of-stream", G_CALLBACK (item_eos_cb),
+      item);
+  g_signal_connect (item->player, "error", G_CALLBACK (item_error_cb), item);
+
+  g_print ("Prerolling item %u: %s\n", entry->index + 1, entry->uri);
+  gst_player_set_uri (item->player, entry->uri);
+  gst_player_pause (item->player);
+
+  return item;
+}
+
+static void
+item_start (ScheduledItem * item)
+{
+  GstClockTime latency = 0, base_time;
+  GstQuery *query;
+
+  if (GST_STATE (item->pipeline) != GST_STATE_PAUSED
+      || GST_STATE_PENDING (item->pipeline) != GST_STATE_VOID_PENDING)
+    g_print ("Item %u was not prerolled in time, try a longer --preroll\n",
+        item->entry->index + 1);
+
+  query = gst_query_new_latency ();
+  if (gst_element_query (item->pipeline, query))
+    gst_query_parse_latency (query, NULL, &latency, NULL);
+  gst_query_unref (query);
+
+  /* running time 0 is rendered at base time + latency, the bin hands
+   * this to all elements on the way to PLAYING */
+  base_time = item->entry->start > latency ? item->entry->start - latency : 0;
+  gst_element_set_base_time (item->pipeline, base_time);
+
+  item->sink_pad = find_sink_pad (item->pipeline);
+  if (item->sink_pad)
+    gst_pad_add_probe (item->sink_pad, GST_PAD_PROBE_TYPE_BUFFER,
+        (GstPadProbeCallback) item_sink_probe, item, NULL);
+
+  gst_player_play (item->player);
+}
+
+static void
+item_free (ScheduledItem * item)
+{
+  g_signal_handlers_disconnect_by_data (item->player, item);
+  gst_player_stop (item->player);
+  gst_object_unref (item->pipeline);
+  /* joins the player thread and shuts down the pipeline, after this the
+   * probe isn't called anymore */
+  gst_object_unref (item->player);
+  if (item->sink_pad)
+    gst_object_unref (item->sink_pad);
+  g_free (item);
+}
+
+static gboolean
+schedule_tick (GstPlaySchedule * self)
+{
+  GstClockTime now;
+
+  self->timeout_id = 0;
+  now = gst_clock_get_time (self->clock);
+
+  if (self->spare && now + START_LEAD >= self->spare->entry->start) {
+    g_print ("Starting item %u\n", self->spare->entry->index + 1);
+    item_start (self->spare);
+    if (self->previous)
+      item_free (self->previous);
+    self->previous = self->current;
+    self->current = self->spare;
+    self->spare = NULL;
+  }
+
+  if (self->previous && now >= self->current->entry->start) {
+    item_free (self->previous);
+    self->previous = NULL;
+  }
+
+  if (!self->spare && self->next < self->entries->len) {
+    ScheduleEntry *entry = g_ptr_array_index (self->entries, self->next);
+
+    if (now + self->preroll >= entry->start) {
+      self->spare = item_new (self, entry);
+      self->next++;
+    }
+  }
+
+  schedule_arm (self);
+
+  return G_SOURCE_REMOVE;
+}
+
+/* wakes up for whatever is due next: stopping the previous item, starting
+ * the prerolled one or prerolling the next one */
+static void
+schedule_arm (GstPlaySchedule * self)
+{
+  GstClockTime due = GST_CLOCK_TIME_NONE, now;
+  guint delay_ms;
+
+  if (self->spare) {
+    due = self->spare->entry->start - START_LEAD;
+  } else if (self->next < self->entries->len) {
+    ScheduleEntry *entry = g_ptr_array_index (self->entries, self->next);
+
+    due = entry->start - self->preroll;
+  }
+
+  if (self->previous && (!GST_CLOCK_TIME_IS_VALID (due)
+          || self->current->entry->start < due))
+    due = self->current->entry->start;
+
+  if (!GST_CLOCK_TIME_IS_VALID (due))
+    return;
+
+  /* woken up again before due, in case the wall clock was changed */
+  now = gst_clock_get_time (self->clock);
+  delay_ms = due > now ? MIN ((due - now) / GST_MSECOND, 60 * 1000) : 0;
+  self->timeout_id = g_timeout_add (delay_ms, (GSourceFunc) schedule_tick,
+      self);
+}
+
+/**
+ * gst_play_schedule_new:
+ * @filename: the schedule file
+ * @preroll: how long before its time each item is prerolled
+ * @error: location for a #GError
+ */
+GstPlaySchedule *
+gst_play_schedule_new (const gchar * filename, GstClockTime preroll,
+    GError ** error)
+{
+  GstPlaySchedule *self;
+  gchar *contents;
+  gchar **lines;
+  guint i;
+
+  if (!g_file_get_contents (filename, &contents, NULL, error))
+    return NULL;
+
+  self = g_new0 (GstPlaySchedule, 1);
+  self->preroll = preroll;
+  self->clock = g_object_new (GST_TYPE_SYSTEM_CLOCK, "clock-type",
+      GST_CLOCK_TYPE_REALTIME, NULL);
+  self->entries =
+      g_ptr_array_new_with_free_func ((GDestroyNotify) schedule_entry_free);
+
+  lines = g_strsplit (contents, "\n", 0);
+  g_free (contents);
+
+  for (i = 0; lines[i]; i++) {
+    gchar *line = g_strstrip (lines[i]);
+    gchar **fields;
+    GstClockTime start;
+
+    if (line[0] == '\0' || line[0] == '#')
+      continue;
+
+    fields = g_strsplit_set (line, " \t", 2);
+    if (!fields[1] || !parse_time (fields[0], &start)) {
+      g_printerr ("Ignoring invalid schedule line %u: %s\n", i + 1, line);
+    } else {
+      ScheduleEntry *entry = g_new0 (ScheduleEntry, 1);
+      gchar *location = g_strstrip (fields[1]);
+
+      entry->start = start;
+      entry->uri = gst_uri_is_valid (location) ? g_strdup (location) :
+          gst_filename_to_uri (location, NULL);
+      if (entry->uri)
+        g_ptr_array_add (self->entries, entry);
+      else
+        schedule_entry_free (entry);
+    }
+    g_strfreev (fields);
+  }
+  g_strfreev (lines);
+
+  g_ptr_array_sort (self->entries, compare_entries);
+  for (i = 0; i < self->entries->len; i++)
+    ((ScheduleEntry *) g_ptr_array_index (self->entries, i))->index = i;
+
+  return self;
+}
+
+void
+gst_play_schedule_free (GstPlaySchedule * self)
+{
+  g_return_if_fail (self != NULL);
+
+  if (self->timeout_id)
+    g_source_remove (self->timeout_id);
+  if (self->spare)
+    item_free (self->spare);
+  if (self->previous)
+    item_free (self->previous);
+  if (self->current)
+    item_free (self->current);
+
+  g_ptr_array_unref (self->entries);
+  gst_object_unref (self->clock);
+  g_free (self);
+}
+
+/**
+ * gst_play_schedule_start:
+ * @done: called once the last item finished
+ *
+ * Items whose time has already passed are skipped.
+ *
+ * Returns: %FALSE if there is nothing left to play, @done is not called
+ * then
+ */
+gboolean
+gst_play_schedule_start (GstPlaySchedule * self,
+    GstPlayScheduleDoneFunc done, gpointer user_data)
+{
+  GstClockTime now;
+
+  g_return_val_if_fail (self != NULL, FALSE);
+
+  self->done = done;
+  self->user_data = user_data;
+
+  now = gst_clock_get_time (self->clock);
+  while (self->next < self->entries->len) {
+    ScheduleEntry *entry = g_ptr_array_index (self->entries, self->next);
+
+    if (entry->start > now)
+      break;
+
+    g_print ("Skipping item %u, its time has passed: %s\n", entry->index + 1,
+        entry->uri);
+    self->next++;
+  }
+
+  if (self->next >= self->entries->len) {
+    g_print ("Nothing left to play in the schedule.\n");
+    return FALSE;
+  }
+
+  schedule_tick (self);
+
+  return TRUE;
+}
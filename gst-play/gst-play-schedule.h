@@ -0,0 +1,36 @@
+/* GStreamer command line playback testing utility - scheduled playback
+ *
+ * Copyright (C) 2016 GStreamer developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+#ifndef __GST_PLAY_SCHEDULE_INCLUDED__
+#define __GST_PLAY_SCHEDULE_INCLUDED__
+
+#include <gst/gst.h>
+
+typedef struct _GstPlaySchedule GstPlaySchedule;
+
+typedef void (*GstPlayScheduleDoneFunc) (gpointer user_data);
+
+GstPlaySchedule * gst_play_schedule_new (const gchar * filename,
+    GstClockTime preroll, GError ** error);
+void gst_play_schedule_free (GstPlaySchedule * schedule);
+
+gboolean gst_play_schedule_start (GstPlaySchedule * schedule,
+    GstPlayScheduleDoneFunc done, gpointer user_data);
+
+#endif /* __GST_PLAY_SCHEDULE_INCLUDED__ */
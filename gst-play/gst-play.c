@@ -30,10 +30,27 @@
 #include <math.h>
 
 #include "gst-play-kb.h"
+#include "gst-play-schedule.h"
+#include "gst-play-benchmark.h"
+#include "gst-player-state-snapshot.h"
+#include "gst-player-looper.h"
+#include "gst-player-clip-export.h"
+#include "gst-player-timeshift.h"
+#include "gst-player-low-latency.h"
+#include "gst-player-net-sync.h"
+#include "gst-player-segments.h"
+#include "gst-player-mmap-src.h"
+#include "gst-player-uring-src.h"
+#include "gst-player-prefetch.h"
+#include "gst-player-seek-index.h"
+#include "gst-player-autoplug-cache.h"
 #include <gst/player/player.h>
 
 #define VOLUME_STEPS 20
 
+/* how many of the next items --prefetch reads ahead */
+#define PREFETCH_ITEMS 2
+
 GST_DEBUG_CATEGORY (play_debug);
 #define GST_CAT_DEFAULT play_debug
 
@@ -44,10 +61,39 @@ typedef struct
   gint cur_idx;
 
   GstPlayer *player;
+  GstPlayerStateSnapshot *snapshot;
   GstState desired_state;
 
   gboolean repeat;
 
+  /* a single item is repeated by the looper instead of at EOS */
+  gboolean repeat_item;
+  GstPlayerLooper *looper;
+  /* from the command line, each item only plays this range */
+  GstClockTime range_start;
+  GstClockTime range_stop;
+  /* start of the A-B range while waiting for its end */
+  GstClockTime ab_start;
+  gboolean ab_active;
+  /* the active A-B range, which is what gets exported */
+  GstClockTime ab_range_start;
+  GstClockTime ab_range_stop;
+  guint reported_loops;
+
+  gboolean export_accurate;
+  guint pending_exports;
+
+  /* only with --low-latency or --measure-latency */
+  GstPlayerLowLatency *low_latency;
+  /* only with --sync-master or --sync-slave */
+  GstPlayerNetSync *net_sync;
+  /* only with --prefetch */
+  GstPlayerPrefetch *prefetch;
+  /* only with --autoplug-cache or --warm-decoders */
+  GstPlayerAutoplugCache *autoplug_cache;
+  /* with --seek-index, only for the player, the playlist keeps the URIs */
+  gboolean seek_index;
+
   GMainLoop *loop;
 } GstPlay;
 
@@ -55,6 +101,7 @@ static gboolean play_next (GstPlay * play);
 static gboolean play_prev (GstPlay * play);
 static void play_reset (GstPlay * play);
 static void play_set_relative_volume (GstPlay * play, gdouble volume_step);
+static void play_report_loops (GstPlay * play);
 
 static void
 end_of_stream_cb (GstPlayer * player, GstPlay * play)
@@ -85,12 +132,31 @@ error_cb (GstPlayer * player, GError * err, GstPlay * play)
 static void
 position_updated_cb (GstPlayer * player, GstClockTime pos, GstPlay * play)
 {
-  GstClockTime dur = -1;
+  GstPlayerStateSnapshotData snapshot;
+  GstPlayerLatencyStats latency;
+  GstClockTimeDiff skew;
+  guint peers;
+  GstClockTime dur;
   gchar status[64] = { 0, };
-
-  g_object_get (play->player, "duration", &dur, NULL);
-
-  memset (status, ' ', sizeof (status) - 1);
+  gint len = 0;
+
+  gst_player_state_snapshot_read (play->snapshot, &snapshot);
+  dur = snapshot.duration;
+
+  if (play->low_latency
+      && gst_player_low_latency_get_stats (play->low_latency, &latency))
+    len = g_snprintf (status, sizeof (status),
+        "latency p50 %.0f p95 %.0f p99 %.0f ms",
+        (gdouble) latency.p50 / GST_MSECOND,
+        (gdouble) latency.p95 / GST_MSECOND,
+        (gdouble) latency.p99 / GST_MSECOND);
+  else if (play->net_sync
+      && gst_player_net_sync_get_skew (play->net_sync, &skew, &peers))
+    len = g_snprintf (status, sizeof (status), "skew %+.1f ms, %u peer%s",
+        (gdouble) skew / GST_MSECOND, peers, peers == 1 ? "" : "s");
+
+  if ((gsize) len < sizeof (status) - 1)
+    memset (status + len, ' ', sizeof (status) - 1 - len);
 
   if (pos != -1 && dur > 0 && dur != -1) {
     gchar dstr[32], pstr[32];
@@ -102,6 +168,8 @@ position_updated_cb (GstPlayer * player, GstClockTime pos, GstPlay * play)
     dstr[9] = '\0';
     g_print ("%s / %s %s\r", pstr, dstr, status);
   }
+
+  play_report_loops (play);
 }
 
 static void
@@ -359,6 +427,12 @@ play_new (gchar ** uris, gdouble initial_volume)
   play->player =
       gst_player_new (NULL, gst_player_g_main_context_signal_dispatcher_new
       (NULL));
+  play->snapshot = gst_player_state_snapshot_new (play->player);
+  play->looper = gst_player_looper_new (play->player);
+  play->range_start = 0;
+  play->range_stop = GST_CLOCK_TIME_NONE;
+  play->ab_start = GST_CLOCK_TIME_NONE;
+  play->ab_range_start = play->ab_range_stop = GST_CLOCK_TIME_NONE;
 
   g_signal_connect (play->player, "position-updated",
       G_CALLBACK (position_updated_cb), play);
@@ -385,7 +459,18 @@ play_free (GstPlay * play)
 {
   play_reset (play);
 
+  gst_player_state_snapshot_free (play->snapshot);
   gst_object_unref (play->player);
+  /* only once nothing is streaming anymore */
+  gst_player_looper_free (play->looper);
+  if (play->low_latency)
+    gst_player_low_latency_free (play->low_latency);
+  if (play->net_sync)
+    gst_player_net_sync_free (play->net_sync);
+  if (play->prefetch)
+    gst_player_prefetch_free (play->prefetch);
+  if (play->autoplug_cache)
+    gst_player_autoplug_cache_free (play->autoplug_cache);
 
   g_main_loop_unref (play->loop);
 
@@ -413,6 +498,127 @@ play_set_relative_volume (GstPlay * play, gdouble volume_step)
   g_print ("Volume: %.0f%%                  \n", volume * 100);
 }
 
+static void
+play_report_loops (GstPlay * play)
+{
+  GstPlayerLooperStats stats;
+
+  gst_player_looper_get_stats (play->looper, &stats);
+  if (stats.loops == play->reported_loops)
+    return;
+  play->reported_loops = stats.loops;
+
+  if (stats.last_jitter == GST_CLOCK_STIME_NONE) {
+    g_print ("Loop %u\n", stats.loops);
+    return;
+  }
+
+  /* positive values are late, i.e. a gap at the boundary */
+  g_print ("Loop %u, boundary jitter %+.3f ms (min %+.3f ms, max %+.3f ms)\n",
+      stats.loops, (gdouble) stats.last_jitter / GST_MSECOND,
+      (gdouble) stats.min_jitter / GST_MSECOND,
+      (gdouble) stats.max_jitter / GST_MSECOND);
+}
+
+/* first sets the start of the range, then its end, then clears it again */
+static void
+play_cycle_ab_loop (GstPlay * play)
+{
+  GstPlayerStateSnapshotData snapshot;
+
+  gst_player_state_snapshot_read (play->snapshot, &snapshot);
+
+  if (play->ab_active) {
+    /* back to repeating the whole item, if that was asked for */
+    gst_player_looper_set_range (play->looper, play->range_start,
+        play->range_stop);
+    gst_player_looper_set_enabled (play->looper, play->repeat_item);
+    play->ab_active = FALSE;
+    g_print ("\nA-B repeat off\n");
+  } else if (!GST_CLOCK_TIME_IS_VALID (play->ab_start)) {
+    play->ab_start = snapshot.position;
+    g_print ("\nA-B repeat from %" GST_TIME_FORMAT "\n",
+        GST_TIME_ARGS (play->ab_start));
+  } else if (snapshot.position > play->ab_start) {
+    gst_player_looper_set_range (play->looper, play->ab_start,
+        snapshot.position);
+    gst_player_looper_set_enabled (play->looper, TRUE);
+    play->ab_active = TRUE;
+    play->ab_range_start = play->ab_start;
+    play->ab_range_stop = snapshot.position;
+    g_print ("\nA-B repeat %" GST_TIME_FORMAT " - %" GST_TIME_FORMAT "\n",
+        GST_TIME_ARGS (play->ab_start), GST_TIME_ARGS (snapshot.position));
+    play->ab_start = GST_CLOCK_TIME_NONE;
+  } else {
+    play->ab_start = GST_CLOCK_TIME_NONE;
+    g_print ("\nA-B repeat off\n");
+  }
+}
+
+static void
+export_done_cb (GstPlayerClipExport * clip, const GError * error,
+    GstPlay * play)
+{
+  if (error)
+    g_printerr ("\nExporting %s failed: %s\n",
+        gst_player_clip_export_get_location (clip), error->message);
+  else
+    g_print ("\nExported %s\n", gst_player_clip_export_get_location (clip));
+
+  gst_player_clip_export_free (clip);
+  play->pending_exports--;
+}
+
+/* runs next to playback, in a pipeline of its own */
+static void
+play_export (GstPlay * play, const gchar * uri, GstClockTime start,
+    GstClockTime stop, const gchar * location)
+{
+  GstPlayerClipExport *clip;
+  GError *err = NULL;
+
+  clip = gst_player_clip_export_new (uri, start, stop, location,
+      play->export_accurate, (GstPlayerClipExportDoneFunc) export_done_cb,
+      play, &err);
+  if (!clip) {
+    g_printerr ("\nCould not export %s: %s\n", location, err->message);
+    g_clear_error (&err);
+    return;
+  }
+
+  play->pending_exports++;
+  g_print ("\nExporting %" GST_TIME_FORMAT " - %" GST_TIME_FORMAT " to %s\n",
+      GST_TIME_ARGS (start), GST_TIME_ARGS (stop), location);
+}
+
+/* the active A-B range of the current item, next to the working directory */
+static void
+play_export_ab_range (GstPlay * play)
+{
+  const gchar *uri = play->uris[play->cur_idx];
+  gchar *path, *basename, *dot, *location;
+
+  if (!play->ab_active) {
+    g_print ("\nNo A-B range to export, set one with 'l'\n");
+    return;
+  }
+
+  path = g_filename_from_uri (uri, NULL, NULL);
+  basename = g_path_get_basename (path ? path : "clip");
+  dot = strrchr (basename, '.');
+  if (dot && dot != basename)
+    *dot = '\0';
+
+  location = g_strdup_printf ("%s-%.3f-%.3f.mkv", basename,
+      (gdouble) play->ab_range_start / GST_SECOND,
+      (gdouble) play->ab_range_stop / GST_SECOND);
+  play_export (play, uri, play->ab_range_start, play->ab_range_stop, location);
+
+  g_free (location);
+  g_free (basename);
+  g_free (path);
+}
+
 static gchar *
 play_uri_get_display_name (GstPlay * play, const gchar * uri)
 {
@@ -430,6 +636,26 @@ play_uri_get_display_name (GstPlay * play, const gchar * uri)
   return loc;
 }
 
+/* the items after the current one, wrapping around when repeating */
+static void
+play_prefetch_upcoming (GstPlay * play)
+{
+  const gchar *upcoming[PREFETCH_ITEMS];
+  gint idx = play->cur_idx;
+  guint n = 0;
+
+  while (n < PREFETCH_ITEMS && n + 1 < play->num_uris) {
+    if (++idx >= play->num_uris) {
+      if (!play->repeat)
+        break;
+      idx = 0;
+    }
+    upcoming[n++] = play->uris[idx];
+  }
+
+  gst_player_prefetch_set_upcoming (play->prefetch, upcoming, n);
+}
+
 static void
 play_uri (GstPlay * play, const gchar * next_uri)
 {
@@ -441,8 +667,18 @@ play_uri (GstPlay * play, const gchar * next_uri)
   g_print ("Now playing %s\n", loc);
   g_free (loc);
 
-  g_object_set (play->player, "uri", next_uri, NULL);
+  if (play->seek_index) {
+    gchar *uri = gst_player_seek_index_wrap_uri (next_uri);
+
+    g_object_set (play->player, "uri", uri, NULL);
+    g_free (uri);
+  } else {
+    g_object_set (play->player, "uri", next_uri, NULL);
+  }
   gst_player_play (play->player);
+
+  if (play->prefetch)
+    play_prefetch_upcoming (play);
 }
 
 /* returns FALSE if we have reached the end of the playlist */
@@ -560,11 +796,14 @@ toggle_paused (GstPlay * play)
 static void
 relative_seek (GstPlay * play, gdouble percent)
 {
-  gint64 dur = -1, pos = -1;
+  GstPlayerStateSnapshotData snapshot;
+  gint64 dur, pos;
 
   g_return_if_fail (percent >= -1.0 && percent <= 1.0);
 
-  g_object_get (play->player, "position", &pos, "duration", &dur, NULL);
+  gst_player_state_snapshot_read (play->snapshot, &snapshot);
+  pos = snapshot.position;
+  dur = snapshot.duration;
 
   if (dur <= 0) {
     g_print ("\nCould not seek.\n");
@@ -577,6 +816,21 @@ relative_seek (GstPlay * play, gdouble percent)
   gst_player_seek (play->player, pos);
 }
 
+/* with --timeshift the duration is the live edge */
+static void
+seek_to_live (GstPlay * play)
+{
+  GstPlayerStateSnapshotData snapshot;
+
+  gst_player_state_snapshot_read (play->snapshot, &snapshot);
+  if (!GST_CLOCK_TIME_IS_VALID (snapshot.duration)) {
+    g_print ("\nCould not seek.\n");
+    return;
+  }
+
+  gst_player_seek (play->player, snapshot.duration);
+}
+
 static void
 keyboard_cb (const gchar * key_input, gpointer user_data)
 {
@@ -609,6 +863,15 @@ keyboard_cb (const gchar * key_input, gpointer user_data)
     case '<':
       play_prev (play);
       break;
+    case 'l':
+      play_cycle_ab_loop (play);
+      break;
+    case 'e':
+      play_export_ab_range (play);
+      break;
+    case 'j':
+      seek_to_live (play);
+      break;
     case 27:                   /* ESC */
       if (key_input[1] == '\0') {
         g_main_loop_quit (play->loop);
@@ -642,6 +905,28 @@ main (int argc, char **argv)
   gboolean interactive = FALSE; /* FIXME: maybe enable by default? */
   gboolean shuffle = FALSE;
   gboolean repeat = FALSE;
+  gchar *ab_loop = NULL;
+  gchar *export_location = NULL;
+  gboolean export_accurate = FALSE;
+  gboolean timeshift = FALSE;
+  gboolean segments = FALSE;
+  gboolean seek_index = FALSE;
+  gboolean autoplug_cache = FALSE;
+  gboolean warm_decoders = FALSE;
+  gboolean io_uring = FALSE;
+  gboolean use_mmap = FALSE;
+  gboolean benchmark = FALSE;
+  gboolean low_latency = FALSE;
+  gboolean measure_latency = FALSE;
+  gint test_source_port = 0;
+  GstElement *test_source = NULL;
+  gint sync_master_port = 0;
+  gchar *sync_slave = NULL;
+  gchar *schedule_file = NULL;
+  gint prefetch = 0;
+  gint prefetch_rate = 4;
+  gdouble preroll = 2.0;
+  gdouble start = 0, end = -1;
   gdouble volume = 1.0;
   gchar **filenames = NULL;
   gchar **uris;
@@ -661,6 +946,67 @@ main (int argc, char **argv)
     {"playlist", 0, 0, G_OPTION_ARG_FILENAME, &playlist_file,
         "Playlist file containing input media files", NULL},
     {"loop", 0, 0, G_OPTION_ARG_NONE, &repeat, "Repeat all", NULL},
+    {"ab-loop", 0, 0, G_OPTION_ARG_STRING, &ab_loop,
+        "Repeat the range from START to END seconds", "START-END"},
+    {"start", 0, 0, G_OPTION_ARG_DOUBLE, &start,
+        "Start playback of each item at this many seconds", "SECONDS"},
+    {"end", 0, 0, G_OPTION_ARG_DOUBLE, &end,
+        "End playback of each item at this many seconds", "SECONDS"},
+    {"export", 0, 0, G_OPTION_ARG_FILENAME, &export_location,
+        "Write the --ab-loop or --start/--end range of the first item to "
+          "FILE, without re-encoding", "FILE"},
+    {"export-accurate", 0, 0, G_OPTION_ARG_NONE, &export_accurate,
+        "Start the export exactly at the range instead of at the keyframe "
+          "before, by re-encoding the video", NULL},
+    {"timeshift", 0, 0, G_OPTION_ARG_NONE, &timeshift,
+        "Buffer live streams so they can be paused and seeked in", NULL},
+    {"segments", 0, 0, G_OPTION_ARG_NONE, &segments,
+        "Play each directory or numbered file pattern (e.g. cam_%04d.mp4) "
+          "as one continuous item", NULL},
+    {"seek-index", 0, 0, G_OPTION_ARG_NONE, &seek_index,
+        "Remember where the keyframes of local files are, for fast seeking "
+          "in files without an index", NULL},
+    {"low-latency", 0, 0, G_OPTION_ARG_NONE, &low_latency,
+        "Buffer as little as possible, for live camera feeds", NULL},
+    {"measure-latency", 0, 0, G_OPTION_ARG_NONE, &measure_latency,
+        "Report the end-to-end latency of a --latency-test-source stream",
+        NULL},
+    {"latency-test-source", 0, 0, G_OPTION_ARG_INT, &test_source_port,
+        "Send a test stream for --measure-latency to udp://127.0.0.1:PORT "
+          "and play it unless other URIs are given", "PORT"},
+    {"sync-master", 0, 0, G_OPTION_ARG_INT, &sync_master_port,
+        "Provide the clock for players started with --sync-slave on PORT "
+          "and PORT+1", "PORT"},
+    {"sync-slave", 0, 0, G_OPTION_ARG_STRING, &sync_slave,
+        "Present frames in sync with the --sync-master player at HOST:PORT",
+        "HOST:PORT"},
+    {"schedule", 0, 0, G_OPTION_ARG_FILENAME, &schedule_file,
+        "Play the items of FILE at the wall clock times given there, one "
+          "'[YYYY-MM-DDT]HH:MM:SS[.fff] FILE|URI' per line", "FILE"},
+    {"preroll", 0, 0, G_OPTION_ARG_DOUBLE, &preroll,
+        "Prepare each --schedule item this many seconds before its time "
+          "(default 2)", "SECONDS"},
+    {"prefetch", 0, 0, G_OPTION_ARG_INT, &prefetch,
+        "Read the first MB megabytes of the next two local files ahead",
+        "MB"},
+    {"prefetch-rate", 0, 0, G_OPTION_ARG_INT, &prefetch_rate,
+        "Read ahead at most this many megabytes per second (default 4)",
+        "MB"},
+    {"autoplug-cache", 0, 0, G_OPTION_ARG_NONE, &autoplug_cache,
+        "Try the demuxers and decoders that worked for the same kind of "
+          "stream before first", NULL},
+    {"warm-decoders", 0, 0, G_OPTION_ARG_NONE, &warm_decoders,
+        "Like --autoplug-cache, and load those elements in the background "
+          "at startup", NULL},
+    {"mmap", 0, 0, G_OPTION_ARG_NONE, &use_mmap,
+        "Read local files through a memory mapping instead of copying them",
+        NULL},
+    {"io-uring", 0, 0, G_OPTION_ARG_NONE, &io_uring,
+        "Read local files with several reads in flight, for high bitrates",
+        NULL},
+    {"benchmark-sources", 0, 0, G_OPTION_ARG_NONE, &benchmark,
+        "Compare how fast the sources for local files read the given files",
+        NULL},
     {G_OPTION_REMAINING, 0, 0, G_OPTION_ARG_FILENAME_ARRAY, &filenames, NULL},
     {NULL}
   };
@@ -680,6 +1026,11 @@ main (int argc, char **argv)
 
   GST_DEBUG_CATEGORY_INIT (play_debug, "play", 0, "gst-play");
 
+  if (use_mmap)
+    gst_player_mmap_src_register ();
+  if (io_uring && !gst_player_uring_src_register ())
+    g_printerr ("io_uring is not available\n");
+
   if (print_version) {
     gchar *version_str;
 
@@ -689,10 +1040,65 @@ main (int argc, char **argv)
     g_free (version_str);
 
     g_free (playlist_file);
+    g_free (ab_loop);
+    g_free (export_location);
+    g_free (sync_slave);
+    g_free (schedule_file);
 
     return 0;
   }
 
+  /* a different mode, with one player for each item */
+  if (schedule_file) {
+    GstPlaySchedule *schedule;
+    GMainLoop *loop;
+
+    schedule =
+        gst_play_schedule_new (schedule_file, MAX (preroll, 0) * GST_SECOND,
+        &err);
+    g_free (schedule_file);
+    g_free (playlist_file);
+    g_free (ab_loop);
+    g_free (export_location);
+    g_free (sync_slave);
+    g_strfreev (filenames);
+
+    if (!schedule) {
+      g_printerr ("Could not read schedule: %s\n", err->message);
+      g_clear_error (&err);
+      return 1;
+    }
+
+    loop = g_main_loop_new (NULL, FALSE);
+    if (gst_play_schedule_start (schedule,
+            (GstPlayScheduleDoneFunc) g_main_loop_quit, loop))
+      g_main_loop_run (loop);
+    g_main_loop_unref (loop);
+    gst_play_schedule_free (schedule);
+
+    gst_deinit ();
+    return 0;
+  }
+
+  if (benchmark) {
+    gboolean ok = filenames != NULL && *filenames != NULL;
+
+    if (!ok)
+      g_printerr ("You must provide at least one file to read.\n");
+    gst_player_mmap_src_register ();
+    gst_player_uring_src_register ();
+    for (i = 0; ok && filenames[i]; i++)
+      ok = gst_play_benchmark_sources (filenames[i], 3);
+    g_strfreev (filenames);
+    g_free (playlist_file);
+    g_free (ab_loop);
+    g_free (export_location);
+    g_free (sync_slave);
+
+    gst_deinit ();
+    return ok ? 0 : 1;
+  }
+
   playlist = g_ptr_array_new ();
 
   if (playlist_file != NULL) {
@@ -719,6 +1125,22 @@ main (int argc, char **argv)
     playlist_file = NULL;
   }
 
+  if (test_source_port > 0) {
+    test_source =
+        gst_player_latency_test_source_new ("127.0.0.1", test_source_port,
+        &err);
+    if (test_source) {
+      measure_latency = TRUE;
+      if (playlist->len == 0 && (filenames == NULL || *filenames == NULL))
+        g_ptr_array_add (playlist,
+            g_strdup_printf ("udp://127.0.0.1:%d", test_source_port));
+    } else {
+      g_printerr ("Could not start the latency test source: %s\n",
+          err->message);
+      g_clear_error (&err);
+    }
+  }
+
   if (playlist->len == 0 && (filenames == NULL || *filenames == NULL)) {
     g_printerr ("Usage: %s FILE1|URI1 [FILE2|URI2] [FILE3|URI3] ...",
         "gst-play");
@@ -727,6 +1149,9 @@ main (int argc, char **argv)
         "You must provide at least one filename or URI to play.");
     /* No input provided. Free array */
     g_ptr_array_free (playlist, TRUE);
+    g_free (ab_loop);
+    g_free (export_location);
+    g_free (sync_slave);
 
     return 1;
   }
@@ -734,9 +1159,17 @@ main (int argc, char **argv)
   /* fill playlist */
   if (filenames != NULL && *filenames != NULL) {
     num = g_strv_length (filenames);
+    if (segments && !gst_player_segments_register ()) {
+      g_printerr ("Segment playback is not available\n");
+      segments = FALSE;
+    }
     for (i = 0; i < num; ++i) {
       GST_LOG ("command line argument: %s", filenames[i]);
-      add_to_playlist (playlist, filenames[i]);
+      if (segments)
+        g_ptr_array_add (playlist,
+            gst_player_segments_make_uri (filenames[i]));
+      else
+        add_to_playlist (playlist, filenames[i]);
     }
     g_strfreev (filenames);
   }
@@ -749,9 +1182,118 @@ main (int argc, char **argv)
   if (shuffle)
     shuffle_uris (uris, num);
 
+  if (timeshift) {
+    if (gst_player_timeshift_register ()) {
+      for (i = 0; i < num; i++) {
+        gchar *uri = gst_player_timeshift_wrap_uri (uris[i]);
+
+        g_free (uris[i]);
+        uris[i] = uri;
+      }
+    } else {
+      g_printerr ("Timeshifting is not available\n");
+    }
+  }
+
+  if (seek_index && !gst_player_seek_index_register ()) {
+    g_printerr ("Seek indexes are not available\n");
+    seek_index = FALSE;
+  }
+
   /* prepare */
   play = play_new (uris, volume);
   play->repeat = repeat;
+  play->seek_index = seek_index;
+  play->export_accurate = export_accurate;
+  if (low_latency || measure_latency)
+    play->low_latency =
+        gst_player_low_latency_new (play->player, low_latency,
+        measure_latency);
+
+  if (prefetch > 0)
+    play->prefetch =
+        gst_player_prefetch_new (play->player, (guint64) prefetch << 20,
+        (guint64) MAX (prefetch_rate, 1) << 20);
+
+  if (autoplug_cache || warm_decoders)
+    play->autoplug_cache =
+        gst_player_autoplug_cache_new (play->player, warm_decoders);
+
+  /* all players present the same frame at the same time */
+  if (sync_master_port > 0) {
+    play->net_sync =
+        gst_player_net_sync_new_master (play->player, sync_master_port, &err);
+  } else if (sync_slave) {
+    gchar *host;
+    gint port;
+
+    if (gst_player_net_sync_parse_address (sync_slave, &host, &port)) {
+      play->net_sync =
+          gst_player_net_sync_new_slave (play->player, host, port, &err);
+      g_free (host);
+    } else {
+      g_printerr ("Invalid address '%s', expected HOST:PORT\n", sync_slave);
+    }
+  }
+  if (err) {
+    g_printerr ("Could not synchronise with other players: %s\n",
+        err->message);
+    g_clear_error (&err);
+  }
+  g_free (sync_slave);
+
+  /* seeked to while prerolling, and ended by the segment stop */
+  if (start > 0 || end >= 0) {
+    if (start >= 0 && (end < 0 || end > start)) {
+      play->range_start = start * GST_SECOND;
+      play->range_stop = end >= 0 ? end * GST_SECOND : GST_CLOCK_TIME_NONE;
+      gst_player_looper_set_range (play->looper, play->range_start,
+          play->range_stop);
+    } else {
+      g_printerr ("Invalid range, the end has to be after the start\n");
+    }
+  }
+
+  /* loop a single item seamlessly instead of restarting it at EOS */
+  if (repeat && num == 1) {
+    play->repeat_item = TRUE;
+    gst_player_looper_set_enabled (play->looper, TRUE);
+  }
+
+  if (ab_loop) {
+    gchar *end = NULL;
+    gdouble start_sec, stop_sec = -1;
+
+    start_sec = g_ascii_strtod (ab_loop, &end);
+    if (end && *end == '-')
+      stop_sec = g_ascii_strtod (end + 1, &end);
+
+    if (end && *end == '\0' && start_sec >= 0 && stop_sec > start_sec) {
+      gst_player_looper_set_range (play->looper, start_sec * GST_SECOND,
+          stop_sec * GST_SECOND);
+      gst_player_looper_set_enabled (play->looper, TRUE);
+      play->ab_active = TRUE;
+      play->ab_range_start = start_sec * GST_SECOND;
+      play->ab_range_stop = stop_sec * GST_SECOND;
+    } else {
+      g_printerr ("Invalid range '%s', expected START-END in seconds\n",
+          ab_loop);
+    }
+    g_free (ab_loop);
+  }
+
+  if (export_location) {
+    if (play->ab_active)
+      play_export (play, uris[0], play->ab_range_start, play->ab_range_stop,
+          export_location);
+    else if (play->range_start > 0
+        || GST_CLOCK_TIME_IS_VALID (play->range_stop))
+      play_export (play, uris[0], play->range_start, play->range_stop,
+          export_location);
+    else
+      g_printerr ("Nothing to export, pass --ab-loop or --start/--end\n");
+    g_free (export_location);
+  }
 
   if (interactive) {
     if (gst_play_kb_set_key_handler (keyboard_cb, play)) {
@@ -764,9 +1306,51 @@ main (int argc, char **argv)
   /* play */
   do_play (play);
 
+  if (play->pending_exports > 0) {
+    g_print ("\nWaiting for the export to finish\n");
+    while (play->pending_exports > 0)
+      g_main_context_iteration (NULL, TRUE);
+  }
+
+  if (play->low_latency) {
+    GstPlayerLatencyStats latency;
+
+    if (gst_player_low_latency_get_stats (play->low_latency, &latency))
+      g_print ("\nLatency over the last %u frames: p50 %.1f ms, p95 %.1f ms, "
+          "p99 %.1f ms, max %.1f ms\n", latency.samples,
+          (gdouble) latency.p50 / GST_MSECOND,
+          (gdouble) latency.p95 / GST_MSECOND,
+          (gdouble) latency.p99 / GST_MSECOND,
+          (gdouble) latency.max / GST_MSECOND);
+  }
+
+  if (play->autoplug_cache) {
+    GstPlayerAutoplugStats autoplug;
+
+    if (gst_player_autoplug_cache_get_stats (play->autoplug_cache,
+            &autoplug)) {
+      g_print ("\nStartup over %u items, %u of %u autoplug decisions "
+          "cached\n", autoplug.items, autoplug.hits,
+          autoplug.hits + autoplug.misses);
+      if (GST_CLOCK_TIME_IS_VALID (autoplug.cached_startup))
+        g_print ("  all cached: %u items, %.1f ms on average\n",
+            autoplug.cached_items,
+            (gdouble) autoplug.cached_startup / GST_MSECOND);
+      if (GST_CLOCK_TIME_IS_VALID (autoplug.uncached_startup))
+        g_print ("  otherwise:  %u items, %.1f ms on average\n",
+            autoplug.items - autoplug.cached_items,
+            (gdouble) autoplug.uncached_startup / GST_MSECOND);
+    }
+  }
+
   /* clean up */
   play_free (play);
 
+  if (test_source) {
+    gst_element_set_state (test_source, GST_STATE_NULL);
+    gst_object_unref (test_source);
+  }
+
   g_print ("\n");
   gst_deinit ();
   return 0;
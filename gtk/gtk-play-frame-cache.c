@@ -0,0 +1,615 @@
+/* GStreamer
+ *
+ * Copyright (C) 2016 GStreamer developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#include <gst/app/gstappsink.h>
+#include <gst/video/video.h>
+
+#include "gtk-play-frame-cache.h"
+
+/* Decoders can only go forward, so stepping backwards means decoding from
+ * the previous keyframe again. Whole groups of pictures are decoded at once
+ * by a private pipeline on a worker thread and kept as cairo surfaces, the
+ * frames closest to where the user is heading are kept once the cache is
+ * full. As the user steps towards the start of what is cached the group
+ * before it is decoded in the background already */
+
+#if G_BYTE_ORDER == G_LITTLE_ENDIAN
+#define CACHE_FORMAT "BGRx"
+#else
+#define CACHE_FORMAT "xRGB"
+#endif
+
+#define MAX_CACHE_SIZE (256 * 1024 * 1024)
+/* refill the cache once this few frames are left before the current one */
+#define PREFETCH_FRAMES 8
+#define STATE_TIMEOUT (5 * GST_SECOND)
+#define PULL_TIMEOUT (2 * GST_SECOND)
+
+typedef struct
+{
+  GstClockTime position;
+  cairo_surface_t *surface;
+  gsize size;
+} CachedFrame;
+
+typedef struct
+{
+  gboolean quit;
+  guint generation;
+  gchar *uri;
+  gint max_width, max_height;
+  /* decode everything from the keyframe before up to this, exclusive */
+  GstClockTime target;
+} RefillJob;
+
+struct _GtkPlayFrameCache
+{
+  GMutex lock;
+  /* CachedFrame, ascending and without gaps */
+  GQueue frames;
+  /* the cache has every frame up to this position, exclusive */
+  GstClockTime end;
+  /* known to be the first frame, there is nothing before it */
+  GstClockTime start;
+  gsize size;
+
+  /* changes whenever the cache is dropped, late refills are discarded */
+  volatile guint generation;
+  gboolean refilling;
+  gchar *uri;
+  gint max_width, max_height;
+
+  GtkPlayFrameCacheFilledFunc filled;
+  gpointer user_data;
+  guint filled_id;
+
+  GThread *thread;
+  GAsyncQueue *jobs;
+
+  /* only touched by the worker thread */
+  GstElement *pipeline;
+  GstElement *capsfilter;
+  GstElement *appsink;
+  gchar *pipeline_uri;
+};
+
+static cairo_user_data_key_t frame_key;
+
+static void
+unmap_frame (gpointer data)
+{
+  GstVideoFrame *vframe = data;
+
+  gst_video_frame_unmap (vframe);
+  g_slice_free (GstVideoFrame, vframe);
+}
+
+static CachedFrame *
+cached_frame_new (GstSample * sample, GstClockTime position)
+{
+  GstVideoInfo info;
+  GstVideoFrame *vframe;
+  CachedFrame *frame;
+  GstCaps *caps = gst_sample_get_caps (sample);
+  GstBuffer *buffer = gst_sample_get_buffer (sample);
+  guint8 *data;
+  gint width, height, stride;
+
+  if (!caps || !buffer || !gst_video_info_from_caps (&info, caps))
+    return NULL;
+
+  vframe = g_slice_new (GstVideoFrame);
+  if (!gst_video_frame_map (vframe, &info, buffer, GST_MAP_READ)) {
+    g_slice_free (GstVideoFrame, vframe);
+    return NULL;
+  }
+
+  data = GST_VIDEO_FRAME_PLANE_DATA (vframe, 0);
+  stride = GST_VIDEO_FRAME_PLANE_STRIDE (vframe, 0);
+  width = GST_VIDEO_FRAME_WIDTH (vframe);
+  height = GST_VIDEO_FRAME_HEIGHT (vframe);
+
+  frame = g_slice_new (CachedFrame);
+  frame->position = position;
+  frame->size = (gsize) stride * height;
+
+  if (stride % 4 == 0 && GPOINTER_TO_SIZE (data) % 4 == 0) {
+    /* the surface keeps the buffer mapped for as long as it lives */
+    frame->surface = cairo_image_surface_create_for_data (data,
+        CAIRO_FORMAT_RGB24, width, height, stride);
+    cairo_surface_set_user_data (frame->surface, &frame_key, vframe,
+        unmap_frame);
+  } else {
+    guint8 *dest;
+    gint dest_stride, y;
+
+    frame->surface = cairo_image_surface_create (CAIRO_FORMAT_RGB24, width,
+        height);
+    dest = cairo_image_surface_get_data (frame->surface);
+    dest_stride = cairo_image_surface_get_stride (frame->surface);
+    for (y = 0; y < height; y++)
+      memcpy (dest + y * dest_stride, data + y * stride, width * 4);
+    cairo_surface_mark_dirty (frame->surface);
+    unmap_frame (vframe);
+  }
+
+  return frame;
+}
+
+static void
+cached_frame_free (CachedFrame * frame)
+{
+  cairo_surface_destroy (frame->surface);
+  g_slice_free (CachedFrame, frame);
+}
+
+static void
+refill_job_free (RefillJob * job)
+{
+  g_free (job->uri);
+  g_slice_free (RefillJob, job);
+}
+
+/* with the lock */
+static void
+clear_frames (GtkPlayFrameCache * self)
+{
+  g_queue_free_full (&self->frames, (GDestroyNotify) cached_frame_free);
+  g_queue_init (&self->frames);
+  self->size = 0;
+  self->end = GST_CLOCK_TIME_NONE;
+  self->start = GST_CLOCK_TIME_NONE;
+}
+
+/* with the lock */
+static void
+request_refill (GtkPlayFrameCache * self, GstClockTime target)
+{
+  RefillJob *job;
+
+  if (self->refilling || !self->uri)
+    return;
+
+  job = g_slice_new0 (RefillJob);
+  job->generation = self->generation;
+  job->uri = g_strdup (self->uri);
+  job->max_width = self->max_width;
+  job->max_height = self->max_height;
+  job->target = target;
+
+  self->refilling = TRUE;
+  g_async_queue_push (self->jobs, job);
+}
+
+static gboolean
+filled_cb (GtkPlayFrameCache * self)
+{
+  g_mutex_lock (&self->lock);
+  self->filled_id = 0;
+  g_mutex_unlock (&self->lock);
+
+  self->filled (self, self->user_data);
+
+  return G_SOURCE_REMOVE;
+}
+
+static gboolean
+worker_prepare_pipeline (GtkPlayFrameCache * self, RefillJob * job)
+{
+  GstCaps *caps;
+
+  if (!self->pipeline) {
+    GstElement *bin, *scale, *convert;
+    GstPad *pad;
+
+    self->pipeline = gst_element_factory_make ("playbin", NULL);
+    bin = gst_bin_new ("framecachesinkbin");
+    scale = gst_element_factory_make ("videoscale", NULL);
+    convert = gst_element_factory_make ("videoconvert", NULL);
+    self->capsfilter = gst_element_factory_make ("capsfilter", NULL);
+    self->appsink = gst_element_factory_make ("appsink", NULL);
+
+    if (!self->pipeline || !scale || !convert || !self->capsfilter ||
+        !self->appsink) {
+      g_warning ("Can't create the frame cache pipeline");
+      return FALSE;
+    }
+
+    /* as fast as the decoder goes, but never more than a few frames ahead
+     * of what was converted already */
+    g_object_set (self->appsink, "sync", FALSE, "max-buffers", 4,
+        "enable-last-sample", FALSE, NULL);
+
+    /* scale before converting, that is the cheaper way round */
+    gst_bin_add_many (GST_BIN (bin), scale, convert, self->capsfilter,
+        self->appsink, NULL);
+    gst_element_link_many (scale, convert, self->capsfilter, self->appsink,
+        NULL);
+    pad = gst_element_get_static_pad (scale, "sink");
+    gst_element_add_pad (bin, gst_ghost_pad_new ("sink", pad));
+    gst_object_unref (pad);
+
+    g_object_set (self->pipeline, "video-sink", bin, NULL);
+    /* video only, by the nick of playbin's GstPlayFlags */
+    gst_util_set_object_arg (G_OBJECT (self->pipeline), "flags", "video");
+  }
+
+  if (g_strcmp0 (self->pipeline_uri, job->uri) != 0) {
+    gst_element_set_state (self->pipeline, GST_STATE_NULL);
+    g_object_set (self->pipeline, "uri", job->uri, NULL);
+    g_free (self->pipeline_uri);
+    self->pipeline_uri = g_strdup (job->uri);
+  }
+
+  caps = gst_caps_new_simple ("video/x-raw",
+      "format", G_TYPE_STRING, CACHE_FORMAT,
+      "pixel-aspect-ratio", GST_TYPE_FRACTION, 1, 1, NULL);
+  if (job->max_width > 0 && job->max_height > 0)
+    gst_caps_set_simple (caps,
+        "width", GST_TYPE_INT_RANGE, 1, job->max_width,
+        "height", GST_TYPE_INT_RANGE, 1, job->max_height, NULL);
+  g_object_set (self->capsfilter, "caps", caps, NULL);
+  gst_caps_unref (caps);
+
+  gst_element_set_state (self->pipeline, GST_STATE_PAUSED);
+
+  return gst_element_get_state (self->pipeline, NULL, NULL,
+      STATE_TIMEOUT) == GST_STATE_CHANGE_SUCCESS;
+}
+
+/* Returns the frames before the target, ascending. If they don't all fit
+ * into the cache the earliest are dropped again, the frame right before
+ * the target is needed first */
+static GQueue *
+worker_decode (GtkPlayFrameCache * self, RefillJob * job, gsize * size)
+{
+  GQueue *frames = g_queue_new ();
+  GstSample *sample;
+  GstClockTime start;
+
+  *size = 0;
+
+  if (!worker_prepare_pipeline (self, job))
+    return frames;
+
+  start = job->target > 0 ? job->target - 1 : 0;
+  /* the segment stops at the target, so the pipeline goes EOS there */
+  if (!gst_element_seek (self->pipeline, 1.0, GST_FORMAT_TIME,
+          GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_KEY_UNIT |
+          GST_SEEK_FLAG_SNAP_BEFORE, GST_SEEK_TYPE_SET, start,
+          GST_SEEK_TYPE_SET, job->target))
+    return frames;
+  if (gst_element_get_state (self->pipeline, NULL, NULL,
+          STATE_TIMEOUT) != GST_STATE_CHANGE_SUCCESS)
+    return frames;
+
+  gst_element_set_state (self->pipeline, GST_STATE_PLAYING);
+
+  while ((sample = gst_app_sink_try_pull_sample (GST_APP_SINK (self->appsink),
+              PULL_TIMEOUT))) {
+    GstBuffer *buffer = gst_sample_get_buffer (sample);
+    const GstSegment *segment = gst_sample_get_segment (sample);
+    GstClockTime position = GST_CLOCK_TIME_NONE;
+    CachedFrame *frame = NULL;
+
+    if (buffer && segment && GST_BUFFER_PTS_IS_VALID (buffer))
+      position = gst_segment_to_stream_time (segment, GST_FORMAT_TIME,
+          GST_BUFFER_PTS (buffer));
+
+    if (GST_CLOCK_TIME_IS_VALID (position) && position < job->target)
+      frame = cached_frame_new (sample, position);
+    gst_sample_unref (sample);
+
+    if (frame) {
+      g_queue_push_tail (frames, frame);
+      *size += frame->size;
+      while (*size > MAX_CACHE_SIZE) {
+        CachedFrame *dropped = g_queue_pop_head (frames);
+
+        *size -= dropped->size;
+        cached_frame_free (dropped);
+      }
+    } else if (GST_CLOCK_TIME_IS_VALID (position)) {
+      break;
+    }
+
+    /* the user moved on in the meantime */
+    if (g_atomic_int_get (&self->generation) != job->generation)
+      break;
+  }
+
+  gst_element_set_state (self->pipeline, GST_STATE_PAUSED);
+
+  return frames;
+}
+
+/* with the lock, the frames end right before the first cached one */
+static void
+merge_frames (GtkPlayFrameCache * self, GQueue * frames, gsize size,
+    GstClockTime target)
+{
+  CachedFrame *frame;
+
+  if (g_queue_is_empty (frames)) {
+    self->start = target;
+    if (!GST_CLOCK_TIME_IS_VALID (self->end))
+      self->end = target;
+    return;
+  }
+
+  if (g_queue_is_empty (&self->frames))
+    self->end = target;
+
+  while ((frame = g_queue_pop_tail (frames)))
+    g_queue_push_head (&self->frames, frame);
+  self->size += size;
+
+  /* the user steps backwards, so the latest frames go first */
+  while (self->size > MAX_CACHE_SIZE && self->frames.length > 1) {
+    frame = g_queue_pop_tail (&self->frames);
+    self->size -= frame->size;
+    self->end = frame->position;
+    cached_frame_free (frame);
+  }
+}
+
+static gpointer
+worker_thread_func (GtkPlayFrameCache * self)
+{
+  RefillJob *job;
+
+  while ((job = g_async_queue_pop (self->jobs)) && !job->quit) {
+    GQueue *frames;
+    gsize size;
+
+    frames = worker_decode (self, job, &size);
+
+    g_mutex_lock (&self->lock);
+    if (job->generation == self->generation) {
+      CachedFrame *first = g_queue_peek_head (&self->frames);
+
+      if (!first || first->position == job->target)
+        merge_frames (self, frames, size, job->target);
+      self->refilling = FALSE;
+      if (!self->filled_id)
+        self->filled_id = g_idle_add ((GSourceFunc) filled_cb, self);
+    }
+    g_mutex_unlock (&self->lock);
+
+    g_queue_free_full (frames, (GDestroyNotify) cached_frame_free);
+    refill_job_free (job);
+  }
+  refill_job_free (job);
+
+  if (self->pipeline) {
+    gst_element_set_state (self->pipeline, GST_STATE_NULL);
+    gst_object_unref (self->pipeline);
+  }
+  g_free (self->pipeline_uri);
+
+  return NULL;
+}
+
+/**
+ * gtk_play_frame_cache_new:
+ * @filled: called from the main thread whenever a refill finished
+ * @user_data: passed to @filled
+ *
+ * Returns: a new, empty frame cache
+ */
+GtkPlayFrameCache *
+gtk_play_frame_cache_new (GtkPlayFrameCacheFilledFunc filled,
+    gpointer user_data)
+{
+  GtkPlayFrameCache *self = g_new0 (GtkPlayFrameCache, 1);
+
+  g_mutex_init (&self->lock);
+  g_queue_init (&self->frames);
+  self->end = GST_CLOCK_TIME_NONE;
+  self->start = GST_CLOCK_TIME_NONE;
+  self->filled = filled;
+  self->user_data = user_data;
+  self->jobs = g_async_queue_new ();
+  self->thread = g_thread_new ("gtk-play-frame-cache",
+      (GThreadFunc) worker_thread_func, self);
+
+  return self;
+}
+
+/**
+ * gtk_play_frame_cache_free:
+ * @cache: the frame cache
+ *
+ * Waits for a running refill to finish, so this should only be done
+ * when the application goes away.
+ */
+void
+gtk_play_frame_cache_free (GtkPlayFrameCache * cache)
+{
+  RefillJob *job = g_slice_new0 (RefillJob);
+
+  g_atomic_int_inc (&cache->generation);
+  job->quit = TRUE;
+  g_async_queue_push (cache->jobs, job);
+  g_thread_join (cache->thread);
+  g_async_queue_unref (cache->jobs);
+
+  if (cache->filled_id)
+    g_source_remove (cache->filled_id);
+
+  clear_frames (cache);
+  g_free (cache->uri);
+  g_mutex_clear (&cache->lock);
+  g_free (cache);
+}
+
+/**
+ * gtk_play_frame_cache_reset:
+ * @cache: the frame cache
+ * @uri: (allow-none): the media the following lookups are about
+ * @max_width: largest width of the cached frames, or 0
+ * @max_height: largest height of the cached frames, or 0
+ *
+ * Drops all frames, e.g. because the pipeline moved on by itself.
+ */
+void
+gtk_play_frame_cache_reset (GtkPlayFrameCache * cache, const gchar * uri,
+    gint max_width, gint max_height)
+{
+  g_mutex_lock (&cache->lock);
+  g_atomic_int_inc (&cache->generation);
+  cache->refilling = FALSE;
+  clear_frames (cache);
+  g_free (cache->uri);
+  cache->uri = g_strdup (uri);
+  cache->max_width = max_width;
+  cache->max_height = max_height;
+  g_mutex_unlock (&cache->lock);
+}
+
+/* with the lock */
+static GList *
+find_frame (GtkPlayFrameCache * self, GstClockTime position)
+{
+  GList *l;
+
+  for (l = self->frames.tail; l; l = l->prev) {
+    CachedFrame *frame = l->data;
+
+    if (frame->position == position)
+      return l;
+    if (frame->position < position)
+      break;
+  }
+
+  return NULL;
+}
+
+/**
+ * gtk_play_frame_cache_lookup_before:
+ * @cache: the frame cache
+ * @position: the frame currently shown
+ * @frame_position: (out): position of the returned frame
+ * @pending: (out) (allow-none): if a refill that might provide the frame
+ *   is in progress
+ *
+ * Without a cached frame right before @position the group of pictures
+ * before it is decoded in the background, the filled callback is called
+ * once that is done.
+ *
+ * Returns: (transfer full) (nullable): the frame right before @position
+ */
+cairo_surface_t *
+gtk_play_frame_cache_lookup_before (GtkPlayFrameCache * cache,
+    GstClockTime position, GstClockTime * frame_position, gboolean * pending)
+{
+  cairo_surface_t *surface = NULL;
+  CachedFrame *first;
+  GList *l = NULL;
+
+  g_mutex_lock (&cache->lock);
+
+  first = g_queue_peek_head (&cache->frames);
+  if (first && first->position < position) {
+    if (position == cache->end)
+      l = cache->frames.tail;
+    else if ((l = find_frame (cache, position)))
+      l = l->prev;
+  }
+
+  if (l) {
+    CachedFrame *frame = l->data;
+    guint index = g_queue_link_index (&cache->frames, l);
+
+    surface = cairo_surface_reference (frame->surface);
+    *frame_position = frame->position;
+
+    if (index < PREFETCH_FRAMES && first->position != cache->start)
+      request_refill (cache, first->position);
+  } else if (position != cache->start) {
+    /* not connected to what is cached, start over */
+    if (first && first->position != position) {
+      g_atomic_int_inc (&cache->generation);
+      cache->refilling = FALSE;
+      clear_frames (cache);
+    }
+    request_refill (cache, position);
+  }
+
+  if (pending)
+    *pending = cache->refilling;
+
+  g_mutex_unlock (&cache->lock);
+
+  return surface;
+}
+
+/**
+ * gtk_play_frame_cache_lookup_after:
+ * @cache: the frame cache
+ * @position: a cached frame
+ * @frame_position: (out): position of the returned frame
+ *
+ * Returns: (transfer full) (nullable): the cached frame right after
+ *   @position, %NULL if that is the end of the cache
+ */
+cairo_surface_t *
+gtk_play_frame_cache_lookup_after (GtkPlayFrameCache * cache,
+    GstClockTime position, GstClockTime * frame_position)
+{
+  cairo_surface_t *surface = NULL;
+  GList *l;
+
+  g_mutex_lock (&cache->lock);
+  l = find_frame (cache, position);
+  if (l && l->next) {
+    CachedFrame *frame = l->next->data;
+
+    surface = cairo_surface_reference (frame->surface);
+    *frame_position = frame->position;
+  }
+  g_mutex_unlock (&cache->lock);
+
+  return surface;
+}
+
+/**
+ * gtk_play_frame_cache_get_end:
+ * @cache: the frame cache
+ *
+ * Returns: the position of the frame right after the last cached one
+ */
+GstClockTime
+gtk_play_frame_cache_get_end (GtkPlayFrameCache * cache)
+{
+  GstClockTime end;
+
+  g_mutex_lock (&cache->lock);
+  end = cache->end;
+  g_mutex_unlock (&cache->lock);
+
+  return end;
+}
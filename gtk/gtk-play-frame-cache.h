@@ -0,0 +1,49 @@
+/* GStreamer
+ *
+ * Copyright (C) 2016 GStreamer developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __GTK_PLAY_FRAME_CACHE_H__
+#define __GTK_PLAY_FRAME_CACHE_H__
+
+#include <gst/gst.h>
+#include <cairo.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GtkPlayFrameCache GtkPlayFrameCache;
+
+typedef void (*GtkPlayFrameCacheFilledFunc) (GtkPlayFrameCache * cache,
+    gpointer user_data);
+
+GtkPlayFrameCache * gtk_play_frame_cache_new (GtkPlayFrameCacheFilledFunc filled,
+    gpointer user_data);
+void gtk_play_frame_cache_free (GtkPlayFrameCache * cache);
+
+void gtk_play_frame_cache_reset (GtkPlayFrameCache * cache, const gchar * uri,
+    gint max_width, gint max_height);
+
+cairo_surface_t * gtk_play_frame_cache_lookup_before (GtkPlayFrameCache * cache,
+    GstClockTime position, GstClockTime * frame_position, gboolean * pending);
+cairo_surface_t * gtk_play_frame_cache_lookup_after (GtkPlayFrameCache * cache,
+    GstClockTime position, GstClockTime * frame_position);
+GstClockTime gtk_play_frame_cache_get_end (GtkPlayFrameCache * cache);
+
+G_END_DECLS
+
+#endif /* __GTK_PLAY_FRAME_CACHE_H__ */
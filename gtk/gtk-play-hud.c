@@ -0,0 +1,742 @@
+/* GStreamer
+ *
+ * Copyright (C) 2016 GStreamer developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#include <gst/gst.h>
+
+#ifdef G_OS_UNIX
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+#include "gtk-play-hud.h"
+
+#if defined (G_OS_UNIX) && defined (_POSIX_THREAD_CPUTIME) && \
+    (_POSIX_THREAD_CPUTIME >= 0)
+#define HAVE_THREAD_CPUTIME 1
+#endif
+
+/* the overlay is only a diagnostic aid, refreshing it once per second keeps
+ * its own cost out of the numbers it shows */
+#define HUD_REFRESH_INTERVAL 1000
+
+static const gchar hud_css[] =
+    "* {\n"
+    "  background-color: rgba(0,0,0,0.6);\n"
+    "  color: #ffffff;\n"
+    "  font-size: 10px;\n"
+    "  padding: 6px;\n"
+    "}\n";
+
+typedef struct
+{
+  GstPad *pad;
+  gulong id;
+} HudProbe;
+
+typedef struct
+{
+  gchar *name;
+#ifdef HAVE_THREAD_CPUTIME
+  clockid_t clock_id;
+#endif
+  gint64 last_cpu_time;
+} HudThread;
+
+struct _GtkPlayHud
+{
+  GstElement *pipeline;
+  GstBus *bus;
+  GObject *renderer;
+
+  gulong element_added_id;
+  gulong element_removed_id;
+  gulong source_setup_id;
+  gulong qos_id;
+  gulong stream_status_id;
+
+  GtkWidget *label;
+  guint refresh_id;
+  GstPlayerLooper *looper;
+  GstPlayerLowLatency *low_latency;
+  GstPlayerNetSync *net_sync;
+
+  GMutex lock;
+
+  /* protected by lock, updated from the streaming threads */
+  GstElement *video_sink;
+  GstElement *audio_sink;
+  GList *queues;
+  GList *probes;
+  GHashTable *threads;
+
+  guint64 decoded_frames;
+  guint64 src_bytes;
+  guint64 qos_late;
+  guint64 decoder_dropped;
+  gint64 qos_jitter;
+  gdouble qos_proportion;
+
+  /* only touched from the main thread */
+  guint64 last_decoded_frames;
+  guint64 last_rendered_frames;
+  guint64 last_src_bytes;
+  gint64 last_sample_time;
+};
+
+static void
+hud_thread_free (HudThread * thread)
+{
+  g_free (thread->name);
+  g_free (thread);
+}
+
+static void
+hud_probe_free (HudProbe * probe)
+{
+  gst_pad_remove_probe (probe->pad, probe->id);
+  gst_object_unref (probe->pad);
+  g_free (probe);
+}
+
+static gboolean
+element_has_klass (GstElement * element, const gchar * klass1,
+    const gchar * klass2)
+{
+  GstElementFactory *factory;
+  const gchar *klass;
+
+  factory = gst_element_get_factory (element);
+  if (!factory)
+    return FALSE;
+
+  klass = gst_element_factory_get_metadata (factory,
+      GST_ELEMENT_METADATA_KLASS);
+
+  return klass && strstr (klass, klass1) && strstr (klass, klass2);
+}
+
+static guint64
+probe_info_get_size (GstPadProbeInfo * info, guint * n_buffers)
+{
+  guint64 size = 0;
+
+  if (GST_PAD_PROBE_INFO_TYPE (info) & GST_PAD_PROBE_TYPE_BUFFER_LIST) {
+    GstBufferList *list = GST_PAD_PROBE_INFO_BUFFER_LIST (info);
+    guint i, len = gst_buffer_list_length (list);
+
+    for (i = 0; i < len; i++)
+      size += gst_buffer_get_size (gst_buffer_list_get (list, i));
+    *n_buffers = len;
+  } else {
+    size = gst_buffer_get_size (GST_PAD_PROBE_INFO_BUFFER (info));
+    *n_buffers = 1;
+  }
+
+  return size;
+}
+
+static GstPadProbeReturn
+decoder_probe_cb (GstPad * pad, GstPadProbeInfo * info, GtkPlayHud * hud)
+{
+  guint n_buffers;
+
+  probe_info_get_size (info, &n_buffers);
+
+  g_mutex_lock (&hud->lock);
+  hud->decoded_frames += n_buffers;
+  g_mutex_unlock (&hud->lock);
+
+  return GST_PAD_PROBE_OK;
+}
+
+static GstPadProbeReturn
+source_probe_cb (GstPad * pad, GstPadProbeInfo * info, GtkPlayHud * hud)
+{
+  guint n_buffers;
+  guint64 size;
+
+  size = probe_info_get_size (info, &n_buffers);
+
+  g_mutex_lock (&hud->lock);
+  hud->src_bytes += size;
+  g_mutex_unlock (&hud->lock);
+
+  return GST_PAD_PROBE_OK;
+}
+
+static void
+hud_add_probe (GtkPlayHud * hud, GstElement * element,
+    const gchar * pad_name, GstPadProbeCallback callback)
+{
+  HudProbe *probe;
+  GstPad *pad;
+
+  pad = gst_element_get_static_pad (element, pad_name);
+  if (!pad)
+    return;
+
+  probe = g_new0 (HudProbe, 1);
+  probe->pad = pad;
+  probe->id = gst_pad_add_probe (pad,
+      GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_BUFFER_LIST, callback,
+      hud, NULL);
+
+  g_mutex_lock (&hud->lock);
+  hud->probes = g_list_prepend (hud->probes, probe);
+  g_mutex_unlock (&hud->lock);
+}
+
+static void
+source_setup_cb (GstElement * playbin, GstElement * source, GtkPlayHud * hud)
+{
+  hud_add_probe (hud, source, "src", (GstPadProbeCallback) source_probe_cb);
+}
+
+static void
+deep_element_added_cb (GstBin * bin, GstBin * sub_bin, GstElement * element,
+    GtkPlayHud * hud)
+{
+  GstElementFactory *factory;
+  const gchar *name;
+
+  factory = gst_element_get_factory (element);
+  name = factory ? GST_OBJECT_NAME (factory) : NULL;
+
+  if (g_strcmp0 (name, "queue") == 0 || g_strcmp0 (name, "queue2") == 0) {
+    g_mutex_lock (&hud->lock);
+    hud->queues = g_list_prepend (hud->queues, gst_object_ref (element));
+    g_mutex_unlock (&hud->lock);
+  } else if (element_has_klass (element, "Decoder", "Video")) {
+    hud_add_probe (hud, element, "src",
+        (GstPadProbeCallback) decoder_probe_cb);
+  } else if (!GST_IS_BIN (element)
+      && GST_OBJECT_FLAG_IS_SET (element, GST_ELEMENT_FLAG_SINK)
+      && g_object_class_find_property (G_OBJECT_GET_CLASS (element),
+          "stats")) {
+    /* only real GstBaseSinks have the stats property, this skips over
+     * wrapper bins like glsinkbin */
+    g_mutex_lock (&hud->lock);
+    if (element_has_klass (element, "Sink", "Video"))
+      gst_object_replace ((GstObject **) & hud->video_sink,
+          GST_OBJECT (element));
+    else if (element_has_klass (element, "Sink", "Audio"))
+      gst_object_replace ((GstObject **) & hud->audio_sink,
+          GST_OBJECT (element));
+    g_mutex_unlock (&hud->lock);
+  }
+}
+
+static void
+deep_element_removed_cb (GstBin * bin, GstBin * sub_bin,
+    GstElement * element, GtkPlayHud * hud)
+{
+  GList *l, *next;
+
+  g_mutex_lock (&hud->lock);
+  if (hud->video_sink == element)
+    gst_object_replace ((GstObject **) & hud->video_sink, NULL);
+  if (hud->audio_sink == element)
+    gst_object_replace ((GstObject **) & hud->audio_sink, NULL);
+
+  l = g_list_find (hud->queues, element);
+  if (l) {
+    gst_object_unref (l->data);
+    hud->queues = g_list_delete_link (hud->queues, l);
+  }
+
+  for (l = hud->probes; l; l = next) {
+    HudProbe *probe = l->data;
+
+    next = l->next;
+    if (GST_OBJECT_PARENT (probe->pad) == GST_OBJECT_CAST (element)) {
+      hud_probe_free (probe);
+      hud->probes = g_list_delete_link (hud->probes, l);
+    }
+  }
+  g_mutex_unlock (&hud->lock);
+}
+
+static void
+qos_cb (GstBus * bus, GstMessage * msg, GtkPlayHud * hud)
+{
+  GstFormat format;
+  guint64 processed, dropped;
+  gint64 jitter;
+  gdouble proportion;
+  gint quality;
+
+  gst_message_parse_qos_values (msg, &jitter, &proportion, &quality);
+  gst_message_parse_qos_stats (msg, &format, &processed, &dropped);
+
+  g_mutex_lock (&hud->lock);
+  if (hud->video_sink
+      && GST_MESSAGE_SRC (msg) == GST_OBJECT (hud->video_sink)) {
+    hud->qos_late++;
+    hud->qos_jitter = jitter;
+    hud->qos_proportion = proportion;
+  } else if (format == GST_FORMAT_BUFFERS && dropped != -1) {
+    /* decoders skipping frames because of QoS */
+    hud->decoder_dropped = dropped;
+  }
+  g_mutex_unlock (&hud->lock);
+}
+
+/* called synchronously from the thread the message is about, which is the
+ * only place we can get at its CPU clock */
+static void
+stream_status_cb (GstBus * bus, GstMessage * msg, GtkPlayHud * hud)
+{
+#ifdef HAVE_THREAD_CPUTIME
+  GstStreamStatusType type;
+  GstElement *owner;
+  const GValue *val;
+  gpointer task;
+
+  gst_message_parse_stream_status (msg, &type, &owner);
+
+  val = gst_message_get_stream_status_object (msg);
+  if (!val || !G_VALUE_HOLDS (val, GST_TYPE_TASK))
+    return;
+  task = g_value_get_object (val);
+
+  if (type == GST_STREAM_STATUS_TYPE_ENTER) {
+    HudThread *thread;
+    clockid_t clock_id;
+
+    if (pthread_getcpuclockid (pthread_self (), &clock_id) != 0)
+      return;
+
+    thread = g_new0 (HudThread, 1);
+    thread->clock_id = clock_id;
+    thread->last_cpu_time = -1;
+    thread->name = g_strdup_printf ("%s:%s", GST_ELEMENT_NAME (owner),
+        GST_MESSAGE_SRC_NAME (msg));
+
+    g_mutex_lock (&hud->lock);
+    g_hash_table_replace (hud->threads, task, thread);
+    g_mutex_unlock (&hud->lock);
+  } else if (type == GST_STREAM_STATUS_TYPE_LEAVE) {
+    g_mutex_lock (&hud->lock);
+    g_hash_table_remove (hud->threads, task);
+    g_mutex_unlock (&hud->lock);
+  }
+#endif
+}
+
+static gdouble
+queue_get_fill_level (GstElement * queue)
+{
+  guint cur_buffers = 0, max_buffers = 0, cur_bytes = 0, max_bytes = 0;
+  guint64 cur_time = 0, max_time = 0;
+  gdouble level = 0.0;
+
+  g_object_get (queue,
+      "current-level-buffers", &cur_buffers, "max-size-buffers", &max_buffers,
+      "current-level-bytes", &cur_bytes, "max-size-bytes", &max_bytes,
+      "current-level-time", &cur_time, "max-size-time", &max_time, NULL);
+
+  if (max_buffers)
+    level = MAX (level, (gdouble) cur_buffers / max_buffers);
+  if (max_bytes)
+    level = MAX (level, (gdouble) cur_bytes / max_bytes);
+  if (max_time)
+    level = MAX (level, (gdouble) cur_time / max_time);
+
+  return level * 100.0;
+}
+
+/* The sinks answer position queries with what they are outputting right
+ * now: the audio sink from the samples the device played, the video sink
+ * from the clock but never past the last frame it rendered. Their
+ * difference is how far the picture runs ahead of the sound */
+static gboolean
+hud_get_av_offset (GstElement * video_sink, GstElement * audio_sink,
+    GstClockTimeDiff * offset)
+{
+  gint64 video_position, audio_position;
+
+  if (!video_sink || !audio_sink)
+    return FALSE;
+
+  if (!gst_element_query_position (video_sink, GST_FORMAT_TIME,
+          &video_position)
+      || !gst_element_query_position (audio_sink, GST_FORMAT_TIME,
+          &audio_position))
+    return FALSE;
+
+  *offset = GST_CLOCK_DIFF (audio_position, video_position);
+
+  return TRUE;
+}
+
+static void
+hud_append_threads (GtkPlayHud * hud, GString * text, gdouble elapsed)
+{
+#ifdef HAVE_THREAD_CPUTIME
+  GHashTableIter iter;
+  HudThread *thread;
+
+  g_hash_table_iter_init (&iter, hud->threads);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *) & thread)) {
+    struct timespec ts;
+    gint64 cpu_time;
+    gchar *name;
+
+    if (clock_gettime (thread->clock_id, &ts) != 0)
+      continue;
+
+    cpu_time = (gint64) ts.tv_sec * GST_SECOND + ts.tv_nsec;
+    name = g_markup_escape_text (thread->name, -1);
+    if (thread->last_cpu_time >= 0 && elapsed > 0.0) {
+      g_string_append_printf (text, "\ncpu      %5.1f%%  %s",
+          100.0 * (cpu_time - thread->last_cpu_time) / (elapsed * GST_SECOND),
+          name);
+    } else {
+      g_string_append_printf (text, "\ncpu         -    %s", name);
+    }
+    g_free (name);
+    thread->last_cpu_time = cpu_time;
+  }
+#endif
+}
+
+static gboolean
+hud_refresh_cb (GtkPlayHud * hud)
+{
+  GString *text;
+  GList *queues, *l;
+  GstElement *video_sink = NULL, *audio_sink = NULL;
+  guint64 decoded, bytes, late, decoder_dropped;
+  guint64 rendered = 0, dropped = 0;
+  GstClockTimeDiff av_offset = 0;
+  gboolean have_av_offset;
+  gint64 jitter, now;
+  gdouble proportion, elapsed = 0.0;
+
+  now = g_get_monotonic_time ();
+  if (hud->last_sample_time)
+    elapsed = (now - hud->last_sample_time) / (gdouble) G_USEC_PER_SEC;
+
+  text = g_string_new ("<tt>");
+
+  g_mutex_lock (&hud->lock);
+  if (hud->video_sink)
+    video_sink = gst_object_ref (hud->video_sink);
+  if (hud->audio_sink)
+    audio_sink = gst_object_ref (hud->audio_sink);
+  queues = g_list_copy_deep (hud->queues, (GCopyFunc) gst_object_ref, NULL);
+  decoded = hud->decoded_frames;
+  bytes = hud->src_bytes;
+  late = hud->qos_late;
+  decoder_dropped = hud->decoder_dropped;
+  jitter = hud->qos_jitter;
+  proportion = hud->qos_proportion;
+  g_mutex_unlock (&hud->lock);
+
+  have_av_offset = hud_get_av_offset (video_sink, audio_sink, &av_offset);
+  if (audio_sink)
+    gst_object_unref (audio_sink);
+
+  if (video_sink) {
+    GstStructure *stats = NULL;
+
+    g_object_get (video_sink, "stats", &stats, NULL);
+    if (stats) {
+      gst_structure_get_uint64 (stats, "rendered", &rendered);
+      gst_structure_get_uint64 (stats, "dropped", &dropped);
+      gst_structure_free (stats);
+    }
+    gst_object_unref (video_sink);
+  }
+
+  /* counters restart whenever the sink or source gets replaced */
+  if (rendered < hud->last_rendered_frames)
+    hud->last_rendered_frames = 0;
+  if (decoded < hud->last_decoded_frames)
+    hud->last_decoded_frames = 0;
+  if (bytes < hud->last_src_bytes)
+    hud->last_src_bytes = 0;
+
+  if (elapsed > 0.0) {
+    g_string_append_printf (text,
+        "decode   %5.1f fps\n"
+        "render   %5.1f fps\n"
+        "bitrate  %5.2f Mbit/s",
+        (decoded - hud->last_decoded_frames) / elapsed,
+        (rendered - hud->last_rendered_frames) / elapsed,
+        (bytes - hud->last_src_bytes) * 8 / elapsed / 1000000.0);
+  } else {
+    g_string_append (text,
+        "decode       - fps\n" "render       - fps\n" "bitrate      - Mbit/s");
+  }
+
+  g_string_append_printf (text,
+      "\ndropped  %" G_GUINT64_FORMAT " sink, %" G_GUINT64_FORMAT " decoder"
+      "\nlate     %" G_GUINT64_FORMAT " (last %+.1f ms late, proportion %.2f)",
+      dropped, decoder_dropped, late, (gdouble) jitter / GST_MSECOND,
+      proportion);
+
+  if (have_av_offset)
+    g_string_append_printf (text, "\na/v      %+.1f ms",
+        (gdouble) av_offset / GST_MSECOND);
+  else
+    g_string_append (text, "\na/v          - ms");
+
+  for (l = queues; l; l = l->next) {
+    gchar *name = g_markup_escape_text (GST_ELEMENT_NAME (l->data), -1);
+
+    g_string_append_printf (text, "\nqueue    %5.1f%%  %s",
+        queue_get_fill_level (l->data), name);
+    g_free (name);
+  }
+  g_list_free_full (queues, gst_object_unref);
+
+  if (hud->renderer) {
+    GstStructure *stats = NULL;
+    guint64 skipped = 0, dropped_early = 0;
+    gint64 mean_delay = 0, jitter = 0;
+
+    g_object_get (hud->renderer, "stats", &stats, NULL);
+    if (stats) {
+      gst_structure_get (stats, "skipped", G_TYPE_UINT64, &skipped,
+          "dropped-early", G_TYPE_UINT64, &dropped_early,
+          "mean-delay", G_TYPE_INT64, &mean_delay,
+          "jitter", G_TYPE_INT64, &jitter, NULL);
+      gst_structure_free (stats);
+    }
+
+    g_string_append_printf (text,
+        "\npacing   %+.1f ms, jitter %.1f ms, skipped %" G_GUINT64_FORMAT
+        ", early drops %" G_GUINT64_FORMAT,
+        (gdouble) mean_delay / GST_MSECOND, (gdouble) jitter / GST_MSECOND,
+        skipped, dropped_early);
+  }
+
+  if (hud->looper && gst_player_looper_get_enabled (hud->looper)) {
+    GstPlayerLooperStats stats;
+
+    gst_player_looper_get_stats (hud->looper, &stats);
+    if (stats.last_jitter != GST_CLOCK_STIME_NONE)
+      g_string_append_printf (text,
+          "\nloop     %u, boundary %+.1f ms (%+.1f .. %+.1f ms)", stats.loops,
+          (gdouble) stats.last_jitter / GST_MSECOND,
+          (gdouble) stats.min_jitter / GST_MSECOND,
+          (gdouble) stats.max_jitter / GST_MSECOND);
+    else
+      g_string_append_printf (text, "\nloop     %u", stats.loops);
+  }
+
+  if (hud->low_latency) {
+    GstPlayerLatencyStats stats;
+
+    if (gst_player_low_latency_get_stats (hud->low_latency, &stats))
+      g_string_append_printf (text,
+          "\nlatency  p50 %.1f ms, p95 %.1f ms, p99 %.1f ms, max %.1f ms",
+          (gdouble) stats.p50 / GST_MSECOND, (gdouble) stats.p95 / GST_MSECOND,
+          (gdouble) stats.p99 / GST_MSECOND, (gdouble) stats.max / GST_MSECOND);
+  }
+
+  if (hud->net_sync) {
+    GstClockTimeDiff skew;
+    guint peers;
+
+    if (gst_player_net_sync_get_skew (hud->net_sync, &skew, &peers))
+      g_string_append_printf (text, "\nsync     skew %+.1f ms, %u peer%s",
+          (gdouble) skew / GST_MSECOND, peers, peers == 1 ? "" : "s");
+    else
+      g_string_append (text, "\nsync     waiting for peers");
+  }
+
+  g_mutex_lock (&hud->lock);
+  hud_append_threads (hud, text, elapsed);
+  g_mutex_unlock (&hud->lock);
+
+  g_string_append (text, "</tt>");
+  gtk_label_set_markup (GTK_LABEL (hud->label), text->str);
+  g_string_free (text, TRUE);
+
+  hud->last_decoded_frames = decoded;
+  hud->last_rendered_frames = rendered;
+  hud->last_src_bytes = bytes;
+  hud->last_sample_time = now;
+
+  return G_SOURCE_CONTINUE;
+}
+
+GtkPlayHud *
+gtk_play_hud_new (GstPlayer * player)
+{
+  GtkPlayHud *hud;
+  GtkCssProvider *provider;
+
+  g_return_val_if_fail (GST_IS_PLAYER (player), NULL);
+
+  hud = g_new0 (GtkPlayHud, 1);
+  g_mutex_init (&hud->lock);
+  hud->threads = g_hash_table_new_full (NULL, NULL, NULL,
+      (GDestroyNotify) hud_thread_free);
+
+  hud->label = g_object_ref_sink (gtk_label_new (NULL));
+  gtk_widget_set_halign (hud->label, GTK_ALIGN_START);
+  gtk_widget_set_valign (hud->label, GTK_ALIGN_START);
+  gtk_widget_set_margin_start (hud->label, 10);
+  gtk_widget_set_margin_top (hud->label, 10);
+  gtk_widget_set_no_show_all (hud->label, TRUE);
+
+  provider = gtk_css_provider_new ();
+  gtk_css_provider_load_from_data (provider, hud_css, -1, NULL);
+  gtk_style_context_add_provider (gtk_widget_get_style_context (hud->label),
+      GTK_STYLE_PROVIDER (provider), G_MAXUINT);
+  g_object_unref (provider);
+
+  /* renderers providing frame pacing statistics */
+  g_object_get (player, "video-renderer", &hud->renderer, NULL);
+  if (hud->renderer
+      && !g_object_class_find_property (G_OBJECT_GET_CLASS (hud->renderer),
+          "stats"))
+    g_clear_object (&hud->renderer);
+
+  hud->pipeline = gst_player_get_pipeline (player);
+  hud->element_added_id = g_signal_connect (hud->pipeline,
+      "deep-element-added", G_CALLBACK (deep_element_added_cb), hud);
+  hud->element_removed_id = g_signal_connect (hud->pipeline,
+      "deep-element-removed", G_CALLBACK (deep_element_removed_cb), hud);
+  hud->source_setup_id = g_signal_connect (hud->pipeline, "source-setup",
+      G_CALLBACK (source_setup_cb), hud);
+
+  /* GstPlayer already has a signal watch on its bus */
+  hud->bus = gst_element_get_bus (hud->pipeline);
+  hud->qos_id = g_signal_connect (hud->bus, "message::qos",
+      G_CALLBACK (qos_cb), hud);
+  gst_bus_enable_sync_message_emission (hud->bus);
+  hud->stream_status_id = g_signal_connect (hud->bus,
+      "sync-message::stream-status", G_CALLBACK (stream_status_cb), hud);
+
+  return hud;
+}
+
+void
+gtk_play_hud_free (GtkPlayHud * hud)
+{
+  g_return_if_fail (hud != NULL);
+
+  if (hud->refresh_id)
+    g_source_remove (hud->refresh_id);
+
+  g_signal_handler_disconnect (hud->bus, hud->qos_id);
+  g_signal_handler_disconnect (hud->bus, hud->stream_status_id);
+  gst_bus_disable_sync_message_emission (hud->bus);
+  gst_object_unref (hud->bus);
+
+  g_signal_handler_disconnect (hud->pipeline, hud->element_added_id);
+  g_signal_handler_disconnect (hud->pipeline, hud->element_removed_id);
+  g_signal_handler_disconnect (hud->pipeline, hud->source_setup_id);
+  gst_object_unref (hud->pipeline);
+  if (hud->renderer)
+    g_object_unref (hud->renderer);
+
+  g_list_free_full (hud->probes, (GDestroyNotify) hud_probe_free);
+  g_list_free_full (hud->queues, gst_object_unref);
+  if (hud->video_sink)
+    gst_object_unref (hud->video_sink);
+  if (hud->audio_sink)
+    gst_object_unref (hud->audio_sink);
+  g_hash_table_unref (hud->threads);
+  g_mutex_clear (&hud->lock);
+
+  g_object_unref (hud->label);
+  g_free (hud);
+}
+
+GtkWidget *
+gtk_play_hud_get_widget (GtkPlayHud * hud)
+{
+  g_return_val_if_fail (hud != NULL, NULL);
+
+  return hud->label;
+}
+
+void
+gtk_play_hud_set_visible (GtkPlayHud * hud, gboolean visible)
+{
+  g_return_if_fail (hud != NULL);
+
+  if (visible == gtk_play_hud_get_visible (hud))
+    return;
+
+  if (visible) {
+    /* first refresh only primes the counters */
+    hud->last_sample_time = 0;
+    hud_refresh_cb (hud);
+    hud->refresh_id = g_timeout_add (HUD_REFRESH_INTERVAL,
+        (GSourceFunc) hud_refresh_cb, hud);
+    gtk_widget_show (hud->label);
+  } else {
+    g_source_remove (hud->refresh_id);
+    hud->refresh_id = 0;
+    gtk_widget_hide (hud->label);
+  }
+}
+
+gboolean
+gtk_play_hud_get_visible (GtkPlayHud * hud)
+{
+  g_return_val_if_fail (hud != NULL, FALSE);
+
+  return hud->refresh_id != 0;
+}
+
+/* also shows the loop boundary statistics, @looper has to stay around
+ * until the HUD goes away */
+void
+gtk_play_hud_set_looper (GtkPlayHud * hud, GstPlayerLooper * looper)
+{
+  g_return_if_fail (hud != NULL);
+
+  hud->looper = looper;
+}
+
+/* also shows the measured end-to-end latency, @low_latency has to stay
+ * around until the HUD goes away */
+void
+gtk_play_hud_set_low_latency (GtkPlayHud * hud,
+    GstPlayerLowLatency * low_latency)
+{
+  g_return_if_fail (hud != NULL);
+
+  hud->low_latency = low_latency;
+}
+
+/* also shows the skew to the other synchronised players, @net_sync has
+ * to stay around until the HUD goes away */
+void
+gtk_play_hud_set_net_sync (GtkPlayHud * hud, GstPlayerNetSync * net_sync)
+{
+  g_return_if_fail (hud != NULL);
+
+  hud->net_sync = net_sync;
+}
@@ -0,0 +1,50 @@
+/* GStreamer
+ *
+ * Copyright (C) 2016 GStreamer developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __GTK_PLAY_HUD_H__
+#define __GTK_PLAY_HUD_H__
+
+#include <gst/player/player.h>
+#include <gtk/gtk.h>
+
+#include "gst-player-looper.h"
+#include "gst-player-low-latency.h"
+#include "gst-player-net-sync.h"
+
+G_BEGIN_DECLS
+
+typedef struct _GtkPlayHud GtkPlayHud;
+
+GtkPlayHud * gtk_play_hud_new (GstPlayer * player);
+void gtk_play_hud_free (GtkPlayHud * hud);
+
+GtkWidget * gtk_play_hud_get_widget (GtkPlayHud * hud);
+
+void gtk_play_hud_set_visible (GtkPlayHud * hud, gboolean visible);
+gboolean gtk_play_hud_get_visible (GtkPlayHud * hud);
+
+void gtk_play_hud_set_looper (GtkPlayHud * hud, GstPlayerLooper * looper);
+void gtk_play_hud_set_low_latency (GtkPlayHud * hud,
+    GstPlayerLowLatency * low_latency);
+void gtk_play_hud_set_net_sync (GtkPlayHud * hud, GstPlayerNetSync * net_sync);
+
+G_END_DECLS
+
+#endif /* __GTK_PLAY_HUD_H__ */
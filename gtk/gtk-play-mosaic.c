@@ -0,0 +1,535 @@
+/* GStreamer
+ *
+ * Copyright (C) 2016 GStreamer developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "gtk-play-mosaic.h"
+#include "gtk-play-reaper.h"
+
+/* Plays several URIs at once in a grid, blended into a single frame by
+ * software compositors and shown by a single gtksink:
+ *
+ *   uridecodebin ! queue ! videoscale ! videoconvert ! capsfilter ! row
+ *   ...                                                             compositor
+ *   row compositor ! queue ! compositor ! capsfilter ! gtksink
+ *
+ * Every input is scaled and converted to the final format and tile size
+ * before it reaches a compositor, on its own streaming thread behind the
+ * queue. All that is left for the compositors is copying opaque tiles,
+ * and with more than one row and column every row is blended on the
+ * thread of its own compositor, the last one only stacks the rows. */
+
+/* cairo's native 32 bit RGB layout, which gtksink can use without another
+ * conversion */
+#if G_BYTE_ORDER == G_LITTLE_ENDIAN
+#define MOSAIC_FORMAT "BGRx"
+#else
+#define MOSAIC_FORMAT "xRGB"
+#endif
+
+/* until the widget got its size */
+#define DEFAULT_WIDTH 1280
+#define DEFAULT_HEIGHT 720
+
+/* how long the widget size has to be stable before renegotiating */
+#define RESIZE_DEBOUNCE_INTERVAL 200
+
+typedef struct
+{
+  GstElement *decodebin;
+  GstElement *queue;
+  GstElement *capsfilter;
+  /* request pad on the row or the final compositor */
+  GstPad *mixer_pad;
+  guint row, column;
+} MosaicTile;
+
+struct _GtkPlayMosaic
+{
+  GstElement *pipeline;
+  GstElement *mixer;
+  GstElement *sink;
+  GtkWidget *widget;
+
+  /* request pads of the row compositors on the final one, by row. Empty
+   * if the tiles are linked to the final compositor directly */
+  GPtrArray *row_pads;
+  MosaicTile *tiles;
+  guint n_tiles;
+  guint rows, columns;
+
+  gint width, height;
+  gint tile_width, tile_height;
+  guint resize_timeout_id;
+  guint bus_watch_id;
+  gboolean playing;
+};
+
+static GstElement *
+make_element (GstPipeline * pipeline, const gchar * factory)
+{
+  GstElement *element = gst_element_factory_make (factory, NULL);
+
+  if (!element) {
+    g_warning ("Mosaic: element '%s' not available", factory);
+    return NULL;
+  }
+
+  gst_bin_add (GST_BIN (pipeline), element);
+
+  return element;
+}
+
+static GstElement *
+make_mixer (GstPipeline * pipeline)
+{
+  GstElement *mixer = make_element (pipeline, "compositor");
+
+  /* gaps between letterboxed tiles should be black, not the default
+   * checker pattern */
+  if (mixer)
+    g_object_set (mixer, "background", 1 /* black */ , NULL);
+
+  return mixer;
+}
+
+static void
+update_layout (GtkPlayMosaic * mosaic)
+{
+  GstCaps *caps;
+  gint tile_width, tile_height;
+  guint i;
+
+  /* chroma subsampled formats further upstream want even sizes */
+  tile_width = MAX ((mosaic->width / (gint) mosaic->columns) & ~1, 2);
+  tile_height = MAX ((mosaic->height / (gint) mosaic->rows) & ~1, 2);
+
+  if (tile_width == mosaic->tile_width && tile_height == mosaic->tile_height)
+    return;
+
+  mosaic->tile_width = tile_width;
+  mosaic->tile_height = tile_height;
+
+  /* videoscale keeps the aspect ratio by adding borders, so every input
+   * is letterboxed into its tile */
+  caps = gst_caps_new_simple ("video/x-raw",
+      "format", G_TYPE_STRING, MOSAIC_FORMAT,
+      "width", G_TYPE_INT, tile_width,
+      "height", G_TYPE_INT, tile_height,
+      "pixel-aspect-ratio", GST_TYPE_FRACTION, 1, 1, NULL);
+
+  for (i = 0; i < mosaic->n_tiles; i++) {
+    MosaicTile *tile = &mosaic->tiles[i];
+
+    if (mosaic->row_pads->len > 0) {
+      g_object_set (tile->mixer_pad, "xpos", tile->column * tile_width,
+          "ypos", 0, NULL);
+    } else {
+      g_object_set (tile->mixer_pad, "xpos", tile->column * tile_width,
+          "ypos", tile->row * tile_height, NULL);
+    }
+    g_object_set (tile->capsfilter, "caps", caps, NULL);
+  }
+
+  for (i = 0; i < mosaic->row_pads->len; i++)
+    g_object_set (g_ptr_array_index (mosaic->row_pads, i), "xpos", 0,
+        "ypos", i * tile_height, NULL);
+
+  gst_caps_unref (caps);
+}
+
+static gboolean
+resize_timeout_cb (GtkPlayMosaic * mosaic)
+{
+  mosaic->resize_timeout_id = 0;
+  update_layout (mosaic);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+widget_size_allocate_cb (GtkWidget * widget, GdkRectangle * allocation,
+    GtkPlayMosaic * mosaic)
+{
+  gint scale = gtk_widget_get_scale_factor (widget);
+
+  if (allocation->width * scale == mosaic->width
+      && allocation->height * scale == mosaic->height)
+    return;
+
+  mosaic->width = allocation->width * scale;
+  mosaic->height = allocation->height * scale;
+
+  /* renegotiating all inputs is expensive, wait until resizing is over */
+  if (mosaic->resize_timeout_id)
+    g_source_remove (mosaic->resize_timeout_id);
+  mosaic->resize_timeout_id = g_timeout_add (RESIZE_DEBOUNCE_INTERVAL,
+      (GSourceFunc) resize_timeout_cb, mosaic);
+}
+
+/* Only decode what ends up in the mosaic, everything else is exposed
+ * still encoded and discarded */
+static gboolean
+autoplug_continue_cb (GstElement * decodebin, GstPad * pad, GstCaps * caps,
+    gpointer user_data)
+{
+  GstStructure *s;
+  const gchar *name;
+
+  if (gst_caps_get_size (caps) == 0)
+    return TRUE;
+
+  s = gst_caps_get_structure (caps, 0);
+  name = gst_structure_get_name (s);
+
+  if (g_str_has_prefix (name, "audio/") || g_str_has_prefix (name, "text/")
+      || g_str_has_prefix (name, "subpicture/"))
+    return FALSE;
+
+  if (gst_structure_has_name (s, "application/x-rtp"))
+    return g_strcmp0 (gst_structure_get_string (s, "media"), "video") == 0;
+
+  return TRUE;
+}
+
+static void
+discard_pad (GstElement * decodebin, GstPad * pad)
+{
+  GstElement *pipeline, *sink;
+  GstPad *sinkpad;
+
+  pipeline = GST_ELEMENT (gst_element_get_parent (decodebin));
+  sink = gst_element_factory_make ("fakesink", NULL);
+  g_object_set (sink, "sync", FALSE, "async", FALSE, NULL);
+  gst_bin_add (GST_BIN (pipeline), sink);
+  gst_element_sync_state_with_parent (sink);
+
+  sinkpad = gst_element_get_static_pad (sink, "sink");
+  gst_pad_link (pad, sinkpad);
+  gst_object_unref (sinkpad);
+  gst_object_unref (pipeline);
+}
+
+static void
+pad_added_cb (GstElement * decodebin, GstPad * pad, MosaicTile * tile)
+{
+  GstCaps *caps;
+  GstPad *sinkpad;
+  gboolean video;
+
+  caps = gst_pad_get_current_caps (pad);
+  if (!caps)
+    caps = gst_pad_query_caps (pad, NULL);
+  video = gst_caps_get_size (caps) > 0
+      && gst_structure_has_name (gst_caps_get_structure (caps, 0),
+      "video/x-raw");
+  gst_caps_unref (caps);
+
+  /* the first video stream gets the tile */
+  sinkpad = gst_element_get_static_pad (tile->queue, "sink");
+  if (!video || gst_pad_is_linked (sinkpad)
+      || GST_PAD_LINK_FAILED (gst_pad_link (pad, sinkpad)))
+    discard_pad (decodebin, pad);
+  gst_object_unref (sinkpad);
+}
+
+static void
+end_tile (MosaicTile * tile)
+{
+  GstPad *sinkpad = gst_element_get_static_pad (tile->queue, "sink");
+
+  /* the compositor would otherwise wait for it forever */
+  gst_pad_send_event (sinkpad, gst_event_new_eos ());
+  gst_object_unref (sinkpad);
+}
+
+static void
+no_more_pads_cb (GstElement * decodebin, MosaicTile * tile)
+{
+  GstPad *sinkpad = gst_element_get_static_pad (tile->queue, "sink");
+  gboolean linked = gst_pad_is_linked (sinkpad);
+
+  gst_object_unref (sinkpad);
+
+  if (!linked) {
+    g_warning ("Mosaic: no video in tile %u,%u", tile->row, tile->column);
+    end_tile (tile);
+  }
+}
+
+static MosaicTile *
+find_tile (GtkPlayMosaic * mosaic, GstObject * object)
+{
+  guint i;
+
+  for (i = 0; i < mosaic->n_tiles; i++) {
+    if (gst_object_has_as_ancestor (object,
+            GST_OBJECT (mosaic->tiles[i].decodebin)))
+      return &mosaic->tiles[i];
+  }
+
+  return NULL;
+}
+
+static gboolean
+bus_cb (GstBus * bus, GstMessage * msg, GtkPlayMosaic * mosaic)
+{
+  switch (GST_MESSAGE_TYPE (msg)) {
+    case GST_MESSAGE_ERROR:{
+      MosaicTile *tile = find_tile (mosaic, GST_MESSAGE_SRC (msg));
+      GError *err = NULL;
+
+      gst_message_parse_error (msg, &err, NULL);
+      if (tile) {
+        /* one broken input should not take the others down */
+        g_warning ("Mosaic: tile %u,%u failed: %s", tile->row, tile->column,
+            err->message);
+        gst_element_set_locked_state (tile->decodebin, TRUE);
+        gst_element_set_state (tile->decodebin, GST_STATE_NULL);
+        end_tile (tile);
+      } else {
+        g_warning ("Mosaic: %s", err->message);
+        gst_element_set_state (mosaic->pipeline, GST_STATE_NULL);
+      }
+      g_clear_error (&err);
+      break;
+    }
+    case GST_MESSAGE_EOS:
+      g_print ("Mosaic: all inputs finished\n");
+      break;
+    default:
+      break;
+  }
+
+  return G_SOURCE_CONTINUE;
+}
+
+static gboolean
+add_tile (GtkPlayMosaic * mosaic, MosaicTile * tile, const gchar * uri,
+    GstElement * mixer)
+{
+  GstPipeline *pipeline = GST_PIPELINE (mosaic->pipeline);
+  GstElement *scale, *convert;
+  GstPad *srcpad;
+
+  tile->decodebin = make_element (pipeline, "uridecodebin");
+  tile->queue = make_element (pipeline, "queue");
+  scale = make_element (pipeline, "videoscale");
+  convert = make_element (pipeline, "videoconvert");
+  tile->capsfilter = make_element (pipeline, "capsfilter");
+  if (!tile->decodebin || !tile->queue || !scale || !convert
+      || !tile->capsfilter)
+    return FALSE;
+
+  g_object_set (tile->decodebin, "uri", uri, NULL);
+  g_signal_connect (tile->decodebin, "autoplug-continue",
+      G_CALLBACK (autoplug_continue_cb), NULL);
+  g_signal_connect (tile->decodebin, "pad-added", G_CALLBACK (pad_added_cb),
+      tile);
+  g_signal_connect (tile->decodebin, "no-more-pads",
+      G_CALLBACK (no_more_pads_cb), tile);
+
+  /* decouple scaling and conversion from decoding, so each input gets a
+   * thread of its own for them */
+  g_object_set (tile->queue, "max-size-buffers", 3, "max-size-bytes", 0,
+      "max-size-time", (guint64) 0, NULL);
+
+  /* scale first, so the conversion only touches the smaller frames */
+  gst_element_link_many (tile->queue, scale, convert, tile->capsfilter, NULL);
+
+  tile->mixer_pad = gst_element_get_request_pad (mixer, "sink_%u");
+  srcpad = gst_element_get_static_pad (tile->capsfilter, "src");
+  gst_pad_link (srcpad, tile->mixer_pad);
+  gst_object_unref (srcpad);
+
+  return TRUE;
+}
+
+static gboolean
+add_row (GtkPlayMosaic * mosaic, GstElement * row_mixer)
+{
+  GstElement *queue;
+  GstPad *srcpad, *sinkpad;
+
+  queue = make_element (GST_PIPELINE (mosaic->pipeline), "queue");
+  if (!queue)
+    return FALSE;
+
+  g_object_set (queue, "max-size-buffers", 2, "max-size-bytes", 0,
+      "max-size-time", (guint64) 0, NULL);
+  gst_element_link (row_mixer, queue);
+
+  sinkpad = gst_element_get_request_pad (mosaic->mixer, "sink_%u");
+  srcpad = gst_element_get_static_pad (queue, "src");
+  gst_pad_link (srcpad, sinkpad);
+  gst_object_unref (srcpad);
+
+  g_ptr_array_add (mosaic->row_pads, sinkpad);
+
+  return TRUE;
+}
+
+/**
+ * gtk_play_mosaic_new:
+ * @uris: (element-type utf8): URIs to show, row by row
+ * @rows: number of rows of the grid
+ * @columns: number of columns of the grid
+ *
+ * Returns: a new mosaic, or %NULL if the needed elements are missing.
+ * URIs beyond @rows * @columns are ignored, missing ones leave their
+ * tiles black.
+ */
+GtkPlayMosaic *
+gtk_play_mosaic_new (GList * uris, guint rows, guint columns)
+{
+  GtkPlayMosaic *mosaic;
+  GstElement *capsfilter, *row_mixer = NULL;
+  GstCaps *caps;
+  GstBus *bus;
+  GList *l;
+  guint i;
+
+  g_return_val_if_fail (rows > 0 && columns > 0, NULL);
+
+  mosaic = g_new0 (GtkPlayMosaic, 1);
+  mosaic->rows = rows;
+  mosaic->columns = columns;
+  mosaic->width = DEFAULT_WIDTH;
+  mosaic->height = DEFAULT_HEIGHT;
+  mosaic->row_pads = g_ptr_array_new_with_free_func (gst_object_unref);
+  mosaic->n_tiles = MIN (g_list_length (uris), rows * columns);
+  mosaic->tiles = g_new0 (MosaicTile, mosaic->n_tiles);
+
+  mosaic->pipeline = gst_pipeline_new ("mosaic");
+  mosaic->mixer = make_mixer (GST_PIPELINE (mosaic->pipeline));
+  capsfilter = make_element (GST_PIPELINE (mosaic->pipeline), "capsfilter");
+  mosaic->sink = make_element (GST_PIPELINE (mosaic->pipeline), "gtksink");
+  if (!mosaic->mixer || !capsfilter || !mosaic->sink)
+    goto error;
+
+  /* the tiles already are in this format, keep the compositor from
+   * converting the whole frame once more */
+  caps = gst_caps_new_simple ("video/x-raw",
+      "format", G_TYPE_STRING, MOSAIC_FORMAT, NULL);
+  g_object_set (capsfilter, "caps", caps, NULL);
+  gst_caps_unref (caps);
+  gst_element_link_many (mosaic->mixer, capsfilter, mosaic->sink, NULL);
+
+  for (i = 0, l = uris; i < mosaic->n_tiles; i++, l = l->next) {
+    MosaicTile *tile = &mosaic->tiles[i];
+
+    tile->row = i / columns;
+    tile->column = i % columns;
+
+    /* a row of one is not worth another compositor, neither is a
+     * single row */
+    if (rows > 1 && columns > 1 && tile->column == 0) {
+      row_mixer = make_mixer (GST_PIPELINE (mosaic->pipeline));
+      if (!row_mixer || !add_row (mosaic, row_mixer))
+        goto error;
+    }
+
+    if (!add_tile (mosaic, tile, l->data, row_mixer ? row_mixer :
+            mosaic->mixer))
+      goto error;
+  }
+
+  g_object_get (mosaic->sink, "widget", &mosaic->widget, NULL);
+  g_signal_connect (mosaic->widget, "size-allocate",
+      G_CALLBACK (widget_size_allocate_cb), mosaic);
+  update_layout (mosaic);
+
+  bus = gst_element_get_bus (mosaic->pipeline);
+  mosaic->bus_watch_id = gst_bus_add_watch (bus, (GstBusFunc) bus_cb, mosaic);
+  gst_object_unref (bus);
+
+  gtk_play_mosaic_set_playing (mosaic, TRUE);
+
+  return mosaic;
+
+error:
+  gtk_play_mosaic_free (mosaic);
+  return NULL;
+}
+
+void
+gtk_play_mosaic_free (GtkPlayMosaic * mosaic)
+{
+  guint i;
+
+  g_return_if_fail (mosaic != NULL);
+
+  if (mosaic->resize_timeout_id)
+    g_source_remove (mosaic->resize_timeout_id);
+  if (mosaic->bus_watch_id)
+    g_source_remove (mosaic->bus_watch_id);
+
+  if (mosaic->widget) {
+    g_signal_handlers_disconnect_by_data (mosaic->widget, mosaic);
+    g_object_unref (mosaic->widget);
+  }
+
+  for (i = 0; i < mosaic->n_tiles; i++) {
+    if (mosaic->tiles[i].decodebin)
+      g_signal_handlers_disconnect_by_data (mosaic->tiles[i].decodebin,
+          &mosaic->tiles[i]);
+    if (mosaic->tiles[i].mixer_pad)
+      gst_object_unref (mosaic->tiles[i].mixer_pad);
+  }
+  g_free (mosaic->tiles);
+  g_ptr_array_unref (mosaic->row_pads);
+
+  gtk_play_reaper_dispose_element (mosaic->pipeline, NULL, NULL);
+
+  g_free (mosaic);
+}
+
+/**
+ * gtk_play_mosaic_get_widget:
+ *
+ * Returns: (transfer none): the widget the mosaic is drawn into
+ */
+GtkWidget *
+gtk_play_mosaic_get_widget (GtkPlayMosaic * mosaic)
+{
+  g_return_val_if_fail (mosaic != NULL, NULL);
+
+  return mosaic->widget;
+}
+
+void
+gtk_play_mosaic_set_playing (GtkPlayMosaic * mosaic, gboolean playing)
+{
+  g_return_if_fail (mosaic != NULL);
+
+  mosaic->playing = playing;
+  gst_element_set_state (mosaic->pipeline,
+      playing ? GST_STATE_PLAYING : GST_STATE_PAUSED);
+}
+
+gboolean
+gtk_play_mosaic_get_playing (GtkPlayMosaic * mosaic)
+{
+  g_return_val_if_fail (mosaic != NULL, FALSE);
+
+  return mosaic->playing;
+}
@@ -0,0 +1,41 @@
+/* GStreamer
+ *
+ * Copyright (C) 2016 GStreamer developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __GTK_PLAY_MOSAIC_H__
+#define __GTK_PLAY_MOSAIC_H__
+
+#include <gst/gst.h>
+#include <gtk/gtk.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GtkPlayMosaic GtkPlayMosaic;
+
+GtkPlayMosaic * gtk_play_mosaic_new (GList * uris, guint rows, guint columns);
+void gtk_play_mosaic_free (GtkPlayMosaic * mosaic);
+
+GtkWidget * gtk_play_mosaic_get_widget (GtkPlayMosaic * mosaic);
+
+void gtk_play_mosaic_set_playing (GtkPlayMosaic * mosaic, gboolean playing);
+gboolean gtk_play_mosaic_get_playing (GtkPlayMosaic * mosaic);
+
+G_END_DECLS
+
+#endif /* __GTK_PLAY_MOSAIC_H__ */
@@ -0,0 +1,169 @@
+/* GStreamer
+ *
+ * Copyright (C) 2016 GStreamer developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "gtk-play-reaper.h"
+
+/* Stopping a player and freeing its pipeline can block for a long time, e.g.
+ * with network sources, so it happens on a background thread instead of the
+ * UI thread. Once this many are still in flight the caller blocks again, so
+ * closed players can not pile up */
+#define MAX_PENDING_TEARDOWNS 4
+
+typedef struct
+{
+  GstPlayer *player;
+  GstElement *element;
+  GDestroyNotify done;
+  gpointer user_data;
+} Teardown;
+
+static GAsyncQueue *teardown_queue;
+/* only touched from the main thread */
+static guint pending_teardowns;
+
+static void
+teardown_player (GstPlayer * player)
+{
+  gst_player_stop (player);
+  g_object_unref (player);
+}
+
+static void
+teardown_element (GstElement * element)
+{
+  gst_element_set_state (element, GST_STATE_NULL);
+  gst_object_unref (element);
+}
+
+static gboolean
+teardown_done_cb (Teardown * teardown)
+{
+  if (teardown->done)
+    teardown->done (teardown->user_data);
+  g_free (teardown);
+  pending_teardowns--;
+
+  return G_SOURCE_REMOVE;
+}
+
+static gpointer
+reaper_thread_func (gpointer user_data)
+{
+  while (TRUE) {
+    Teardown *teardown = g_async_queue_pop (teardown_queue);
+
+    if (teardown->player)
+      teardown_player (teardown->player);
+    else
+      teardown_element (teardown->element);
+    teardown->player = NULL;
+    teardown->element = NULL;
+
+    g_main_context_invoke (NULL, (GSourceFunc) teardown_done_cb, teardown);
+  }
+
+  return NULL;
+}
+
+/**
+ * gtk_play_reaper_dispose:
+ * @player: (transfer full): the player to get rid of
+ * @done: (allow-none): called from the main thread once @player is gone
+ * @user_data: data passed to @done
+ *
+ * Stops and unrefs @player asynchronously. Signal handlers should be
+ * disconnected before.
+ */
+static void
+push_teardown (GstPlayer * player, GstElement * element, GDestroyNotify done,
+    gpointer user_data)
+{
+  Teardown *teardown;
+
+  if (pending_teardowns >= MAX_PENDING_TEARDOWNS) {
+    if (player)
+      teardown_player (player);
+    else
+      teardown_element (element);
+    if (done)
+      done (user_data);
+    return;
+  }
+
+  if (!teardown_queue) {
+    teardown_queue = g_async_queue_new ();
+    g_thread_unref (g_thread_new ("gtk-play-reaper", reaper_thread_func,
+            NULL));
+  }
+
+  teardown = g_new0 (Teardown, 1);
+  teardown->player = player;
+  teardown->element = element;
+  teardown->done = done;
+  teardown->user_data = user_data;
+
+  pending_teardowns++;
+  g_async_queue_push (teardown_queue, teardown);
+}
+
+void
+gtk_play_reaper_dispose (GstPlayer * player, GDestroyNotify done,
+    gpointer user_data)
+{
+  g_return_if_fail (GST_IS_PLAYER (player));
+
+  push_teardown (player, NULL, done, user_data);
+}
+
+/**
+ * gtk_play_reaper_dispose_element:
+ * @element: (transfer full): the pipeline to get rid of
+ * @done: (allow-none): called from the main thread once @element is gone
+ * @user_data: data passed to @done
+ *
+ * Like gtk_play_reaper_dispose(), but for a pipeline that is not driven by
+ * a #GstPlayer. Its bus watch should be removed before.
+ */
+void
+gtk_play_reaper_dispose_element (GstElement * element, GDestroyNotify done,
+    gpointer user_data)
+{
+  g_return_if_fail (GST_IS_ELEMENT (element));
+
+  push_teardown (NULL, element, done, user_data);
+}
+
+/**
+ * gtk_play_reaper_flush:
+ *
+ * Waits until all players and pipelines passed to the reaper are gone.
+ * This iterates the default main context, as the GTK sinks need it for
+ * shutting down.
+ */
+void
+gtk_play_reaper_flush (void)
+{
+  while (pending_teardowns > 0)
+    g_main_context_iteration (NULL, TRUE);
+}
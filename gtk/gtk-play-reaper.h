@@ -0,0 +1,36 @@
+/* GStreamer
+ *
+ * Copyright (C) 2016 GStreamer developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __GTK_PLAY_REAPER_H__
+#define __GTK_PLAY_REAPER_H__
+
+#include <gst/player/player.h>
+
+G_BEGIN_DECLS
+
+void gtk_play_reaper_dispose (GstPlayer * player, GDestroyNotify done,
+    gpointer user_data);
+void gtk_play_reaper_dispose_element (GstElement * element,
+    GDestroyNotify done, gpointer user_data);
+void gtk_play_reaper_flush (void);
+
+G_END_DECLS
+
+#endif /* __GTK_PLAY_REAPER_H__ */
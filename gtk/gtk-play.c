@@ -19,6 +19,7 @@
  * Boston, MA 02110-1301, USA.
  */
 
+#include <stdio.h>
 #include <string.h>
 #include <math.h>
 
@@ -39,9 +40,26 @@
 
 #include <gst/player/player.h>
 #include "gtk-video-renderer.h"
+#include "gtk-play-hud.h"
+#include "gtk-play-reaper.h"
+#include "gtk-play-frame-cache.h"
+#include "gtk-play-mosaic.h"
+#include "gst-player-looper.h"
+#include "gst-player-clip-export.h"
+#include "gst-player-timeshift.h"
+#include "gst-player-low-latency.h"
+#include "gst-player-net-sync.h"
+#include "gst-player-segments.h"
+#include "gst-player-mmap-src.h"
+#include "gst-player-prefetch.h"
+#include "gst-player-seek-index.h"
+#include "gst-player-autoplug-cache.h"
 
 #define APP_NAME "gtk-play"
 
+/* how many of the next items --prefetch reads ahead */
+#define PREFETCH_ITEMS 2
+
 #define TOOLBAR_GET_OBJECT(x) \
   (GtkWidget *)gtk_builder_get_object (play->toolbar_ui, #x)
 
@@ -60,6 +78,26 @@ typedef struct
 
   GstPlayer *player;
   GstPlayerVideoRenderer *renderer;
+  GtkPlayHud *hud;
+  GstPlayerLooper *looper;
+  /* only with --low-latency or --measure-latency */
+  gboolean low_latency_profile;
+  gboolean measure_latency;
+  GstPlayerLowLatency *low_latency;
+  /* only with --sync-master or --sync-slave */
+  gint sync_master_port;
+  gchar *sync_slave;
+  GstPlayerNetSync *net_sync;
+  /* only with --prefetch, in MB and MB/s */
+  guint prefetch_size;
+  guint prefetch_rate;
+  GstPlayerPrefetch *prefetch;
+  /* only with --autoplug-cache or --warm-decoders */
+  gboolean use_autoplug_cache;
+  gboolean warm_decoders;
+  GstPlayerAutoplugCache *autoplug_cache;
+  /* only with --seek-index, the URIs are wrapped for the player only */
+  gboolean seek_index;
 
   GList *uris;
   GList *current_uri;
@@ -70,6 +108,7 @@ typedef struct
   GtkWidget *prev_button, *next_button;
   GtkWidget *seekbar;
   GtkWidget *video_area;
+  GtkWidget *subtitle_area;
   GtkWidget *volume_button;
   GtkWidget *fullscreen_button;
   GtkWidget *toolbar;
@@ -82,9 +121,40 @@ typedef struct
   GdkCursor *default_cursor;
   gboolean playing;
   gboolean loop;
+  /* each item only plays this range */
+  GstClockTime range_start;
+  GstClockTime range_stop;
+  /* start of the A-B range while waiting for its end */
+  GstClockTime ab_start;
+  gboolean ab_active;
+  /* the active A-B range, which is what gets exported */
+  GstClockTime ab_range_start;
+  GstClockTime ab_range_stop;
   gboolean fullscreen;
   gint toolbar_hide_timeout;
 
+  /* last (clock time, stream time, rate) snapshot taken from the player,
+   * the seekbar position is extrapolated from it on every frame */
+  GstPlayerState state;
+  GstClock *clock;
+  GstClockTime snapshot_clock_time;
+  GstClockTime snapshot_position;
+  gdouble snapshot_rate;
+  GstClockTime duration;
+  guint64 shown_seconds;
+  guint position_tick_id;
+
+  /* frame stepping, backwards steps are served from decoded frames while
+   * the pipeline itself stays where it was */
+  GtkPlayFrameCache *frame_cache;
+  GtkWidget *step_area;
+  cairo_surface_t *step_surface;
+  GstClockTime step_position;
+  GstClockTime step_pipeline_position;
+  gboolean step_waiting;
+  GstBus *bus;
+  gulong step_done_id;
+
   GtkBuilder *toolbar_ui;
 } GtkPlay;
 
@@ -101,6 +171,10 @@ void next_button_clicked_cb (GtkButton * button, GtkPlay * play);
 void media_info_dialog_button_clicked_cb (GtkButton * button, GtkPlay * play);
 void fullscreen_button_toggled_cb (GtkToggleButton * widget, GtkPlay * play);
 void seekbar_value_changed_cb (GtkRange * range, GtkPlay * play);
+static void position_snapshot_update (GtkPlay * play, GstClockTime position);
+static void frame_step (GtkPlay * play, gboolean forward);
+static void frame_step_reset (GtkPlay * play);
+static void frame_step_resume (GtkPlay * play);
 void volume_button_value_changed_cb (GtkScaleButton * button, gdouble value,
     GtkPlay * play);
 
@@ -110,6 +184,17 @@ enum
   PROP_LOOP,
   PROP_FULLSCREEN,
   PROP_URIS,
+  PROP_START,
+  PROP_END,
+  PROP_LOW_LATENCY,
+  PROP_MEASURE_LATENCY,
+  PROP_SYNC_MASTER,
+  PROP_SYNC_SLAVE,
+  PROP_PREFETCH,
+  PROP_PREFETCH_RATE,
+  PROP_AUTOPLUG_CACHE,
+  PROP_WARM_DECODERS,
+  PROP_SEEK_INDEX,
 
   LAST_PROP
 };
@@ -208,7 +293,9 @@ gtk_play_set_rate (GtkPlay * play, gdouble step)
   val += step;
   if (val == 0.0)
     val = step;
+  frame_step_reset (play);
   gst_player_set_rate (play->player, val);
+  position_snapshot_update (play, gst_player_get_position (play->player));
 
   if (val == 1.0)
     gtk_label_set_label (play->rate_label, NULL);
@@ -228,6 +315,108 @@ seekbar_add_delta (GtkPlay * play, gint delta_sec)
   gtk_range_set_value (GTK_RANGE (play->seekbar), value + delta_sec);
 }
 
+/* first sets the start of the range, then its end, then clears it again */
+static void
+ab_loop_cycle (GtkPlay * play)
+{
+  GstClockTime position = gst_player_get_position (play->player);
+
+  if (play->ab_active) {
+    /* back to repeating the whole item, if that was asked for */
+    gst_player_looper_set_range (play->looper, play->range_start,
+        play->range_stop);
+    gst_player_looper_set_enabled (play->looper, play->loop
+        && g_list_length (play->uris) == 1);
+    play->ab_active = FALSE;
+  } else if (!GST_CLOCK_TIME_IS_VALID (play->ab_start)) {
+    play->ab_start = position;
+  } else if (GST_CLOCK_TIME_IS_VALID (position) && position > play->ab_start) {
+    gst_player_looper_set_range (play->looper, play->ab_start, position);
+    gst_player_looper_set_enabled (play->looper, TRUE);
+    play->ab_active = TRUE;
+    play->ab_range_start = play->ab_start;
+    play->ab_range_stop = position;
+    play->ab_start = GST_CLOCK_TIME_NONE;
+  } else {
+    play->ab_start = GST_CLOCK_TIME_NONE;
+  }
+}
+
+static void
+export_done_cb (GstPlayerClipExport * clip, const GError * error,
+    gpointer user_data)
+{
+  if (error)
+    g_printerr ("Exporting %s failed: %s\n",
+        gst_player_clip_export_get_location (clip), error->message);
+  else
+    g_print ("Exported %s\n", gst_player_clip_export_get_location (clip));
+
+  gst_player_clip_export_free (clip);
+  g_application_release (g_application_get_default ());
+}
+
+static gchar *
+export_file_dialog (GtkPlay * play)
+{
+  GtkWidget *chooser;
+  gchar *location = NULL;
+  gchar *name, *basename, *dot;
+
+  basename = g_path_get_basename (play->current_uri->data);
+  dot = strrchr (basename, '.');
+  if (dot && dot != basename)
+    *dot = '\0';
+  name = g_strdup_printf ("%s-%.3f-%.3f.mkv", basename,
+      (gdouble) play->ab_range_start / GST_SECOND,
+      (gdouble) play->ab_range_stop / GST_SECOND);
+
+  chooser = gtk_file_chooser_dialog_new ("Export clip", GTK_WINDOW (play),
+      GTK_FILE_CHOOSER_ACTION_SAVE,
+      "_Cancel", GTK_RESPONSE_CANCEL, "_Save", GTK_RESPONSE_ACCEPT, NULL);
+  gtk_file_chooser_set_do_overwrite_confirmation (GTK_FILE_CHOOSER (chooser),
+      TRUE);
+  gtk_file_chooser_set_current_name (GTK_FILE_CHOOSER (chooser), name);
+
+  if (gtk_dialog_run (GTK_DIALOG (chooser)) == GTK_RESPONSE_ACCEPT)
+    location = gtk_file_chooser_get_filename (GTK_FILE_CHOOSER (chooser));
+
+  gtk_widget_destroy (chooser);
+  g_free (name);
+  g_free (basename);
+
+  return location;
+}
+
+/* Writes the A-B range to a file by remuxing. The export keeps the
+ * application alive until it is done, even if the window is closed */
+static void
+export_ab_range (GtkPlay * play, gboolean accurate)
+{
+  GstPlayerClipExport *clip;
+  GError *err = NULL;
+  gchar *location;
+
+  if (!play->ab_active)
+    return;
+
+  location = export_file_dialog (play);
+  if (!location)
+    return;
+
+  clip = gst_player_clip_export_new (play->current_uri->data,
+      play->ab_range_start, play->ab_range_stop, location, accurate,
+      export_done_cb, NULL, &err);
+  if (clip) {
+    g_application_hold (g_application_get_default ());
+  } else {
+    g_printerr ("Could not export %s: %s\n", location, err->message);
+    g_clear_error (&err);
+  }
+
+  g_free (location);
+}
+
 /* this mapping follow the mplayer key-bindings */
 static gboolean
 key_press_event_cb (GtkWidget * widget, GdkEventKey * event, gpointer data)
@@ -306,6 +495,16 @@ key_press_event_cb (GtkWidget * widget, GdkEventKey * event, gpointer data)
       gtk_play_set_rate (play, 1.0 - val);
       break;
     }
+    case GDK_KEY_comma:{
+      /* Step one frame backward */
+      frame_step (play, FALSE);
+      break;
+    }
+    case GDK_KEY_period:{
+      /* Step one frame forward */
+      frame_step (play, TRUE);
+      break;
+    }
     case GDK_KEY_less:{
       /* Go backward in the playlist */
       if (g_list_previous (play->current_uri))
@@ -348,6 +547,25 @@ key_press_event_cb (GtkWidget * widget, GdkEventKey * event, gpointer data)
       gtk_toggle_button_set_active (fs, active);
       break;
     }
+    case GDK_KEY_l:
+      /* Set A-B repeat start, end, or clear it */
+      ab_loop_cycle (play);
+      break;
+    case GDK_KEY_e:
+    case GDK_KEY_E:
+      /* Export the A-B range, with shift re-encoding the video */
+      export_ab_range (play, event->keyval == GDK_KEY_E);
+      break;
+    case GDK_KEY_j:
+      /* Catch up with a timeshifted live stream */
+      if (GST_CLOCK_TIME_IS_VALID (play->duration))
+        gst_player_seek (play->player, play->duration);
+      break;
+    case GDK_KEY_o:
+      /* Toggle performance overlay */
+      gtk_play_hud_set_visible (play->hud,
+          !gtk_play_hud_get_visible (play->hud));
+      break;
     case GDK_KEY_p:
     case GDK_KEY_space:
       /* toggle pause/play */
@@ -397,6 +615,7 @@ play_pause_button_clicked_cb (GtkButton * button, GtkPlay * play)
         gtk_application_inhibit (GTK_APPLICATION (g_application_get_default ()),
         GTK_WINDOW (play), GTK_APPLICATION_INHIBIT_IDLE, "Playing media");
 
+    frame_step_resume (play);
     gst_player_play (play->player);
     image = TOOLBAR_GET_OBJECT (pause_image);
     gtk_button_set_image (GTK_BUTTON (play->play_pause_button), image);
@@ -404,6 +623,26 @@ play_pause_button_clicked_cb (GtkButton * button, GtkPlay * play)
   }
 }
 
+/* the items after the current one, wrapping around when looping */
+static void
+prefetch_upcoming (GtkPlay * play)
+{
+  const gchar *upcoming[PREFETCH_ITEMS];
+  GList *l = play->current_uri;
+  guint n = 0;
+
+  while (n < PREFETCH_ITEMS) {
+    l = g_list_next (l);
+    if (!l && play->loop)
+      l = play->uris;
+    if (!l || l == play->current_uri)
+      break;
+    upcoming[n++] = l->data;
+  }
+
+  gst_player_prefetch_set_upcoming (play->prefetch, upcoming, n);
+}
+
 static void
 play_current_uri (GtkPlay * play, GList * uri, const gchar * ext_suburi)
 {
@@ -420,9 +659,17 @@ play_current_uri (GtkPlay * play, GList * uri, const gchar * ext_suburi)
   /* set uri or suburi */
   if (ext_suburi)
     gst_player_set_subtitle_uri (play->player, ext_suburi);
-  else
+  else if (play->seek_index) {
+    gchar *wrapped = gst_player_seek_index_wrap_uri (uri->data);
+
+    gst_player_set_uri (play->player, wrapped);
+    g_free (wrapped);
+  } else
     gst_player_set_uri (play->player, uri->data);
   play->current_uri = uri;
+  frame_step_reset (play);
+  if (play->prefetch)
+    prefetch_upcoming (play);
   if (play->playing) {
     if (play->inhibit_cookie)
       gtk_application_uninhibit (GTK_APPLICATION (g_application_get_default ()),
@@ -891,6 +1138,8 @@ G_MODULE_EXPORT void
 seekbar_value_changed_cb (GtkRange * range, GtkPlay * play)
 {
   gdouble value = gtk_range_get_value (GTK_RANGE (play->seekbar));
+
+  frame_step_reset (play);
   gst_player_seek (play->player, gst_util_uint64_scale (value, GST_SECOND, 1));
 }
 
@@ -1375,6 +1624,10 @@ get_child_position (GtkOverlay * overlay, GtkWidget * widget,
   gint x, y;
   GtkWidget *relative = play->video_area;
 
+  /* the HUD is placed by its own alignment */
+  if (play->hud && widget == gtk_play_hud_get_widget (play->hud))
+    return FALSE;
+
   child = gtk_bin_get_child (GTK_BIN (overlay));
   gtk_widget_translate_coordinates (relative, child, 0, 0, &x, &y);
   main_alloc.x = x;
@@ -1382,6 +1635,12 @@ get_child_position (GtkOverlay * overlay, GtkWidget * widget,
   main_alloc.width = gtk_widget_get_allocated_width (relative);
   main_alloc.height = gtk_widget_get_allocated_height (relative);
 
+  /* subtitles and stepped frames cover the whole video area */
+  if (widget == play->subtitle_area || widget == play->step_area) {
+    *alloc = main_alloc;
+    return TRUE;
+  }
+
   gtk_widget_get_preferred_size (widget, NULL, &req);
 
   alloc->x = (main_alloc.width - req.width) / 2;
@@ -1401,6 +1660,38 @@ get_child_position (GtkOverlay * overlay, GtkWidget * widget,
   return TRUE;
 }
 
+static gboolean
+step_area_draw_cb (GtkWidget * widget, cairo_t * cr, GtkPlay * play)
+{
+  gint width, height, surface_width, surface_height;
+  gdouble scale;
+
+  if (!play->step_surface)
+    return FALSE;
+
+  width = gtk_widget_get_allocated_width (widget);
+  height = gtk_widget_get_allocated_height (widget);
+  surface_width = cairo_image_surface_get_width (play->step_surface);
+  surface_height = cairo_image_surface_get_height (play->step_surface);
+
+  cairo_set_source_rgb (cr, 0, 0, 0);
+  cairo_paint (cr);
+
+  if (surface_width <= 0 || surface_height <= 0)
+    return TRUE;
+
+  /* the frames have square pixels already */
+  scale = MIN ((gdouble) width / surface_width,
+      (gdouble) height / surface_height);
+  cairo_translate (cr, (width - surface_width * scale) / 2,
+      (height - surface_height * scale) / 2);
+  cairo_scale (cr, scale, scale);
+  cairo_set_source_surface (cr, play->step_surface, 0, 0);
+  cairo_paint (cr);
+
+  return TRUE;
+}
+
 static void
 create_ui (GtkPlay * play)
 {
@@ -1425,6 +1716,9 @@ create_ui (GtkPlay * play)
     play->video_area =
         gst_player_gtk_video_renderer_get_widget (GST_PLAYER_GTK_VIDEO_RENDERER
         (play->renderer));
+    play->subtitle_area =
+        gst_player_gtk_video_renderer_get_subtitle_widget
+        (GST_PLAYER_GTK_VIDEO_RENDERER (play->renderer));
   } else {
     play->renderer = gst_player_video_overlay_video_renderer_new (NULL);
 
@@ -1473,6 +1767,27 @@ create_ui (GtkPlay * play)
   gtk_widget_set_size_request (play->toolbar, 500, 50);
 
   play->toolbar_overlay = gtk_overlay_new ();
+
+  /* shows the frames stepped back to over the video */
+  play->step_area = gtk_drawing_area_new ();
+  g_signal_connect (play->step_area, "draw", G_CALLBACK (step_area_draw_cb),
+      play);
+  gtk_widget_set_no_show_all (play->step_area, TRUE);
+  gtk_overlay_add_overlay (GTK_OVERLAY (play->toolbar_overlay),
+      play->step_area);
+#if GTK_CHECK_VERSION(3,18,0)
+  gtk_overlay_set_overlay_pass_through (GTK_OVERLAY (play->toolbar_overlay),
+      play->step_area, TRUE);
+#endif
+
+  if (play->subtitle_area) {
+    gtk_overlay_add_overlay (GTK_OVERLAY (play->toolbar_overlay),
+        play->subtitle_area);
+#if GTK_CHECK_VERSION(3,18,0)
+    gtk_overlay_set_overlay_pass_through (GTK_OVERLAY (play->toolbar_overlay),
+        play->subtitle_area, TRUE);
+#endif
+  }
   gtk_overlay_add_overlay (GTK_OVERLAY (play->toolbar_overlay), play->toolbar);
   gtk_container_add (GTK_CONTAINER (play->toolbar_overlay), main_hbox);
   gtk_container_add (GTK_CONTAINER (play), play->toolbar_overlay);
@@ -1507,6 +1822,8 @@ create_ui (GtkPlay * play)
 static void
 duration_changed_cb (GstPlayer * unused, GstClockTime duration, GtkPlay * play)
 {
+  play->duration = duration;
+
   g_signal_handlers_block_by_func (play->seekbar,
       seekbar_value_changed_cb, play);
   gtk_range_set_range (GTK_RANGE (play->seekbar), 0.0,
@@ -1536,18 +1853,326 @@ update_position_label (GtkLabel * label, guint64 seconds)
 }
 
 static void
-position_updated_cb (GstPlayer * unused, GstClockTime position, GtkPlay * play)
+position_display (GtkPlay * play, GstClockTime position)
 {
+  guint64 seconds = position / GST_SECOND;
+
   g_signal_handlers_block_by_func (play->seekbar,
       seekbar_value_changed_cb, play);
   gtk_range_set_value (GTK_RANGE (play->seekbar),
       (gdouble) position / GST_SECOND);
-  update_position_label (play->elapshed_label, position / GST_SECOND);
-  update_position_label (play->remain_label,
-      GST_CLOCK_DIFF (position, gst_player_get_duration (play->player)) /
-      GST_SECOND);
   g_signal_handlers_unblock_by_func (play->seekbar,
       seekbar_value_changed_cb, play);
+
+  /* the labels only have second granularity, don't relayout them per frame */
+  if (seconds == play->shown_seconds)
+    return;
+  play->shown_seconds = seconds;
+
+  update_position_label (play->elapshed_label, seconds);
+  update_position_label (play->remain_label,
+      GST_CLOCK_DIFF (position, play->duration) / GST_SECOND);
+}
+
+static GstClockTime
+position_extrapolate (GtkPlay * play)
+{
+  GstClockTimeDiff elapsed;
+  gdouble position;
+
+  if (!GST_CLOCK_TIME_IS_VALID (play->snapshot_position))
+    return 0;
+
+  if (play->state != GST_PLAYER_STATE_PLAYING || !play->clock ||
+      !GST_CLOCK_TIME_IS_VALID (play->snapshot_clock_time))
+    return play->snapshot_position;
+
+  elapsed = GST_CLOCK_DIFF (play->snapshot_clock_time,
+      gst_clock_get_time (play->clock));
+  position = (gdouble) play->snapshot_position + elapsed * play->snapshot_rate;
+
+  if (position < 0)
+    return 0;
+  if (GST_CLOCK_TIME_IS_VALID (play->duration) && position > play->duration)
+    return play->duration;
+
+  return (GstClockTime) position;
+}
+
+static void
+position_snapshot_update (GtkPlay * play, GstClockTime position)
+{
+  GstElement *pipeline;
+  GstClock *clock;
+
+  pipeline = gst_player_get_pipeline (play->player);
+  clock = gst_element_get_clock (pipeline);
+  gst_object_unref (pipeline);
+
+  gst_object_replace ((GstObject **) & play->clock, (GstObject *) clock);
+  if (clock)
+    gst_object_unref (clock);
+
+  play->snapshot_clock_time =
+      play->clock ? gst_clock_get_time (play->clock) : GST_CLOCK_TIME_NONE;
+  play->snapshot_position = position;
+  play->snapshot_rate = gst_player_get_rate (play->player);
+
+  position_display (play, position_extrapolate (play));
+}
+
+static gboolean
+position_tick_cb (GtkWidget * widget, GdkFrameClock * frame_clock,
+    gpointer user_data)
+{
+  GtkPlay *play = user_data;
+
+  position_display (play, position_extrapolate (play));
+
+  return G_SOURCE_CONTINUE;
+}
+
+static void
+position_tick_set_active (GtkPlay * play, gboolean active)
+{
+  if (active && !play->position_tick_id)
+    play->position_tick_id = gtk_widget_add_tick_callback (play->seekbar,
+        position_tick_cb, play, NULL);
+  else if (!active && play->position_tick_id) {
+    gtk_widget_remove_tick_callback (play->seekbar, play->position_tick_id);
+    play->position_tick_id = 0;
+  }
+}
+
+static void
+position_updated_cb (GstPlayer * unused, GstClockTime position, GtkPlay * play)
+{
+  /* only a coarse resync now, the seekbar moves from the tick callback */
+  position_snapshot_update (play, position);
+}
+
+static void
+seek_done_cb (GstPlayer * unused, GstClockTime position, GtkPlay * play)
+{
+  position_snapshot_update (play, position);
+}
+
+static void
+state_changed_cb (GstPlayer * unused, GstPlayerState state, GtkPlay * play)
+{
+  play->state = state;
+
+  if (state == GST_PLAYER_STATE_STOPPED) {
+    frame_step_reset (play);
+    position_tick_set_active (play, FALSE);
+    gst_object_replace ((GstObject **) & play->clock, NULL);
+    play->snapshot_position = GST_CLOCK_TIME_NONE;
+    play->shown_seconds = G_MAXUINT64;
+    return;
+  }
+
+  if (state == GST_PLAYER_STATE_PLAYING)
+    frame_step_reset (play);
+
+  position_snapshot_update (play, gst_player_get_position (play->player));
+  position_tick_set_active (play, state == GST_PLAYER_STATE_PLAYING);
+}
+
+/* stream time of the frame the pipeline shows right now */
+static GstClockTime
+frame_step_current_position (GtkPlay * play)
+{
+  GstElement *pipeline;
+  GstSample *sample = NULL;
+  GstClockTime position = GST_CLOCK_TIME_NONE;
+
+  pipeline = gst_player_get_pipeline (play->player);
+  g_object_get (pipeline, "sample", &sample, NULL);
+  gst_object_unref (pipeline);
+
+  if (sample) {
+    GstBuffer *buffer = gst_sample_get_buffer (sample);
+    const GstSegment *segment = gst_sample_get_segment (sample);
+
+    if (buffer && segment && GST_BUFFER_PTS_IS_VALID (buffer))
+      position = gst_segment_to_stream_time (segment, GST_FORMAT_TIME,
+          GST_BUFFER_PTS (buffer));
+    gst_sample_unref (sample);
+  }
+
+  return position;
+}
+
+/* takes ownership of @surface, %NULL shows the pipeline's frame again */
+static void
+frame_step_show (GtkPlay * play, cairo_surface_t * surface,
+    GstClockTime position)
+{
+  if (play->step_surface)
+    cairo_surface_destroy (play->step_surface);
+  play->step_surface = surface;
+
+  if (surface) {
+    play->step_position = position;
+    gtk_widget_show (play->step_area);
+    gtk_widget_queue_draw (play->step_area);
+  } else {
+    play->step_position = GST_CLOCK_TIME_NONE;
+    gtk_widget_hide (play->step_area);
+  }
+
+  if (GST_CLOCK_TIME_IS_VALID (position))
+    position_display (play, position);
+}
+
+static void
+frame_step_reset (GtkPlay * play)
+{
+  gint scale;
+
+  if (!play->frame_cache)
+    return;
+
+  play->step_waiting = FALSE;
+  play->step_pipeline_position = GST_CLOCK_TIME_NONE;
+  if (play->step_surface)
+    frame_step_show (play, NULL, GST_CLOCK_TIME_NONE);
+
+  /* no need to keep frames larger than they are shown */
+  scale = gtk_widget_get_scale_factor (play->video_area);
+  gtk_play_frame_cache_reset (play->frame_cache,
+      play->current_uri ? play->current_uri->data : NULL,
+      gtk_widget_get_allocated_width (play->video_area) * scale,
+      gtk_widget_get_allocated_height (play->video_area) * scale);
+}
+
+/* playback continues from the frame that is shown, not from where the
+ * pipeline was left */
+static void
+frame_step_resume (GtkPlay * play)
+{
+  GstElement *pipeline;
+
+  if (!play->step_surface || !GST_CLOCK_TIME_IS_VALID (play->step_position))
+    return;
+
+  pipeline = gst_player_get_pipeline (play->player);
+  gst_element_seek_simple (pipeline, GST_FORMAT_TIME,
+      GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_ACCURATE, play->step_position);
+  gst_object_unref (pipeline);
+  play->step_pipeline_position = play->step_position;
+}
+
+static gboolean
+frame_step_update_cb (GtkPlay * play)
+{
+  GstClockTime position;
+
+  if (!play->player)
+    return G_SOURCE_REMOVE;
+
+  position = frame_step_current_position (play);
+  if (GST_CLOCK_TIME_IS_VALID (position))
+    position_snapshot_update (play, position);
+
+  return G_SOURCE_REMOVE;
+}
+
+/* the player reports no positions while paused, so the new one is picked
+ * up once the step is done. From the player's thread */
+static void
+step_done_cb (GstBus * bus, GstMessage * msg, GtkPlay * play)
+{
+  g_idle_add_full (G_PRIORITY_DEFAULT_IDLE,
+      (GSourceFunc) frame_step_update_cb, g_object_ref (play),
+      g_object_unref);
+}
+
+static void
+frame_step_pipeline (GtkPlay * play)
+{
+  GstElement *pipeline;
+
+  pipeline = gst_player_get_pipeline (play->player);
+  gst_element_send_event (pipeline,
+      gst_event_new_step (GST_FORMAT_BUFFERS, 1, 1.0, TRUE, FALSE));
+  gst_object_unref (pipeline);
+}
+
+static void
+frame_step (GtkPlay * play, gboolean forward)
+{
+  cairo_surface_t *surface;
+  GstClockTime position, frame_position = GST_CLOCK_TIME_NONE;
+  gboolean pending = FALSE;
+
+  /* the first step only stops at the current frame */
+  if (play->playing) {
+    gtk_button_clicked (GTK_BUTTON (play->play_pause_button));
+    return;
+  }
+
+  if (play->state != GST_PLAYER_STATE_PAUSED)
+    return;
+
+  if (forward) {
+    GstClockTime end;
+
+    play->step_waiting = FALSE;
+
+    if (!GST_CLOCK_TIME_IS_VALID (play->step_position)) {
+      frame_step_pipeline (play);
+      return;
+    }
+
+    surface = gtk_play_frame_cache_lookup_after (play->frame_cache,
+        play->step_position, &frame_position);
+    if (surface) {
+      frame_step_show (play, surface, frame_position);
+      return;
+    }
+
+    /* past the cached frames, the pipeline has to show the next one. Unless
+     * frames were dropped from the cache that is the one it shows already */
+    end = gtk_play_frame_cache_get_end (play->frame_cache);
+    if (GST_CLOCK_TIME_IS_VALID (end) && end != play->step_pipeline_position) {
+      GstElement *pipeline = gst_player_get_pipeline (play->player);
+
+      gst_element_seek_simple (pipeline, GST_FORMAT_TIME,
+          GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_ACCURATE, end);
+      gst_object_unref (pipeline);
+      play->step_pipeline_position = end;
+    }
+    frame_step_show (play, NULL, end);
+    return;
+  }
+
+  if (GST_CLOCK_TIME_IS_VALID (play->step_position)) {
+    position = play->step_position;
+  } else {
+    position = frame_step_current_position (play);
+    if (!GST_CLOCK_TIME_IS_VALID (position))
+      return;
+    play->step_pipeline_position = position;
+  }
+
+  surface = gtk_play_frame_cache_lookup_before (play->frame_cache, position,
+      &frame_position, &pending);
+  if (surface)
+    frame_step_show (play, surface, frame_position);
+
+  /* shown once the group of pictures before was decoded */
+  play->step_waiting = !surface && pending;
+}
+
+static void
+frame_cache_filled_cb (GtkPlayFrameCache * cache, GtkPlay * play)
+{
+  if (!play->step_waiting)
+    return;
+
+  play->step_waiting = FALSE;
+  frame_step (play, FALSE);
 }
 
 static void
@@ -1699,6 +2324,39 @@ gtk_play_set_property (GObject * object, guint prop_id, const GValue * value,
     case PROP_URIS:
       self->uris = g_value_get_pointer (value);
       break;
+    case PROP_START:
+      self->range_start = g_value_get_uint64 (value);
+      break;
+    case PROP_END:
+      self->range_stop = g_value_get_uint64 (value);
+      break;
+    case PROP_LOW_LATENCY:
+      self->low_latency_profile = g_value_get_boolean (value);
+      break;
+    case PROP_MEASURE_LATENCY:
+      self->measure_latency = g_value_get_boolean (value);
+      break;
+    case PROP_SYNC_MASTER:
+      self->sync_master_port = g_value_get_int (value);
+      break;
+    case PROP_SYNC_SLAVE:
+      self->sync_slave = g_value_dup_string (value);
+      break;
+    case PROP_PREFETCH:
+      self->prefetch_size = g_value_get_uint (value);
+      break;
+    case PROP_PREFETCH_RATE:
+      self->prefetch_rate = g_value_get_uint (value);
+      break;
+    case PROP_AUTOPLUG_CACHE:
+      self->use_autoplug_cache = g_value_get_boolean (value);
+      break;
+    case PROP_WARM_DECODERS:
+      self->warm_decoders = g_value_get_boolean (value);
+      break;
+    case PROP_SEEK_INDEX:
+      self->seek_index = g_value_get_boolean (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -1721,6 +2379,8 @@ gtk_play_constructor (GType type, guint n_construct_params,
     GObjectConstructParam * construct_params)
 {
   GtkPlay *self;
+  GstElement *pipeline;
+  GError *err = NULL;
 
   self =
       (GtkPlay *) G_OBJECT_CLASS (gtk_play_parent_class)->constructor (type,
@@ -1741,16 +2401,98 @@ gtk_play_constructor (GType type, guint n_construct_params,
       gst_player_new (self->renderer,
       gst_player_g_main_context_signal_dispatcher_new (NULL));
 
+  self->state = GST_PLAYER_STATE_STOPPED;
+  self->snapshot_position = GST_CLOCK_TIME_NONE;
+  self->duration = GST_CLOCK_TIME_NONE;
+  self->shown_seconds = G_MAXUINT64;
+  self->step_position = GST_CLOCK_TIME_NONE;
+  self->step_pipeline_position = GST_CLOCK_TIME_NONE;
+  self->frame_cache =
+      gtk_play_frame_cache_new ((GtkPlayFrameCacheFilledFunc)
+      frame_cache_filled_cb, self);
+  /* the position is extrapolated locally, so a slow resync is enough */
+  gst_player_set_position_update_interval (self->player, 1000);
+
+  /* a single item is repeated seamlessly instead of restarting at EOS */
+  self->looper = gst_player_looper_new (self->player);
+  self->ab_start = GST_CLOCK_TIME_NONE;
+  /* seeked to while prerolling, and ended by the segment stop */
+  if (GST_CLOCK_TIME_IS_VALID (self->range_stop)
+      && self->range_stop <= self->range_start)
+    self->range_stop = GST_CLOCK_TIME_NONE;
+  gst_player_looper_set_range (self->looper, self->range_start,
+      self->range_stop);
+  if (self->loop && g_list_length (self->uris) == 1)
+    gst_player_looper_set_enabled (self->looper, TRUE);
+
+  if (self->prefetch_size > 0)
+    self->prefetch =
+        gst_player_prefetch_new (self->player,
+        (guint64) self->prefetch_size << 20,
+        (guint64) self->prefetch_rate << 20);
+
+  if (self->low_latency_profile || self->measure_latency)
+    self->low_latency =
+        gst_player_low_latency_new (self->player, self->low_latency_profile,
+        self->measure_latency);
+
+  if (self->use_autoplug_cache || self->warm_decoders)
+    self->autoplug_cache =
+        gst_player_autoplug_cache_new (self->player, self->warm_decoders);
+
+  /* all players present the same frame at the same time */
+  if (self->sync_master_port > 0) {
+    self->net_sync =
+        gst_player_net_sync_new_master (self->player, self->sync_master_port,
+        &err);
+  } else if (self->sync_slave) {
+    gchar *host;
+    gint port;
+
+    if (gst_player_net_sync_parse_address (self->sync_slave, &host, &port)) {
+      self->net_sync =
+          gst_player_net_sync_new_slave (self->player, host, port, &err);
+      g_free (host);
+    } else {
+      g_printerr ("Invalid address '%s', expected HOST:PORT\n",
+          self->sync_slave);
+    }
+  }
+  if (err) {
+    g_printerr ("Could not synchronise with other players: %s\n",
+        err->message);
+    g_clear_error (&err);
+  }
+
+  self->hud = gtk_play_hud_new (self->player);
+  gtk_play_hud_set_looper (self->hud, self->looper);
+  gtk_play_hud_set_low_latency (self->hud, self->low_latency);
+  gtk_play_hud_set_net_sync (self->hud, self->net_sync);
+  if (self->toolbar_overlay)
+    gtk_overlay_add_overlay (GTK_OVERLAY (self->toolbar_overlay),
+        gtk_play_hud_get_widget (self->hud));
+
   g_signal_connect (self->player, "position-updated",
       G_CALLBACK (position_updated_cb), self);
   g_signal_connect (self->player, "duration-changed",
       G_CALLBACK (duration_changed_cb), self);
+  g_signal_connect (self->player, "seek-done",
+      G_CALLBACK (seek_done_cb), self);
+  g_signal_connect (self->player, "state-changed",
+      G_CALLBACK (state_changed_cb), self);
   g_signal_connect (self->player, "end-of-stream", G_CALLBACK (eos_cb), self);
   g_signal_connect (self->player, "media-info-updated",
       G_CALLBACK (media_info_updated_cb), self);
   g_signal_connect (self->player, "volume-changed",
       G_CALLBACK (player_volume_changed_cb), self);
 
+  /* GstPlayer already has a signal watch on its bus */
+  pipeline = gst_player_get_pipeline (self->player);
+  self->bus = gst_element_get_bus (pipeline);
+  gst_object_unref (pipeline);
+  self->step_done_id = g_signal_connect (self->bus, "message::step-done",
+      G_CALLBACK (step_done_cb), self);
+
   /* enable visualization (by default playbin uses goom) */
   /* if visualization is enabled then use the first element */
   gst_player_set_visualization_enabled (self->player, TRUE);
@@ -1760,6 +2502,48 @@ gtk_play_constructor (GType type, guint n_construct_params,
   return G_OBJECT (self);
 }
 
+/* everything that has to stay around until the player is gone */
+typedef struct
+{
+  GtkPlayHud *hud;
+  GstPlayerLooper *looper;
+  GstPlayerLowLatency *low_latency;
+  GstPlayerNetSync *net_sync;
+  GstPlayerAutoplugCache *autoplug_cache;
+} PlayerExtras;
+
+static PlayerExtras *
+player_extras_new (GtkPlayHud * hud, GstPlayerLooper * looper,
+    GstPlayerLowLatency * low_latency, GstPlayerNetSync * net_sync,
+    GstPlayerAutoplugCache * autoplug_cache)
+{
+  PlayerExtras *extras = g_new0 (PlayerExtras, 1);
+
+  extras->hud = hud;
+  extras->looper = looper;
+  extras->low_latency = low_latency;
+  extras->net_sync = net_sync;
+  extras->autoplug_cache = autoplug_cache;
+
+  return extras;
+}
+
+static void
+player_extras_free (PlayerExtras * extras)
+{
+  if (extras->hud)
+    gtk_play_hud_free (extras->hud);
+  if (extras->looper)
+    gst_player_looper_free (extras->looper);
+  if (extras->low_latency)
+    gst_player_low_latency_free (extras->low_latency);
+  if (extras->net_sync)
+    gst_player_net_sync_free (extras->net_sync);
+  if (extras->autoplug_cache)
+    gst_player_autoplug_cache_free (extras->autoplug_cache);
+  g_free (extras);
+}
+
 static void
 gtk_play_dispose (GObject * object)
 {
@@ -1773,12 +2557,49 @@ gtk_play_dispose (GObject * object)
   if (self->uris)
     g_list_free_full (self->uris, g_free);
   self->uris = NULL;
+  g_free (self->sync_slave);
+  self->sync_slave = NULL;
+  if (self->position_tick_id && self->seekbar)
+    gtk_widget_remove_tick_callback (self->seekbar, self->position_tick_id);
+  self->position_tick_id = 0;
+  gst_object_replace ((GstObject **) & self->clock, NULL);
+
+  if (self->frame_cache)
+    gtk_play_frame_cache_free (self->frame_cache);
+  self->frame_cache = NULL;
+  if (self->step_surface)
+    cairo_surface_destroy (self->step_surface);
+  self->step_surface = NULL;
+
+  if (self->prefetch)
+    gst_player_prefetch_free (self->prefetch);
+  self->prefetch = NULL;
+
+  if (self->bus) {
+    g_signal_handler_disconnect (self->bus, self->step_done_id);
+    gst_object_unref (self->bus);
+  }
+  self->bus = NULL;
+
   if (self->player) {
-    gst_player_stop (self->player);
-    g_object_unref (self->player);
+    g_signal_handlers_disconnect_by_data (self->player, self);
+
+    /* the HUD can only go once nothing is streaming anymore */
+    if (self->hud)
+      gtk_play_hud_set_visible (self->hud, FALSE);
+    gtk_play_reaper_dispose (self->player,
+        (GDestroyNotify) player_extras_free, player_extras_new (self->hud,
+            self->looper, self->low_latency, self->net_sync,
+            self->autoplug_cache));
+    self->hud = NULL;
+    self->looper = NULL;
+    self->low_latency = NULL;
+    self->net_sync = NULL;
+    self->autoplug_cache = NULL;
   }
   self->player = NULL;
   g_clear_object (&self->video_area);
+  g_clear_object (&self->subtitle_area);
 
   G_OBJECT_CLASS (gtk_play_parent_class)->dispose (object);
 }
@@ -1808,11 +2629,128 @@ gtk_play_class_init (GtkPlayClass * klass)
   gtk_play_properties[PROP_URIS] =
       g_param_spec_pointer ("uris", "URIs", "URIs to play",
       G_PARAM_WRITABLE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS);
+  gtk_play_properties[PROP_START] =
+      g_param_spec_uint64 ("start", "Start", "Where to start each item",
+      0, G_MAXUINT64, 0,
+      G_PARAM_WRITABLE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS);
+  gtk_play_properties[PROP_END] =
+      g_param_spec_uint64 ("end", "End",
+      "Where to end each item, GST_CLOCK_TIME_NONE for its end",
+      0, G_MAXUINT64, GST_CLOCK_TIME_NONE,
+      G_PARAM_WRITABLE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS);
+  gtk_play_properties[PROP_LOW_LATENCY] =
+      g_param_spec_boolean ("low-latency", "Low latency",
+      "Buffer as little as possible", FALSE,
+      G_PARAM_WRITABLE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS);
+  gtk_play_properties[PROP_MEASURE_LATENCY] =
+      g_param_spec_boolean ("measure-latency", "Measure latency",
+      "Measure the end-to-end latency of the latency test source", FALSE,
+      G_PARAM_WRITABLE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS);
+  gtk_play_properties[PROP_SYNC_MASTER] =
+      g_param_spec_int ("sync-master", "Sync master",
+      "Port to provide the clock for synchronised players on, 0 for none",
+      0, 65534, 0,
+      G_PARAM_WRITABLE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS);
+  gtk_play_properties[PROP_SYNC_SLAVE] =
+      g_param_spec_string ("sync-slave", "Sync slave",
+      "HOST:PORT of the player to synchronise with", NULL,
+      G_PARAM_WRITABLE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS);
+  gtk_play_properties[PROP_PREFETCH] =
+      g_param_spec_uint ("prefetch", "Prefetch",
+      "Megabytes to read ahead of the next items, 0 for none",
+      0, G_MAXUINT, 0,
+      G_PARAM_WRITABLE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS);
+  gtk_play_properties[PROP_PREFETCH_RATE] =
+      g_param_spec_uint ("prefetch-rate", "Prefetch rate",
+      "Megabytes per second to read ahead at most", 1, G_MAXUINT, 4,
+      G_PARAM_WRITABLE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS);
+  gtk_play_properties[PROP_AUTOPLUG_CACHE] =
+      g_param_spec_boolean ("autoplug-cache", "Autoplug cache",
+      "Try the elements that worked for the same kind of stream first",
+      FALSE,
+      G_PARAM_WRITABLE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS);
+  gtk_play_properties[PROP_WARM_DECODERS] =
+      g_param_spec_boolean ("warm-decoders", "Warm decoders",
+      "Load the elements of the autoplug cache in the background", FALSE,
+      G_PARAM_WRITABLE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS);
+  gtk_play_properties[PROP_SEEK_INDEX] =
+      g_param_spec_boolean ("seek-index", "Seek index",
+      "Play local files with a persistent keyframe index", FALSE,
+      G_PARAM_WRITABLE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS);
 
   g_object_class_install_properties (object_class, LAST_PROP,
       gtk_play_properties);
 }
 
+static gboolean
+mosaic_key_press_event_cb (GtkWidget * window, GdkEventKey * event,
+    GtkPlayMosaic * mosaic)
+{
+  GdkWindow *gdk_window;
+
+  if (event->state & (GDK_CONTROL_MASK | GDK_MOD1_MASK))
+    return FALSE;
+
+  switch (event->keyval) {
+    case GDK_KEY_p:
+    case GDK_KEY_space:
+      gtk_play_mosaic_set_playing (mosaic,
+          !gtk_play_mosaic_get_playing (mosaic));
+      break;
+    case GDK_KEY_f:
+      gdk_window = gtk_widget_get_window (window);
+      if (gdk_window && (gdk_window_get_state (gdk_window) &
+              GDK_WINDOW_STATE_FULLSCREEN))
+        gtk_window_unfullscreen (GTK_WINDOW (window));
+      else
+        gtk_window_fullscreen (GTK_WINDOW (window));
+      break;
+    case GDK_KEY_q:
+      gtk_widget_destroy (window);
+      break;
+    default:
+      return FALSE;
+  }
+
+  return TRUE;
+}
+
+/* --grid: all URIs at once in one window, without the player UI */
+static gboolean
+mosaic_window_new (GList * uris, guint rows, guint columns,
+    gboolean fullscreen)
+{
+  GtkPlayMosaic *mosaic;
+  GtkWidget *window;
+
+  if (g_list_length (uris) > rows * columns)
+    g_printerr ("Only showing the first %u of %u files in a %ux%u grid\n",
+        rows * columns, g_list_length (uris), rows, columns);
+
+  mosaic = gtk_play_mosaic_new (uris, rows, columns);
+  if (!mosaic)
+    return FALSE;
+
+  window = gtk_application_window_new (GTK_APPLICATION
+      (g_application_get_default ()));
+  gtk_window_set_title (GTK_WINDOW (window), APP_NAME);
+  gtk_window_set_default_size (GTK_WINDOW (window), 1280, 720);
+  gtk_container_add (GTK_CONTAINER (window),
+      gtk_play_mosaic_get_widget (mosaic));
+
+  gtk_widget_add_events (window, GDK_KEY_PRESS_MASK);
+  g_signal_connect (window, "key-press-event",
+      G_CALLBACK (mosaic_key_press_event_cb), mosaic);
+  g_signal_connect_swapped (window, "destroy",
+      G_CALLBACK (gtk_play_mosaic_free), mosaic);
+
+  if (fullscreen)
+    gtk_window_fullscreen (GTK_WINDOW (window));
+  gtk_widget_show_all (window);
+
+  return TRUE;
+}
+
 static gint
 gtk_play_app_command_line (GApplication * application,
     GApplicationCommandLine * command_line)
@@ -1820,23 +2758,64 @@ gtk_play_app_command_line (GApplication * application,
   GVariantDict *options;
   GtkPlay *play;
   GList *uris = NULL;
-  gboolean loop = FALSE, fullscreen = FALSE;
+  gboolean loop = FALSE, fullscreen = FALSE, timeshift = FALSE;
+  gboolean low_latency = FALSE, measure_latency = FALSE, segments = FALSE;
+  gboolean seek_index = FALSE, autoplug_cache = FALSE, warm_decoders = FALSE;
+  gboolean use_mmap = FALSE;
+  gint sync_master_port = 0, prefetch = 0, prefetch_rate = 4;
+  const gchar *sync_slave = NULL;
+  gdouble start = 0, end = -1;
   gchar **uris_array = NULL;
+  const gchar *grid = NULL;
+  guint rows = 0, columns = 0;
 
   options = g_application_command_line_get_options_dict (command_line);
 
   g_variant_dict_lookup (options, "loop", "b", &loop);
   g_variant_dict_lookup (options, "fullscreen", "b", &fullscreen);
+  g_variant_dict_lookup (options, "start", "d", &start);
+  g_variant_dict_lookup (options, "end", "d", &end);
+  g_variant_dict_lookup (options, "grid", "&s", &grid);
+  g_variant_dict_lookup (options, "timeshift", "b", &timeshift);
+  g_variant_dict_lookup (options, "segments", "b", &segments);
+  g_variant_dict_lookup (options, "seek-index", "b", &seek_index);
+  g_variant_dict_lookup (options, "low-latency", "b", &low_latency);
+  g_variant_dict_lookup (options, "measure-latency", "b", &measure_latency);
+  g_variant_dict_lookup (options, "sync-master", "i", &sync_master_port);
+  g_variant_dict_lookup (options, "sync-slave", "&s", &sync_slave);
+  g_variant_dict_lookup (options, "prefetch", "i", &prefetch);
+  g_variant_dict_lookup (options, "prefetch-rate", "i", &prefetch_rate);
+  g_variant_dict_lookup (options, "autoplug-cache", "b", &autoplug_cache);
+  g_variant_dict_lookup (options, "warm-decoders", "b", &warm_decoders);
+  g_variant_dict_lookup (options, "mmap", "b", &use_mmap);
   g_variant_dict_lookup (options, G_OPTION_REMAINING, "^a&ay", &uris_array);
 
+  if (use_mmap) {
+    static gboolean registered = FALSE;
+
+    if (!registered)
+      registered = gst_player_mmap_src_register ();
+  }
+
+  if (segments) {
+    static gboolean registered = FALSE;
+
+    if (!registered)
+      registered = gst_player_segments_register ();
+    segments = registered;
+  }
+
   if (uris_array) {
     gchar **p;
     GQueue uris_builder = G_QUEUE_INIT;
 
     p = uris_array;
     while (*p) {
-      g_queue_push_tail (&uris_builder, gst_uri_is_valid (*p) ?
-          g_strdup (*p) : gst_filename_to_uri (*p, NULL));
+      if (segments)
+        g_queue_push_tail (&uris_builder, gst_player_segments_make_uri (*p));
+      else
+        g_queue_push_tail (&uris_builder, gst_uri_is_valid (*p) ?
+            g_strdup (*p) : gst_filename_to_uri (*p, NULL));
       p++;
     }
     uris = uris_builder.head;
@@ -1847,9 +2826,59 @@ gtk_play_app_command_line (GApplication * application,
   if (!uris)
     return -1;
 
+  if (timeshift) {
+    static gboolean registered = FALSE;
+    GList *l;
+
+    if (!registered)
+      registered = gst_player_timeshift_register ();
+
+    for (l = uris; l && registered; l = l->next) {
+      gchar *uri = gst_player_timeshift_wrap_uri (l->data);
+
+      g_free (l->data);
+      l->data = uri;
+    }
+  }
+
+  if (seek_index) {
+    static gboolean registered = FALSE;
+
+    if (!registered)
+      registered = gst_player_seek_index_register ();
+    seek_index = registered;
+  }
+
+  if (grid) {
+    gboolean ok;
+
+    if (sscanf (grid, "%ux%u", &rows, &columns) != 2 || rows == 0
+        || columns == 0 || rows > 16 || columns > 16) {
+      g_printerr ("Invalid grid '%s', expected ROWSxCOLUMNS\n", grid);
+      g_list_free_full (uris, g_free);
+      return -1;
+    }
+
+    ok = mosaic_window_new (uris, rows, columns, fullscreen);
+    g_list_free_full (uris, g_free);
+    if (!ok)
+      return -1;
+
+    return
+        G_APPLICATION_CLASS (gtk_play_app_parent_class)->command_line
+        (application, command_line);
+  }
+
   play =
       g_object_new (gtk_play_get_type (), "loop", loop, "fullscreen",
-      fullscreen, "uris", uris, NULL);
+      fullscreen, "uris", uris, "start",
+      (guint64) (MAX (start, 0) * GST_SECOND), "end",
+      end >= 0 ? (guint64) (end * GST_SECOND) : GST_CLOCK_TIME_NONE,
+      "low-latency", low_latency, "measure-latency", measure_latency,
+      "sync-master", CLAMP (sync_master_port, 0, 65534), "sync-slave",
+      sync_slave, "prefetch", (guint) MAX (prefetch, 0), "prefetch-rate",
+      (guint) MAX (prefetch_rate, 1), "autoplug-cache", autoplug_cache,
+      "warm-decoders", warm_decoders, "seek-index", seek_index, NULL);
   gtk_widget_show_all (GTK_WIDGET (play));
 
   return
@@ -1880,6 +2909,46 @@ gtk_play_app_new (void)
     {"loop", 'l', 0, G_OPTION_ARG_NONE, NULL, "Repeat all"},
     {"fullscreen", 'f', 0, G_OPTION_ARG_NONE, NULL,
         "Show the player in fullscreen"},
+    {"start", 0, 0, G_OPTION_ARG_DOUBLE, NULL,
+        "Start playback of each item at this many seconds", "SECONDS"},
+    {"end", 0, 0, G_OPTION_ARG_DOUBLE, NULL,
+        "End playback of each item at this many seconds", "SECONDS"},
+    {"grid", 0, 0, G_OPTION_ARG_STRING, NULL,
+        "Play all files at once, composited into a grid", "ROWSxCOLUMNS"},
+    {"timeshift", 0, 0, G_OPTION_ARG_NONE, NULL,
+        "Buffer live streams so they can be paused and seeked in", NULL},
+    {"segments", 0, 0, G_OPTION_ARG_NONE, NULL,
+        "Play each directory or numbered file pattern (e.g. cam_%04d.mp4) "
+          "as one continuous item", NULL},
+    {"seek-index", 0, 0, G_OPTION_ARG_NONE, NULL,
+        "Remember where the keyframes of local files are, for fast seeking "
+          "in files without an index", NULL},
+    {"low-latency", 0, 0, G_OPTION_ARG_NONE, NULL,
+        "Buffer as little as possible, for live camera feeds", NULL},
+    {"measure-latency", 0, 0, G_OPTION_ARG_NONE, NULL,
+        "Show the end-to-end latency of a gst-play --latency-test-source "
+          "stream in the HUD", NULL},
+    {"sync-master", 0, 0, G_OPTION_ARG_INT, NULL,
+        "Provide the clock for players started with --sync-slave on PORT "
+          "and PORT+1", "PORT"},
+    {"sync-slave", 0, 0, G_OPTION_ARG_STRING, NULL,
+        "Present frames in sync with the --sync-master player at HOST:PORT",
+        "HOST:PORT"},
+    {"prefetch", 0, 0, G_OPTION_ARG_INT, NULL,
+        "Read the first MB megabytes of the next two local files ahead",
+        "MB"},
+    {"prefetch-rate", 0, 0, G_OPTION_ARG_INT, NULL,
+        "Read ahead at most this many megabytes per second (default 4)",
+        "MB"},
+    {"autoplug-cache", 0, 0, G_OPTION_ARG_NONE, NULL,
+        "Try the demuxers and decoders that worked for the same kind of "
+          "stream before first", NULL},
+    {"warm-decoders", 0, 0, G_OPTION_ARG_NONE, NULL,
+        "Like --autoplug-cache, and load those elements in the background "
+          "at startup", NULL},
+    {"mmap", 0, 0, G_OPTION_ARG_NONE, NULL,
+        "Read local files through a memory mapping instead of copying them",
+        NULL},
     {NULL}
   };
 
@@ -1913,6 +2982,8 @@ main (gint argc, gchar ** argv)
   status = g_application_run (G_APPLICATION (app), argc, argv);;
   g_object_unref (app);
 
+  gtk_play_reaper_flush ();
+
   gst_deinit ();
   return status;
 }
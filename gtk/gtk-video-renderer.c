@@ -18,7 +18,31 @@
  * Boston, MA 02110-1301, USA.
  */
 
+#include <string.h>
+
+#include <gst/video/video.h>
+
 #include "gtk-video-renderer.h"
+#include "gst-player-frame-pacing.h"
+
+/* cairo's native 32 bit RGB layout, which gtksink can use without another
+ * conversion */
+#if G_BYTE_ORDER == G_LITTLE_ENDIAN
+#define SOFTWARE_SINK_FORMAT "BGRx"
+#else
+#define SOFTWARE_SINK_FORMAT "xRGB"
+#endif
+
+/* how long the widget size has to be stable before renegotiating */
+#define RESIZE_DEBOUNCE_INTERVAL 200
+
+typedef struct
+{
+  cairo_surface_t *surface;
+  gint x, y;
+  guint width, height;
+  gdouble alpha;
+} SubtitleRectangle;
 
 struct _GstPlayerGtkVideoRenderer
 {
@@ -26,6 +50,37 @@ struct _GstPlayerGtkVideoRenderer
 
   GstElement *sink;
   GtkWidget *widget;
+
+  /* only for the software gtksink, subtitles are drawn separately then
+   * instead of being blended into every frame */
+  GtkWidget *subtitle_widget;
+  GstPad *sink_pad;
+  gulong sink_probe_id;
+
+  /* only for the software gtksink, frames are scaled down to the widget
+   * size upstream of the sink instead of by cairo on the UI thread */
+  GstElement *capsfilter;
+  guint resize_timeout_id;
+
+  GMutex lock;
+  /* protected by lock */
+  gint widget_width, widget_height;
+  GstVideoInfo info;
+  gboolean have_info;
+  gboolean have_composition;
+  guint composition_seqnum;
+  GList *rectangles;
+  gboolean rectangles_changed;
+
+  /* frame pacing, intended presentation time against the time the widget
+   * actually drew the frame */
+  GstPlayerFramePacing *pacing;
+  GstPad *pacing_pad;
+  gulong pacing_probe_id;
+
+  /* main thread only, the rasterised layer for the current widget size */
+  cairo_surface_t *layer;
+  gint layer_width, layer_height;
 };
 
 struct _GstPlayerGtkVideoRendererClass
@@ -41,6 +96,9 @@ enum
 {
   GTK_VIDEO_RENDERER_PROP_0,
   GTK_VIDEO_RENDERER_PROP_WIDGET,
+  GTK_VIDEO_RENDERER_PROP_SUBTITLE_WIDGET,
+  GTK_VIDEO_RENDERER_PROP_STATS,
+  GTK_VIDEO_RENDERER_PROP_ADAPTIVE,
   GTK_VIDEO_RENDERER_PROP_LAST
 };
 
@@ -52,6 +110,25 @@ G_DEFINE_TYPE_WITH_CODE (GstPlayerGtkVideoRenderer,
 static GParamSpec
     * gtk_video_renderer_param_specs[GTK_VIDEO_RENDERER_PROP_LAST] = { NULL, };
 
+static GstStructure *pacing_get_stats (GstPlayerGtkVideoRenderer * self);
+
+static void
+gst_player_gtk_video_renderer_set_property (GObject * object,
+    guint prop_id, const GValue * value, GParamSpec * pspec)
+{
+  GstPlayerGtkVideoRenderer *self = GST_PLAYER_GTK_VIDEO_RENDERER (object);
+
+  switch (prop_id) {
+    case GTK_VIDEO_RENDERER_PROP_ADAPTIVE:
+      gst_player_frame_pacing_set_adaptive (self->pacing,
+          g_value_get_boolean (value));
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
 static void
 gst_player_gtk_video_renderer_get_property (GObject * object,
     guint prop_id, GValue * value, GParamSpec * pspec)
@@ -62,21 +139,583 @@ gst_player_gtk_video_renderer_get_property (GObject * object,
     case GTK_VIDEO_RENDERER_PROP_WIDGET:
       g_value_set_object (value, self->widget);
       break;
+    case GTK_VIDEO_RENDERER_PROP_SUBTITLE_WIDGET:
+      g_value_set_object (value, self->subtitle_widget);
+      break;
+    case GTK_VIDEO_RENDERER_PROP_STATS:
+      g_value_take_boxed (value, pacing_get_stats (self));
+      break;
+    case GTK_VIDEO_RENDERER_PROP_ADAPTIVE:
+      g_value_set_boolean (value,
+          gst_player_frame_pacing_get_adaptive (self->pacing));
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
   }
 }
 
+static void
+subtitle_rectangle_free (SubtitleRectangle * rect)
+{
+  cairo_surface_destroy (rect->surface);
+  g_free (rect);
+}
+
+/* Rasterises the rectangles once per cue, the overlay's unscaled ARGB
+ * pixels are in the same layout as CAIRO_FORMAT_ARGB32 on every
+ * endianness */
+static GList *
+subtitle_rectangles_from_composition (GstVideoOverlayComposition * comp)
+{
+  GList *rectangles = NULL;
+  guint i, n;
+
+  n = gst_video_overlay_composition_n_rectangles (comp);
+  for (i = 0; i < n; i++) {
+    GstVideoOverlayRectangle *rectangle;
+    SubtitleRectangle *rect;
+    GstVideoMeta *vmeta;
+    GstBuffer *pixels;
+    GstMapInfo map;
+    guint8 *data;
+    gint stride, row;
+
+    rectangle = gst_video_overlay_composition_get_rectangle (comp, i);
+    pixels = gst_video_overlay_rectangle_get_pixels_unscaled_argb (rectangle,
+        GST_VIDEO_OVERLAY_FORMAT_FLAG_PREMULTIPLIED_ALPHA);
+    vmeta = pixels ? gst_buffer_get_video_meta (pixels) : NULL;
+    if (!vmeta || !gst_buffer_map (pixels, &map, GST_MAP_READ))
+      continue;
+
+    rect = g_new0 (SubtitleRectangle, 1);
+    gst_video_overlay_rectangle_get_render_rectangle (rectangle, &rect->x,
+        &rect->y, &rect->width, &rect->height);
+    rect->alpha = gst_video_overlay_rectangle_get_global_alpha (rectangle);
+
+    rect->surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32,
+        vmeta->width, vmeta->height);
+    cairo_surface_flush (rect->surface);
+    data = cairo_image_surface_get_data (rect->surface);
+    stride = cairo_image_surface_get_stride (rect->surface);
+    for (row = 0; row < vmeta->height; row++)
+      memcpy (data + row * stride,
+          map.data + vmeta->offset[0] + row * vmeta->stride[0],
+          vmeta->width * 4);
+    cairo_surface_mark_dirty (rect->surface);
+
+    gst_buffer_unmap (pixels, &map);
+
+    rectangles = g_list_append (rectangles, rect);
+  }
+
+  return rectangles;
+}
+
+static gboolean
+subtitle_queue_draw (GtkWidget * widget)
+{
+  gtk_widget_queue_draw (widget);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+subtitle_set_rectangles (GstPlayerGtkVideoRenderer * self,
+    GList * rectangles, gboolean have_composition, guint seqnum)
+{
+  g_mutex_lock (&self->lock);
+  g_list_free_full (self->rectangles, (GDestroyNotify) subtitle_rectangle_free);
+  self->rectangles = rectangles;
+  self->have_composition = have_composition;
+  self->composition_seqnum = seqnum;
+  self->rectangles_changed = TRUE;
+  g_mutex_unlock (&self->lock);
+
+  g_main_context_invoke_full (NULL, G_PRIORITY_DEFAULT,
+      (GSourceFunc) subtitle_queue_draw, g_object_ref (self->subtitle_widget),
+      g_object_unref);
+}
+
+static void
+subtitle_layer_update (GstPlayerGtkVideoRenderer * self, GtkWidget * widget,
+    gint width, gint height)
+{
+  gdouble dar, out_x, out_y, out_width, out_height, scale_x, scale_y;
+  GList *l;
+  cairo_t *cr;
+
+  if (!self->rectangles_changed && self->layer_width == width
+      && self->layer_height == height)
+    return;
+
+  if (self->layer)
+    cairo_surface_destroy (self->layer);
+  self->layer = NULL;
+  self->layer_width = width;
+  self->layer_height = height;
+  self->rectangles_changed = FALSE;
+
+  if (!self->rectangles || !self->have_info || width <= 0 || height <= 0)
+    return;
+
+  /* gtksink letterboxes the video, place the subtitles the same way */
+  dar = (gdouble) GST_VIDEO_INFO_WIDTH (&self->info) *
+      GST_VIDEO_INFO_PAR_N (&self->info) /
+      (GST_VIDEO_INFO_HEIGHT (&self->info) *
+      GST_VIDEO_INFO_PAR_D (&self->info));
+  if ((gdouble) width / height > dar) {
+    out_height = height;
+    out_width = height * dar;
+  } else {
+    out_width = width;
+    out_height = width / dar;
+  }
+  out_x = (width - out_width) / 2;
+  out_y = (height - out_height) / 2;
+  scale_x = out_width / GST_VIDEO_INFO_WIDTH (&self->info);
+  scale_y = out_height / GST_VIDEO_INFO_HEIGHT (&self->info);
+
+  self->layer =
+      gdk_window_create_similar_image_surface (gtk_widget_get_window (widget),
+      CAIRO_FORMAT_ARGB32, width, height, 0);
+  cr = cairo_create (self->layer);
+  for (l = self->rectangles; l; l = l->next) {
+    SubtitleRectangle *rect = l->data;
+
+    cairo_save (cr);
+    cairo_translate (cr, out_x + rect->x * scale_x, out_y + rect->y * scale_y);
+    cairo_scale (cr,
+        rect->width * scale_x /
+        cairo_image_surface_get_width (rect->surface),
+        rect->height * scale_y /
+        cairo_image_surface_get_height (rect->surface));
+    cairo_set_source_surface (cr, rect->surface, 0, 0);
+    cairo_paint_with_alpha (cr, rect->alpha);
+    cairo_restore (cr);
+  }
+  cairo_destroy (cr);
+}
+
+static gboolean
+subtitle_draw_cb (GtkWidget * widget, cairo_t * cr,
+    GstPlayerGtkVideoRenderer * self)
+{
+  g_mutex_lock (&self->lock);
+  subtitle_layer_update (self, widget, gtk_widget_get_allocated_width (widget),
+      gtk_widget_get_allocated_height (widget));
+  g_mutex_unlock (&self->lock);
+
+  if (self->layer) {
+    cairo_set_source_surface (cr, self->layer, 0, 0);
+    cairo_paint (cr);
+  }
+
+  return FALSE;
+}
+
+static gboolean
+caps_has_overlay_feature (GstCaps * caps)
+{
+  guint i;
+
+  for (i = 0; i < gst_caps_get_size (caps); i++) {
+    GstCapsFeatures *f = gst_caps_get_features (caps, i);
+
+    if (f && gst_caps_features_contains (f,
+            GST_CAPS_FEATURE_META_GST_VIDEO_OVERLAY_COMPOSITION))
+      return TRUE;
+  }
+
+  return FALSE;
+}
+
+static GstCaps *
+caps_remove_overlay_feature (GstCaps * caps)
+{
+  GstCaps *result = gst_caps_copy (caps);
+  guint i;
+
+  for (i = 0; i < gst_caps_get_size (result); i++) {
+    GstCapsFeatures *f = gst_caps_get_features (result, i);
+
+    if (!f || gst_caps_features_is_any (f))
+      continue;
+
+    gst_caps_features_remove (f,
+        GST_CAPS_FEATURE_META_GST_VIDEO_OVERLAY_COMPOSITION);
+    if (gst_caps_features_get_size (f) == 0)
+      gst_caps_set_features (result, i, NULL);
+  }
+
+  return result;
+}
+
+static GstCaps *
+caps_add_overlay_feature (GstCaps * caps)
+{
+  GstCaps *result = gst_caps_copy (caps);
+  guint i;
+
+  for (i = 0; i < gst_caps_get_size (result); i++) {
+    GstCapsFeatures *f = gst_caps_get_features (result, i);
+
+    if (f && !gst_caps_features_is_any (f) && !gst_caps_features_contains (f,
+            GST_CAPS_FEATURE_META_GST_VIDEO_OVERLAY_COMPOSITION))
+      gst_caps_features_add (f,
+          GST_CAPS_FEATURE_META_GST_VIDEO_OVERLAY_COMPOSITION);
+  }
+
+  /* prefer the meta, but keep the plain caps as a fallback */
+  gst_caps_append (result, gst_caps_ref (caps));
+
+  return result;
+}
+
+/* runs the sink's own query handler, bypassing our probe */
+static gboolean
+sink_pad_query (GstPad * pad, GstQuery * query)
+{
+  GstObject *parent;
+  gboolean res;
+
+  parent = gst_object_get_parent (GST_OBJECT (pad));
+  res = GST_PAD_QUERYFUNC (pad) (pad, parent, query);
+  if (parent)
+    gst_object_unref (parent);
+
+  return res;
+}
+
+/* gtksink itself knows nothing about the overlay composition meta, so we
+ * advertise it on its behalf. textoverlay then attaches the subtitles as
+ * meta instead of blending them into a writable copy of every frame */
+static GstPadProbeReturn
+sink_pad_query_probe (GstPad * pad, GstQuery * query)
+{
+  switch (GST_QUERY_TYPE (query)) {
+    case GST_QUERY_CAPS:{
+      GstCaps *filter, *stripped = NULL, *caps, *result;
+      GstQuery *sub;
+
+      gst_query_parse_caps (query, &filter);
+      if (filter)
+        stripped = caps_remove_overlay_feature (filter);
+
+      sub = gst_query_new_caps (stripped);
+      if (!sink_pad_query (pad, sub)) {
+        gst_query_unref (sub);
+        if (stripped)
+          gst_caps_unref (stripped);
+        return GST_PAD_PROBE_OK;
+      }
+      gst_query_parse_caps_result (sub, &caps);
+      result = caps_add_overlay_feature (caps);
+      gst_query_unref (sub);
+
+      if (filter) {
+        GstCaps *tmp = gst_caps_intersect_full (filter, result,
+            GST_CAPS_INTERSECT_FIRST);
+
+        gst_caps_unref (result);
+        gst_caps_unref (stripped);
+        result = tmp;
+      }
+
+      gst_query_set_caps_result (query, result);
+      gst_caps_unref (result);
+
+      return GST_PAD_PROBE_HANDLED;
+    }
+    case GST_QUERY_ACCEPT_CAPS:{
+      GstCaps *caps, *stripped;
+      GstQuery *sub;
+      gboolean result = FALSE;
+
+      gst_query_parse_accept_caps (query, &caps);
+      if (!caps_has_overlay_feature (caps))
+        return GST_PAD_PROBE_OK;
+
+      stripped = caps_remove_overlay_feature (caps);
+      sub = gst_query_new_accept_caps (stripped);
+      if (sink_pad_query (pad, sub))
+        gst_query_parse_accept_caps_result (sub, &result);
+      gst_query_unref (sub);
+      gst_caps_unref (stripped);
+
+      gst_query_set_accept_caps_result (query, result);
+
+      return GST_PAD_PROBE_HANDLED;
+    }
+    case GST_QUERY_ALLOCATION:
+      /* the caps in the query might carry the feature, but gtksink only
+       * looks at the video info so it does not care */
+      sink_pad_query (pad, query);
+      gst_query_add_allocation_meta (query,
+          GST_VIDEO_OVERLAY_COMPOSITION_META_API_TYPE, NULL);
+
+      return GST_PAD_PROBE_HANDLED;
+    default:
+      return GST_PAD_PROBE_OK;
+  }
+}
+
+static void
+update_output_caps (GstPlayerGtkVideoRenderer * self)
+{
+  GstCaps *caps, *old_caps = NULL;
+  gint width = 0, height = 0;
+
+  if (!self->capsfilter)
+    return;
+
+  g_mutex_lock (&self->lock);
+  if (self->have_info && self->widget_width > 0 && self->widget_height > 0) {
+    gdouble display_width, display_height, scale;
+
+    display_width = (gdouble) GST_VIDEO_INFO_WIDTH (&self->info) *
+        GST_VIDEO_INFO_PAR_N (&self->info) / GST_VIDEO_INFO_PAR_D (&self->info);
+    display_height = GST_VIDEO_INFO_HEIGHT (&self->info);
+
+    /* fit into the widget keeping the display aspect ratio, but never
+     * upscale as gtksink can do that for free while drawing */
+    scale = MIN (self->widget_width / display_width,
+        self->widget_height / display_height);
+    scale = MIN (scale, 1.0);
+
+    width = MAX (1, (gint) (display_width * scale + 0.5));
+    height = MAX (1, (gint) (display_height * scale + 0.5));
+  }
+  g_mutex_unlock (&self->lock);
+
+  caps = gst_caps_new_simple ("video/x-raw",
+      "format", G_TYPE_STRING, SOFTWARE_SINK_FORMAT,
+      "pixel-aspect-ratio", GST_TYPE_FRACTION, 1, 1, NULL);
+  if (width > 0 && height > 0)
+    gst_caps_set_simple (caps, "width", G_TYPE_INT, width,
+        "height", G_TYPE_INT, height, NULL);
+
+  /* the capsfilter triggers a reconfigure upstream on changes */
+  g_object_get (self->capsfilter, "caps", &old_caps, NULL);
+  if (!old_caps || !gst_caps_is_equal (old_caps, caps))
+    g_object_set (self->capsfilter, "caps", caps, NULL);
+  if (old_caps)
+    gst_caps_unref (old_caps);
+  gst_caps_unref (caps);
+}
+
+static gboolean
+resize_timeout_cb (GstPlayerGtkVideoRenderer * self)
+{
+  self->resize_timeout_id = 0;
+  update_output_caps (self);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+widget_size_allocate_cb (GtkWidget * widget, GdkRectangle * allocation,
+    GstPlayerGtkVideoRenderer * self)
+{
+  gint scale, width, height;
+  gboolean first;
+
+  scale = gtk_widget_get_scale_factor (widget);
+  width = allocation->width * scale;
+  height = allocation->height * scale;
+
+  g_mutex_lock (&self->lock);
+  if (width == self->widget_width && height == self->widget_height) {
+    g_mutex_unlock (&self->lock);
+    return;
+  }
+  first = self->widget_width == 0 || self->widget_height == 0;
+  self->widget_width = width;
+  self->widget_height = height;
+  g_mutex_unlock (&self->lock);
+
+  if (self->resize_timeout_id)
+    g_source_remove (self->resize_timeout_id);
+  self->resize_timeout_id = 0;
+
+  /* renegotiating is expensive, wait until resizing is over */
+  if (first)
+    update_output_caps (self);
+  else
+    self->resize_timeout_id = g_timeout_add (RESIZE_DEBOUNCE_INTERVAL,
+        (GSourceFunc) resize_timeout_cb, self);
+}
+
+static GstPadProbeReturn
+pacing_probe_cb (GstPad * pad, GstPadProbeInfo * info,
+    GstPlayerGtkVideoRenderer * self)
+{
+  gst_player_frame_pacing_sink_probe (self->pacing, info);
+
+  return GST_PAD_PROBE_OK;
+}
+
+static gboolean
+pacing_draw_cb (GtkWidget * widget, cairo_t * cr,
+    GstPlayerGtkVideoRenderer * self)
+{
+  gst_player_frame_pacing_frame_shown (self->pacing);
+
+  return FALSE;
+}
+
+static GstStructure *
+pacing_get_stats (GstPlayerGtkVideoRenderer * self)
+{
+  GValue histogram = G_VALUE_INIT, bounds = G_VALUE_INIT, v = G_VALUE_INIT;
+  GstPlayerFramePacingStats stats;
+  GstStructure *s;
+  guint i;
+
+  gst_player_frame_pacing_get_stats (self->pacing, &stats);
+
+  s = gst_structure_new ("application/x-gst-player-frame-pacing",
+      "presented", G_TYPE_UINT64, stats.presented,
+      "skipped", G_TYPE_UINT64, stats.skipped,
+      "dropped-early", G_TYPE_UINT64, stats.dropped_early,
+      "mean-delay", G_TYPE_INT64, (gint64) stats.mean_delay,
+      "jitter", G_TYPE_INT64, (gint64) stats.jitter,
+      "max-delay", G_TYPE_INT64, (gint64) stats.max_delay, NULL);
+
+  g_value_init (&histogram, GST_TYPE_ARRAY);
+  g_value_init (&v, G_TYPE_UINT64);
+  for (i = 0; i < G_N_ELEMENTS (stats.histogram); i++) {
+    g_value_set_uint64 (&v, stats.histogram[i]);
+    gst_value_array_append_value (&histogram, &v);
+  }
+  g_value_unset (&v);
+
+  g_value_init (&bounds, GST_TYPE_ARRAY);
+  g_value_init (&v, G_TYPE_INT);
+  for (i = 0; i < G_N_ELEMENTS (stats.histogram_bounds); i++) {
+    g_value_set_int (&v, stats.histogram_bounds[i]);
+    gst_value_array_append_value (&bounds, &v);
+  }
+  g_value_unset (&v);
+
+  gst_structure_take_value (s, "histogram", &histogram);
+  gst_structure_take_value (s, "histogram-bounds", &bounds);
+
+  return s;
+}
+
+static GstPadProbeReturn
+sink_pad_probe_cb (GstPad * pad, GstPadProbeInfo * info,
+    GstPlayerGtkVideoRenderer * self)
+{
+  if (GST_PAD_PROBE_INFO_TYPE (info) & GST_PAD_PROBE_TYPE_QUERY_DOWNSTREAM) {
+    if (!self->subtitle_widget)
+      return GST_PAD_PROBE_OK;
+
+    return sink_pad_query_probe (pad, GST_PAD_PROBE_INFO_QUERY (info));
+  }
+
+  if (GST_PAD_PROBE_INFO_TYPE (info) & (GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM |
+          GST_PAD_PROBE_TYPE_EVENT_FLUSH)) {
+    GstEvent *event = GST_PAD_PROBE_INFO_EVENT (info);
+
+    gst_player_frame_pacing_entry_probe (self->pacing, info);
+
+    if (!self->subtitle_widget) {
+      /* nothing else to do for sinks that handle subtitles themselves */
+    } else if (GST_EVENT_TYPE (event) == GST_EVENT_CAPS) {
+      GstCaps *caps;
+
+      gst_event_parse_caps (event, &caps);
+
+      g_mutex_lock (&self->lock);
+      self->have_info = gst_video_info_from_caps (&self->info, caps);
+      self->rectangles_changed = TRUE;
+      g_mutex_unlock (&self->lock);
+
+      update_output_caps (self);
+
+      if (caps_has_overlay_feature (caps)) {
+        GstCaps *stripped = caps_remove_overlay_feature (caps);
+
+        GST_PAD_PROBE_INFO_DATA (info) = gst_event_new_caps (stripped);
+        gst_caps_unref (stripped);
+        gst_event_unref (event);
+      }
+    } else if (GST_EVENT_TYPE (event) == GST_EVENT_STREAM_START) {
+      subtitle_set_rectangles (self, NULL, FALSE, 0);
+    }
+
+    return GST_PAD_PROBE_OK;
+  }
+
+  if (GST_PAD_PROBE_INFO_TYPE (info) & GST_PAD_PROBE_TYPE_BUFFER) {
+    GstVideoOverlayCompositionMeta *meta;
+    GstVideoOverlayComposition *comp = NULL;
+    gboolean unchanged;
+    guint seqnum = 0;
+
+    if (gst_player_frame_pacing_entry_probe (self->pacing, info))
+      return GST_PAD_PROBE_DROP;
+
+    if (!self->subtitle_widget)
+      return GST_PAD_PROBE_OK;
+
+    meta = gst_buffer_get_video_overlay_composition_meta
+        (GST_PAD_PROBE_INFO_BUFFER (info));
+    if (meta) {
+      comp = meta->overlay;
+      seqnum = gst_video_overlay_composition_get_seqnum (comp);
+    }
+
+    /* the overlay reuses its composition for as long as the text stays
+     * the same, only rasterise again when that changes */
+    g_mutex_lock (&self->lock);
+    unchanged = (comp != NULL) == self->have_composition
+        && seqnum == self->composition_seqnum;
+    g_mutex_unlock (&self->lock);
+
+    if (!unchanged)
+      subtitle_set_rectangles (self,
+          comp ? subtitle_rectangles_from_composition (comp) : NULL,
+          comp != NULL, seqnum);
+  }
+
+  return GST_PAD_PROBE_OK;
+}
+
 static void
 gst_player_gtk_video_renderer_finalize (GObject * object)
 {
   GstPlayerGtkVideoRenderer *self = GST_PLAYER_GTK_VIDEO_RENDERER (object);
 
+  if (self->sink_pad) {
+    gst_pad_remove_probe (self->sink_pad, self->sink_probe_id);
+    gst_object_unref (self->sink_pad);
+  }
+  if (self->pacing_pad) {
+    gst_pad_remove_probe (self->pacing_pad, self->pacing_probe_id);
+    gst_object_unref (self->pacing_pad);
+  }
+  gst_player_frame_pacing_free (self->pacing);
+  if (self->resize_timeout_id)
+    g_source_remove (self->resize_timeout_id);
+  if (self->capsfilter)
+    gst_object_unref (self->capsfilter);
   if (self->sink)
     gst_object_unref (self->sink);
-  if (self->widget)
+  if (self->widget) {
+    g_signal_handlers_disconnect_by_data (self->widget, self);
     g_object_unref (self->widget);
+  }
+  if (self->subtitle_widget) {
+    g_signal_handlers_disconnect_by_data (self->subtitle_widget, self);
+    g_object_unref (self->subtitle_widget);
+  }
+  if (self->layer)
+    cairo_surface_destroy (self->layer);
+  g_list_free_full (self->rectangles, (GDestroyNotify) subtitle_rectangle_free);
+  g_mutex_clear (&self->lock);
 
   G_OBJECT_CLASS
       (gst_player_gtk_video_renderer_parent_class)->finalize (object);
@@ -88,6 +727,7 @@ static void
 {
   GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
 
+  gobject_class->set_property = gst_player_gtk_video_renderer_set_property;
   gobject_class->get_property = gst_player_gtk_video_renderer_get_property;
   gobject_class->finalize = gst_player_gtk_video_renderer_finalize;
 
@@ -97,14 +737,95 @@ static void
       "Widget to render the video into", GTK_TYPE_WIDGET,
       G_PARAM_READABLE | G_PARAM_STATIC_STRINGS);
 
+  gtk_video_renderer_param_specs
+      [GTK_VIDEO_RENDERER_PROP_SUBTITLE_WIDGET] =
+      g_param_spec_object ("subtitle-widget", "Subtitle Widget",
+      "Widget to overlay on top of the video widget for drawing subtitles, "
+      "or NULL if the sink renders them itself", GTK_TYPE_WIDGET,
+      G_PARAM_READABLE | G_PARAM_STATIC_STRINGS);
+
+  gtk_video_renderer_param_specs
+      [GTK_VIDEO_RENDERER_PROP_STATS] =
+      g_param_spec_boxed ("stats", "Statistics",
+      "Frame pacing statistics, delays between the intended and the actual "
+      "presentation time of the frames", GST_TYPE_STRUCTURE,
+      G_PARAM_READABLE | G_PARAM_STATIC_STRINGS);
+
+  gtk_video_renderer_param_specs
+      [GTK_VIDEO_RENDERER_PROP_ADAPTIVE] =
+      g_param_spec_boolean ("adaptive", "Adaptive",
+      "Drop late frames before colour conversion", FALSE,
+      G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
   g_object_class_install_properties (gobject_class,
       GTK_VIDEO_RENDERER_PROP_LAST, gtk_video_renderer_param_specs);
 }
 
+static void
+set_n_threads (GstElement * element)
+{
+  if (g_object_class_find_property (G_OBJECT_GET_CLASS (element),
+          "n-threads"))
+    g_object_set (element, "n-threads", 0, NULL);
+}
+
+/* Wraps gtksink into a bin that scales and converts in a multithreaded
+ * converter, or returns NULL if those are not available */
+static GstElement *
+create_software_sink (GstPlayerGtkVideoRenderer * self, GstElement * gtk_sink)
+{
+  GstElement *bin, *first, *last;
+  GstPad *pad;
+
+  bin = gst_bin_new ("gtksinkbin");
+
+  first = last = gst_element_factory_make ("videoconvertscale", NULL);
+  if (first) {
+    set_n_threads (first);
+    gst_bin_add (GST_BIN (bin), first);
+  } else {
+    first = gst_element_factory_make ("videoscale", NULL);
+    last = gst_element_factory_make ("videoconvert", NULL);
+    if (!first || !last) {
+      if (first)
+        gst_object_unref (first);
+      if (last)
+        gst_object_unref (last);
+      gst_object_unref (bin);
+      return NULL;
+    }
+
+    /* scale first, so the conversion only touches the smaller frames */
+    set_n_threads (first);
+    set_n_threads (last);
+    gst_bin_add_many (GST_BIN (bin), first, last, NULL);
+    gst_element_link_pads (first, "src", last, "sink");
+  }
+
+  self->capsfilter = gst_element_factory_make ("capsfilter", NULL);
+  gst_bin_add_many (GST_BIN (bin), gst_object_ref (self->capsfilter),
+      gst_object_ref (gtk_sink), NULL);
+  gst_element_link_pads (last, "src", self->capsfilter, "sink");
+  gst_element_link_pads (self->capsfilter, "src", gtk_sink, "sink");
+
+  pad = gst_element_get_static_pad (first, "sink");
+  gst_element_add_pad (bin, gst_ghost_pad_new ("sink", pad));
+  gst_object_unref (pad);
+
+  update_output_caps (self);
+
+  return bin;
+}
+
 static void
 gst_player_gtk_video_renderer_init (GstPlayerGtkVideoRenderer * self)
 {
-  GstElement *gtk_sink = gst_element_factory_make ("gtkglsink", NULL);
+  GstElement *gtk_sink;
+
+  g_mutex_init (&self->lock);
+  self->pacing = gst_player_frame_pacing_new ();
+
+  gtk_sink = gst_element_factory_make ("gtkglsink", NULL);
 
   if (gtk_sink) {
     GstElement *sink = gst_element_factory_make ("glsinkbin", NULL);
@@ -114,13 +835,41 @@ gst_player_gtk_video_renderer_init (GstPlayerGtkVideoRenderer * self)
   } else {
     gtk_sink = gst_element_factory_make ("gtksink", NULL);
 
-    self->sink = gst_object_ref (gtk_sink);
+    self->sink = create_software_sink (self, gtk_sink);
+    if (!self->sink)
+      self->sink = gst_object_ref (gtk_sink);
+
+    self->subtitle_widget = g_object_ref_sink (gtk_drawing_area_new ());
+    g_signal_connect (self->subtitle_widget, "draw",
+        G_CALLBACK (subtitle_draw_cb), self);
   }
 
   g_assert (self->sink != NULL);
 
+  /* everything upstream of any conversion */
+  self->sink_pad = gst_element_get_static_pad (self->sink, "sink");
+  self->sink_probe_id = gst_pad_add_probe (self->sink_pad,
+      GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM |
+      GST_PAD_PROBE_TYPE_EVENT_FLUSH | GST_PAD_PROBE_TYPE_QUERY_DOWNSTREAM |
+      GST_PAD_PROBE_TYPE_PUSH, (GstPadProbeCallback) sink_pad_probe_cb,
+      self, NULL);
+
+  gst_player_frame_pacing_set_sink (self->pacing, gtk_sink);
+  self->pacing_pad = gst_element_get_static_pad (gtk_sink, "sink");
+  self->pacing_probe_id = gst_pad_add_probe (self->pacing_pad,
+      GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM |
+      GST_PAD_PROBE_TYPE_EVENT_FLUSH,
+      (GstPadProbeCallback) pacing_probe_cb, self, NULL);
+
   g_object_get (gtk_sink, "widget", &self->widget, NULL);
   gst_object_unref (gtk_sink);
+
+  g_signal_connect_after (self->widget, "draw", G_CALLBACK (pacing_draw_cb),
+      self);
+
+  if (self->capsfilter)
+    g_signal_connect (self->widget, "size-allocate",
+        G_CALLBACK (widget_size_allocate_cb), self);
 }
 
 static GstElement *gst_player_gtk_video_renderer_create_video_sink
@@ -176,3 +925,22 @@ GtkWidget *gst_player_gtk_video_renderer_get_widget
 
   return widget;
 }
+
+/**
+ * gst_player_gtk_video_renderer_get_subtitle_widget:
+ * @self: #GstPlayerVideoRenderer instance
+ *
+ * Returns: (transfer full) (nullable): The GtkWidget that draws subtitles,
+ *   to be overlaid on top of the video widget
+ */
+GtkWidget *gst_player_gtk_video_renderer_get_subtitle_widget
+    (GstPlayerGtkVideoRenderer * self)
+{
+  GtkWidget *widget;
+
+  g_return_val_if_fail (GST_IS_PLAYER_GTK_VIDEO_RENDERER (self), NULL);
+
+  g_object_get (self, "subtitle-widget", &widget, NULL);
+
+  return widget;
+}
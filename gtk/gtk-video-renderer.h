@@ -43,6 +43,7 @@ GType gst_player_gtk_video_renderer_get_type (void);
 
 GstPlayerVideoRenderer * gst_player_gtk_video_renderer_new (void);
 GtkWidget * gst_player_gtk_video_renderer_get_widget (GstPlayerGtkVideoRenderer * self);
+GtkWidget * gst_player_gtk_video_renderer_get_subtitle_widget (GstPlayerGtkVideoRenderer * self);
 
 G_END_DECLS
 
@@ -20,12 +20,15 @@
 
 #include <QApplication>
 #include <QQmlApplicationEngine>
+#include <QQmlContext>
 #include <QCommandLineParser>
 #include <QStringList>
 #include <QUrl>
 
 #include "player.h"
 #include "imagesample.h"
+#include "playlistmodel.h"
+#include "softwarerenderer.h"
 
 int main(int argc, char *argv[])
 {
@@ -37,6 +40,9 @@ int main(int argc, char *argv[])
     parser.addHelpOption();
     parser.addPositionalArgument("urls",
         QCoreApplication::translate("main", "URLs to play, optionally."), "[urls...]");
+    QCommandLineOption softwareOption("software",
+        QCoreApplication::translate("main", "Render video without OpenGL."));
+    parser.addOption(softwareOption);
     parser.process(app);
 
     QList<QUrl> media_files;
@@ -48,30 +54,54 @@ int main(int argc, char *argv[])
 
     qmlRegisterType<Player>("Player", 1, 0, "Player");
     qmlRegisterType<ImageSample>("ImageSample", 1, 0, "ImageSample");
+    qmlRegisterType<SoftwareVideoItem>("SoftwareVideoItem", 1, 0, "SoftwareVideoItem");
+    qmlRegisterType<PlaylistModel>("PlaylistModel", 1, 0, "PlaylistModel");
 
     /* the plugin must be loaded before loading the qml file to register the
      * GstGLVideoItem qml item
      * FIXME Add a QQmlExtensionPlugin into qmlglsink to register GstGLVideoItem
      * with the QML engine, then remove this */
     gst_init(NULL,NULL);
-    GstElement *sink = gst_element_factory_make ("qmlglsink", NULL);
-    gst_object_unref(sink);
+    bool software = parser.isSet(softwareOption);
+    if (!software) {
+        GstElement *sink = gst_element_factory_make ("qmlglsink", NULL);
+        GstElementFactory *bin = gst_element_factory_find ("glsinkbin");
+
+        // no GL at all, e.g. on headless machines
+        software = !sink || !bin;
+        if (sink) gst_object_unref(sink);
+        if (bin) gst_object_unref(bin);
+    }
+    Player::setSoftwareRendering(software);
+
 
+    {
+        // declared before the engine, so it outlives the bindings to it
+        PlaylistModel playlist;
+        playlist.setUrls(media_files);
 
-    QQmlApplicationEngine engine;
-    engine.load(QUrl(QStringLiteral("qrc:/main.qml")));
+        QQmlApplicationEngine engine;
+        engine.rootContext()->setContextProperty("softwareRendering", software);
+        engine.rootContext()->setContextProperty("playlistModel", &playlist);
+        // the engine owns the provider
+        engine.addImageProvider("playlist",
+                                new PlaylistThumbnailProvider(&playlist));
+        engine.load(QUrl(QStringLiteral("qrc:/main.qml")));
 
-    QObject *rootObject = engine.rootObjects().first();
+        QObject *rootObject = engine.rootObjects().first();
 
-    Player *player = rootObject->findChild<Player*>("player");
+        Player *player = rootObject->findChild<Player*>("player");
 
-    QQuickItem *videoItem = rootObject->findChild<QQuickItem*>("videoItem");
-    player->setVideoOutput(videoItem);
+        QQuickItem *videoItem = rootObject->findChild<QQuickItem*>("videoItem");
+        player->setVideoOutput(videoItem);
 
-    if (!media_files.isEmpty())
-        player->setPlaylist(media_files);
+        player->setPlaylistModel(&playlist);
+
+        result = app.exec();
+    }
 
-    result = app.exec();
+    // the engine took the player with it, wait for its pipeline to go away
+    QGstPlayer::Player::waitForPendingTeardowns();
 
     gst_deinit ();
     return result;
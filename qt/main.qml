@@ -24,7 +24,6 @@ import QtQuick.Controls.Styles 1.3
 import QtQuick.Dialogs 1.2
 import QtQuick.Window 2.1
 import Player 1.0
-import org.freedesktop.gstreamer.GLVideoItem 1.0
 import ImageSample 1.0
 
 import "fontawesome.js" as FontAwesome
@@ -43,9 +42,15 @@ ApplicationWindow {
         id: player
         objectName: "player"
         volume: 0.5
-        positionUpdateInterval: 100
+        // the slider extrapolates the position itself, see positionTimer
+        positionUpdateInterval: 1000
         autoPlay: false
 
+        onPositionUpdated: {
+            if (!slider.pressed)
+                slider.value = new_position
+        }
+
         onStateChanged: {
             if (state === Player.STOPPED) {
                 playbutton.state = "play"
@@ -60,13 +65,14 @@ ApplicationWindow {
         }
     }
 
-    GstGLVideoItem {
+    // the GL item can only be imported when qmlglsink is available
+    Loader {
         id: video
-        objectName: "videoItem"
         anchors.centerIn: parent
         width: parent.width
         height: parent.height
         visible: player.videoAvailable
+        source: softwareRendering ? "SoftwareVideoOutput.qml" : "GLVideoOutput.qml"
     }
 
     ImageSample {
@@ -93,12 +99,21 @@ ApplicationWindow {
         onTriggered: {
             if (!playbarMouseArea.containsMouse) {
                 playbar.opacity = 0.0
+                playlist.visible = false
                 settings.visible = false
             }
             stop()
         }
     }
 
+    Timer {
+        id: positionTimer
+        interval: 16
+        repeat: true
+        running: player.state === Player.PLAYING && !slider.pressed
+        onTriggered: slider.value = player.extrapolatedPosition()
+    }
+
     FileDialog {
         id: fileDialog
         //nameFilters: [TODO globs from mime types]
@@ -138,6 +153,81 @@ ApplicationWindow {
                 hoverEnabled: true
             }
 
+            Rectangle {
+                id: playlist
+                width: 300
+                height: Math.min(playlistView.contentHeight, window.height / 2)
+                color: Qt.rgba(1, 1, 1, 0.7)
+                anchors.left: parent.left
+                anchors.bottom: parent.top
+                anchors.bottomMargin: 3
+                border.width: 1
+                border.color: "white"
+                radius: 5
+                visible: false
+
+                Component {
+                    id: playlistDelegate
+                    Item {
+                        width: 300; height: 40
+
+                        // probed in the background, see PlaylistModel
+                        Image {
+                            id: thumbnail
+                            source: model.thumbnail
+                            width: 60; height: 34
+                            fillMode: Image.PreserveAspectFit
+                            sourceSize.width: 120
+                            sourceSize.height: 68
+                            // evicted thumbnails are asked for again
+                            cache: false
+                            anchors.left: parent.left
+                            anchors.leftMargin: 5
+                            anchors.verticalCenter: parent.verticalCenter
+                        }
+
+                        Text {
+                            text: model.title
+                            font.pixelSize: 13
+                            font.bold: model.uri == player.source
+                            elide: Text.ElideRight
+                            anchors.left: thumbnail.right
+                            anchors.leftMargin: 5
+                            anchors.right: duration.left
+                            anchors.rightMargin: 5
+                            anchors.verticalCenter: parent.verticalCenter
+                        }
+
+                        Text {
+                            id: duration
+                            font.pixelSize: 13
+                            text: {
+                                if (model.duration < 0)
+                                    return ""
+                                var length = new Date(Math.floor(model.duration / 1e6));
+                                return length.getMinutes() + ":" + ('0'+length.getSeconds()).slice(-2)
+                            }
+                            anchors.right: parent.right
+                            anchors.rightMargin: 10
+                            anchors.verticalCenter: parent.verticalCenter
+                        }
+
+                        MouseArea {
+                           anchors.fill: parent
+                           onClicked: player.setPlaylistIndex(index)
+                        }
+                    }
+                }
+
+                ListView {
+                    id: playlistView
+                    anchors.fill: parent
+                    clip: true
+                    model: playlistModel
+                    delegate: playlistDelegate
+                }
+            }
+
             Rectangle {
                 id: settings
                 width: 150; height: settingsView.contentHeight
@@ -618,6 +708,18 @@ ApplicationWindow {
 
                 }
 
+                Text {
+                    id: playlistButton
+                    font.pixelSize: 17
+                    font.family: "FontAwesome"
+                    text: FontAwesome.Icon.List
+
+                    MouseArea {
+                        anchors.fill: parent
+                        onClicked: playlist.visible = !playlist.visible
+                    }
+                }
+
                 Text {
                     id: cog
                     font.pixelSize: 17
@@ -666,7 +768,6 @@ ApplicationWindow {
                 Slider {
                     id: slider
                     maximumValue: player.duration
-                    value: player.position
                     onPressedChanged: player.seek(value)
                     onValueChanged: {
                         if (pressed)
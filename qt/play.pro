@@ -1,6 +1,6 @@
 TEMPLATE = app
 
-QT += qml quick widgets
+QT += qml quick widgets concurrent
 
 CONFIG += c++11
 
@@ -20,8 +20,12 @@ QT_CONFIG -= no-pkg-config
 CONFIG += link_pkgconfig
 PKGCONFIG = \
     gstreamer-1.0 \
+    gstreamer-app-1.0 \
+    gstreamer-base-1.0 \
+    gstreamer-pbutils-1.0 \
     gstreamer-player-1.0 \
-    gstreamer-tag-1.0
+    gstreamer-tag-1.0 \
+    gstreamer-video-1.0
 }
 
 macx {
@@ -33,16 +37,27 @@ macx {
         -F/Library/Frameworks -framework GStreamer
 }
 
+INCLUDEPATH += ../common
+
 HEADERS += \
+    ../common/gst-player-state-snapshot.h \
+    ../common/gst-player-frame-pacing.h \
     qgstplayer.h \
     player.h \
+    playlistmodel.h \
     quickrenderer.h \
+    softwarerenderer.h \
+    videoitemrenderer.h \
     imagesample.h
 
 SOURCES += main.cpp \
+    ../common/gst-player-state-snapshot.c \
+    ../common/gst-player-frame-pacing.c \
     qgstplayer.cpp \
     player.cpp \
+    playlistmodel.cpp \
     quickrenderer.cpp \
+    softwarerenderer.cpp \
     imagesample.cpp
 
 DISTFILES +=
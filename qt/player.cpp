@@ -20,22 +20,75 @@
  */
 
 #include "player.h"
+#include "playlistmodel.h"
 #include "quickrenderer.h"
+#include "softwarerenderer.h"
+
+static bool useSoftwareRenderer = false;
 
 Player::Player(QObject *parent)
-    : Player(parent, new QuickRenderer)
+    : Player(parent, createRenderer())
 {
 
 }
 
-Player::Player(QObject *parent, QuickRenderer *renderer)
+Player::Player(QObject *parent, VideoItemRenderer *renderer)
     : QGstPlayer::Player(parent, renderer)
     , renderer_(renderer)
 {
     renderer_->setParent(this);
 }
 
+VideoItemRenderer *Player::createRenderer()
+{
+    if (useSoftwareRenderer)
+        return new SoftwareRenderer;
+
+    return new QuickRenderer;
+}
+
 void Player::setVideoOutput(QQuickItem *output)
 {
     renderer_->setVideoItem(output);
 }
+
+void Player::setPlaylistModel(PlaylistModel *model)
+{
+    if (playlistModel_)
+        disconnect(playlistModel_, 0, this, 0);
+
+    playlistModel_ = model;
+    connect(model, SIGNAL(modelReset()), SLOT(onPlaylistReset()));
+    connect(model, SIGNAL(rowsInserted(QModelIndex,int,int)),
+            SLOT(onPlaylistRowsInserted(QModelIndex,int,int)));
+
+    onPlaylistReset();
+}
+
+void Player::onPlaylistReset()
+{
+    QList<QUrl> urls = playlistModel_->urls();
+
+    // the player can't play an empty playlist, it keeps what it has
+    if (!urls.isEmpty())
+        setPlaylist(urls);
+}
+
+void Player::onPlaylistRowsInserted(const QModelIndex &parent, int first,
+                                    int last)
+{
+    Q_UNUSED(parent);
+
+    for (int row = first; row <= last; row++)
+        appendToPlaylist(playlistModel_->urlAt(row));
+}
+
+void Player::setSoftwareRendering(bool software)
+{
+    useSoftwareRenderer = software;
+}
+
+bool Player::softwareRendering()
+{
+    return useSoftwareRenderer;
+}
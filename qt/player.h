@@ -21,11 +21,14 @@
 #ifndef PLAYER_H
 #define PLAYER_H
 
+#include <QModelIndex>
 #include <QObject>
+#include <QPointer>
 #include <QQuickItem>
 #include "qgstplayer.h"
+#include "videoitemrenderer.h"
 
-class QuickRenderer;
+class PlaylistModel;
 
 class Player : public QGstPlayer::Player
 {
@@ -33,10 +36,24 @@ class Player : public QGstPlayer::Player
 public:
     Player(QObject *parent = 0);
     void setVideoOutput(QQuickItem *output);
+    // plays what @model holds and follows its changes
+    void setPlaylistModel(PlaylistModel *model);
+
+    // draw without GL through an appsink, must be set before the QML
+    // engine creates the first player
+    static void setSoftwareRendering(bool software);
+    static bool softwareRendering();
+
+private slots:
+    void onPlaylistReset();
+    void onPlaylistRowsInserted(const QModelIndex &parent, int first,
+                                int last);
 
 private:
-    Player(QObject *parent, QuickRenderer *renderer);
-    QuickRenderer *renderer_;
+    static VideoItemRenderer *createRenderer();
+    Player(QObject *parent, VideoItemRenderer *renderer);
+    VideoItemRenderer *renderer_;
+    QPointer<PlaylistModel> playlistModel_;
 };
 
 Q_DECLARE_METATYPE(Player*)
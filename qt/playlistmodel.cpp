@@ -0,0 +1,392 @@
+/* GStreamer
+ *
+ * Copyright (C) 2016 GStreamer developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "playlistmodel.h"
+
+#include <QRunnable>
+#include <QStringList>
+#include <QThread>
+#include <QThreadStorage>
+
+#include <gst/gst.h>
+#include <gst/pbutils/pbutils.h>
+
+// a view shows a few dozen rows at most, anything requested before
+// that has been scrolled past already
+static const int maxPendingRequests = 64;
+static const int maxThumbnailSize = 256;
+// in KiB, see thumbnailCost()
+static const int thumbnailCacheSize = 64 * 1024;
+static const GstClockTime discoverTimeout = 5 * GST_SECOND;
+
+// one discoverer per pool thread, it goes away with the thread once
+// that expired
+class Discoverer
+{
+public:
+    Discoverer()
+        : discoverer_(gst_discoverer_new(discoverTimeout, NULL))
+    {
+    }
+
+    ~Discoverer()
+    {
+        if (discoverer_) g_object_unref(discoverer_);
+    }
+
+    GstDiscoverer *get() const { return discoverer_; }
+
+private:
+    GstDiscoverer *discoverer_;
+};
+
+static QThreadStorage<Discoverer*> discoverers;
+
+static int thumbnailCost(const QImage &image)
+{
+    return qMax(1, image.byteCount() / 1024);
+}
+
+static QImage imageFromTags(const GstTagList *tags)
+{
+    GstSample *sample = NULL;
+    QImage image;
+
+    if (!gst_tag_list_get_sample(tags, GST_TAG_IMAGE, &sample) &&
+        !gst_tag_list_get_sample(tags, GST_TAG_PREVIEW_IMAGE, &sample))
+        return image;
+
+    GstBuffer *buffer = gst_sample_get_buffer(sample);
+    GstMapInfo map_info;
+
+    if (buffer && gst_buffer_map(buffer, &map_info, GST_MAP_READ)) {
+        image = QImage::fromData(map_info.data, map_info.size);
+        gst_buffer_unmap(buffer, &map_info);
+    }
+    gst_sample_unref(sample);
+
+    if (image.width() > maxThumbnailSize || image.height() > maxThumbnailSize)
+        image = image.scaled(maxThumbnailSize, maxThumbnailSize,
+                             Qt::KeepAspectRatio, Qt::SmoothTransformation);
+
+    return image;
+}
+
+class DiscoverTask : public QRunnable
+{
+public:
+    DiscoverTask(PlaylistModel *model, int generation, int row, const QUrl &url)
+        : model_(model)
+        , generation_(generation)
+        , row_(row)
+        , url_(url)
+    {
+    }
+
+    void run();
+
+private:
+    // the model waits for all tasks before it goes away
+    PlaylistModel *model_;
+    int generation_;
+    int row_;
+    QUrl url_;
+};
+
+void DiscoverTask::run()
+{
+    if (!discoverers.hasLocalData())
+        discoverers.setLocalData(new Discoverer);
+
+    GstDiscoverer *discoverer = discoverers.localData()->get();
+    QString title;
+    qint64 duration = -1;
+    QImage thumbnail;
+
+    if (discoverer) {
+        QByteArray uri = url_.toEncoded();
+        GstDiscovererInfo *info =
+            gst_discoverer_discover_uri(discoverer, uri.constData(), NULL);
+
+        if (info) {
+            const GstTagList *tags = gst_discoverer_info_get_tags(info);
+            gchar *str = NULL;
+
+            duration = gst_discoverer_info_get_duration(info);
+            if (tags && gst_tag_list_get_string(tags, GST_TAG_TITLE, &str)) {
+                title = QString::fromUtf8(str);
+                g_free(str);
+            }
+            if (tags)
+                thumbnail = imageFromTags(tags);
+
+            gst_discoverer_info_unref(info);
+        }
+    }
+
+    QMetaObject::invokeMethod(model_, "onDiscovered", Qt::QueuedConnection,
+                              Q_ARG(int, generation_), Q_ARG(int, row_),
+                              Q_ARG(QString, title), Q_ARG(qint64, duration),
+                              Q_ARG(QImage, thumbnail));
+}
+
+PlaylistModel::PlaylistModel(QObject *parent)
+    : QAbstractListModel(parent)
+    , generation_(0)
+    , thumbnails_(thumbnailCacheSize)
+    , running_(0)
+{
+    // probing is mostly waiting for I/O, but never starve the playback
+    pool_.setMaxThreadCount(qBound(1, QThread::idealThreadCount() / 2, 4));
+}
+
+PlaylistModel::~PlaylistModel()
+{
+    pool_.clear();
+    pool_.waitForDone();
+}
+
+int PlaylistModel::rowCount(const QModelIndex &parent) const
+{
+    if (parent.isValid())
+        return 0;
+
+    return entries_.size();
+}
+
+int PlaylistModel::count() const
+{
+    return entries_.size();
+}
+
+QHash<int, QByteArray> PlaylistModel::roleNames() const
+{
+    QHash<int, QByteArray> roles;
+
+    roles[UriRole] = "uri";
+    roles[TitleRole] = "title";
+    roles[DurationRole] = "duration";
+    roles[ThumbnailRole] = "thumbnail";
+    roles[DiscoveredRole] = "discovered";
+
+    return roles;
+}
+
+// Views only ask for the rows they are about to show, so this is where
+// probing is triggered
+QVariant PlaylistModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= entries_.size())
+        return QVariant();
+
+    int row = index.row();
+    const Entry &entry = entries_.at(row);
+
+    switch (role) {
+    case UriRole:
+        return entry.url;
+    case Qt::DisplayRole:
+    case TitleRole:
+        if (!entry.discovered)
+            request(row);
+        if (!entry.title.isEmpty())
+            return entry.title;
+        return entry.url.fileName().isEmpty() ? entry.url.toString()
+                                              : entry.url.fileName();
+    case DurationRole:
+        if (!entry.discovered)
+            request(row);
+        return entry.duration;
+    case ThumbnailRole:
+        if (entry.hasThumbnail && thumbnails_.contains(row))
+            return QUrl(QString("image://playlist/%1/%2/%3").arg(generation_)
+                        .arg(row).arg(entry.thumbnailRevision));
+        // also when it was evicted from the cache in the meantime
+        if (!entry.discovered || entry.hasThumbnail)
+            request(row);
+        return QUrl();
+    case DiscoveredRole:
+        return entry.discovered;
+    default:
+        return QVariant();
+    }
+}
+
+void PlaylistModel::request(int row) const
+{
+    if (queued_.contains(row))
+        return;
+
+    pending_.prepend(row);
+    queued_.insert(row);
+
+    while (pending_.size() > maxPendingRequests)
+        queued_.remove(pending_.takeLast());
+
+    startPending();
+}
+
+void PlaylistModel::startPending() const
+{
+    PlaylistModel *self = const_cast<PlaylistModel*>(this);
+
+    while (running_ < pool_.maxThreadCount() && !pending_.isEmpty()) {
+        int row = pending_.takeFirst();
+
+        running_++;
+        pool_.start(new DiscoverTask(self, generation_, row,
+                                     entries_.at(row).url));
+    }
+}
+
+void PlaylistModel::onDiscovered(int generation, int row, QString title,
+                                 qint64 duration, QImage thumbnail)
+{
+    running_--;
+
+    if (generation == generation_ && row < entries_.size()) {
+        Entry &entry = entries_[row];
+
+        queued_.remove(row);
+        entry.discovered = true;
+        entry.title = title;
+        entry.duration = duration;
+        entry.hasThumbnail = !thumbnail.isNull();
+        if (entry.hasThumbnail) {
+            thumbnails_.insert(row, new QImage(thumbnail),
+                               thumbnailCost(thumbnail));
+            entry.thumbnailRevision++;
+        }
+
+        QModelIndex changed = index(row);
+        emit dataChanged(changed, changed);
+    }
+
+    startPending();
+}
+
+QList<QUrl> PlaylistModel::urls() const
+{
+    QList<QUrl> urls;
+
+    urls.reserve(entries_.size());
+    foreach (const Entry &entry, entries_)
+        urls << entry.url;
+
+    return urls;
+}
+
+QUrl PlaylistModel::urlAt(int row) const
+{
+    if (row < 0 || row >= entries_.size())
+        return QUrl();
+
+    return entries_.at(row).url;
+}
+
+void PlaylistModel::setUrls(const QList<QUrl> &urls)
+{
+    beginResetModel();
+
+    generation_++;
+    pending_.clear();
+    queued_.clear();
+    thumbnails_.clear();
+
+    entries_.clear();
+    entries_.reserve(urls.size());
+    foreach (const QUrl &url, urls) {
+        Entry entry;
+        entry.url = url;
+        entries_.append(entry);
+    }
+
+    endResetModel();
+    emit countChanged();
+}
+
+void PlaylistModel::append(const QUrl &url)
+{
+    Entry entry;
+    entry.url = url;
+
+    beginInsertRows(QModelIndex(), entries_.size(), entries_.size());
+    entries_.append(entry);
+    endInsertRows();
+    emit countChanged();
+}
+
+void PlaylistModel::clear()
+{
+    setUrls(QList<QUrl>());
+}
+
+QImage PlaylistModel::thumbnail(int generation, int row) const
+{
+    if (generation != generation_ || row < 0 || row >= entries_.size())
+        return QImage();
+
+    QImage *thumbnail = thumbnails_.object(row);
+
+    // evicted since the view got the URL, it gets a new one once probed
+    if (!thumbnail) {
+        if (entries_.at(row).hasThumbnail)
+            request(row);
+        return QImage();
+    }
+
+    return *thumbnail;
+}
+
+PlaylistThumbnailProvider::PlaylistThumbnailProvider(PlaylistModel *model)
+    : QQuickImageProvider(QQuickImageProvider::Image)
+    , model_(model)
+{
+}
+
+// @id is "generation/row/revision"
+QImage PlaylistThumbnailProvider::requestImage(const QString &id, QSize *size,
+                                               const QSize &requestedSize)
+{
+    QStringList parts = id.split('/');
+    QImage image;
+
+    if (parts.size() != 3)
+        return image;
+
+    int generation = parts.at(0).toInt();
+    int row = parts.at(1).toInt();
+
+    if (QThread::currentThread() == model_->thread())
+        image = model_->thumbnail(generation, row);
+    else
+        QMetaObject::invokeMethod(model_, "thumbnail",
+                                  Qt::BlockingQueuedConnection,
+                                  Q_RETURN_ARG(QImage, image),
+                                  Q_ARG(int, generation), Q_ARG(int, row));
+
+    if (!image.isNull() && requestedSize.isValid())
+        image = image.scaled(requestedSize, Qt::KeepAspectRatio,
+                             Qt::SmoothTransformation);
+    if (size)
+        *size = image.size();
+
+    return image;
+}
@@ -0,0 +1,132 @@
+/* GStreamer
+ *
+ * Copyright (C) 2016 GStreamer developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef PLAYLISTMODEL_H
+#define PLAYLISTMODEL_H
+
+#include <QAbstractListModel>
+#include <QCache>
+#include <QImage>
+#include <QList>
+#include <QQuickImageProvider>
+#include <QSet>
+#include <QThreadPool>
+#include <QUrl>
+#include <QVector>
+
+// Playlist for QML views. Title, duration and thumbnail of an entry are
+// only probed once a view asks for them, i.e. when its delegate is about
+// to be shown, by a small pool of discoverers in the background. The
+// thumbnail role is an "image://playlist/" URL, served by
+// PlaylistThumbnailProvider
+class PlaylistModel : public QAbstractListModel
+{
+    Q_OBJECT
+    Q_PROPERTY(QList<QUrl> urls READ urls WRITE setUrls NOTIFY countChanged)
+    Q_PROPERTY(int count READ count NOTIFY countChanged)
+
+public:
+    enum Roles {
+        UriRole = Qt::UserRole + 1,
+        TitleRole,
+        DurationRole,
+        ThumbnailRole,
+        DiscoveredRole
+    };
+
+    explicit PlaylistModel(QObject *parent = 0);
+    ~PlaylistModel();
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const;
+    QHash<int, QByteArray> roleNames() const;
+
+    QList<QUrl> urls() const;
+    void setUrls(const QList<QUrl> &urls);
+    int count() const;
+
+    Q_INVOKABLE QUrl urlAt(int row) const;
+    Q_INVOKABLE void append(const QUrl &url);
+    Q_INVOKABLE void clear();
+
+    // for PlaylistThumbnailProvider, a null image if it is not known (anymore)
+    Q_INVOKABLE QImage thumbnail(int generation, int row) const;
+
+signals:
+    void countChanged();
+
+private slots:
+    void onDiscovered(int generation, int row, QString title, qint64 duration,
+                      QImage thumbnail);
+
+private:
+    struct Entry
+    {
+        Entry()
+            : duration(-1), discovered(false), hasThumbnail(false)
+            , thumbnailRevision(0)
+        {
+        }
+
+        QUrl url;
+        QString title;
+        qint64 duration;
+        bool discovered;
+        bool hasThumbnail;
+        // part of the URL, so views load a thumbnail that was probed again
+        int thumbnailRevision;
+    };
+
+    void request(int row) const;
+    void startPending() const;
+
+    QVector<Entry> entries_;
+    // changes whenever rows are reset, late results for old rows are dropped
+    int generation_;
+
+    // thumbnails are the only big part, they are evicted and probed again
+    // when they are needed after a long time
+    mutable QCache<int, QImage> thumbnails_;
+
+    // newest requests first, the oldest are dropped once the view
+    // scrolled past them
+    mutable QList<int> pending_;
+    // pending or being probed right now
+    mutable QSet<int> queued_;
+    mutable int running_;
+    mutable QThreadPool pool_;
+};
+
+// Registered with the QML engine as "playlist". Thumbnails are looked up in
+// the model's thread, also for asynchronous images
+class PlaylistThumbnailProvider : public QQuickImageProvider
+{
+public:
+    // @model has to outlive the engine
+    explicit PlaylistThumbnailProvider(PlaylistModel *model);
+
+    QImage requestImage(const QString &id, QSize *size,
+                        const QSize &requestedSize);
+
+private:
+    PlaylistModel *model_;
+};
+
+#endif // PLAYLISTMODEL_H
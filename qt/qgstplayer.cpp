@@ -26,9 +26,17 @@
 #include <QThread>
 #include <QtAlgorithms>
 #include <QImage>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QQueue>
+#include <QWaitCondition>
+#include <QFutureWatcher>
+#include <QtConcurrent>
+#include <QThreadPool>
 
 #include <gst/gst.h>
 #include <gst/tag/tag.h>
+#include <gst/video/video.h>
 
 namespace QGstPlayer {
 
@@ -42,6 +50,94 @@ public:
 
 } _register;
 
+// Stopping a player and freeing its pipeline can block for a long time, e.g.
+// with network sources, so it happens on a background thread instead of the
+// GUI thread. Once maxPendingTeardowns are still in flight the caller blocks
+// again, so closed players can not pile up
+class PlayerReaper : public QThread
+{
+public:
+    PlayerReaper()
+        : outstanding_(0)
+        , quit_(false)
+    {
+    }
+
+    static PlayerReaper *instance(bool create = true)
+    {
+        static PlayerReaper *reaper = 0;
+
+        if (!reaper && create) {
+            reaper = new PlayerReaper;
+            reaper->start();
+        }
+
+        return reaper;
+    }
+
+    void dispose(GstPlayer *player)
+    {
+        QMutexLocker locker(&lock_);
+
+        if (quit_ || outstanding_ >= maxPendingTeardowns) {
+            locker.unlock();
+            teardown(player);
+            return;
+        }
+
+        outstanding_++;
+        queue_.enqueue(player);
+        cond_.wakeAll();
+    }
+
+    void shutdown()
+    {
+        {
+            QMutexLocker locker(&lock_);
+            quit_ = true;
+            cond_.wakeAll();
+        }
+
+        wait();
+    }
+
+protected:
+    void run()
+    {
+        QMutexLocker locker(&lock_);
+
+        forever {
+            while (queue_.isEmpty() && !quit_)
+                cond_.wait(&lock_);
+
+            if (queue_.isEmpty())
+                break;
+
+            GstPlayer *player = queue_.dequeue();
+            locker.unlock();
+            teardown(player);
+            locker.relock();
+
+            outstanding_--;
+        }
+    }
+
+private:
+    static const int maxPendingTeardowns = 4;
+
+    static void teardown(GstPlayer *player)
+    {
+        gst_player_stop(player);
+        g_object_unref(player);
+    }
+
+    QMutex lock_;
+    QWaitCondition cond_;
+    QQueue<GstPlayer*> queue_;
+    int outstanding_;
+    bool quit_;
+};
+
 MediaInfo::MediaInfo(Player *player)
     : QObject(player)
     , uri_()
@@ -389,20 +485,32 @@ void Player::setPositionUpdateInterval(quint32 interval)
 Player::Player(QObject *parent, VideoRenderer *renderer)
     : QObject(parent)
     , player_()
+    , snapshot_()
+    , dispatcher_()
+    , videoRenderer_(renderer)
     , state_(STOPPED)
     , videoDimensions_(QSize())
     , mediaInfo_()
     , videoAvailable_(false)
     , subtitleEnabled_(false)
     , autoPlay_(false)
+    , clock_()
+    , snapshotClockTime_(GST_CLOCK_TIME_NONE)
+    , snapshotPosition_(GST_CLOCK_TIME_NONE)
+    , snapshotRate_(1.0)
+    , videoSnapshotRequests_(0)
 {
 
+    dispatcher_ = gst_player_qt_signal_dispatcher_new(this);
     player_ = gst_player_new(renderer ? renderer->renderer() : 0,
-        gst_player_qt_signal_dispatcher_new(this));
+        static_cast<GstPlayerSignalDispatcher*>(g_object_ref(dispatcher_)));
+    // must see the signals before our own handlers below
+    snapshot_ = gst_player_state_snapshot_new(player_);
 
     g_object_connect(player_,
         "swapped-signal::state-changed", G_CALLBACK (Player::onStateChanged), this,
         "swapped-signal::position-updated", G_CALLBACK (Player::onPositionUpdated), this,
+        "swapped-signal::seek-done", G_CALLBACK (Player::onSeekDone), this,
         "swapped-signal::duration-changed", G_CALLBACK (Player::onDurationChanged), this,
         "swapped-signal::buffering", G_CALLBACK (Player::onBufferingChanged), this,
         "swapped-signal::video-dimensions-changed", G_CALLBACK (Player::onVideoDimensionsChanged), this,
@@ -419,9 +527,138 @@ Player::~Player()
 {
     if (player_) {
       g_signal_handlers_disconnect_by_data(player_, this);
-      gst_player_stop(player_);
-      g_object_unref(player_);
+      gst_player_state_snapshot_free(snapshot_);
+      // signals still in flight must not reach us anymore
+      g_object_set(dispatcher_, "player", NULL, NULL);
+      PlayerReaper::instance()->dispose(player_);
     }
+    if (dispatcher_) g_object_unref(dispatcher_);
+    if (clock_) gst_object_unref(clock_);
+}
+
+void Player::waitForPendingTeardowns()
+{
+    PlayerReaper *reaper = PlayerReaper::instance(false);
+
+    // video snapshots still being converted hold on to their player
+    QThreadPool::globalInstance()->waitForDone();
+
+    if (reaper)
+        reaper->shutdown();
+}
+
+void Player::updatePositionSnapshot(GstClockTime position)
+{
+    GstElement *pipeline = gst_player_get_pipeline(player_);
+    GstClock *clock = gst_element_get_clock(pipeline);
+    gst_object_unref(pipeline);
+
+    gst_object_replace(reinterpret_cast<GstObject **>(&clock_),
+        GST_OBJECT_CAST(clock));
+    if (clock) gst_object_unref(clock);
+
+    snapshotClockTime_ = clock_ ? gst_clock_get_time(clock_) : GST_CLOCK_TIME_NONE;
+    snapshotPosition_ = position;
+    snapshotRate_ = gst_player_get_rate(player_);
+}
+
+qint64 Player::extrapolatedPosition() const
+{
+    if (!GST_CLOCK_TIME_IS_VALID(snapshotPosition_))
+        return 0;
+
+    if (state_ != PLAYING || !clock_
+        || !GST_CLOCK_TIME_IS_VALID(snapshotClockTime_))
+        return snapshotPosition_;
+
+    GstClockTimeDiff elapsed = GST_CLOCK_DIFF(snapshotClockTime_,
+        gst_clock_get_time(clock_));
+    qreal position = snapshotPosition_ + elapsed * snapshotRate_;
+    GstClockTime dur = duration();
+
+    if (position < 0)
+        return 0;
+    if (GST_CLOCK_TIME_IS_VALID(dur) && position > dur)
+        return dur;
+
+    return position;
+}
+
+static void unmapVideoFrame(void *info)
+{
+    GstVideoFrame *frame = static_cast<GstVideoFrame*>(info);
+
+    gst_video_frame_unmap(frame);
+    g_slice_free(GstVideoFrame, frame);
+}
+
+// runs on a worker thread, takes over the reference to the player
+static QImage takeVideoSnapshot(GstPlayer *player, QSize size,
+                                QImage::Format format)
+{
+    GstStructure *config = gst_structure_new_empty("config");
+    GstPlayerSnapshotFormat nativeFormat =
+        Q_BYTE_ORDER == Q_LITTLE_ENDIAN ? GST_PLAYER_THUMBNAIL_RAW_BGRx
+                                        : GST_PLAYER_THUMBNAIL_RAW_xRGB;
+
+    if (size.width() > 0)
+        gst_structure_set(config, "width", G_TYPE_INT, size.width(), NULL);
+    if (size.height() > 0)
+        gst_structure_set(config, "height", G_TYPE_INT, size.height(), NULL);
+
+    GstSample *sample = gst_player_get_video_snapshot(player, nativeFormat,
+                                                      config);
+    gst_structure_free(config);
+    g_object_unref(player);
+
+    if (!sample)
+        return QImage();
+
+    GstVideoInfo info;
+    GstVideoFrame *frame = g_slice_new(GstVideoFrame);
+    QImage image;
+
+    if (gst_video_info_from_caps(&info, gst_sample_get_caps(sample)) &&
+        gst_video_frame_map(frame, &info, gst_sample_get_buffer(sample),
+                            GST_MAP_READ)) {
+        // no copy, the frame stays mapped for as long as the image lives
+        image = QImage(static_cast<const uchar*>(GST_VIDEO_FRAME_PLANE_DATA(frame, 0)),
+                       GST_VIDEO_FRAME_WIDTH(frame), GST_VIDEO_FRAME_HEIGHT(frame),
+                       GST_VIDEO_FRAME_PLANE_STRIDE(frame, 0),
+                       QImage::Format_RGB32, unmapVideoFrame, frame);
+        if (format != QImage::Format_RGB32)
+            image = image.convertToFormat(format);
+    } else {
+        g_slice_free(GstVideoFrame, frame);
+    }
+    gst_sample_unref(sample);
+
+    return image;
+}
+
+QFuture<QImage> Player::videoSnapshot(const QSize &size,
+                                      QImage::Format format) const
+{
+    Q_ASSERT(player_ != 0);
+
+    // converting the frame runs a small pipeline, never do that here
+    return QtConcurrent::run(takeVideoSnapshot,
+                             static_cast<GstPlayer*>(g_object_ref(player_)),
+                             size, format);
+}
+
+int Player::requestVideoSnapshot(const QSize &size)
+{
+    int request = ++videoSnapshotRequests_;
+    QFutureWatcher<QImage> *watcher = new QFutureWatcher<QImage>(this);
+
+    connect(watcher, &QFutureWatcher<QImage>::finished, this, [=]() {
+        emit videoSnapshotReady(request, watcher->result());
+        watcher->deleteLater();
+    });
+    watcher->setFuture(videoSnapshot(size));
+
+    return request;
 }
 
 void
@@ -429,12 +666,34 @@ Player::onStateChanged(Player * player, GstPlayerState state)
 {
     player->state_ =  static_cast<Player::State>(state);
 
+    if (state == GST_PLAYER_STATE_STOPPED) {
+        gst_object_replace(reinterpret_cast<GstObject **>(&player->clock_),
+            NULL);
+        player->snapshotPosition_ = GST_CLOCK_TIME_NONE;
+    } else {
+        player->updatePositionSnapshot(
+            gst_player_get_position(player->player_));
+    }
+
     emit player->stateChanged(player->state_);
 }
 
 void
 Player::onPositionUpdated(Player * player, GstClockTime position)
 {
+    player->updatePositionSnapshot(position);
+
+    emit player->positionUpdated(position);
+    // the renderer counts frames as they go, refresh the stats along with
+    // the position instead of once per frame
+    emit player->frameStatsChanged();
+}
+
+void
+Player::onSeekDone(Player * player, GstClockTime position)
+{
+    player->updatePositionSnapshot(position);
+
     emit player->positionUpdated(position);
 }
 
@@ -535,6 +794,28 @@ void Player::setPlaylist(const QList<QUrl> &playlist)
     setUri(*iter_);
 }
 
+void Player::setPlaylistIndex(int index)
+{
+    if (index < 0 || index >= playlist_.size())
+        return;
+
+    iter_ = playlist_.begin() + index;
+    setUri(*iter_);
+}
+
+void Player::appendToPlaylist(const QUrl &url)
+{
+    bool empty = playlist_.isEmpty();
+    // appending can invalidate the iterator
+    int index = empty ? 0 : iter_ - playlist_.begin();
+
+    playlist_.append(url);
+    iter_ = playlist_.begin() + index;
+
+    if (empty)
+        setUri(*iter_);
+}
+
 void Player::next()
 {
     if (playlist_.isEmpty())
@@ -571,6 +852,22 @@ void Player::setAutoPlay(bool auto_play)
     }
 }
 
+QVariantMap Player::frameStats() const
+{
+    return videoRenderer_ ? videoRenderer_->frameStats() : QVariantMap();
+}
+
+bool Player::adaptiveFrameDropping() const
+{
+    return videoRenderer_ ? videoRenderer_->adaptiveFrameDropping() : false;
+}
+
+void Player::setAdaptiveFrameDropping(bool adaptive)
+{
+    if (videoRenderer_)
+        videoRenderer_->setAdaptiveFrameDropping(adaptive);
+}
+
 QUrl Player::source() const
 {
     Q_ASSERT(player_ != 0);
@@ -582,16 +879,22 @@ QUrl Player::source() const
 
 qint64 Player::duration() const
 {
-    Q_ASSERT(player_ != 0);
+    Q_ASSERT(snapshot_ != 0);
+
+    GstPlayerStateSnapshotData data;
+    gst_player_state_snapshot_read(snapshot_, &data);
 
-    return gst_player_get_duration(player_);
+    return data.duration;
 }
 
 qint64 Player::position() const
 {
-    Q_ASSERT(player_ != 0);
+    Q_ASSERT(snapshot_ != 0);
+
+    GstPlayerStateSnapshotData data;
+    gst_player_state_snapshot_read(snapshot_, &data);
 
-    return gst_player_get_position(player_);
+    return data.position;
 }
 
 qreal Player::volume() const
@@ -610,7 +913,12 @@ bool Player::isMuted() const
 
 int Player::buffering() const
 {
-    return 0;
+    Q_ASSERT(snapshot_ != 0);
+
+    GstPlayerStateSnapshotData data;
+    gst_player_state_snapshot_read(snapshot_, &data);
+
+    return data.buffering_percent;
 }
 
 QSize Player::resolution() const
@@ -714,6 +1022,20 @@ VideoRenderer::~VideoRenderer()
     if (renderer_) gst_object_unref(renderer_);
 }
 
+QVariantMap VideoRenderer::frameStats() const
+{
+    return QVariantMap();
+}
+
+bool VideoRenderer::adaptiveFrameDropping() const
+{
+    return false;
+}
+
+void VideoRenderer::setAdaptiveFrameDropping(bool)
+{
+}
+
 }
 
 struct _GstPlayerQtVideoRenderer
@@ -836,6 +1158,7 @@ struct _GstPlayerQtSignalDispatcher
 {
   GObject parent;
 
+  GMutex lock;
   gpointer player;
 };
 
@@ -867,6 +1190,11 @@ static GParamSpec
 static void
 gst_player_qt_signal_dispatcher_finalize (GObject * object)
 {
+  GstPlayerQtSignalDispatcher *self =
+      GST_PLAYER_QT_SIGNAL_DISPATCHER (object);
+
+  g_mutex_clear (&self->lock);
+
   G_OBJECT_CLASS
       (gst_player_qt_signal_dispatcher_parent_class)->finalize
       (object);
@@ -881,7 +1209,9 @@ gst_player_qt_signal_dispatcher_set_property (GObject * object,
 
   switch (prop_id) {
     case QT_SIGNAL_DISPATCHER_PROP_PLAYER:
+      g_mutex_lock (&self->lock);
       self->player = g_value_get_pointer (value);
+      g_mutex_unlock (&self->lock);
       break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
@@ -898,7 +1228,9 @@ gst_player_qt_signal_dispatcher_get_property (GObject * object,
 
   switch (prop_id) {
     case QT_SIGNAL_DISPATCHER_PROP_PLAYER:
+      g_mutex_lock (&self->lock);
       g_value_set_pointer (value, self->player);
+      g_mutex_unlock (&self->lock);
       break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
@@ -931,9 +1263,9 @@ static void
 
 static void
 gst_player_qt_signal_dispatcher_init
-    (G_GNUC_UNUSED GstPlayerQtSignalDispatcher * self)
+    (GstPlayerQtSignalDispatcher * self)
 {
-
+  g_mutex_init (&self->lock);
 }
 
 static void
@@ -943,12 +1275,22 @@ gst_player_qt_signal_dispatcher_dispatch (GstPlayerSignalDispatcher
 {
   GstPlayerQtSignalDispatcher *self = GST_PLAYER_QT_SIGNAL_DISPATCHER (iface);
   QObject dispatch;
+
+  // the player might be on its way to the reaper already
+  g_mutex_lock (&self->lock);
+  if (!self->player) {
+    g_mutex_unlock (&self->lock);
+    if (destroy) destroy(data);
+    return;
+  }
+
   QObject *receiver = static_cast<QObject*>(self->player);
 
   QObject::connect(&dispatch, &QObject::destroyed, receiver, [=]() {
     emitter(data);
     if (destroy) destroy(data);
   }, Qt::QueuedConnection);
+  g_mutex_unlock (&self->lock);
 }
 
 static void
@@ -28,7 +28,9 @@
 #include <QVariant>
 #include <QList>
 #include <QImage>
+#include <QFuture>
 #include <gst/player/player.h>
+#include "gst-player-state-snapshot.h"
 
 namespace QGstPlayer {
 
@@ -61,6 +63,9 @@ class Player : public QObject
                NOTIFY subtitleEnabledChanged)
     Q_PROPERTY(bool autoPlay READ autoPlay WRITE setAutoPlay)
     Q_PROPERTY(QList<QUrl> playlist READ playlist WRITE setPlaylist)
+    Q_PROPERTY(QVariantMap frameStats READ frameStats NOTIFY frameStatsChanged)
+    Q_PROPERTY(bool adaptiveFrameDropping READ adaptiveFrameDropping
+               WRITE setAdaptiveFrameDropping)
 
     Q_ENUMS(State)
 
@@ -95,6 +100,22 @@ public:
     quint32 positionUpdateInterval() const;
     bool autoPlay() const;
     QList<QUrl> playlist() const;
+    QVariantMap frameStats() const;
+    bool adaptiveFrameDropping() const;
+
+    // players are torn down in the background, call before gst_deinit()
+    static void waitForPendingTeardowns();
+
+    // position extrapolated from the last clock snapshot, no player query
+    Q_INVOKABLE qint64 extrapolatedPosition() const;
+
+    // The frame currently shown, converted on a worker thread. An invalid
+    // size keeps the video size, with only one dimension set the other one
+    // follows the display aspect ratio
+    QFuture<QImage> videoSnapshot(const QSize &size = QSize(),
+                                  QImage::Format format = QImage::Format_RGB32) const;
+    // for QML, the result comes with videoSnapshotReady()
+    Q_INVOKABLE int requestVideoSnapshot(const QSize &size = QSize());
 
 signals:
     void stateChanged(State new_state);
@@ -109,6 +130,8 @@ signals:
     void sourceChanged(QUrl new_url);
     void videoAvailableChanged(bool videoAvailable);
     void subtitleEnabledChanged(bool enabled);
+    void videoSnapshotReady(int request, QImage image);
+    void frameStatsChanged();
 
 public slots:
     void play();
@@ -125,14 +148,20 @@ public slots:
     void setSubtitleEnabled(bool enabled);
     void setPositionUpdateInterval(quint32 interval);
     void setPlaylist(const QList<QUrl> &playlist);
+    // plays the item at @index of the playlist
+    void setPlaylistIndex(int index);
+    // keeps playing the current item, or starts with @url if there was none
+    void appendToPlaylist(const QUrl &url);
     void next();
     void previous();
     void setAutoPlay(bool auto_play);
+    void setAdaptiveFrameDropping(bool adaptive);
 
 private:
     Q_DISABLE_COPY(Player)
     static void onStateChanged(Player *, GstPlayerState state);
     static void onPositionUpdated(Player *, GstClockTime position);
+    static void onSeekDone(Player *, GstClockTime position);
     static void onDurationChanged(Player *, GstClockTime duration);
     static void onBufferingChanged(Player *, int percent);
     static void onVideoDimensionsChanged(Player *, int w, int h);
@@ -142,8 +171,12 @@ private:
     static void onEndOfStreamReached(Player *);
 
     void setUri(QUrl url);
+    void updatePositionSnapshot(GstClockTime position);
 
     GstPlayer *player_;
+    GstPlayerStateSnapshot *snapshot_;
+    GstPlayerSignalDispatcher *dispatcher_;
+    VideoRenderer *videoRenderer_;
     State state_;
     QSize videoDimensions_;
     MediaInfo *mediaInfo_;
@@ -152,6 +185,11 @@ private:
     bool autoPlay_;
     QList<QUrl> playlist_;
     QList<QUrl>::iterator iter_;
+    GstClock *clock_;
+    GstClockTime snapshotClockTime_;
+    GstClockTime snapshotPosition_;
+    gdouble snapshotRate_;
+    int videoSnapshotRequests_;
 };
 
 class VideoRenderer
@@ -159,6 +197,12 @@ class VideoRenderer
 public:
     GstPlayerVideoRenderer *renderer();
     virtual GstElement *createVideoSink() = 0;
+
+    // frame pacing, the delays between the intended and the actual
+    // presentation time of the frames
+    virtual QVariantMap frameStats() const;
+    virtual bool adaptiveFrameDropping() const;
+    virtual void setAdaptiveFrameDropping(bool adaptive);
 protected:
     VideoRenderer();
     virtual ~VideoRenderer();
@@ -20,16 +20,60 @@
 
 #include "quickrenderer.h"
 
+#include <QVariantList>
+
+// the pad probes share the pacing state with the renderer, they can
+// outlive it while the player is torn down in the background
+typedef QSharedPointer<GstPlayerFramePacing> Pacing;
+
+static void destroyProbeData(gpointer user_data)
+{
+    delete static_cast<Pacing*>(user_data);
+}
+
+static GstPadProbeReturn onSinkProbe(GstPad *, GstPadProbeInfo *info,
+                                     gpointer user_data)
+{
+    gst_player_frame_pacing_sink_probe(
+        static_cast<Pacing*>(user_data)->data(), info);
+
+    return GST_PAD_PROBE_OK;
+}
+
+static GstPadProbeReturn onBinProbe(GstPad *, GstPadProbeInfo *info,
+                                    gpointer user_data)
+{
+    if (gst_player_frame_pacing_entry_probe(
+            static_cast<Pacing*>(user_data)->data(), info))
+        return GST_PAD_PROBE_DROP;
+
+    return GST_PAD_PROBE_OK;
+}
+
 QuickRenderer::QuickRenderer(QObject *parent)
-    : QObject(parent)
-    , QGstPlayer::VideoRenderer()
+    : VideoItemRenderer(parent)
     , sink()
+    , sinkPad_()
+    , sinkProbe_()
+    , binPad_()
+    , binProbe_()
+    , pacing_(gst_player_frame_pacing_new(), gst_player_frame_pacing_free)
 {
 
 }
 
 QuickRenderer::~QuickRenderer()
 {
+    if (window_)
+        disconnect(window_, 0, this, 0);
+    if (sinkPad_) {
+        gst_pad_remove_probe(sinkPad_, sinkProbe_);
+        gst_object_unref(sinkPad_);
+    }
+    if (binPad_) {
+        gst_pad_remove_probe(binPad_, binProbe_);
+        gst_object_unref(binPad_);
+    }
     if (sink) gst_object_unref(sink);
 }
 
@@ -44,6 +88,21 @@ GstElement *QuickRenderer::createVideoSink()
     g_object_set (glsinkbin, "sink", qmlglsink, NULL);
 
     sink = static_cast<GstElement*>(gst_object_ref_sink(qmlglsink));
+    gst_player_frame_pacing_set_sink(pacing_.data(), sink);
+
+    // the sink's own pad sees the frames as they are handed to the scene
+    // graph, the bin's pad is upstream of the GL upload and conversion
+    sinkPad_ = gst_element_get_static_pad(sink, "sink");
+    sinkProbe_ = gst_pad_add_probe(sinkPad_,
+        static_cast<GstPadProbeType>(GST_PAD_PROBE_TYPE_BUFFER |
+            GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM | GST_PAD_PROBE_TYPE_EVENT_FLUSH),
+        onSinkProbe, new Pacing(pacing_), destroyProbeData);
+
+    binPad_ = gst_element_get_static_pad(glsinkbin, "sink");
+    binProbe_ = gst_pad_add_probe(binPad_,
+        static_cast<GstPadProbeType>(GST_PAD_PROBE_TYPE_BUFFER |
+            GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM | GST_PAD_PROBE_TYPE_EVENT_FLUSH),
+        onBinProbe, new Pacing(pacing_), destroyProbeData);
 
     return glsinkbin;
 }
@@ -53,4 +112,62 @@ void QuickRenderer::setVideoItem(QQuickItem *item)
     Q_ASSERT(item);
 
     g_object_set(sink, "widget", item, NULL);
+
+    connect(item, SIGNAL(windowChanged(QQuickWindow*)),
+            SLOT(onWindowChanged(QQuickWindow*)));
+    onWindowChanged(item->window());
+}
+
+void QuickRenderer::onWindowChanged(QQuickWindow *window)
+{
+    if (window_)
+        disconnect(window_, 0, this, 0);
+
+    window_ = window;
+
+    // emitted from the render thread right after the frame hit the screen
+    if (window_)
+        connect(window_, SIGNAL(frameSwapped()), SLOT(onFrameSwapped()),
+                Qt::DirectConnection);
+}
+
+void QuickRenderer::onFrameSwapped()
+{
+    gst_player_frame_pacing_frame_shown(pacing_.data());
+}
+
+QVariantMap QuickRenderer::frameStats() const
+{
+    GstPlayerFramePacingStats pacing;
+    QVariantMap stats;
+    QVariantList histogram, bounds;
+
+    gst_player_frame_pacing_get_stats(pacing_.data(), &pacing);
+
+    for (size_t i = 0; i < G_N_ELEMENTS(pacing.histogram); i++)
+        histogram << pacing.histogram[i];
+    for (size_t i = 0; i < G_N_ELEMENTS(pacing.histogram_bounds); i++)
+        bounds << pacing.histogram_bounds[i];
+
+    // delays in ms, positive values are late
+    stats["presented"] = pacing.presented;
+    stats["skipped"] = pacing.skipped;
+    stats["droppedEarly"] = pacing.dropped_early;
+    stats["meanDelay"] = double(pacing.mean_delay) / GST_MSECOND;
+    stats["jitter"] = double(pacing.jitter) / GST_MSECOND;
+    stats["maxDelay"] = double(pacing.max_delay) / GST_MSECOND;
+    stats["histogram"] = histogram;
+    stats["histogramBounds"] = bounds;
+
+    return stats;
+}
+
+bool QuickRenderer::adaptiveFrameDropping() const
+{
+    return gst_player_frame_pacing_get_adaptive(pacing_.data());
+}
+
+void QuickRenderer::setAdaptiveFrameDropping(bool adaptive)
+{
+    gst_player_frame_pacing_set_adaptive(pacing_.data(), adaptive);
 }
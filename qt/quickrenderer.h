@@ -23,9 +23,13 @@
 
 #include <QObject>
 #include <QQuickItem>
-#include "qgstplayer.h"
+#include <QQuickWindow>
+#include <QPointer>
+#include <QSharedPointer>
+#include "videoitemrenderer.h"
+#include "gst-player-frame-pacing.h"
 
-class QuickRenderer : public QObject, public QGstPlayer::VideoRenderer
+class QuickRenderer : public VideoItemRenderer
 {
     Q_OBJECT
 public:
@@ -33,10 +37,26 @@ public:
     ~QuickRenderer();
 
     GstElement *createVideoSink();
+
+    QVariantMap frameStats() const;
+    bool adaptiveFrameDropping() const;
+    void setAdaptiveFrameDropping(bool adaptive);
+
+public slots:
     void setVideoItem(QQuickItem *item);
 
+private slots:
+    void onWindowChanged(QQuickWindow *window);
+    void onFrameSwapped();
+
 private:
     GstElement *sink;
+    GstPad *sinkPad_;
+    gulong sinkProbe_;
+    GstPad *binPad_;
+    gulong binProbe_;
+    QPointer<QQuickWindow> window_;
+    QSharedPointer<GstPlayerFramePacing> pacing_;
 };
 
 #endif // QUICKPLAYER_H
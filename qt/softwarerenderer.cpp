@@ -0,0 +1,363 @@
+/* GStreamer
+ *
+ * Copyright (C) 2016 GStreamer developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "softwarerenderer.h"
+
+#include <QAtomicInt>
+#include <QImage>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QPointer>
+#include <QQuickWindow>
+#include <QSGSimpleTextureNode>
+#include <cstring>
+
+#include <gst/app/gstappsink.h>
+#include <gst/video/video.h>
+
+// QImage::Format_RGB32 is 0xffRRGGBB in native byte order
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+static const char nativeFormat[] = "BGRx";
+#else
+static const char nativeFormat[] = "xRGB";
+#endif
+
+// The streaming thread always fills the back frame and then swaps it with
+// the middle one, the render thread swaps the middle one with the front
+// frame whenever a newer one was published. Neither ever waits for the
+// other and no frame memory is reallocated while the format stays the same
+class FrameTripleBuffer
+{
+public:
+    struct Frame
+    {
+        Frame() : wrapped(false) {}
+
+        QImage image;
+        QSizeF displaySize;
+        // image refers to the mapped GstBuffer instead of its own memory
+        bool wrapped;
+    };
+
+    FrameTripleBuffer()
+        : state_(1)
+        , back_(0)
+        , front_(2)
+        , updatePending_(0)
+        , caps_()
+    {
+        gst_video_info_init(&info_);
+    }
+
+    ~FrameTripleBuffer()
+    {
+        if (caps_) gst_caps_unref(caps_);
+    }
+
+    // streaming thread
+    void push(GstSample *sample);
+
+    // scene graph render thread, with the GUI thread blocked
+    bool acquire();
+    const Frame &front() const { return frames_[front_]; }
+
+    void setItem(QQuickItem *item);
+    void updateScheduled() { updatePending_.storeRelease(0); }
+
+    static GstFlowReturn onNewPreroll(GstAppSink *sink, gpointer user_data);
+    static GstFlowReturn onNewSample(GstAppSink *sink, gpointer user_data);
+    static void destroyCallbackData(gpointer user_data);
+
+private:
+    static const int freshBit = 4;
+
+    static void unmapFrame(void *info);
+    void publish();
+    void scheduleUpdate();
+
+    Frame frames_[3];
+    // index of the middle frame, with freshBit set until it was acquired
+    QAtomicInt state_;
+    int back_;
+    int front_;
+
+    QAtomicInt updatePending_;
+    QMutex itemLock_;
+    QPointer<QQuickItem> item_;
+
+    // only touched by the streaming thread
+    GstCaps *caps_;
+    GstVideoInfo info_;
+};
+
+void FrameTripleBuffer::unmapFrame(void *info)
+{
+    GstVideoFrame *frame = static_cast<GstVideoFrame*>(info);
+
+    gst_video_frame_unmap(frame);
+    g_slice_free(GstVideoFrame, frame);
+}
+
+void FrameTripleBuffer::push(GstSample *sample)
+{
+    GstCaps *caps = gst_sample_get_caps(sample);
+    GstBuffer *buffer = gst_sample_get_buffer(sample);
+
+    if (!caps || !buffer)
+        return;
+
+    if (caps != caps_) {
+        if (!gst_video_info_from_caps(&info_, caps))
+            return;
+        gst_caps_replace(&caps_, caps);
+    }
+
+    GstVideoFrame *vframe = g_slice_new(GstVideoFrame);
+    if (!gst_video_frame_map(vframe, &info_, buffer, GST_MAP_READ)) {
+        g_slice_free(GstVideoFrame, vframe);
+        return;
+    }
+
+    const uchar *data = static_cast<const uchar*>(GST_VIDEO_FRAME_PLANE_DATA(vframe, 0));
+    int stride = GST_VIDEO_FRAME_PLANE_STRIDE(vframe, 0);
+    int width = GST_VIDEO_FRAME_WIDTH(vframe);
+    int height = GST_VIDEO_FRAME_HEIGHT(vframe);
+    Frame &frame = frames_[back_];
+
+    if (stride % 4 == 0 && reinterpret_cast<quintptr>(data) % 4 == 0) {
+        // the image keeps the buffer mapped for as long as anything, e.g. a
+        // texture still waiting for its upload, refers to it
+        frame.image = QImage(data, width, height, stride, QImage::Format_RGB32,
+                             unmapFrame, vframe);
+        frame.wrapped = true;
+    } else {
+        if (frame.wrapped || frame.image.size() != QSize(width, height))
+            frame.image = QImage(width, height, QImage::Format_RGB32);
+        frame.wrapped = false;
+
+        // only detaches if a texture still holds on to the previous frame
+        for (int y = 0; y < height; y++)
+            memcpy(frame.image.scanLine(y), data + y * stride, width * 4);
+
+        unmapFrame(vframe);
+    }
+
+    frame.displaySize = QSizeF(qreal(width) * GST_VIDEO_INFO_PAR_N(&info_) /
+                               GST_VIDEO_INFO_PAR_D(&info_), height);
+
+    publish();
+    scheduleUpdate();
+}
+
+void FrameTripleBuffer::publish()
+{
+    back_ = state_.fetchAndStoreOrdered(back_ | freshBit) & ~freshBit;
+}
+
+bool FrameTripleBuffer::acquire()
+{
+    if (!(state_.loadAcquire() & freshBit))
+        return false;
+
+    front_ = state_.fetchAndStoreOrdered(front_) & ~freshBit;
+
+    return true;
+}
+
+void FrameTripleBuffer::setItem(QQuickItem *item)
+{
+    QMutexLocker locker(&itemLock_);
+
+    item_ = item;
+}
+
+// at most one update is queued, however fast frames come in
+void FrameTripleBuffer::scheduleUpdate()
+{
+    if (!updatePending_.testAndSetOrdered(0, 1))
+        return;
+
+    QMutexLocker locker(&itemLock_);
+
+    if (item_)
+        QMetaObject::invokeMethod(item_, "update", Qt::QueuedConnection);
+    else
+        updatePending_.storeRelease(0);
+}
+
+GstFlowReturn FrameTripleBuffer::onNewPreroll(GstAppSink *sink,
+                                              gpointer user_data)
+{
+    FrameTripleBuffer *self =
+        static_cast<QSharedPointer<FrameTripleBuffer>*>(user_data)->data();
+    GstSample *sample = gst_app_sink_pull_preroll(sink);
+
+    if (sample) {
+        self->push(sample);
+        gst_sample_unref(sample);
+    }
+
+    return GST_FLOW_OK;
+}
+
+GstFlowReturn FrameTripleBuffer::onNewSample(GstAppSink *sink,
+                                             gpointer user_data)
+{
+    FrameTripleBuffer *self =
+        static_cast<QSharedPointer<FrameTripleBuffer>*>(user_data)->data();
+    GstSample *sample = gst_app_sink_pull_sample(sink);
+
+    if (sample) {
+        self->push(sample);
+        gst_sample_unref(sample);
+    }
+
+    return GST_FLOW_OK;
+}
+
+void FrameTripleBuffer::destroyCallbackData(gpointer user_data)
+{
+    delete static_cast<QSharedPointer<FrameTripleBuffer>*>(user_data);
+}
+
+SoftwareVideoItem::SoftwareVideoItem(QQuickItem *parent)
+    : QQuickItem(parent)
+{
+    setFlag(ItemHasContents, true);
+}
+
+SoftwareVideoItem::~SoftwareVideoItem()
+{
+    if (frames_)
+        frames_->setItem(0);
+}
+
+void SoftwareVideoItem::setFrames(const QSharedPointer<FrameTripleBuffer> &frames)
+{
+    if (frames_)
+        frames_->setItem(0);
+
+    frames_ = frames;
+
+    if (frames_)
+        frames_->setItem(this);
+    update();
+}
+
+QSGNode *SoftwareVideoItem::updatePaintNode(QSGNode *oldNode,
+                                            UpdatePaintNodeData *)
+{
+    QSGSimpleTextureNode *node = static_cast<QSGSimpleTextureNode*>(oldNode);
+
+    if (!frames_) {
+        delete node;
+        return 0;
+    }
+
+    frames_->updateScheduled();
+
+    if (frames_->acquire() || !node) {
+        const FrameTripleBuffer::Frame &frame = frames_->front();
+
+        if (frame.image.isNull()) {
+            delete node;
+            return 0;
+        }
+
+        if (!node) {
+            node = new QSGSimpleTextureNode;
+            node->setOwnsTexture(true);
+            node->setFiltering(QSGTexture::Linear);
+        }
+
+        // replaces and deletes the previous frame's texture
+        node->setTexture(window()->createTextureFromImage(frame.image,
+            QQuickWindow::TextureIsOpaque));
+        displaySize_ = frame.displaySize;
+    }
+
+    QSizeF size = displaySize_.scaled(boundingRect().size(), Qt::KeepAspectRatio);
+    node->setRect(QRectF(QPointF((width() - size.width()) / 2,
+                                 (height() - size.height()) / 2), size));
+
+    return node;
+}
+
+void SoftwareVideoItem::geometryChanged(const QRectF &newGeometry,
+                                        const QRectF &oldGeometry)
+{
+    QQuickItem::geometryChanged(newGeometry, oldGeometry);
+
+    update();
+}
+
+SoftwareRenderer::SoftwareRenderer(QObject *parent)
+    : VideoItemRenderer(parent)
+    , frames_(new FrameTripleBuffer)
+{
+
+}
+
+SoftwareRenderer::~SoftwareRenderer()
+{
+
+}
+
+GstElement *SoftwareRenderer::createVideoSink()
+{
+    GstElement *bin = gst_bin_new("softwaresinkbin");
+    GstElement *convert = gst_element_factory_make("videoconvert", NULL);
+    GstElement *appsink = gst_element_factory_make("appsink", NULL);
+
+    Q_ASSERT(convert && appsink);
+
+    GstCaps *caps = gst_caps_new_simple("video/x-raw",
+        "format", G_TYPE_STRING, nativeFormat, NULL);
+    // the newest frame is all we need, keep nothing else alive
+    g_object_set(appsink, "caps", caps, "max-buffers", 1, "drop", TRUE,
+                 "enable-last-sample", FALSE, "qos", TRUE, NULL);
+    gst_caps_unref(caps);
+
+    GstAppSinkCallbacks callbacks = GstAppSinkCallbacks();
+    callbacks.new_preroll = FrameTripleBuffer::onNewPreroll;
+    callbacks.new_sample = FrameTripleBuffer::onNewSample;
+    // the streaming thread can outlive us while the player is torn down
+    gst_app_sink_set_callbacks(GST_APP_SINK(appsink), &callbacks,
+        new QSharedPointer<FrameTripleBuffer>(frames_),
+        FrameTripleBuffer::destroyCallbackData);
+
+    gst_bin_add_many(GST_BIN(bin), convert, appsink, NULL);
+    gst_element_link(convert, appsink);
+
+    GstPad *pad = gst_element_get_static_pad(convert, "sink");
+    gst_element_add_pad(bin, gst_ghost_pad_new("sink", pad));
+    gst_object_unref(pad);
+
+    return bin;
+}
+
+void SoftwareRenderer::setVideoItem(QQuickItem *item)
+{
+    SoftwareVideoItem *videoItem = qobject_cast<SoftwareVideoItem*>(item);
+
+    Q_ASSERT(videoItem);
+
+    videoItem->setFrames(frames_);
+}
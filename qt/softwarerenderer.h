@@ -0,0 +1,71 @@
+/* GStreamer
+ *
+ * Copyright (C) 2016 GStreamer developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef SOFTWARERENDERER_H
+#define SOFTWARERENDERER_H
+
+#include <QObject>
+#include <QQuickItem>
+#include <QSharedPointer>
+#include <QSizeF>
+#include "videoitemrenderer.h"
+
+// Latest decoded frames, exchanged between the streaming thread and the
+// scene graph without locks
+class FrameTripleBuffer;
+
+// Video item for the software renderer, it draws the newest frame as a
+// scene graph texture and is only updated when a new frame arrives
+class SoftwareVideoItem : public QQuickItem
+{
+    Q_OBJECT
+public:
+    SoftwareVideoItem(QQuickItem *parent = 0);
+    ~SoftwareVideoItem();
+
+    void setFrames(const QSharedPointer<FrameTripleBuffer> &frames);
+
+protected:
+    QSGNode *updatePaintNode(QSGNode *oldNode, UpdatePaintNodeData *data);
+    void geometryChanged(const QRectF &newGeometry, const QRectF &oldGeometry);
+
+private:
+    QSharedPointer<FrameTripleBuffer> frames_;
+    QSizeF displaySize_;
+};
+
+// Renderer for systems without usable GL, pulls frames from an appsink
+class SoftwareRenderer : public VideoItemRenderer
+{
+    Q_OBJECT
+public:
+    SoftwareRenderer(QObject *parent = 0);
+    ~SoftwareRenderer();
+
+    GstElement *createVideoSink();
+
+public slots:
+    void setVideoItem(QQuickItem *item);
+
+private:
+    QSharedPointer<FrameTripleBuffer> frames_;
+};
+
+#endif // SOFTWARERENDERER_H